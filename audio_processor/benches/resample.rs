@@ -0,0 +1,95 @@
+// Copyright 2024 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//! Compares the cost of `PolyphaseResampler` with `SpeexResampler`.
+//!
+//! Run with `cargo bench --bench resample`.
+
+use std::hint::black_box;
+use std::time::Duration;
+use std::time::Instant;
+
+use audio_processor::processors::PolyphaseResampler;
+use audio_processor::processors::ResampleQuality;
+use audio_processor::processors::SpeexResampler;
+use audio_processor::AudioProcessor;
+use audio_processor::Format;
+use audio_processor::MultiBuffer;
+
+/// Seconds of audio resampled by each measurement.
+const AUDIO_SECONDS: usize = 20;
+
+/// Returns the time to resample `AUDIO_SECONDS` of audio in blocks of
+/// `input_format`.
+fn measure(mut processor: impl AudioProcessor<I = f32, O = f32>, input_format: Format) -> Duration {
+    let mut input = MultiBuffer::from(
+        (0..input_format.channels)
+            .map(|ch| {
+                (0..input_format.block_size)
+                    .map(|i| ((i * (ch + 1)) as f32 * 0.01).sin())
+                    .collect()
+            })
+            .collect::<Vec<Vec<f32>>>(),
+    );
+    let blocks = AUDIO_SECONDS * input_format.frame_rate / input_format.block_size;
+
+    // Warm up caches and filter state.
+    for _ in 0..blocks / 10 {
+        black_box(processor.process(input.as_multi_slice()).unwrap());
+    }
+    let start = Instant::now();
+    for _ in 0..blocks {
+        black_box(
+            processor
+                .process(black_box(input.as_multi_slice()))
+                .unwrap(),
+        );
+    }
+    start.elapsed()
+}
+
+fn main() {
+    println!(
+        "{:>22} {:>10} {:>12} {:>12} {:>12} {:>8}",
+        "rates", "block", "speex", "low", "medium", "speedup"
+    );
+    for (channels, in_rate, out_rate) in [
+        (1, 48000, 16000),
+        (1, 16000, 48000),
+        (1, 48000, 24000),
+        (1, 24000, 48000),
+        (2, 44100, 48000),
+        (2, 48000, 44100),
+    ] {
+        // 10 ms blocks, as used by CRAS.
+        let input_format = Format {
+            channels,
+            block_size: in_rate / 100,
+            frame_rate: in_rate,
+        };
+        let speex = measure(
+            SpeexResampler::new(input_format, out_rate).unwrap(),
+            input_format,
+        );
+        let [low, medium] = [ResampleQuality::Low, ResampleQuality::Medium].map(|quality| {
+            measure(
+                PolyphaseResampler::new(input_format, out_rate, quality).unwrap(),
+                input_format,
+            )
+        });
+        let per_block = |d: Duration| {
+            let blocks = AUDIO_SECONDS * 100;
+            format!("{:.2} us", d.as_secs_f64() * 1e6 / blocks as f64)
+        };
+        println!(
+            "{:>22} {:>10} {:>12} {:>12} {:>12} {:>7.2}x",
+            format!("{channels}ch {in_rate}->{out_rate}"),
+            input_format.block_size,
+            per_block(speex),
+            per_block(low),
+            per_block(medium),
+            speex.as_secs_f64() / medium.as_secs_f64(),
+        );
+    }
+}
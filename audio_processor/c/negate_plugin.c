@@ -13,12 +13,35 @@
 struct negate_processor {
   struct plugin_processor p;
   struct plugin_processor_config config;
+  // Number of blocks |buffers| can hold.
+  size_t max_blocks;
   // Buffer for output data.
   // Ideally we'd be using a 1D array. But a 2D array allows address sanitizer
   // to catch programming errors.
   float* buffers[MULTI_SLICE_MAX_CH];
 };
 
+// Negates input into block |block| of the output buffers.
+static void negate_block(struct negate_processor* np,
+                         const struct multi_slice* input,
+                         struct multi_slice* output,
+                         size_t block) {
+  size_t offset = block * np->config.block_size;
+
+  for (size_t ch = 0; ch < input->channels; ch++) {
+    float* in_ch = input->data[ch];
+    float* out_ch = np->buffers[ch] + offset;
+
+    for (size_t i = 0; i < input->num_frames; i++) {
+      out_ch[i] = -1 * in_ch[i];
+    }
+    output->data[ch] = out_ch;
+  }
+
+  output->channels = input->channels;
+  output->num_frames = input->num_frames;
+}
+
 static enum status negate_processor_run(struct plugin_processor* p,
                                         const struct multi_slice* input,
                                         struct multi_slice* output) {
@@ -32,18 +55,30 @@ static enum status negate_processor_run(struct plugin_processor* p,
     fprintf(stderr, "%s() called\n", __func__);
   }
 
-  for (size_t ch = 0; ch < input->channels; ch++) {
-    float* in_ch = input->data[ch];
-    float* out_ch = np->buffers[ch];
+  negate_block(np, input, output, 0);
+  return StatusOk;
+}
 
-    for (size_t i = 0; i < input->num_frames; i++) {
-      out_ch[i] = -1 * in_ch[i];
-    }
+static enum status negate_processor_process_many(
+    struct plugin_processor* p,
+    const struct multi_slice* inputs,
+    struct multi_slice* outputs,
+    size_t num_blocks) {
+  if (!p) {
+    return ErrInvalidProcessor;
   }
 
-  output->channels = input->channels;
-  output->num_frames = input->num_frames;
-  memcpy(output->data, np->buffers, sizeof(output->data));
+  struct negate_processor* np = (struct negate_processor*)p;
+
+  if (num_blocks > np->max_blocks) {
+    return ErrInvalidArgument;
+  }
+  for (size_t i = 0; i < num_blocks; i++) {
+    if (inputs[i].num_frames > np->config.block_size) {
+      return ErrInvalidArgument;
+    }
+    negate_block(np, &inputs[i], &outputs[i], i);
+  }
   return StatusOk;
 }
 
@@ -78,9 +113,19 @@ static enum status negate_processor_get_output_frame_rate(
   return StatusOk;
 }
 
-enum status negate_processor_create(
-    struct plugin_processor** out,
-    const struct plugin_processor_config* config) {
+static void fill_ext(const struct plugin_processor_config* config,
+                     size_t max_blocks,
+                     struct plugin_processor_ext* ext) {
+  ext->realtime_safe = true;
+  if (max_blocks > 1) {
+    ext->preferred_block_size = config->block_size * max_blocks;
+    ext->process_many = negate_processor_process_many;
+  }
+}
+
+static enum status create(struct plugin_processor** out,
+                          const struct plugin_processor_config* config,
+                          size_t max_blocks) {
   static const struct plugin_processor_ops ops = {
       .run = negate_processor_run,
       .destroy = negate_processor_destroy,
@@ -102,15 +147,44 @@ enum status negate_processor_create(
 
   np->p.ops = &ops;
   np->config = *config;
+  np->config.ext = NULL;
+  np->max_blocks = max_blocks;
 
   for (size_t i = 0; i < config->channels; i++) {
-    np->buffers[i] = calloc(config->block_size, sizeof(*np->buffers[i]));
+    np->buffers[i] =
+        calloc(config->block_size * max_blocks, sizeof(*np->buffers[i]));
     if (!np->buffers[i]) {
       negate_processor_destroy(&np->p);
       return ErrOutOfMemory;
     }
   }
 
+  if (config->ext) {
+    fill_ext(config, max_blocks, config->ext);
+  }
+
   *out = &np->p;
   return StatusOk;
 }
+
+enum status negate_processor_create(
+    struct plugin_processor** out,
+    const struct plugin_processor_config* config) {
+  return create(out, config, 1);
+}
+
+enum status negate_batch_processor_create(
+    struct plugin_processor** out,
+    const struct plugin_processor_config* config) {
+  return create(out, config, NEGATE_BATCH_BLOCKS);
+}
+
+enum status negate_batch_processor_create_query(
+    const struct plugin_processor_config* config,
+    struct plugin_processor_ext* ext) {
+  if (config->channels > MULTI_SLICE_MAX_CH) {
+    return ErrInvalidConfig;
+  }
+  fill_ext(config, NEGATE_BATCH_BLOCKS, ext);
+  return StatusOk;
+}
@@ -15,6 +15,17 @@ enum status negate_processor_create(
     struct plugin_processor** out,
     const struct plugin_processor_config* config);
 
+// Like negate_processor_create, but prefers blocks of
+// NEGATE_BATCH_BLOCKS times the configured block size through process_many.
+#define NEGATE_BATCH_BLOCKS 4
+enum status negate_batch_processor_create(
+    struct plugin_processor** out,
+    const struct plugin_processor_config* config);
+// The processor_query of negate_batch_processor_create.
+enum status negate_batch_processor_create_query(
+    const struct plugin_processor_config* config,
+    struct plugin_processor_ext* ext);
+
 #ifdef __cplusplus
 }
 #endif
@@ -28,12 +28,19 @@ struct plugin_processor {
   const struct plugin_processor_ops* ops;
 };
 
+struct plugin_processor_ext;
+
 // Configuration for plugin_processor.
 struct plugin_processor_config {
   size_t channels;    // Number of input channels.
   size_t block_size;  // Number of input audio frames passed in each iteration.
   size_t frame_rate;  // Number of input frames in each second.
   bool debug;         // Whether to show debug information.
+  // Zeroed by the host and optionally filled by the constructor. NULL if
+  // the host does not use the extension. The storage is owned by the host
+  // and stays valid until destroy returns, but the host reads it only once,
+  // after the constructor returns.
+  struct plugin_processor_ext* ext;
 };
 
 // Reference to multiple slices. Can be used to represent deinterelved audio
@@ -44,6 +51,30 @@ struct multi_slice {
   float* data[MULTI_SLICE_MAX_CH];  // Pointers to the start of each channel.
 };
 
+// Optional properties and methods of a plugin_processor, filled by
+// processor_create through plugin_processor_config.ext. Plugins built
+// against an older version of this header leave everything zero.
+struct plugin_processor_ext {
+  // Number of frames the output is delayed from the input.
+  size_t latency_frames;
+  // The block size the processor works best with, 0 for no preference.
+  // If it is a multiple of the configured block size and process_many is
+  // set, the host may batch blocks with process_many. To be created with
+  // this block size in the first place, export a processor_query.
+  size_t preferred_block_size;
+  // Whether run and process_many never allocate memory, take locks or do
+  // I/O, so they can be called from a real-time thread. Hosts requiring
+  // real-time safety refuse processors leaving this false.
+  bool realtime_safe;
+  // Optional. Like run, but for num_blocks consecutive blocks of the
+  // configured block size. inputs and outputs have num_blocks elements. The
+  // output data is valid until the next call to run or process_many.
+  enum status (*process_many)(struct plugin_processor* p,
+                              const struct multi_slice* inputs,
+                              struct multi_slice* outputs,
+                              size_t num_blocks);
+};
+
 // Create a plugin audio processor. The created processor should be stored in
 // out. On error a status other than StatusOk should be returned.
 //
@@ -52,7 +83,17 @@ typedef enum status (*processor_create)(
     struct plugin_processor** out,
     const struct plugin_processor_config* config);
 
-// Method table for plugin_processor. All functions are required.
+// Optional. Fills ext for a processor that processor_create would create
+// with config, without creating it. config->ext is NULL. A plugin exports
+// it as the constructor's name followed by "_query". The host uses
+// ext->preferred_block_size to choose the block size passed to the
+// constructor, which is only honored if the processor keeps the frame rate.
+typedef enum status (*processor_query)(
+    const struct plugin_processor_config* config,
+    struct plugin_processor_ext* ext);
+
+// Method table for plugin_processor. All functions are required. Optional
+// methods are in plugin_processor_ext.
 struct plugin_processor_ops {
   // Run the plugin audio processor p. The plugin processor should store the
   // result in output.
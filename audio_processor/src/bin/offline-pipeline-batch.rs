@@ -0,0 +1,530 @@
+// Copyright 2024 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//! Runs a corpus of WAVE files through a set of plugins or pipelines, using
+//! all cores, and reports the cost and the output hash of each pipeline.
+//!
+//! Each (pipeline, block size, file) combination is a job. Jobs are pulled
+//! from a shared queue by worker threads, each building its own pipeline, so
+//! the measurements of one job are not affected by the others except through
+//! shared hardware resources.
+
+use std::collections::BTreeMap;
+use std::path::Path;
+use std::path::PathBuf;
+use std::sync::atomic::AtomicUsize;
+use std::sync::atomic::Ordering;
+use std::sync::mpsc::channel;
+use std::time::Duration;
+use std::time::Instant;
+
+use anyhow::bail;
+use anyhow::Context;
+use audio_processor::cdcfg::parse;
+use audio_processor::cdcfg::NaiveResolverContext;
+use audio_processor::config::PipelineBuilder;
+use audio_processor::config::Processor;
+use audio_processor::processors::peer::AudioWorkerSubprocessFactory;
+use audio_processor::processors::profile::cpu_time;
+use audio_processor::processors::WavSource;
+use audio_processor::util::set_thread_priority;
+use audio_processor::AudioProcessor;
+use audio_processor::MultiBuffer;
+use audio_processor::Shape;
+use clap::Parser;
+use serde::Serialize;
+
+#[derive(Parser, Debug)]
+struct Command {
+    /// Input WAVE files, or directories searched recursively for .wav files.
+    #[arg(required = true)]
+    inputs: Vec<PathBuf>,
+
+    /// Path to a plugin library (.so) or pipeline (.txtpb) to run.
+    /// Can be repeated.
+    #[arg(short, long = "pipeline", required = true)]
+    pipelines: Vec<PathBuf>,
+
+    /// Symbol name of the function that creates the plugin processor in
+    /// the .so pipelines.
+    #[arg(long, default_value = "plugin_processor_create")]
+    plugin_name: String,
+
+    /// Block sizes of the processor, in milliseconds. Each pipeline is run
+    /// with each of them.
+    #[arg(long, value_delimiter = ',', default_value = "10")]
+    block_size_ms: Vec<usize>,
+
+    /// Number of worker threads. Defaults to the number of CPUs.
+    #[arg(short, long)]
+    jobs: Option<usize>,
+
+    /// Sets the thread priority of the workers similarly to CRAS.
+    #[arg(long)]
+    set_thread_priority: bool,
+
+    /// Write the JSON report to this file instead of stdout.
+    #[arg(long)]
+    report: Option<PathBuf>,
+}
+
+/// Returns the .wav files in `inputs`, sorted by decreasing size so that the
+/// longest jobs are started first and the run does not end on a long tail.
+fn collect_inputs(inputs: &[PathBuf]) -> anyhow::Result<Vec<PathBuf>> {
+    fn walk(path: &Path, files: &mut Vec<(u64, PathBuf)>) -> anyhow::Result<()> {
+        let metadata = std::fs::metadata(path).with_context(|| format!("{path:?}"))?;
+        if metadata.is_dir() {
+            for entry in std::fs::read_dir(path).with_context(|| format!("{path:?}"))? {
+                let path = entry?.path();
+                if path.is_dir() || path.extension().is_some_and(|ext| ext == "wav") {
+                    walk(&path, files)?;
+                }
+            }
+        } else {
+            files.push((metadata.len(), path.into()));
+        }
+        Ok(())
+    }
+
+    let mut files = Vec::new();
+    for input in inputs {
+        walk(input, &mut files)?;
+    }
+    if files.is_empty() {
+        bail!("no .wav file in {inputs:?}");
+    }
+    files.sort_by(|a, b| b.0.cmp(&a.0).then_with(|| a.1.cmp(&b.1)));
+    Ok(files.into_iter().map(|(_, path)| path).collect())
+}
+
+fn load_processor(path: &Path, plugin_name: &str) -> anyhow::Result<Processor> {
+    match path.extension().and_then(|ext| ext.to_str()) {
+        Some("so") => Ok(Processor::Plugin {
+            path: path.into(),
+            constructor: plugin_name.into(),
+        }),
+        Some("txtpb") => parse(&NaiveResolverContext::default(), &Default::default(), path),
+        _ => bail!("{path:?}: invalid extension; supported extensions: .so, .txtpb"),
+    }
+}
+
+/// 64-bit FNV-1a. Used instead of `DefaultHasher` whose output may change
+/// between Rust releases, so that reports can be compared over time.
+struct Fnv1a(u64);
+
+impl Fnv1a {
+    fn new() -> Self {
+        Self(0xcbf29ce484222325)
+    }
+
+    fn write(&mut self, bytes: &[u8]) {
+        for &b in bytes {
+            self.0 = (self.0 ^ b as u64).wrapping_mul(0x100000001b3);
+        }
+    }
+}
+
+#[derive(Debug)]
+struct Job {
+    pipeline: usize,
+    block_size_ms: usize,
+    input: PathBuf,
+}
+
+struct JobResult {
+    frames: usize,
+    frame_rate: usize,
+    output_channels: usize,
+    output_hash: u64,
+    /// CPU and wall time of each block.
+    cpu: Vec<Duration>,
+    wall: Vec<Duration>,
+}
+
+fn run_job(command: &Command, job: &Job) -> anyhow::Result<JobResult> {
+    let reader = hound::WavReader::open(&job.input).context("cannot open input file")?;
+    let frame_rate = reader.spec().sample_rate as usize;
+    let block_size = job.block_size_ms * frame_rate / 1000;
+    if block_size == 0 {
+        bail!("{} ms is less than one frame", job.block_size_ms);
+    }
+    let mut source = WavSource::new(reader, block_size);
+
+    let mut worker_factory = AudioWorkerSubprocessFactory::default();
+    if command.set_thread_priority {
+        worker_factory = worker_factory.with_set_thread_priority();
+    }
+    let processor = load_processor(&command.pipelines[job.pipeline], &command.plugin_name)?;
+    let mut pipeline = PipelineBuilder::new(source.get_output_format())
+        .with_worker_factory(worker_factory)
+        .build(processor)?;
+
+    let mut result = JobResult {
+        frames: 0,
+        frame_rate,
+        output_channels: 0,
+        output_hash: 0,
+        cpu: Vec::new(),
+        wall: Vec::new(),
+    };
+    let mut hasher = Fnv1a::new();
+    let mut buf = MultiBuffer::new(Shape {
+        channels: 0,
+        frames: 0,
+    });
+    loop {
+        let slices = source.process(buf.as_multi_slice())?;
+        // Drop the last partial block like offline-pipeline does.
+        if slices.min_len() < block_size {
+            break;
+        }
+
+        let wall_start = Instant::now();
+        let cpu_start = cpu_time();
+        let output = pipeline.process(slices)?;
+        result.cpu.push(cpu_time().saturating_sub(cpu_start));
+        result.wall.push(wall_start.elapsed());
+
+        // Hash interleaved samples so that the hash does not depend on the
+        // block size.
+        result.output_channels = output.channels();
+        for i in 0..output.min_len() {
+            for ch in output.iter() {
+                hasher.write(&ch[i].to_bits().to_le_bytes());
+            }
+        }
+        result.frames += block_size;
+    }
+    result.output_hash = hasher.0;
+    Ok(result)
+}
+
+#[derive(Debug, Default, Serialize)]
+struct Percentiles {
+    p50_ms: f64,
+    p90_ms: f64,
+    p99_ms: f64,
+    max_ms: f64,
+}
+
+impl Percentiles {
+    fn new(mut samples: Vec<Duration>) -> Self {
+        if samples.is_empty() {
+            return Self::default();
+        }
+        samples.sort_unstable();
+        let at = |q: f64| {
+            let rank = (q * samples.len() as f64).ceil() as usize;
+            samples[rank.clamp(1, samples.len()) - 1].as_secs_f64() * 1000.
+        };
+        Self {
+            p50_ms: at(0.5),
+            p90_ms: at(0.9),
+            p99_ms: at(0.99),
+            max_ms: at(1.),
+        }
+    }
+}
+
+#[derive(Debug, Serialize)]
+struct FileReport {
+    input: PathBuf,
+    #[serde(skip_serializing_if = "Option::is_none")]
+    error: Option<String>,
+    frames: usize,
+    output_channels: usize,
+    /// FNV-1a of the interleaved output samples, as hexadecimal.
+    output_hash: String,
+    real_time_factor: f64,
+}
+
+#[derive(Debug, Serialize)]
+struct PipelineReport {
+    pipeline: PathBuf,
+    block_size_ms: usize,
+    audio_sec: f64,
+    cpu_sec: f64,
+    wall_sec: f64,
+    /// Total CPU time over the duration of the audio.
+    real_time_factor: f64,
+    blocks: usize,
+    /// Per block times over all the files.
+    cpu: Percentiles,
+    wall: Percentiles,
+    failed: usize,
+    files: Vec<FileReport>,
+}
+
+#[derive(Debug, Serialize)]
+struct Report {
+    threads: usize,
+    elapsed_sec: f64,
+    pipelines: Vec<PipelineReport>,
+}
+
+fn build_report(
+    command: &Command,
+    jobs: &[Job],
+    results: Vec<anyhow::Result<JobResult>>,
+    threads: usize,
+    elapsed: Duration,
+) -> Report {
+    let mut groups: BTreeMap<(usize, usize), Vec<(&Job, anyhow::Result<JobResult>)>> =
+        BTreeMap::new();
+    for (job, result) in jobs.iter().zip(results) {
+        groups
+            .entry((job.pipeline, job.block_size_ms))
+            .or_default()
+            .push((job, result));
+    }
+
+    let pipelines = groups
+        .into_iter()
+        .map(|((pipeline, block_size_ms), mut results)| {
+            results.sort_by(|a, b| a.0.input.cmp(&b.0.input));
+            let mut audio_sec = 0.;
+            let mut cpu = Vec::new();
+            let mut wall = Vec::new();
+            let mut failed = 0;
+            let mut files = Vec::new();
+            for (job, result) in results {
+                match result {
+                    Ok(r) => {
+                        let duration = r.frames as f64 / r.frame_rate as f64;
+                        let cpu_sec: f64 = r.cpu.iter().map(Duration::as_secs_f64).sum();
+                        audio_sec += duration;
+                        files.push(FileReport {
+                            input: job.input.clone(),
+                            error: None,
+                            frames: r.frames,
+                            output_channels: r.output_channels,
+                            output_hash: format!("{:016x}", r.output_hash),
+                            real_time_factor: cpu_sec / duration,
+                        });
+                        cpu.extend(r.cpu);
+                        wall.extend(r.wall);
+                    }
+                    Err(err) => {
+                        failed += 1;
+                        files.push(FileReport {
+                            input: job.input.clone(),
+                            error: Some(format!("{err:#}")),
+                            frames: 0,
+                            output_channels: 0,
+                            output_hash: String::new(),
+                            real_time_factor: 0.,
+                        });
+                    }
+                }
+            }
+            let cpu_sec: f64 = cpu.iter().map(Duration::as_secs_f64).sum();
+            let wall_sec: f64 = wall.iter().map(Duration::as_secs_f64).sum();
+            PipelineReport {
+                pipeline: command.pipelines[pipeline].clone(),
+                block_size_ms,
+                audio_sec,
+                cpu_sec,
+                wall_sec,
+                real_time_factor: if audio_sec > 0. {
+                    cpu_sec / audio_sec
+                } else {
+                    0.
+                },
+                blocks: cpu.len(),
+                cpu: Percentiles::new(cpu),
+                wall: Percentiles::new(wall),
+                failed,
+                files,
+            }
+        })
+        .collect();
+
+    Report {
+        threads,
+        elapsed_sec: elapsed.as_secs_f64(),
+        pipelines,
+    }
+}
+
+pub fn main() {
+    if let Err(err) = run(Command::parse()) {
+        eprintln!("{err:#}");
+        std::process::exit(1);
+    }
+}
+
+fn run(command: Command) -> anyhow::Result<Report> {
+    eprintln!("{:?}", command);
+
+    let inputs = collect_inputs(&command.inputs)?;
+    // Check the pipelines once before spawning jobs for them.
+    for path in &command.pipelines {
+        load_processor(path, &command.plugin_name)?;
+    }
+    let mut jobs = Vec::new();
+    for input in &inputs {
+        for pipeline in 0..command.pipelines.len() {
+            for &block_size_ms in &command.block_size_ms {
+                jobs.push(Job {
+                    pipeline,
+                    block_size_ms,
+                    input: input.clone(),
+                });
+            }
+        }
+    }
+
+    let threads = match command.jobs {
+        Some(jobs) => jobs.max(1),
+        None => std::thread::available_parallelism().map_or(1, |n| n.get()),
+    }
+    .min(jobs.len());
+    eprintln!("running {} jobs on {} threads", jobs.len(), threads);
+
+    let start = Instant::now();
+    let next_job = AtomicUsize::new(0);
+    let (result_sender, result_receiver) = channel();
+    std::thread::scope(|s| {
+        for _ in 0..threads {
+            let result_sender = result_sender.clone();
+            let (command, jobs, next_job) = (&command, &jobs, &next_job);
+            s.spawn(move || {
+                if command.set_thread_priority {
+                    if let Err(err) = set_thread_priority() {
+                        eprintln!("cannot set thread priority: {err:#}");
+                    }
+                }
+                loop {
+                    let i = next_job.fetch_add(1, Ordering::Relaxed);
+                    let Some(job) = jobs.get(i) else {
+                        break;
+                    };
+                    let result = run_job(command, job);
+                    if let Err(err) = &result {
+                        eprintln!("{job:?} failed: {err:#}");
+                    }
+                    result_sender.send((i, result)).unwrap();
+                }
+            });
+        }
+    });
+    drop(result_sender);
+    let elapsed = start.elapsed();
+
+    let mut results: Vec<_> = result_receiver.into_iter().collect();
+    results.sort_by_key(|(i, _)| *i);
+    let results = results.into_iter().map(|(_, result)| result).collect();
+    let report = build_report(&command, &jobs, results, threads, elapsed);
+
+    let json = serde_json::to_string_pretty(&report).context("JSON serialization failed")?;
+    match &command.report {
+        Some(path) => std::fs::write(path, json).with_context(|| format!("{path:?}"))?,
+        None => println!("{json}"),
+    }
+    Ok(report)
+}
+
+#[cfg(test)]
+mod tests {
+    use std::time::Duration;
+
+    use super::Fnv1a;
+    use super::Percentiles;
+
+    #[test]
+    fn fnv1a() {
+        let mut h = Fnv1a::new();
+        assert_eq!(h.0, 0xcbf29ce484222325);
+        h.write(b"a");
+        assert_eq!(h.0, 0xaf63dc4c8601ec8c);
+    }
+
+    #[test]
+    fn percentiles() {
+        let samples = (1..=100).map(Duration::from_millis).collect();
+        let p = Percentiles::new(samples);
+        assert_eq!(p.p50_ms, 50.);
+        assert_eq!(p.p90_ms, 90.);
+        assert_eq!(p.p99_ms, 99.);
+        assert_eq!(p.max_ms, 100.);
+
+        let p = Percentiles::new(vec![Duration::from_millis(3)]);
+        assert_eq!(p.p50_ms, 3.);
+        assert_eq!(p.max_ms, 3.);
+        assert_eq!(Percentiles::new(vec![]).max_ms, 0.);
+    }
+
+    #[cfg(feature = "bazel")]
+    #[test]
+    fn negate_corpus() {
+        use std::env;
+        use std::path::Path;
+
+        use tempfile::TempDir;
+
+        fn write_wav(path: &Path, value: i16, frames: usize) {
+            let mut writer = hound::WavWriter::create(
+                path,
+                hound::WavSpec {
+                    channels: 2,
+                    sample_rate: 48000,
+                    bits_per_sample: 16,
+                    sample_format: hound::SampleFormat::Int,
+                },
+            )
+            .unwrap();
+            for _ in 0..frames * 2 {
+                writer.write_sample(value).unwrap();
+            }
+        }
+
+        let dir = TempDir::new().unwrap();
+        let corpus = dir.path().join("corpus");
+        std::fs::create_dir_all(corpus.join("nested")).unwrap();
+        write_wav(&corpus.join("a.wav"), 1000, 48000);
+        write_wav(&corpus.join("nested/b.wav"), 1000, 48000);
+        // A trailing partial block is dropped.
+        write_wav(&corpus.join("c.wav"), -1000, 24100);
+        std::fs::write(corpus.join("ignored.txt"), "").unwrap();
+
+        let report = super::run(crate::Command {
+            inputs: vec![corpus],
+            pipelines: vec![env::var("LIBTEST_PLUGINS_SO").unwrap().into()],
+            plugin_name: "negate_processor_create".to_string(),
+            block_size_ms: vec![10, 20],
+            jobs: Some(3),
+            set_thread_priority: false,
+            report: Some(dir.path().join("report.json")),
+        })
+        .unwrap();
+
+        assert_eq!(report.threads, 3);
+        assert_eq!(report.pipelines.len(), 2);
+        let mut hashes = Vec::new();
+        for (p, block_size_ms) in report.pipelines.iter().zip([10, 20]) {
+            assert_eq!(p.block_size_ms, block_size_ms);
+            assert_eq!(p.failed, 0);
+            assert_eq!(p.files.len(), 3);
+            // 1 s for a and b, 500 ms for c.
+            assert_eq!(p.blocks, (2 * 1000 + 500) / block_size_ms);
+            assert!(p.real_time_factor > 0.);
+            assert!(p.cpu.p50_ms <= p.cpu.max_ms);
+            // Sorted by path.
+            let (a, c, b) = (&p.files[0], &p.files[1], &p.files[2]);
+            assert!(a.input.ends_with("a.wav"), "{:?}", a.input);
+            assert!(b.input.ends_with("nested/b.wav"), "{:?}", b.input);
+            assert_eq!(a.frames, 48000);
+            assert_eq!(c.frames, 24000);
+            assert_eq!(a.output_channels, 2);
+            assert_eq!(a.output_hash, b.output_hash);
+            assert_ne!(a.output_hash, c.output_hash);
+            hashes.push(a.output_hash.clone());
+        }
+        // The hash does not depend on the block size.
+        assert_eq!(hashes[0], hashes[1]);
+
+        let json = std::fs::read_to_string(dir.path().join("report.json")).unwrap();
+        assert!(json.contains("\"real_time_factor\""), "{json}");
+    }
+}
@@ -10,11 +10,14 @@ use std::path::PathBuf;
 
 use anyhow::bail;
 use anyhow::Context;
+use protobuf::EnumOrUnknown;
 
 use crate::config::Processor;
+use crate::processors::ResampleQuality;
 use crate::proto::cdcfg::dlc_plugin;
 use crate::proto::cdcfg::dlc_plugin::Dlc_id_oneof;
 use crate::proto::cdcfg::plugin;
+use crate::proto::cdcfg::resample;
 
 pub trait ResolverContext {
     fn get_wav_dump_root(&self) -> Option<&Path>;
@@ -128,6 +131,19 @@ fn get_const_or_var_str<'a>(
     }
 }
 
+fn resolve_resample_quality(
+    quality: EnumOrUnknown<resample::Quality>,
+) -> anyhow::Result<Option<ResampleQuality>> {
+    use resample::Quality::*;
+    Ok(match quality.enum_value() {
+        Ok(QUALITY_DEFAULT) => None,
+        Ok(QUALITY_LOW) => Some(ResampleQuality::Low),
+        Ok(QUALITY_MEDIUM) => Some(ResampleQuality::Medium),
+        Ok(QUALITY_HIGH) => Some(ResampleQuality::High),
+        Err(value) => bail!("unknown value {value}"),
+    })
+}
+
 fn resolve(
     context: &dyn ResolverContext,
     vars: &HashMap<String, String>,
@@ -206,6 +222,7 @@ fn resolve(
                 .output_frame_rate
                 .try_into()
                 .context("resample output_frame_rate")?,
+            quality: resolve_resample_quality(resample.quality).context("resample quality")?,
         },
         Pipeline(pipeline) => Processor::Pipeline {
             processors: pipeline
@@ -293,6 +310,7 @@ mod tests {
     use super::ResolverContext;
     use crate::cdcfg::DlcIdCollector;
     use crate::config::Processor;
+    use crate::processors::ResampleQuality;
 
     fn assert_resolve_error(
         context: &dyn ResolverContext,
@@ -329,7 +347,7 @@ mod tests {
   processors {
     wrap_chunk {
       inner_block_size: 10
-      inner { resample { output_frame_rate: 24000 } }
+      inner { resample { output_frame_rate: 24000 quality: QUALITY_HIGH } }
     }
   }
   processors {
@@ -367,7 +385,8 @@ mod tests {
                 processors: vec![
                     Processor::WrapChunk {
                         inner: Box::new(Processor::Resample {
-                            output_frame_rate: 24000
+                            output_frame_rate: 24000,
+                            quality: Some(ResampleQuality::High),
                         }),
                         inner_block_size: 10,
                         disallow_hoisting: false,
@@ -386,7 +405,8 @@ mod tests {
                     },
                     Processor::Peer {
                         processor: Box::new(Processor::Resample {
-                            output_frame_rate: 48000
+                            output_frame_rate: 48000,
+                            quality: None,
                         })
                     }
                 ]
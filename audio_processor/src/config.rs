@@ -2,10 +2,12 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+use std::cell::RefCell;
 use std::fmt::Debug;
 use std::path::PathBuf;
 use std::rc::Rc;
 use std::sync::mpsc::Sender;
+use std::sync::Arc;
 
 use anyhow::bail;
 use anyhow::Context;
@@ -17,11 +19,14 @@ use serde::Serialize;
 use crate::processors::peer::ManagedBlockingSeqPacketProcessor;
 use crate::processors::peer::ThreadedWorkerFactory;
 use crate::processors::peer::WorkerFactory;
+use crate::processors::profile::LiveStats;
 use crate::processors::profile::Profile;
 use crate::processors::profile::ProfileStats;
 use crate::processors::ChunkWrapper;
 use crate::processors::DynamicPluginProcessor;
 use crate::processors::InPlaceNegateAudioProcessor;
+use crate::processors::PolyphaseResampler;
+use crate::processors::ResampleQuality;
 use crate::processors::SpeexResampler;
 use crate::AudioProcessor;
 use crate::Format;
@@ -47,6 +52,10 @@ pub enum Processor {
     },
     Resample {
         output_frame_rate: usize,
+        /// Resample with a [`PolyphaseResampler`] of this quality instead
+        /// of the default [`SpeexResampler`].
+        #[serde(default)]
+        quality: Option<ResampleQuality>,
     },
     Pipeline {
         processors: Vec<Processor>,
@@ -115,10 +124,15 @@ impl PartialEq for PreloadedProcessor {
 
 impl Eq for PreloadedProcessor {}
 
+/// Collects the [`LiveStats`] of the stages of a pipeline, in order.
+pub type LiveStatsCollector = Rc<RefCell<Vec<Arc<LiveStats>>>>;
+
 pub struct PipelineBuilder {
     pipeline: Pipeline,
     profile_sender: Option<Sender<ProfileStats>>,
+    live_stats: Option<LiveStatsCollector>,
     worker_factory: Rc<dyn WorkerFactory>,
+    require_realtime_safe: bool,
 }
 
 impl PipelineBuilder {
@@ -126,7 +140,9 @@ impl PipelineBuilder {
         Self {
             pipeline: Pipeline::new(input_format),
             profile_sender: None,
+            live_stats: None,
             worker_factory: Rc::new(ThreadedWorkerFactory),
+            require_realtime_safe: false,
         }
     }
 
@@ -143,12 +159,27 @@ impl PipelineBuilder {
         self
     }
 
+    /// Enable live profiling. The [`LiveStats`] of each `Plugin`, `Preloaded`,
+    /// `Resample` and `Peer` stage are added to `collector` and can be read
+    /// while the pipeline runs.
+    pub fn with_live_stats(mut self, collector: LiveStatsCollector) -> Self {
+        self.live_stats = Some(collector);
+        self
+    }
+
     /// Use the factory to spawn peer workers.
     pub fn with_worker_factory(mut self, factory: impl WorkerFactory + 'static) -> Self {
         self.worker_factory = Rc::new(factory);
         self
     }
 
+    /// Refuse `Plugin`s that do not declare to be real-time safe. Use when
+    /// the pipeline runs on a real-time thread.
+    pub fn with_require_realtime_safe(mut self) -> Self {
+        self.require_realtime_safe = true;
+        self
+    }
+
     fn output_format(&self) -> Format {
         self.pipeline.get_output_format()
     }
@@ -157,7 +188,34 @@ impl PipelineBuilder {
         Self {
             pipeline: Pipeline::new(input_format),
             profile_sender: self.profile_sender.clone(),
+            live_stats: self.live_stats.clone(),
             worker_factory: self.worker_factory.clone(),
+            require_realtime_safe: self.require_realtime_safe,
+        }
+    }
+
+    /// Returns new [`LiveStats`] for the stage `key` if live stats are
+    /// enabled.
+    fn new_live_stats(&self, key: String) -> Option<Arc<LiveStats>> {
+        let live = Arc::new(LiveStats::new(key));
+        self.live_stats.as_ref()?.borrow_mut().push(live.clone());
+        Some(live)
+    }
+
+    /// Returns `processor` wrapped in a [`Profile`] reporting live stats
+    /// under `key`, or `processor` itself if live stats are disabled.
+    fn live_profile(
+        &self,
+        processor: impl AudioProcessor<I = f32, O = f32> + Send + 'static,
+        key: String,
+    ) -> Box<dyn AudioProcessor<I = f32, O = f32> + Send> {
+        match self.new_live_stats(key) {
+            Some(live) => {
+                let mut profile = Profile::new(processor);
+                profile.set_live_stats(live);
+                Box::new(profile)
+            }
+            None => Box::new(processor),
         }
     }
 
@@ -188,25 +246,97 @@ impl PipelineBuilder {
                 ));
             }
             Plugin { path, constructor } => {
-                let plugin = DynamicPluginProcessor::new(
-                    path.to_str().context("path.to_str")?,
+                let path_str = path.to_str().context("path.to_str")?;
+                let format = self.output_format();
+                // Honor the block size preferred by the plugin. Blocks are
+                // batched when the preference is a multiple of the block size
+                // and the plugin supports process_many. Otherwise the plugin
+                // is created at its preferred size and chunked, if it says so
+                // before being created.
+                let hints = DynamicPluginProcessor::query(path_str, &constructor, format)
+                    .context("DynamicPluginProcessor::query")?;
+                let preferred = hints.preferred_block_size;
+                let batchable = format.block_size > 0 && preferred % format.block_size == 0;
+                let chunk_size = (preferred != 0
+                    && preferred != format.block_size
+                    && !(batchable && hints.process_many.is_some()))
+                .then_some(preferred);
+                let mut plugin = DynamicPluginProcessor::new(
+                    path_str,
                     &constructor,
-                    self.output_format(),
+                    Format {
+                        block_size: chunk_size.unwrap_or(format.block_size),
+                        ..format
+                    },
                 )
                 .context("DynamicPluginProcessor::new")?;
-                if let Some(sender) = &self.profile_sender {
+
+                // ChunkWrapper cannot handle a change of frame rate or
+                // up-mixing.
+                let output_format = plugin.get_output_format();
+                let mut chunk = None;
+                if let Some(size) = chunk_size {
+                    if output_format.frame_rate != format.frame_rate
+                        || output_format.channels > format.channels
+                    {
+                        bail!(
+                            "plugin {constructor} prefers block size {size} \
+                             but changes the format to {output_format:?}"
+                        );
+                    }
+                    chunk = Some((size, format.block_size % size == 0));
+                } else {
+                    let preferred = plugin.plugin().preferred_block_size();
+                    if preferred != format.block_size
+                        && format.block_size > 0
+                        && preferred % format.block_size == 0
+                        && plugin.plugin().supports_process_many()
+                        && output_format.frame_rate == format.frame_rate
+                    {
+                        // Feed the plugin several blocks at once.
+                        plugin
+                            .plugin_mut()
+                            .enable_batching(preferred / format.block_size);
+                        chunk = Some((preferred, false));
+                    }
+                }
+
+                if self.require_realtime_safe && !plugin.plugin().realtime_safe() {
+                    bail!("plugin {constructor} is not declared real-time safe");
+                }
+                self.pipeline.latency_frames += plugin.plugin().latency_frames();
+                log::info!(
+                    "plugin {constructor}: latency {} frames, preferred block size {}, \
+                     realtime safe {}, {}",
+                    plugin.plugin().latency_frames(),
+                    plugin.plugin().preferred_block_size(),
+                    plugin.plugin().realtime_safe(),
+                    match chunk {
+                        _ if plugin.plugin().batching_enabled() => "batched",
+                        Some(_) => "chunked",
+                        None => "not chunked",
+                    },
+                );
+
+                let key = format!(
+                    "{}@{}",
+                    constructor,
+                    path.file_name()
+                        .context("path.file_name() failed")?
+                        .to_string_lossy(),
+                );
+                if self.profile_sender.is_some() || self.live_stats.is_some() {
                     let mut profile = Profile::new(plugin);
-                    profile.set_key(format!(
-                        "{}@{}",
-                        constructor,
-                        path.file_name()
-                            .context("path.file_name() failed")?
-                            .to_string_lossy(),
-                    ));
-                    profile.set_sender(sender.clone());
-                    self.pipeline.add(profile);
+                    profile.set_key(key.clone());
+                    if let Some(sender) = &self.profile_sender {
+                        profile.set_sender(sender.clone());
+                    }
+                    if let Some(live) = self.new_live_stats(key) {
+                        profile.set_live_stats(live);
+                    }
+                    self.add_plugin(profile, chunk, output_format.channels);
                 } else {
-                    self.pipeline.add(plugin);
+                    self.add_plugin(plugin, chunk, output_format.channels);
                 }
             }
             WrapChunk {
@@ -217,7 +347,7 @@ impl PipelineBuilder {
                 if self.output_format().block_size == inner_block_size && !disallow_hoisting {
                     self.add(*inner).context("inner")?;
                 } else {
-                    let inner_pipeline = self
+                    let mut inner_pipeline = self
                         .child_builder(Format {
                             block_size: inner_block_size,
                             ..self.output_format()
@@ -225,33 +355,78 @@ impl PipelineBuilder {
                         .build(*inner)
                         .context("inner")?;
 
+                    self.pipeline.latency_frames += inner_pipeline.latency_frames;
+                    let outer_block_size = self.output_format().block_size;
+                    let input_channels = self.output_format().channels;
                     let inner_channels = inner_pipeline.get_output_format().channels;
-                    // TODO: When the inner_pipeline only has a single processor, wrap just that processor.
-                    self.pipeline.add(ChunkWrapper::new(
-                        inner_pipeline,
-                        self.output_format().block_size,
-                        inner_block_size,
-                        self.output_format().channels,
-                        inner_channels,
-                    ));
+                    // The outer block size is stable when hoisting is allowed,
+                    // so blocks can be split without buffering.
+                    let in_place = !disallow_hoisting
+                        && inner_block_size > 0
+                        && outer_block_size % inner_block_size == 0;
+                    if inner_pipeline.vec.len() == 1 {
+                        // Wrap just that processor.
+                        let inner = inner_pipeline.vec.pop().unwrap();
+                        self.add_chunk_wrapper(
+                            inner,
+                            in_place,
+                            inner_block_size,
+                            input_channels,
+                            inner_channels,
+                        );
+                    } else {
+                        self.add_chunk_wrapper(
+                            inner_pipeline,
+                            in_place,
+                            inner_block_size,
+                            input_channels,
+                            inner_channels,
+                        );
+                    }
                 }
             }
-            Resample { output_frame_rate } => {
-                if self.output_format().frame_rate != output_frame_rate {
-                    self.pipeline.add(
-                        SpeexResampler::new(self.output_format(), output_frame_rate)
-                            .context("SpeexResampler::new")?,
-                    );
+            Resample {
+                output_frame_rate,
+                quality,
+            } => {
+                let input_frame_rate = self.output_format().frame_rate;
+                if input_frame_rate != output_frame_rate {
+                    let key = format!("resample {input_frame_rate}->{output_frame_rate}");
+                    let resampler = match quality {
+                        Some(quality) => self.live_profile(
+                            PolyphaseResampler::new(
+                                self.output_format(),
+                                output_frame_rate,
+                                quality,
+                            )
+                            .context("PolyphaseResampler::new")?,
+                            key,
+                        ),
+                        None => self.live_profile(
+                            SpeexResampler::new(self.output_format(), output_frame_rate)
+                                .context("SpeexResampler::new")?,
+                            key,
+                        ),
+                    };
+                    self.pipeline.vec.push(resampler);
                 }
             }
             Pipeline { processors } => {
-                for (i, config) in processors.into_iter().enumerate() {
+                for (i, config) in merge_wrap_chunks(processors).into_iter().enumerate() {
                     self.add(config)
                         .with_context(|| format!("pipeline processor#{i}"))?;
                 }
             }
-            Preloaded(PreloadedProcessor { processor, .. }) => {
-                self.pipeline.vec.push(processor);
+            Preloaded(PreloadedProcessor {
+                description,
+                processor,
+            }) => {
+                if self.live_stats.is_some() {
+                    let processor = self.live_profile(processor, description.to_string());
+                    self.pipeline.vec.push(processor);
+                } else {
+                    self.pipeline.vec.push(processor);
+                }
             }
             ShuffleChannels { channel_indexes } => {
                 // Optimization: only shuffle channels if it would change the
@@ -293,18 +468,102 @@ impl PipelineBuilder {
                 // Do nothing.
             }
             Peer { processor } => {
-                self.pipeline.add(
+                let peer = self.live_profile(
                     ManagedBlockingSeqPacketProcessor::new(
                         self.worker_factory.as_ref(),
                         self.output_format(),
                         *processor,
                     )
                     .context("ManagedBlockingSeqPacketProcessor::new")?,
+                    String::from("peer"),
                 );
+                self.pipeline.vec.push(peer);
             }
         }
         Ok(())
     }
+
+    /// Adds `plugin`, wrapped in a [`ChunkWrapper`] if `chunk` is set to
+    /// the block size and whether blocks can be processed in place.
+    fn add_plugin(
+        &mut self,
+        plugin: impl AudioProcessor<I = f32, O = f32> + Send + 'static,
+        chunk: Option<(usize, bool)>,
+        output_channels: usize,
+    ) {
+        match chunk {
+            Some((block_size, in_place)) => {
+                let input_channels = self.output_format().channels;
+                self.add_chunk_wrapper(
+                    plugin,
+                    in_place,
+                    block_size,
+                    input_channels,
+                    output_channels,
+                );
+            }
+            None => self.pipeline.add(plugin),
+        }
+    }
+
+    fn add_chunk_wrapper(
+        &mut self,
+        inner: impl AudioProcessor<I = f32, O = f32> + Send + 'static,
+        in_place: bool,
+        inner_block_size: usize,
+        input_channels: usize,
+        output_channels: usize,
+    ) {
+        let outer_block_size = self.output_format().block_size;
+        if in_place {
+            self.pipeline.add(ChunkWrapper::new_in_place(
+                inner,
+                outer_block_size,
+                inner_block_size,
+                input_channels,
+                output_channels,
+            ));
+        } else {
+            self.pipeline.add(ChunkWrapper::new(
+                inner,
+                outer_block_size,
+                inner_block_size,
+                input_channels,
+                output_channels,
+            ));
+        }
+    }
+}
+
+/// Merges adjacent `WrapChunk`s with the same block size, so that blocks are
+/// split and buffered once for all of them.
+fn merge_wrap_chunks(processors: Vec<Processor>) -> Vec<Processor> {
+    let mut merged: Vec<Processor> = Vec::with_capacity(processors.len());
+    for config in processors {
+        match (merged.last_mut(), config) {
+            (
+                Some(Processor::WrapChunk {
+                    inner,
+                    inner_block_size,
+                    disallow_hoisting,
+                }),
+                Processor::WrapChunk {
+                    inner: next_inner,
+                    inner_block_size: next_inner_block_size,
+                    disallow_hoisting: next_disallow_hoisting,
+                },
+            ) if *inner_block_size == next_inner_block_size
+                && *disallow_hoisting == next_disallow_hoisting =>
+            {
+                let prev_inner = std::mem::replace(inner.as_mut(), Processor::Nothing);
+                **inner = Processor::Pipeline {
+                    processors: vec![prev_inner, *next_inner],
+                };
+            }
+            (_, config) => merged.push(config),
+        }
+    }
+    merged
 }
 
 #[cfg(test)]
@@ -314,10 +573,12 @@ mod tests {
     use assert_matches::assert_matches;
     use hound::WavSpec;
 
+    use crate::config::LiveStatsCollector;
     use crate::config::PipelineBuilder;
     use crate::config::PreloadedProcessor;
     use crate::config::Processor;
     use crate::processors::NegateAudioProcessor;
+    use crate::processors::ResampleQuality;
     use crate::util::read_wav;
     use crate::AudioProcessor;
     use crate::Format;
@@ -370,6 +631,7 @@ mod tests {
                 },
                 Resample {
                     output_frame_rate: 48000,
+                    quality: Default::default(),
                 },
                 WavSink {
                     path: tempdir.path().join("6.wav"),
@@ -434,9 +696,10 @@ mod tests {
                 ..
             }
         );
+        // 5 is a multiple of 1, processed in place without delay.
         assert_eq!(
             wavs[2].1.to_vecs(),
-            [[0.0, 1.0, 2.0, 3.0, 4.0], [0.0, 6.0, 7.0, 8.0, 9.0]]
+            [[1.0, 2.0, 3.0, 4.0, 5.0], [6.0, 7.0, 8.0, 9.0, 10.0]]
         );
 
         assert_matches!(
@@ -449,7 +712,7 @@ mod tests {
         );
         assert_eq!(
             wavs[3].1.to_vecs(),
-            [[0.0, 1.0, 2.0, 3.0], [0.0, 6.0, 7.0, 8.0]]
+            [[1.0, 2.0, 3.0, 4.0], [6.0, 7.0, 8.0, 9.0]]
         );
 
         assert_matches!(
@@ -462,7 +725,7 @@ mod tests {
         );
         assert_eq!(
             wavs[4].1.to_vecs(),
-            [[-0.0, -1.0, -2.0, -3.0], [-0.0, -6.0, -7.0, -8.0]]
+            [[-1.0, -2.0, -3.0, -4.0], [-6.0, -7.0, -8.0, -9.0]]
         );
 
         assert_matches!(
@@ -475,7 +738,7 @@ mod tests {
         );
         assert_eq!(
             wavs[5].1.to_vecs(),
-            [[0.0, 0.0, -0.0, -1.0, -2.0], [0.0, 0.0, -0.0, -6.0, -7.0]]
+            [[0.0, 0.0, -1.0, -2.0, -3.0], [0.0, 0.0, -6.0, -7.0, -8.0]]
         );
 
         assert_matches!(
@@ -489,6 +752,58 @@ mod tests {
         assert_eq!(wavs[6].1.to_vecs(), output.to_vecs());
     }
 
+    #[test]
+    fn wrap_chunk_in_place() {
+        let mut pipeline = PipelineBuilder::new(Format {
+            channels: 1,
+            block_size: 4,
+            frame_rate: 48000,
+        })
+        .build(Processor::WrapChunk {
+            inner: Box::new(Processor::Negate),
+            inner_block_size: 2,
+            disallow_hoisting: false,
+        })
+        .unwrap();
+        assert_eq!(pipeline.vec.len(), 1);
+
+        let mut input = MultiBuffer::from(vec![vec![1f32, 2., 3., 4.]]);
+        let output = pipeline.process(input.as_multi_slice()).unwrap();
+        assert_eq!(output.into_raw(), [[-1., -2., -3., -4.]]);
+    }
+
+    #[test]
+    fn merge_wrap_chunks() {
+        use Processor::*;
+
+        let mut pipeline = PipelineBuilder::new(Format {
+            channels: 1,
+            block_size: 3,
+            frame_rate: 48000,
+        })
+        .build(Pipeline {
+            processors: vec![
+                WrapChunk {
+                    inner: Box::new(Negate),
+                    inner_block_size: 2,
+                    disallow_hoisting: false,
+                },
+                WrapChunk {
+                    inner: Box::new(Negate),
+                    inner_block_size: 2,
+                    disallow_hoisting: false,
+                },
+            ],
+        })
+        .unwrap();
+        assert_eq!(pipeline.vec.len(), 1, "should be merged");
+
+        // Delayed once by the merged ChunkWrapper.
+        let mut input = MultiBuffer::from(vec![vec![1f32, 2., 3.]]);
+        let output = pipeline.process(input.as_multi_slice()).unwrap();
+        assert_eq!(output.into_raw(), [[0., 0., 1.]]);
+    }
+
     #[test]
     fn preloaded() {
         let mut input: MultiBuffer<f32> =
@@ -516,6 +831,72 @@ mod tests {
         );
     }
 
+    #[test]
+    fn live_stats() {
+        let input_format = Format {
+            channels: 1,
+            block_size: 4,
+            frame_rate: 24000,
+        };
+        let collector = LiveStatsCollector::default();
+        let mut pipeline = PipelineBuilder::new(input_format)
+            .with_live_stats(collector.clone())
+            .build(Processor::Pipeline {
+                processors: vec![
+                    Processor::Preloaded(PreloadedProcessor {
+                        description: "preloaded negate",
+                        processor: Box::new(NegateAudioProcessor::new(input_format)),
+                    }),
+                    Processor::Negate,
+                    Processor::Resample {
+                        output_frame_rate: 48000,
+                        quality: Default::default(),
+                    },
+                ],
+            })
+            .unwrap();
+
+        let mut input = MultiBuffer::from(vec![vec![1f32, 2., 3., 4.]]);
+        pipeline.process(input.as_multi_slice()).unwrap();
+
+        let snapshots: Vec<_> = collector
+            .borrow()
+            .iter()
+            .map(|live| live.snapshot())
+            .collect();
+        assert_eq!(snapshots.len(), 2);
+        assert_eq!(snapshots[0].key, "preloaded negate");
+        assert_eq!(snapshots[0].frames, 4);
+        assert_eq!(snapshots[1].key, "resample 24000->48000");
+        assert_eq!(snapshots[1].blocks, 1);
+    }
+
+    #[test]
+    fn resample_quality() {
+        let build = |quality| {
+            PipelineBuilder::new(Format {
+                channels: 1,
+                block_size: 256,
+                frame_rate: 48000,
+            })
+            .build(Processor::Resample {
+                output_frame_rate: 16000,
+                quality,
+            })
+            .unwrap()
+        };
+
+        // Speex by default, which truncates the block size.
+        assert_eq!(build(None).get_output_format().block_size, 85);
+        // The polyphase resampler reports the largest block size.
+        assert_eq!(
+            build(Some(ResampleQuality::Low))
+                .get_output_format()
+                .block_size,
+            86
+        );
+    }
+
     #[test]
     fn shuffle_channels() {
         let mut pipeline = PipelineBuilder::new(Format {
@@ -702,6 +1083,57 @@ mod bazel_tests {
         assert_eq!(output.into_raw(), [[1., 2., 3., 4.], [5., 6., 7., 8.]]);
     }
 
+    #[test]
+    fn batched_plugin() {
+        let mut pipeline = PipelineBuilder::new(Format {
+            channels: 1,
+            block_size: 2,
+            frame_rate: 48000,
+        })
+        .build(Processor::Plugin {
+            path: std::env::var("LIBTEST_PLUGINS_SO").unwrap().into(),
+            constructor: "negate_batch_processor_create".into(),
+        })
+        .unwrap();
+        assert_eq!(pipeline.get_output_format().block_size, 2);
+
+        // The plugin prefers 4 blocks at once, so the output is delayed by
+        // 8 frames.
+        let mut outputs = vec![];
+        for i in 0..8 {
+            let mut input: MultiBuffer<f32> =
+                MultiBuffer::from(vec![vec![(2 * i + 1) as f32, (2 * i + 2) as f32]]);
+            outputs.extend_from_slice(&pipeline.process(input.as_multi_slice()).unwrap()[0]);
+        }
+        assert_eq!(
+            outputs,
+            [0., 0., 0., 0., 0., 0., 0., 0., -1., -2., -3., -4., -5., -6., -7., -8.]
+        );
+    }
+
+    #[test]
+    fn require_realtime_safe() {
+        let format = Format {
+            channels: 1,
+            block_size: 2,
+            frame_rate: 48000,
+        };
+        let plugin = |constructor: &str| Processor::Plugin {
+            path: std::env::var("LIBTEST_PLUGINS_SO").unwrap().into(),
+            constructor: constructor.into(),
+        };
+
+        // abs_processor_create does not fill the extension table.
+        assert!(PipelineBuilder::new(format)
+            .with_require_realtime_safe()
+            .build(plugin("abs_processor_create"))
+            .is_err());
+        assert!(PipelineBuilder::new(format)
+            .with_require_realtime_safe()
+            .build(plugin("negate_processor_create"))
+            .is_ok());
+    }
+
     #[test]
     fn profile() {
         let test_plugin_path: std::path::PathBuf = env::var("LIBTEST_PLUGINS_SO").unwrap().into();
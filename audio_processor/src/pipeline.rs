@@ -18,6 +18,9 @@ pub type ProcessorVec = Vec<Box<dyn AudioProcessor<I = f32, O = f32> + Send>>;
 pub struct Pipeline {
     pub input_format: Format,
     pub vec: ProcessorVec,
+    /// Sum of the latencies reported by the plugins in the pipeline, in
+    /// frames.
+    pub latency_frames: usize,
 }
 
 impl Pipeline {
@@ -25,6 +28,7 @@ impl Pipeline {
         Pipeline {
             input_format,
             vec: Vec::new(),
+            latency_frames: 0,
         }
     }
 
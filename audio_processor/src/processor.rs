@@ -72,6 +72,22 @@ pub trait AudioProcessor {
     fn get_output_format(&self) -> Format;
 }
 
+impl<P: AudioProcessor + ?Sized> AudioProcessor for Box<P> {
+    type I = P::I;
+    type O = P::O;
+
+    fn process<'a>(
+        &'a mut self,
+        input: MultiSlice<'a, Self::I>,
+    ) -> Result<MultiSlice<'a, Self::O>> {
+        (**self).process(input)
+    }
+
+    fn get_output_format(&self) -> Format {
+        (**self).get_output_format()
+    }
+}
+
 impl<T> ByteProcessor for T
 where
     T: AudioProcessor,
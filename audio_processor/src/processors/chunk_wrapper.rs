@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 use crate::AudioProcessor;
+use crate::Error;
 use crate::Format;
 use crate::MultiBuffer;
 use crate::Sample;
@@ -14,14 +15,23 @@ use crate::Shape;
 ///
 /// The ChunkWrapper assumes that the wrapped AudioProcessor has the same
 /// input and output formats.
+///
+/// By default the output is delayed by `block_size` frames, so that inputs
+/// of any size can be processed. A ChunkWrapper created with
+/// [`ChunkWrapper::new_in_place`] instead splits inputs that are a multiple
+/// of `block_size` and processes them in place, without delay.
 pub struct ChunkWrapper<T: AudioProcessor<I = S, O = S>, S: Sample> {
     inner: T,
     block_size: usize,
     output_format: Format,
+    in_place: bool,
 
     index: usize,
     pending: MultiBuffer<T::I>,
     processed: MultiBuffer<T::I>,
+    // Addresses of the input channels in process_in_place. Sized for
+    // input_channels at construction so processing does not allocate.
+    starts: Vec<usize>,
 }
 
 impl<T: AudioProcessor<I = S, O = S>, S: Sample> AudioProcessor for ChunkWrapper<T, S> {
@@ -32,6 +42,10 @@ impl<T: AudioProcessor<I = S, O = S>, S: Sample> AudioProcessor for ChunkWrapper
         &'a mut self,
         mut input: crate::MultiSlice<'a, Self::I>,
     ) -> crate::Result<crate::MultiSlice<'a, Self::O>> {
+        if self.in_place {
+            return self.process_in_place(input);
+        }
+
         let mut remaining = input.min_len();
         let mut x = 0;
 
@@ -75,6 +89,59 @@ impl<T: AudioProcessor<I = S, O = S>, S: Sample> ChunkWrapper<T, S> {
             .clone_from_multi_slice(mslice);
         mslice.clone_from_multi_slice(&self.processed.as_multi_slice().indexes(range));
     }
+
+    fn process_in_place<'a>(
+        &mut self,
+        mut input: crate::MultiSlice<'a, S>,
+    ) -> crate::Result<crate::MultiSlice<'a, S>> {
+        let frames = input.min_len();
+        if frames % self.block_size != 0 {
+            return Err(Error::InvalidShape {
+                want_channels: input.channels(),
+                want_frames: self.output_format.block_size,
+                got_channels: input.channels(),
+                got_frames: frames,
+            });
+        }
+
+        // Used to tell whether the inner processor returned the block it was
+        // given, in which case the output is already in place.
+        self.starts.clear();
+        self.starts
+            .extend(input.iter().map(|ch| ch.as_ptr() as usize));
+        for x in (0..frames).step_by(self.block_size) {
+            let range = x..x + self.block_size;
+            let in_place = {
+                let output = self.inner.process(input.indexes(range.clone()))?;
+                if output.channels() != self.output_format.channels
+                    || output.min_len() != self.block_size
+                {
+                    return Err(Error::InvalidShape {
+                        want_channels: self.output_format.channels,
+                        want_frames: self.block_size,
+                        got_channels: output.channels(),
+                        got_frames: output.min_len(),
+                    });
+                }
+                let in_place = output.iter().zip(self.starts.iter()).all(|(ch, start)| {
+                    ch.as_ptr() as usize == start + x * std::mem::size_of::<S>()
+                });
+                if !in_place {
+                    self.processed
+                        .as_multi_slice()
+                        .clone_from_multi_slice(&output);
+                }
+                in_place
+            };
+            if !in_place {
+                input
+                    .indexes(range)
+                    .clone_from_multi_slice(&self.processed.as_multi_slice());
+            }
+        }
+
+        Ok(input)
+    }
 }
 
 impl<T: AudioProcessor<I = S, O = S>, S: Sample> ChunkWrapper<T, S> {
@@ -99,6 +166,7 @@ impl<T: AudioProcessor<I = S, O = S>, S: Sample> ChunkWrapper<T, S> {
                 block_size: outer_block_size,
                 frame_rate: inner_output_format.frame_rate,
             },
+            in_place: false,
             index: 0,
             pending: MultiBuffer::new_equilibrium(Shape {
                 channels: input_channels,
@@ -108,6 +176,34 @@ impl<T: AudioProcessor<I = S, O = S>, S: Sample> ChunkWrapper<T, S> {
                 channels: output_channels,
                 frames: block_size,
             }),
+            starts: Vec::with_capacity(input_channels),
+        }
+    }
+
+    /// Create a ChunkWrapper which processes its input in place without
+    /// delay. `outer_block_size` must be a multiple of `block_size` and
+    /// inputs must be a multiple of `block_size` frames long.
+    pub fn new_in_place(
+        inner: T,
+        outer_block_size: usize,
+        block_size: usize,
+        input_channels: usize,
+        output_channels: usize,
+    ) -> Self {
+        assert!(block_size > 0 && outer_block_size % block_size == 0);
+        Self {
+            in_place: true,
+            pending: MultiBuffer::new(Shape {
+                channels: input_channels,
+                frames: 0,
+            }),
+            ..Self::new(
+                inner,
+                outer_block_size,
+                block_size,
+                input_channels,
+                output_channels,
+            )
         }
     }
 }
@@ -162,6 +258,43 @@ mod tests {
         }));
     }
 
+    fn in_place_neg<T: AudioProcessor<I = i32, O = i32>>(neg: T) {
+        let mut cw = ChunkWrapper::new_in_place(neg, 4, 2, 2, 2);
+
+        let mut input = MultiBuffer::from(vec![vec![1, 2, 3, 4], vec![5, 6, 7, 8]]);
+        assert_eq!(
+            cw.process(input.as_multi_slice()).unwrap().into_raw(),
+            [[-1i32, -2, -3, -4], [-5, -6, -7, -8]]
+        );
+
+        let mut input = MultiBuffer::from(vec![vec![9, 10], vec![11, 12]]);
+        assert_eq!(
+            cw.process(input.as_multi_slice()).unwrap().into_raw(),
+            [[-9i32, -10], [-11, -12]]
+        );
+
+        let mut input = MultiBuffer::from(vec![vec![1, 2, 3], vec![4, 5, 6]]);
+        assert!(cw.process(input.as_multi_slice()).is_err());
+    }
+
+    #[test]
+    fn in_place_neg_test() {
+        in_place_neg(NegateAudioProcessor::<i32>::new(Format {
+            channels: 2,
+            block_size: 2,
+            frame_rate: 48000,
+        }));
+    }
+
+    #[test]
+    fn in_place_neg_in_place_test() {
+        in_place_neg(InPlaceNegateAudioProcessor::<i32>::new(Format {
+            channels: 2,
+            block_size: 2,
+            frame_rate: 48000,
+        }));
+    }
+
     // TODO: Add a test for when input_channels and output_channels are different.
 
     // TODO: Add mock-based testing to check that data passed into
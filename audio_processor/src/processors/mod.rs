@@ -22,6 +22,9 @@ pub use wav::*;
 mod speex;
 pub use speex::*;
 
+mod polyphase;
+pub use polyphase::*;
+
 mod thread;
 pub use thread::*;
 
@@ -17,14 +17,19 @@ use zerocopy::AsBytes;
 
 use super::messages::multi_slice_from_buf;
 use super::messages::new_payload_buffer;
+use super::messages::parse_frames;
 use super::messages::recv;
-use super::messages::recv_slice;
+use super::messages::recv_with_fd;
 use super::messages::send;
+use super::messages::send_frames;
 use super::messages::send_str;
 use super::messages::Init;
 use super::messages::RequestOp;
 use super::messages::ResponseOp;
 use super::messages::CONTROL_MSG_MAX_SIZE;
+use super::shm::copy_to_region;
+use super::shm::multi_slice_from_region;
+use super::shm::SharedAudioMemory;
 use crate::config;
 use crate::AudioProcessor;
 use crate::Format;
@@ -32,8 +37,12 @@ use crate::MultiSlice;
 
 pub struct BlockingSeqPacketProcessor {
     fd: OwnedFd,
+    input_format: Format,
     output_format: Format,
     output_buffer: Vec<f32>,
+    /// Set if the worker agreed to pass audio through shared memory.
+    /// Blocks that don't fit are still sent through the socket.
+    shm: Option<SharedAudioMemory>,
 }
 
 impl BlockingSeqPacketProcessor {
@@ -48,26 +57,54 @@ impl BlockingSeqPacketProcessor {
             &serde_json::to_string(&Init {
                 input_format,
                 config,
+                shared_memory: true,
             })
             .context("serialize init message")?,
         )
         .context("send init message")?;
         let mut buf = [0u8; CONTROL_MSG_MAX_SIZE];
-        let (response_op, payload) =
-            recv_slice::<ResponseOp>(fd.as_fd(), &mut buf).context("recv init message reply")?;
+        let (response_op, payload_len, shm_fd) =
+            recv_with_fd::<ResponseOp>(fd.as_fd(), &mut buf).context("recv init message reply")?;
+        let payload = &buf[..payload_len];
         match response_op {
             ResponseOp::Ok => {
                 let output_format: Format =
                     serde_json::from_slice(payload).context("deserialize output format")?;
+                let shm = match shm_fd {
+                    Some(shm_fd) => Some(
+                        SharedAudioMemory::map(shm_fd.as_fd(), input_format, output_format)
+                            .context("map shared memory")?,
+                    ),
+                    None => None,
+                };
                 Ok(Self {
                     fd,
+                    input_format,
                     output_format,
                     output_buffer: new_payload_buffer(output_format),
+                    shm,
                 })
             }
             ResponseOp::Error => bail!("error from peer: {}", String::from_utf8_lossy(payload)),
+            ResponseOp::OkShared => bail!("unexpected response op {response_op:?} during init"),
         }
     }
+
+    /// Sends `input` through the shared memory. Returns false without
+    /// sending anything if it doesn't fit.
+    fn send_shared(&mut self, input: &MultiSlice<f32>) -> anyhow::Result<bool> {
+        let Some(shm) = self.shm.as_mut() else {
+            return Ok(false);
+        };
+        if input.channels() != self.input_format.channels {
+            return Ok(false);
+        }
+        let Some(frames) = copy_to_region(input, shm.regions().0) else {
+            return Ok(false);
+        };
+        send_frames(self.fd.as_fd(), RequestOp::ProcessShared, frames)?;
+        Ok(true)
+    }
 }
 
 impl AudioProcessor for BlockingSeqPacketProcessor {
@@ -78,11 +115,13 @@ impl AudioProcessor for BlockingSeqPacketProcessor {
         &'a mut self,
         input: MultiSlice<'a, Self::I>,
     ) -> crate::Result<MultiSlice<'a, Self::O>> {
-        send(
-            self.fd.as_fd(),
-            RequestOp::Process,
-            input.iter().map(|ch| IoSlice::new(ch.as_bytes())),
-        )?;
+        if !self.send_shared(&input)? {
+            send(
+                self.fd.as_fd(),
+                RequestOp::Process,
+                input.iter().map(|ch| IoSlice::new(ch.as_bytes())),
+            )?;
+        }
 
         let buf = self.output_buffer.as_bytes_mut();
         let (response_op, payload_len) = recv::<ResponseOp>(self.fd.as_fd(), buf)?;
@@ -93,6 +132,18 @@ impl AudioProcessor for BlockingSeqPacketProcessor {
                 payload_len,
                 self.output_format.channels,
             )?),
+            ResponseOp::OkShared => {
+                let frames = parse_frames(&self.output_buffer.as_bytes()[..payload_len])?;
+                let shm = self
+                    .shm
+                    .as_mut()
+                    .context("shared memory response without shared memory")?;
+                Ok(multi_slice_from_region(
+                    shm.regions().1,
+                    frames,
+                    self.output_format.channels,
+                )?)
+            }
             ResponseOp::Error => Err(anyhow!(
                 "error from peer: {}",
                 String::from_utf8_lossy(&self.output_buffer.as_bytes()[..payload_len])
@@ -127,10 +178,13 @@ mod tests {
     use crate::processors::peer::messages::recv;
     use crate::processors::peer::messages::recv_slice;
     use crate::processors::peer::messages::send;
+    use crate::processors::peer::messages::send_frames;
     use crate::processors::peer::messages::send_str;
+    use crate::processors::peer::messages::send_str_with_fd;
     use crate::processors::peer::messages::RequestOp;
     use crate::processors::peer::messages::ResponseOp;
     use crate::processors::peer::messages::CONTROL_MSG_MAX_SIZE;
+    use crate::processors::peer::shm::SharedAudioMemory;
     use crate::processors::peer::worker;
     use crate::AudioProcessor;
     use crate::Format;
@@ -359,6 +413,45 @@ mod tests {
         });
     }
 
+    #[test]
+    fn process_shared_output_too_large() {
+        let (host_fd, worker_fd) = create_socketpair().unwrap();
+        let format = Format {
+            block_size: 4,
+            channels: 1,
+            frame_rate: 48000,
+        };
+        std::thread::scope(|s| {
+            s.spawn(|| {
+                let mut buf = [0u8; CONTROL_MSG_MAX_SIZE];
+                let (op, _) = recv_slice::<RequestOp>(worker_fd.as_fd(), &mut buf).unwrap();
+                assert_eq!(op, RequestOp::Init);
+
+                let (_shm, shm_fd) = SharedAudioMemory::create(format, format).unwrap();
+                send_str_with_fd(
+                    worker_fd.as_fd(),
+                    ResponseOp::Ok,
+                    &serde_json::to_string(&format).unwrap(),
+                    shm_fd.as_fd(),
+                )
+                .unwrap();
+
+                let (op, _) = recv_slice::<RequestOp>(worker_fd.as_fd(), &mut buf).unwrap();
+                assert_eq!(op, RequestOp::ProcessShared);
+                send_frames(worker_fd.as_fd(), ResponseOp::OkShared, 100000).unwrap();
+            });
+            s.spawn(|| {
+                let mut processor =
+                    BlockingSeqPacketProcessor::new(host_fd, format, config::Processor::Negate)
+                        .unwrap();
+
+                let mut input = MultiBuffer::from(vec![vec![1f32]]);
+                let err = processor.process(input.as_multi_slice()).unwrap_err();
+                assert!(format!("{err:#}").contains("do not fit"), "{err:#}");
+            });
+        });
+    }
+
     #[test]
     fn process_negate() {
         let (host_fd, worker_fd) = create_socketpair().unwrap();
@@ -10,7 +10,9 @@ use std::io::IoSlice;
 use std::io::IoSliceMut;
 use std::os::fd::AsRawFd;
 use std::os::fd::BorrowedFd;
+use std::os::fd::FromRawFd;
 use std::os::fd::OwnedFd;
+use std::os::fd::RawFd;
 use std::slice;
 
 use anyhow::bail;
@@ -20,6 +22,8 @@ use nix::sys::socket::recvmsg;
 use nix::sys::socket::sendmsg;
 use nix::sys::socket::socketpair;
 use nix::sys::socket::AddressFamily;
+use nix::sys::socket::ControlMessage;
+use nix::sys::socket::ControlMessageOwned;
 use nix::sys::socket::MsgFlags;
 use nix::sys::socket::SockFlag;
 use nix::sys::socket::SockType;
@@ -36,6 +40,8 @@ pub(super) enum RequestOp {
     Init,
     Process,
     Stop,
+    // Audio is in the shared memory, the payload is the frame count as u32.
+    ProcessShared,
 }
 
 // The maximum size of control (non-audio data) messages.
@@ -45,6 +51,10 @@ pub(super) const CONTROL_MSG_MAX_SIZE: usize = 4096;
 pub(super) struct Init {
     pub input_format: Format,
     pub config: config::Processor,
+    /// Asks the worker to pass audio through shared memory. If the worker
+    /// agrees, it attaches a memfd to the reply. See `shm`.
+    #[serde(default)]
+    pub shared_memory: bool,
 }
 
 #[repr(u8)]
@@ -52,6 +62,8 @@ pub(super) struct Init {
 pub(super) enum ResponseOp {
     Ok,
     Error,
+    // Audio is in the shared memory, the payload is the frame count as u32.
+    OkShared,
 }
 
 pub(super) trait Op: Sized {
@@ -71,6 +83,8 @@ impl Op for RequestOp {
             Ok(RequestOp::Process)
         } else if op == RequestOp::Stop as u8 {
             Ok(RequestOp::Stop)
+        } else if op == RequestOp::ProcessShared as u8 {
+            Ok(RequestOp::ProcessShared)
         } else {
             bail!("unexpected Op {op}");
         }
@@ -87,6 +101,8 @@ impl Op for ResponseOp {
             Ok(ResponseOp::Ok)
         } else if op == ResponseOp::Error as u8 {
             Ok(ResponseOp::Error)
+        } else if op == ResponseOp::OkShared as u8 {
+            Ok(ResponseOp::OkShared)
         } else {
             bail!("unexpected Op {op}");
         }
@@ -114,6 +130,44 @@ pub(super) fn send_str(fd: BorrowedFd, op: impl Op, s: &str) -> anyhow::Result<(
     send(fd, op, std::iter::once(IoSlice::new(s.as_bytes())))
 }
 
+/// Like `send_str` but also passes `passed_fd` to the peer.
+pub(super) fn send_str_with_fd(
+    fd: BorrowedFd,
+    op: impl Op,
+    s: &str,
+    passed_fd: BorrowedFd,
+) -> anyhow::Result<()> {
+    let op_byte = op.as_u8();
+    let iov = [
+        IoSlice::new(slice::from_ref(&op_byte)),
+        IoSlice::new(s.as_bytes()),
+    ];
+    let fds = [passed_fd.as_raw_fd()];
+    sendmsg::<()>(
+        fd.as_raw_fd(),
+        &iov,
+        &[ControlMessage::ScmRights(&fds)],
+        MsgFlags::empty(),
+        None,
+    )
+    .context("sendmsg")?;
+    Ok(())
+}
+
+/// Sends a message whose payload is a frame count.
+pub(super) fn send_frames(fd: BorrowedFd, op: impl Op, frames: usize) -> anyhow::Result<()> {
+    let frames = u32::try_from(frames).context("frames")?;
+    send(fd, op, std::iter::once(IoSlice::new(&frames.to_ne_bytes())))
+}
+
+/// Parses the payload of a message sent with `send_frames`.
+pub(super) fn parse_frames(payload: &[u8]) -> anyhow::Result<usize> {
+    let bytes: [u8; 4] = payload
+        .try_into()
+        .with_context(|| format!("invalid frames payload length {}", payload.len()))?;
+    Ok(u32::from_ne_bytes(bytes) as usize)
+}
+
 pub(super) fn recv<'a, T: Op>(fd: BorrowedFd, buf: &mut [u8]) -> anyhow::Result<(T, usize)> {
     let mut op_byte = 255u8;
 
@@ -127,6 +181,43 @@ pub(super) fn recv<'a, T: Op>(fd: BorrowedFd, buf: &mut [u8]) -> anyhow::Result<
     Ok((T::try_from_u8(op_byte)?, payload_len))
 }
 
+/// Like `recv` but also returns the fd passed by the peer, if any.
+pub(super) fn recv_with_fd<T: Op>(
+    fd: BorrowedFd,
+    buf: &mut [u8],
+) -> anyhow::Result<(T, usize, Option<OwnedFd>)> {
+    let mut op_byte = 255u8;
+    let mut cmsg_buf = nix::cmsg_space!([RawFd; 1]);
+
+    let mut iov = [
+        IoSliceMut::new(slice::from_mut(&mut op_byte)),
+        IoSliceMut::new(buf),
+    ];
+    let r = recvmsg::<()>(
+        fd.as_raw_fd(),
+        &mut iov,
+        Some(&mut cmsg_buf),
+        MsgFlags::MSG_CMSG_CLOEXEC,
+    )
+    .context("recvmsg")?;
+    let mut passed_fd = None;
+    for cmsg in r.cmsgs() {
+        if let ControlMessageOwned::ScmRights(fds) = cmsg {
+            for raw_fd in fds {
+                // SAFETY: The kernel installed `raw_fd` for this process and
+                // nothing else refers to it.
+                let owned = unsafe { OwnedFd::from_raw_fd(raw_fd) };
+                passed_fd.get_or_insert(owned);
+            }
+        }
+    }
+    let payload_len = r.bytes.checked_sub(1).context("empty message")?;
+    ensure!(!r.flags.contains(MsgFlags::MSG_TRUNC), "message too long");
+    ensure!(!r.flags.contains(MsgFlags::MSG_CTRUNC), "too many fds");
+    Ok((T::try_from_u8(op_byte)?, payload_len, passed_fd))
+}
+
+#[cfg(test)]
 pub(super) fn recv_slice<'a, T: Op>(
     fd: BorrowedFd,
     buf: &'a mut [u8],
@@ -135,14 +226,15 @@ pub(super) fn recv_slice<'a, T: Op>(
     Ok((op, &mut buf[..len]))
 }
 
+pub(super) fn new_payload_buffer_len(format: Format) -> usize {
+    Ord::max(
+        CONTROL_MSG_MAX_SIZE / 4,            // For control messages.
+        format.block_size * format.channels, // For audio data.
+    )
+}
+
 pub(super) fn new_payload_buffer(format: Format) -> Vec<f32> {
-    vec![
-        0f32;
-        Ord::max(
-            CONTROL_MSG_MAX_SIZE / 4,            // For control messages.
-            format.block_size * format.channels, // For audio data.
-        )
-    ]
+    vec![0f32; new_payload_buffer_len(format)]
 }
 
 pub(super) fn multi_slice_from_buf(
@@ -193,6 +285,24 @@ mod tests {
         assert_eq!(msg, b"hello world");
     }
 
+    #[test]
+    fn roundtrip_with_fd() {
+        let (tx, rx) = create_socketpair().unwrap();
+        let (passed, _) = create_socketpair().unwrap();
+        super::send_str_with_fd(tx.as_fd(), RequestOp::Init, "hi", passed.as_fd()).unwrap();
+        let mut buf = [0u8; 1024];
+        let (op, len, fd) = super::recv_with_fd::<RequestOp>(rx.as_fd(), &mut buf).unwrap();
+        assert_eq!(op, RequestOp::Init);
+        assert_eq!(&buf[..len], b"hi");
+        assert!(fd.is_some());
+
+        super::send_frames(tx.as_fd(), RequestOp::ProcessShared, 480).unwrap();
+        let (op, len, fd) = super::recv_with_fd::<RequestOp>(rx.as_fd(), &mut buf).unwrap();
+        assert_eq!(op, RequestOp::ProcessShared);
+        assert_eq!(super::parse_frames(&buf[..len]).unwrap(), 480);
+        assert!(fd.is_none());
+    }
+
     #[test]
     fn too_long() {
         let (tx, rx) = create_socketpair().unwrap();
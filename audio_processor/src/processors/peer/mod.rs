@@ -5,6 +5,7 @@
 mod host;
 mod managed;
 mod messages;
+mod shm;
 mod worker;
 
 pub use host::BlockingSeqPacketProcessor;
@@ -0,0 +1,282 @@
+// Copyright 2024 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//! Shared memory used to pass audio blocks between the host and the worker
+//! without copying them through the socket.
+//!
+//! The memory is a sealed memfd created by the worker and sent to the host in
+//! the reply to the Init request. It holds an input region followed by an
+//! output region, each sized with `payload_len`. Within a region, channels
+//! are stored one after another, each `frames` samples long. The socket is
+//! then only used for small doorbell messages carrying frame counts.
+
+use std::ffi::CStr;
+use std::os::fd::AsRawFd;
+use std::os::fd::BorrowedFd;
+use std::os::fd::FromRawFd;
+use std::os::fd::OwnedFd;
+use std::ptr::NonNull;
+
+use anyhow::bail;
+use anyhow::ensure;
+use anyhow::Context;
+
+use crate::Format;
+use crate::MultiSlice;
+
+/// Seals that guarantee the size of the memfd never changes. Without them a
+/// peer could truncate the file and make the other side fault on access.
+const REQUIRED_SEALS: libc::c_int = libc::F_SEAL_SHRINK | libc::F_SEAL_GROW;
+
+/// Returns the number of samples a region needs to hold a block of `format`.
+/// Matches the size of the buffers used for socket payloads.
+pub(super) fn payload_len(format: Format) -> usize {
+    super::messages::new_payload_buffer_len(format)
+}
+
+pub(super) struct SharedAudioMemory {
+    addr: NonNull<f32>,
+    input_len: usize,
+    output_len: usize,
+}
+
+// SAFETY: The mapping is owned by `SharedAudioMemory` and only accessed
+// through `&mut self`.
+unsafe impl Send for SharedAudioMemory {}
+
+impl SharedAudioMemory {
+    fn size_bytes(input_len: usize, output_len: usize) -> anyhow::Result<usize> {
+        input_len
+            .checked_add(output_len)
+            .and_then(|len| len.checked_mul(std::mem::size_of::<f32>()))
+            .context("shared memory size overflow")
+    }
+
+    /// Creates and maps a sealed memfd for blocks of `input_format` and
+    /// `output_format`. Returns the mapping and the fd to send to the peer.
+    pub fn create(input_format: Format, output_format: Format) -> anyhow::Result<(Self, OwnedFd)> {
+        let input_len = payload_len(input_format);
+        let output_len = payload_len(output_format);
+        let size = Self::size_bytes(input_len, output_len)?;
+
+        let name = CStr::from_bytes_with_nul(b"audio_processor_peer\0").unwrap();
+        // SAFETY: `name` is a valid NULL-terminated string.
+        let raw_fd = unsafe {
+            libc::memfd_create(name.as_ptr(), libc::MFD_CLOEXEC | libc::MFD_ALLOW_SEALING)
+        };
+        if raw_fd < 0 {
+            return Err(std::io::Error::last_os_error()).context("memfd_create");
+        }
+        // SAFETY: `raw_fd` was just created and is owned by nobody else.
+        let fd = unsafe { OwnedFd::from_raw_fd(raw_fd) };
+
+        // SAFETY: `fd` is a valid file descriptor.
+        if unsafe { libc::ftruncate(fd.as_raw_fd(), size as libc::off_t) } < 0 {
+            return Err(std::io::Error::last_os_error()).context("ftruncate");
+        }
+        // SAFETY: `fd` is a valid file descriptor.
+        if unsafe {
+            libc::fcntl(
+                fd.as_raw_fd(),
+                libc::F_ADD_SEALS,
+                REQUIRED_SEALS | libc::F_SEAL_SEAL,
+            )
+        } < 0
+        {
+            return Err(std::io::Error::last_os_error()).context("F_ADD_SEALS");
+        }
+
+        let shm = Self::map_fd(fd.as_raw_fd(), input_len, output_len)?;
+        Ok((shm, fd))
+    }
+
+    /// Maps a memfd received from the peer, checking that it is sealed and
+    /// large enough for blocks of `input_format` and `output_format`.
+    pub fn map(
+        fd: BorrowedFd,
+        input_format: Format,
+        output_format: Format,
+    ) -> anyhow::Result<Self> {
+        let input_len = payload_len(input_format);
+        let output_len = payload_len(output_format);
+        let size = Self::size_bytes(input_len, output_len)?;
+
+        // SAFETY: `fd` is a valid file descriptor.
+        let seals = unsafe { libc::fcntl(fd.as_raw_fd(), libc::F_GET_SEALS) };
+        if seals < 0 {
+            return Err(std::io::Error::last_os_error()).context("F_GET_SEALS");
+        }
+        ensure!(
+            seals & REQUIRED_SEALS == REQUIRED_SEALS,
+            "shared memory is not sealed: {seals:#x}"
+        );
+
+        // SAFETY: `stat` is plain data and filled by fstat.
+        let mut stat: libc::stat = unsafe { std::mem::zeroed() };
+        // SAFETY: `fd` is a valid file descriptor and `stat` is writable.
+        if unsafe { libc::fstat(fd.as_raw_fd(), &mut stat) } < 0 {
+            return Err(std::io::Error::last_os_error()).context("fstat");
+        }
+        ensure!(
+            stat.st_size >= 0 && stat.st_size as usize >= size,
+            "shared memory too small: {} < {size}",
+            stat.st_size
+        );
+
+        Self::map_fd(fd.as_raw_fd(), input_len, output_len)
+    }
+
+    fn map_fd(raw_fd: libc::c_int, input_len: usize, output_len: usize) -> anyhow::Result<Self> {
+        let size = Self::size_bytes(input_len, output_len)?;
+        if size == 0 {
+            bail!("empty shared memory");
+        }
+        // SAFETY: Maps a new region, no existing memory is affected.
+        let addr = unsafe {
+            libc::mmap(
+                std::ptr::null_mut(),
+                size,
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_SHARED,
+                raw_fd,
+                0,
+            )
+        };
+        if addr == libc::MAP_FAILED {
+            return Err(std::io::Error::last_os_error()).context("mmap");
+        }
+        Ok(Self {
+            addr: NonNull::new(addr as *mut f32).context("mmap returned NULL")?,
+            input_len,
+            output_len,
+        })
+    }
+
+    /// Returns the input and output regions.
+    pub fn regions(&mut self) -> (&mut [f32], &mut [f32]) {
+        // SAFETY: The mapping is `input_len + output_len` samples long, page
+        // aligned and lives as long as `self`, which is mutably borrowed.
+        // The peer may write to the memory concurrently, which can only
+        // garble the audio samples, any bit pattern being a valid f32.
+        let all = unsafe {
+            std::slice::from_raw_parts_mut(self.addr.as_ptr(), self.input_len + self.output_len)
+        };
+        all.split_at_mut(self.input_len)
+    }
+}
+
+impl Drop for SharedAudioMemory {
+    fn drop(&mut self) {
+        let size = (self.input_len + self.output_len) * std::mem::size_of::<f32>();
+        // SAFETY: Unmaps the region mapped in `map_fd`, no reference to it
+        // outlives `self`.
+        unsafe {
+            libc::munmap(self.addr.as_ptr() as *mut libc::c_void, size);
+        }
+    }
+}
+
+/// Returns a `MultiSlice` of `channels` channels of `frames` samples stored
+/// one after another in `region`.
+pub(super) fn multi_slice_from_region(
+    region: &mut [f32],
+    frames: usize,
+    channels: usize,
+) -> anyhow::Result<MultiSlice<'_, f32>> {
+    let len = frames
+        .checked_mul(channels)
+        .filter(|len| *len <= region.len())
+        .with_context(|| {
+            format!(
+                "{frames} frames of {channels} channels do not fit in {} samples",
+                region.len()
+            )
+        })?;
+    let mut rest = &mut region[..len];
+    let mut slices = Vec::with_capacity(channels);
+    for _ in 0..channels {
+        let (ch, tail) = std::mem::take(&mut rest).split_at_mut(frames);
+        slices.push(ch);
+        rest = tail;
+    }
+    Ok(MultiSlice::from_raw(slices))
+}
+
+/// Copies `src` into `region` with the layout of `multi_slice_from_region`.
+/// Returns the number of frames copied, or None if `src` does not fit or
+/// its channels have different lengths.
+pub(super) fn copy_to_region(src: &MultiSlice<f32>, region: &mut [f32]) -> Option<usize> {
+    let frames = src.min_len();
+    if src.iter().any(|ch| ch.len() != frames) || frames.checked_mul(src.channels())? > region.len()
+    {
+        return None;
+    }
+    if frames > 0 {
+        for (ch, dst) in src.iter().zip(region.chunks_mut(frames)) {
+            dst.copy_from_slice(ch);
+        }
+    }
+    Some(frames)
+}
+
+#[cfg(test)]
+mod tests {
+    use std::os::fd::AsFd;
+
+    use super::*;
+    use crate::MultiBuffer;
+
+    const INPUT: Format = Format {
+        channels: 2,
+        block_size: 480,
+        frame_rate: 48000,
+    };
+    const OUTPUT: Format = Format {
+        channels: 1,
+        block_size: 2048,
+        frame_rate: 48000,
+    };
+
+    #[test]
+    fn create_and_map_share_memory() {
+        let (mut worker, fd) = SharedAudioMemory::create(INPUT, OUTPUT).unwrap();
+        let mut host = SharedAudioMemory::map(fd.as_fd(), INPUT, OUTPUT).unwrap();
+        assert_eq!(host.regions().0.len(), worker.regions().0.len());
+        assert_eq!(host.regions().1.len(), 2048);
+
+        host.regions().0[3] = 1.5;
+        worker.regions().1[7] = -2.5;
+        assert_eq!(worker.regions().0[3], 1.5);
+        assert_eq!(host.regions().1[7], -2.5);
+    }
+
+    #[test]
+    fn map_rejects_small_memory() {
+        let (_worker, fd) = SharedAudioMemory::create(INPUT, INPUT).unwrap();
+        let err = match SharedAudioMemory::map(fd.as_fd(), INPUT, OUTPUT) {
+            Ok(_) => panic!("should fail"),
+            Err(err) => err,
+        };
+        assert!(err.to_string().contains("too small"), "{err}");
+    }
+
+    #[test]
+    fn region_roundtrip() {
+        let mut region = vec![0f32; 8];
+        let mut input = MultiBuffer::from(vec![vec![1f32, 2., 3.], vec![4., 5., 6.]]);
+        assert_eq!(
+            copy_to_region(&input.as_multi_slice(), &mut region),
+            Some(3)
+        );
+        let output = multi_slice_from_region(&mut region, 3, 2).unwrap();
+        assert_eq!(output.into_raw(), [[1f32, 2., 3.], [4., 5., 6.]]);
+
+        assert!(multi_slice_from_region(&mut region, 5, 2).is_err());
+        let mut too_large = MultiBuffer::from(vec![vec![0f32; 5], vec![0f32; 5]]);
+        assert_eq!(
+            copy_to_region(&too_large.as_multi_slice(), &mut region),
+            None
+        );
+    }
+}
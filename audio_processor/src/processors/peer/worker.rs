@@ -15,9 +15,15 @@ use zerocopy::AsBytes;
 
 use super::messages::multi_slice_from_buf;
 use super::messages::new_payload_buffer;
+use super::messages::parse_frames;
 use super::messages::send;
+use super::messages::send_frames;
 use super::messages::send_str;
+use super::messages::send_str_with_fd;
 use super::messages::ResponseOp;
+use super::shm::copy_to_region;
+use super::shm::multi_slice_from_region;
+use super::shm::SharedAudioMemory;
 use crate::processors::peer::messages::recv;
 use crate::processors::peer::messages::Init;
 use crate::processors::peer::messages::RequestOp;
@@ -43,10 +49,15 @@ pub struct Worker<'a> {
     /// the sender is allowed to send fewer frames than the configured block size.
     input_format: Format,
     input_buffer: Vec<f32>,
+    /// Set if the host asked to pass audio through shared memory.
+    shm: Option<SharedAudioMemory>,
 }
 
 enum Response<'a> {
     AudioOutput(MultiSlice<'a, f32>),
+    /// Output of a block received through the shared memory, to be returned
+    /// through the output region if it fits.
+    SharedAudioOutput(MultiSlice<'a, f32>, &'a mut [f32]),
     Stop,
 }
 
@@ -72,19 +83,25 @@ impl<'a> Worker<'a> {
         let output_format = pipeline.get_output_format();
         alarm::cancel();
 
-        send_str(
-            fd,
-            ResponseOp::Ok,
-            &serde_json::to_string(&output_format)
-                .context("serde_json::to_string(output_format)")?,
-        )
-        .context("send response")?;
+        let reply = serde_json::to_string(&output_format)
+            .context("serde_json::to_string(output_format)")?;
+        let shm = if config.shared_memory {
+            let (shm, shm_fd) = SharedAudioMemory::create(config.input_format, output_format)
+                .context("SharedAudioMemory::create")?;
+            send_str_with_fd(fd, ResponseOp::Ok, &reply, shm_fd.as_fd())
+                .context("send response")?;
+            Some(shm)
+        } else {
+            send_str(fd, ResponseOp::Ok, &reply).context("send response")?;
+            None
+        };
 
         Ok(Self {
             fd,
             pipeline,
             input_format: config.input_format,
             input_buffer: new_payload_buffer(config.input_format),
+            shm,
         })
     }
 
@@ -93,6 +110,7 @@ impl<'a> Worker<'a> {
         pipeline: &'c mut Pipeline,
         input_buffer: &'c mut Vec<f32>,
         input_format: &'c Format,
+        shm: &'c mut Option<SharedAudioMemory>,
     ) -> anyhow::Result<Response<'c>> {
         let (request_op, payload_len) =
             recv::<RequestOp>(fd.as_fd(), input_buffer.as_bytes_mut()).context("recv")?;
@@ -109,6 +127,20 @@ impl<'a> Worker<'a> {
 
                 Ok(Response::AudioOutput(output))
             }
+            RequestOp::ProcessShared => {
+                let frames = parse_frames(&input_buffer.as_bytes()[..payload_len])?;
+                let (input_region, output_region) = shm
+                    .as_mut()
+                    .context("ProcessShared without shared memory")?
+                    .regions();
+                let input = multi_slice_from_region(input_region, frames, input_format.channels)?;
+
+                alarm::set(AUDIO_WORKER_PIPELINE_TIMEOUT_SEC);
+                let output = pipeline.process(input).context("pipeline.process")?;
+                alarm::cancel();
+
+                Ok(Response::SharedAudioOutput(output, output_region))
+            }
             RequestOp::Stop => Ok(Response::Stop),
         }
     }
@@ -119,6 +151,7 @@ impl<'a> Worker<'a> {
             &mut self.pipeline,
             &mut self.input_buffer,
             &self.input_format,
+            &mut self.shm,
         ) {
             Ok(response) => match response {
                 Response::AudioOutput(multi_slice) => {
@@ -131,6 +164,19 @@ impl<'a> Worker<'a> {
                     )?;
                     Ok(ControlFlow::Continue(()))
                 }
+                Response::SharedAudioOutput(multi_slice, output_region) => {
+                    match copy_to_region(&multi_slice, output_region) {
+                        Some(frames) => send_frames(self.fd.as_fd(), ResponseOp::OkShared, frames)?,
+                        None => send(
+                            self.fd.as_fd(),
+                            ResponseOp::Ok,
+                            multi_slice
+                                .iter()
+                                .map(|slice| IoSlice::new(slice.as_bytes())),
+                        )?,
+                    }
+                    Ok(ControlFlow::Continue(()))
+                }
                 Response::Stop => {
                     send(self.fd.as_fd(), ResponseOp::Ok, std::iter::empty())?;
                     Ok(ControlFlow::Break(()))
@@ -185,12 +231,16 @@ mod tests {
     use super::Worker;
     use crate::config;
     use crate::processors::peer::messages::create_socketpair;
+    use crate::processors::peer::messages::parse_frames;
     use crate::processors::peer::messages::recv_slice;
+    use crate::processors::peer::messages::recv_with_fd;
     use crate::processors::peer::messages::send;
+    use crate::processors::peer::messages::send_frames;
     use crate::processors::peer::messages::send_str;
     use crate::processors::peer::messages::Init;
     use crate::processors::peer::messages::RequestOp;
     use crate::processors::peer::messages::ResponseOp;
+    use crate::processors::peer::shm::SharedAudioMemory;
     use crate::Format;
     use crate::MultiBuffer;
 
@@ -250,7 +300,9 @@ mod tests {
             },
             config: config::Processor::Resample {
                 output_frame_rate: 48000,
+                quality: Default::default(),
             },
+            shared_memory: false,
         };
         send(
             host_fd.as_fd(),
@@ -300,6 +352,7 @@ mod tests {
                 frame_rate: 24000,
             },
             config: config::Processor::Negate,
+            shared_memory: false,
         };
         send(
             host_fd.as_fd(),
@@ -335,6 +388,7 @@ mod tests {
                 frame_rate: 24000,
             },
             config: config::Processor::Negate,
+            shared_memory: false,
         };
         send(
             host_fd.as_fd(),
@@ -383,4 +437,50 @@ mod tests {
 
         worker_thread.join().unwrap();
     }
+
+    #[test]
+    fn process_negate_shared_memory() {
+        let (host_fd, worker_fd) = create_socketpair().unwrap();
+        let worker_thread = std::thread::spawn(move || {
+            Worker::run_result(worker_fd).unwrap();
+        });
+        let format = Format {
+            channels: 2,
+            block_size: 3,
+            frame_rate: 24000,
+        };
+        let config = Init {
+            input_format: format,
+            config: config::Processor::Negate,
+            shared_memory: true,
+        };
+        send_str(
+            host_fd.as_fd(),
+            RequestOp::Init,
+            &serde_json::ser::to_string(&config).unwrap(),
+        )
+        .unwrap();
+
+        let mut buf = vec![0u8; 1024];
+        let (response_op, _, shm_fd) =
+            recv_with_fd::<ResponseOp>(host_fd.as_fd(), &mut buf).unwrap();
+        assert_eq!(response_op, ResponseOp::Ok);
+        let mut shm = SharedAudioMemory::map(shm_fd.unwrap().as_fd(), format, format).unwrap();
+
+        // Blocks shorter than block_size are allowed.
+        shm.regions().0[..4].copy_from_slice(&[1., 2., 4., 5.]);
+        send_frames(host_fd.as_fd(), RequestOp::ProcessShared, 2).unwrap();
+        let (response_op, payload) = recv_slice::<ResponseOp>(host_fd.as_fd(), &mut buf).unwrap();
+        assert_eq!(response_op, ResponseOp::OkShared);
+        assert_eq!(parse_frames(payload).unwrap(), 2);
+        assert_eq!(shm.regions().1[..4], [-1., -2., -4., -5.]);
+
+        // Frame counts that overflow the shared memory are rejected.
+        send_frames(host_fd.as_fd(), RequestOp::ProcessShared, 100000).unwrap();
+        let (response_op, payload) = recv_slice::<ResponseOp>(host_fd.as_fd(), &mut buf).unwrap();
+        assert_eq!(response_op, ResponseOp::Error);
+        assert_payload_contains(payload, "do not fit");
+
+        worker_thread.join().unwrap();
+    }
 }
@@ -2,9 +2,12 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+use super::binding;
 use super::dl;
+use super::processor::zeroed_ext;
 use super::PluginProcessor;
 use super::PluginProcessorCreate;
+use super::PluginProcessorQuery;
 use crate::AudioProcessor;
 use crate::Format;
 
@@ -40,6 +43,36 @@ impl DynamicPluginProcessor {
             _library: dyn_lib,
         })
     }
+
+    /// Returns the extension table the constructor named `symbol` in `lib`
+    /// would fill when creating a processor with `format`, without creating
+    /// it. The table is zeroed if the library does not export a
+    /// `processor_query` for the constructor.
+    pub fn query(
+        lib: &str,
+        symbol: &str,
+        format: Format,
+    ) -> crate::Result<binding::plugin_processor_ext> {
+        let dyn_lib = dl::DynLib::new(lib)?;
+        let Ok(sym) = dyn_lib.sym(&format!("{symbol}_query")) else {
+            return Ok(zeroed_ext());
+        };
+        let query: PluginProcessorQuery = unsafe { std::mem::transmute(sym) };
+
+        // SAFETY: We assume that the dynamic library is safe if it is
+        // loaded successfully.
+        unsafe { PluginProcessor::query(query, format) }
+    }
+
+    /// Returns the wrapped [`PluginProcessor`].
+    pub fn plugin(&self) -> &PluginProcessor {
+        &self.processor
+    }
+
+    /// Returns the wrapped [`PluginProcessor`] mutably.
+    pub fn plugin_mut(&mut self) -> &mut PluginProcessor {
+        &mut self.processor
+    }
 }
 
 impl AudioProcessor for DynamicPluginProcessor {
@@ -6,12 +6,19 @@ use super::binding;
 use super::PluginError;
 use crate::AudioProcessor;
 use crate::Format;
+use crate::MultiBuffer;
+use crate::Shape;
 
 pub type PluginProcessorCreate = unsafe extern "C" fn(
     out: *mut *mut binding::plugin_processor,
     config: *const binding::plugin_processor_config,
 ) -> binding::status;
 
+pub type PluginProcessorQuery = unsafe extern "C" fn(
+    config: *const binding::plugin_processor_config,
+    ext: *mut binding::plugin_processor_ext,
+) -> binding::status;
+
 pub type PluginProcessorRun = unsafe extern "C" fn(
     *mut binding::plugin_processor,
     *const binding::multi_slice,
@@ -24,6 +31,25 @@ pub type PluginProcessorDestroy =
 pub type PluginProcessorGetOutputFrameRate =
     unsafe extern "C" fn(*mut binding::plugin_processor, *mut usize) -> binding::status;
 
+pub type PluginProcessorProcessMany = unsafe extern "C" fn(
+    *mut binding::plugin_processor,
+    *const binding::multi_slice,
+    *mut binding::multi_slice,
+    usize,
+) -> binding::status;
+
+/// Buffers used to pass several blocks to `process_many` at once.
+#[derive(Debug)]
+struct Batch {
+    process_many: PluginProcessorProcessMany,
+    max_blocks: usize,
+    inputs: Vec<binding::multi_slice>,
+    outputs: Vec<binding::multi_slice>,
+    // Holds the output when the plugin does not return the blocks one after
+    // another in memory. Has as many channels as the input.
+    buffer: MultiBuffer<f32>,
+}
+
 #[derive(Debug)]
 /// `PluginProcessor` is an [`AudioProcessor`] that wraps an audio processor
 /// implemented in another language.
@@ -33,11 +59,25 @@ pub struct PluginProcessor {
     destroy: PluginProcessorDestroy,
     input_format: Format,
     _get_output_frame_rate: PluginProcessorGetOutputFrameRate,
+    // Boxed so the pointer passed to the constructor stays valid for the
+    // lifetime of the processor.
+    ext: Box<binding::plugin_processor_ext>,
+    batch: Option<Batch>,
 }
 
 // SAFETY: Assume that the binding is safe to use across different threads.
 unsafe impl Send for PluginProcessor {}
 
+/// Returns an extension table for plugins that do not fill it.
+pub(super) fn zeroed_ext() -> binding::plugin_processor_ext {
+    binding::plugin_processor_ext {
+        latency_frames: 0,
+        preferred_block_size: 0,
+        realtime_safe: false,
+        process_many: None,
+    }
+}
+
 /// Helper to create a [`crate::Error`] for unexpected NULLs.
 fn null_error(desc: &str) -> crate::Error {
     crate::Error::Plugin(PluginError::UnexpectedNull(String::from(desc)))
@@ -54,11 +94,13 @@ impl PluginProcessor {
         constructor: PluginProcessorCreate,
         format: Format,
     ) -> crate::Result<PluginProcessor> {
+        let mut ext = Box::new(zeroed_ext());
         let config = binding::plugin_processor_config {
             block_size: format.block_size,
             channels: format.channels,
             frame_rate: format.frame_rate,
             debug: false,
+            ext: ext.as_mut(),
         };
 
         let mut handle = std::mem::MaybeUninit::zeroed();
@@ -69,7 +111,31 @@ impl PluginProcessor {
             return Err(null_error("create"));
         }
 
-        Self::from_handle(handle, format)
+        let mut processor = Self::from_handle(handle, format)?;
+        processor.ext = ext;
+        Ok(processor)
+    }
+
+    /// Returns the extension table a processor created by the constructor
+    /// matching `query` with `format` would fill, without creating it.
+    ///
+    /// # Safety
+    /// This function is safe only if `query` is a pointer to a
+    /// `processor_query` function. See also `plugin_processor.h`.
+    pub unsafe fn query(
+        query: PluginProcessorQuery,
+        format: Format,
+    ) -> crate::Result<binding::plugin_processor_ext> {
+        let mut ext = zeroed_ext();
+        let config = binding::plugin_processor_config {
+            block_size: format.block_size,
+            channels: format.channels,
+            frame_rate: format.frame_rate,
+            debug: false,
+            ext: std::ptr::null_mut(),
+        };
+        query(&config, &mut ext).check()?;
+        Ok(ext)
     }
 
     /// Create a [`PluginProcessor`] from a already created plugin_processor
@@ -103,9 +169,145 @@ impl PluginProcessor {
             destroy,
             _get_output_frame_rate,
             input_format: format,
+            ext: Box::new(zeroed_ext()),
+            batch: None,
         })
     }
 
+    /// Returns the number of frames the output is delayed from the input,
+    /// as reported by the plugin.
+    pub fn latency_frames(&self) -> usize {
+        self.ext.latency_frames
+    }
+
+    /// Returns the block size the plugin works best with, or 0 if the
+    /// plugin has no preference.
+    pub fn preferred_block_size(&self) -> usize {
+        self.ext.preferred_block_size
+    }
+
+    /// Returns whether the plugin declared that processing never allocates,
+    /// locks or does I/O.
+    pub fn realtime_safe(&self) -> bool {
+        self.ext.realtime_safe
+    }
+
+    /// Returns whether the plugin can process several blocks in one call.
+    pub fn supports_process_many(&self) -> bool {
+        self.ext.process_many.is_some()
+    }
+
+    /// Lets `process` take up to `max_blocks` blocks at once and pass them
+    /// to the plugin's `process_many`. Inputs must then be a multiple of
+    /// the block size. Does nothing if the plugin does not support it.
+    pub fn enable_batching(&mut self, max_blocks: usize) {
+        let Some(process_many) = self.ext.process_many else {
+            return;
+        };
+        if max_blocks <= 1 {
+            self.batch = None;
+            return;
+        }
+        self.batch = Some(Batch {
+            process_many,
+            max_blocks,
+            inputs: Vec::with_capacity(max_blocks),
+            outputs: Vec::with_capacity(max_blocks),
+            buffer: MultiBuffer::new(Shape {
+                channels: self.input_format.channels,
+                frames: max_blocks * self.input_format.block_size,
+            }),
+        });
+    }
+
+    /// Returns whether [`Self::enable_batching`] took effect.
+    pub fn batching_enabled(&self) -> bool {
+        self.batch.is_some()
+    }
+
+    fn process_batch<'a>(
+        &'a mut self,
+        input: crate::MultiSlice<'a, f32>,
+    ) -> crate::Result<crate::MultiSlice<'a, f32>> {
+        let block_size = self.input_format.block_size;
+        let frames = input.min_len();
+        let batch = self.batch.as_mut().expect("batching not enabled");
+        let num_blocks = frames / block_size;
+        if frames % block_size != 0 || num_blocks > batch.max_blocks {
+            return Err(crate::Error::InvalidShape {
+                want_channels: input.channels(),
+                want_frames: batch.max_blocks * block_size,
+                got_channels: input.channels(),
+                got_frames: frames,
+            });
+        }
+
+        let c_input = binding::multi_slice::try_from(input)?;
+        batch.inputs.clear();
+        for i in 0..num_blocks {
+            let mut block = c_input;
+            block.num_frames = block_size;
+            for ch in &mut block.data[..block.channels] {
+                *ch = ch.wrapping_add(i * block_size);
+            }
+            batch.inputs.push(block);
+        }
+        batch.outputs.clear();
+        batch
+            .outputs
+            .resize(num_blocks, binding::multi_slice::zeroed());
+        // SAFETY: `inputs` and `outputs` hold `num_blocks` elements and the
+        // input blocks point into `input`, which outlives the call.
+        unsafe {
+            (batch.process_many)(
+                self.handle,
+                batch.inputs.as_ptr(),
+                batch.outputs.as_mut_ptr(),
+                num_blocks,
+            )
+            .check()?;
+        }
+
+        let first = batch.outputs[0];
+        let mut contiguous = true;
+        for (i, block) in batch.outputs.iter().enumerate() {
+            if block.channels != first.channels
+                || block.channels > self.input_format.channels
+                || block.num_frames != block_size
+            {
+                return Err(crate::Error::InvalidShape {
+                    want_channels: first.channels,
+                    want_frames: block_size,
+                    got_channels: block.channels,
+                    got_frames: block.num_frames,
+                });
+            }
+            contiguous &= block.data[..block.channels]
+                .iter()
+                .zip(first.data.iter())
+                .all(|(ch, first_ch)| *ch == first_ch.wrapping_add(i * block_size));
+        }
+
+        if contiguous {
+            let mut output = first;
+            output.num_frames = frames;
+            // SAFETY: The plugin returned `num_blocks` blocks which follow
+            // each other in memory, so each channel holds `frames` samples.
+            return Ok(unsafe { crate::MultiSlice::from_raw(output.as_slice_vec()) });
+        }
+
+        let mut channels = batch.buffer.as_multi_slice().into_raw();
+        channels.truncate(first.channels);
+        for (i, block) in batch.outputs.iter_mut().enumerate() {
+            // SAFETY: The plugin returned a valid multi_slice.
+            let src = unsafe { block.as_slice_vec() };
+            for (dst, src) in channels.iter_mut().zip(src) {
+                dst[i * block_size..(i + 1) * block_size].copy_from_slice(src);
+            }
+        }
+        Ok(crate::MultiSlice::from_raw(channels).into_indexes(0..frames))
+    }
+
     fn get_output_frame_rate<'a>(&'a self) -> usize {
         let mut frame_rate = 0;
         let status = unsafe { (self._get_output_frame_rate)(self.handle, &mut frame_rate) };
@@ -134,6 +336,9 @@ impl AudioProcessor for PluginProcessor {
         &'a mut self,
         input: crate::MultiSlice<'a, Self::I>,
     ) -> crate::Result<crate::MultiSlice<'a, Self::O>> {
+        if self.batch.is_some() && input.min_len() > self.input_format.block_size {
+            return self.process_batch(input);
+        }
         let mut c_input = binding::multi_slice::try_from(input)?;
         let mut c_output = binding::multi_slice::zeroed();
         // SAFETY: we assume that `self` is a valid `PluginProcessor`, thus
@@ -312,6 +517,94 @@ mod plugin_tests {
         assert_eq!(input.to_vecs(), [[1., 2., 3., 4.], [5., 6., 7., 8.]]);
     }
 
+    #[test]
+    fn ext_defaults() {
+        let ap = unsafe {
+            PluginProcessor::new(
+                binding::negate_processor_create,
+                Format {
+                    channels: 2,
+                    block_size: 4,
+                    frame_rate: 48000,
+                },
+            )
+        }
+        .unwrap();
+
+        assert!(ap.realtime_safe());
+        assert_eq!(ap.latency_frames(), 0);
+        assert_eq!(ap.preferred_block_size(), 0);
+        assert!(!ap.supports_process_many());
+    }
+
+    #[test]
+    fn negate_process_many() {
+        let mut ap = unsafe {
+            PluginProcessor::new(
+                binding::negate_batch_processor_create,
+                Format {
+                    channels: 2,
+                    block_size: 2,
+                    frame_rate: 48000,
+                },
+            )
+        }
+        .unwrap();
+        assert!(ap.supports_process_many());
+        assert_eq!(
+            ap.preferred_block_size(),
+            2 * binding::NEGATE_BATCH_BLOCKS as usize
+        );
+        ap.enable_batching(binding::NEGATE_BATCH_BLOCKS as usize);
+
+        let mut input: MultiBuffer<f32> = MultiBuffer::from(vec![
+            vec![1., 2., 3., 4., 5., 6.],
+            vec![7., 8., 9., 10., 11., 12.],
+        ]);
+        let output = ap.process(input.as_multi_slice()).unwrap();
+        assert_eq!(
+            output.into_raw(),
+            [
+                [-1., -2., -3., -4., -5., -6.],
+                [-7., -8., -9., -10., -11., -12.]
+            ]
+        );
+
+        // A single block still goes through run.
+        let mut input: MultiBuffer<f32> = MultiBuffer::from(vec![vec![1., 2.], vec![3., 4.]]);
+        let output = ap.process(input.as_multi_slice()).unwrap();
+        assert_eq!(output.into_raw(), [[-1., -2.], [-3., -4.]]);
+
+        // Not a multiple of the block size.
+        let mut input: MultiBuffer<f32> =
+            MultiBuffer::from(vec![vec![1., 2., 3.], vec![4., 5., 6.]]);
+        assert_matches!(
+            ap.process(input.as_multi_slice()).unwrap_err(),
+            crate::Error::InvalidShape { .. }
+        );
+    }
+
+    #[test]
+    fn query() {
+        let ext = unsafe {
+            PluginProcessor::query(
+                binding::negate_batch_processor_create_query,
+                Format {
+                    channels: 2,
+                    block_size: 3,
+                    frame_rate: 48000,
+                },
+            )
+        }
+        .unwrap();
+        assert!(ext.realtime_safe);
+        assert!(ext.process_many.is_some());
+        assert_eq!(
+            ext.preferred_block_size,
+            3 * binding::NEGATE_BATCH_BLOCKS as usize
+        );
+    }
+
     #[test]
     fn get_output_format() {
         let ap = unsafe {
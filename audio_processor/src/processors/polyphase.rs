@@ -0,0 +1,451 @@
+// Copyright 2024 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+use anyhow::anyhow;
+use serde::Deserialize;
+use serde::Serialize;
+
+use crate::AudioProcessor;
+use crate::Error;
+use crate::Format;
+use crate::MultiBuffer;
+use crate::Shape;
+
+/// Number of independent accumulators of the filter loop. Filters are padded
+/// to a multiple of it so that the loop has no remainder.
+const LANES: usize = 8;
+
+/// Largest number of filter phases, bounding the size of the filter table.
+/// 44100 <-> 48000 needs 160 phases.
+const MAX_PHASES: usize = 4096;
+
+/// Trade-off between the quality of a [`PolyphaseResampler`] and its cost.
+#[derive(Debug, Default, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+pub enum ResampleQuality {
+    /// 16 taps per phase.
+    Low,
+    /// 32 taps per phase, comparable to the speex quality used by
+    /// [`crate::processors::SpeexResampler`].
+    #[default]
+    Medium,
+    /// 64 taps per phase.
+    High,
+}
+
+impl ResampleQuality {
+    /// Returns the number of taps when upsampling, the beta of the Kaiser
+    /// window and the cutoff frequency relative to the lower Nyquist
+    /// frequency.
+    fn params(self) -> (usize, f64, f64) {
+        match self {
+            ResampleQuality::Low => (16, 5., 0.85),
+            ResampleQuality::Medium => (32, 7., 0.91),
+            ResampleQuality::High => (64, 9., 0.95),
+        }
+    }
+}
+
+/// Resample float PCM frames with a windowed sinc polyphase filter.
+///
+/// Inputs of any size are accepted. The position between two input frames
+/// where the next output frame falls is kept across calls, so when the block
+/// size does not resample to an integral number of frames, the output size
+/// alternates around the exact value. `get_output_format().block_size` is
+/// then the largest size and a `WrapChunk` can be used to feed the next
+/// processors with fixed blocks.
+///
+/// The output is delayed by half of the filter length, in input frames.
+pub struct PolyphaseResampler {
+    /// Output frames are generated every `down / up` input frames.
+    up: usize,
+    down: usize,
+    taps: usize,
+    /// `up` filters of `taps` coefficients, one per fractional position,
+    /// stored in the order they apply to the input frames.
+    coefs: Vec<f32>,
+    /// Position of the next output frame relative to the first frame of the
+    /// next input, in 1 / `up` frames.
+    next: usize,
+    /// Per channel, the last `taps - 1` input frames, followed by the
+    /// current chunk of input while processing.
+    history: Vec<Vec<f32>>,
+    /// Largest number of input frames appended to `history` at once, so it
+    /// never grows beyond the capacity reserved in `new`.
+    chunk_frames: usize,
+    output_buffer: MultiBuffer<f32>,
+    /// Frames per channel of `output_buffer`, grown for large inputs.
+    output_capacity: usize,
+    output_format: Format,
+}
+
+fn gcd(a: usize, b: usize) -> usize {
+    if b == 0 {
+        a
+    } else {
+        gcd(b, a % b)
+    }
+}
+
+/// Modified Bessel function of the first kind, of order 0.
+fn bessel_i0(x: f64) -> f64 {
+    let mut sum = 1.;
+    let mut term = 1.;
+    let mut k = 1.;
+    while term > sum * 1e-12 {
+        term *= (x / (2. * k)).powi(2);
+        sum += term;
+        k += 1.;
+    }
+    sum
+}
+
+/// Returns the filter table of [`PolyphaseResampler::coefs`].
+fn design_filters(up: usize, down: usize, taps: usize, beta: f64, cutoff: f64) -> Vec<f32> {
+    // Cutoff relative to the input Nyquist frequency.
+    let fc = cutoff * (up as f64 / down as f64).min(1.);
+    let half = (taps / 2) as f64;
+    let window_norm = bessel_i0(beta);
+    let h = |t: f64| {
+        let x = t / half;
+        if x.abs() >= 1. {
+            return 0.;
+        }
+        let window = bessel_i0(beta * (1. - x * x).sqrt()) / window_norm;
+        let arg = std::f64::consts::PI * fc * t;
+        let sinc = if arg == 0. { 1. } else { arg.sin() / arg };
+        fc * sinc * window
+    };
+
+    let mut coefs = Vec::with_capacity(up * taps);
+    for phase in 0..up {
+        let frac = phase as f64 / up as f64;
+        // The m-th coefficient applies to the input frame `taps - 1 - m`
+        // frames before the newest one.
+        let filter: Vec<f64> = (0..taps)
+            .map(|m| h((taps - 1 - m) as f64 + frac - half))
+            .collect();
+        // Normalize the DC gain of every phase to 1.
+        let sum: f64 = filter.iter().sum();
+        coefs.extend(filter.iter().map(|c| (c / sum) as f32));
+    }
+    coefs
+}
+
+/// Dot product of two slices of the same length, a multiple of `LANES`.
+/// The independent accumulators let the compiler vectorize the loop.
+#[inline]
+fn dot(a: &[f32], b: &[f32]) -> f32 {
+    let mut acc = [0f32; LANES];
+    for (a, b) in a.chunks_exact(LANES).zip(b.chunks_exact(LANES)) {
+        for k in 0..LANES {
+            acc[k] += a[k] * b[k];
+        }
+    }
+    acc.iter().sum()
+}
+
+impl PolyphaseResampler {
+    /// Create a resampler for the given input format and output rate.
+    pub fn new(
+        input_format: Format,
+        output_rate: usize,
+        quality: ResampleQuality,
+    ) -> crate::Result<Self> {
+        if input_format.frame_rate == 0 || output_rate == 0 {
+            return Err(anyhow!(
+                "invalid frame rates {} -> {}",
+                input_format.frame_rate,
+                output_rate
+            )
+            .into());
+        }
+        let g = gcd(input_format.frame_rate, output_rate);
+        let up = output_rate / g;
+        let down = input_format.frame_rate / g;
+        if up > MAX_PHASES {
+            return Err(anyhow!(
+                "resampling {} -> {} needs {} filter phases, more than {}",
+                input_format.frame_rate,
+                output_rate,
+                up,
+                MAX_PHASES
+            )
+            .into());
+        }
+
+        let (base_taps, beta, cutoff) = quality.params();
+        // Widen the filter in proportion to the lower cutoff frequency when
+        // downsampling, to keep the same transition band.
+        let taps = (base_taps * down).div_ceil(up).max(base_taps);
+        let taps = taps.next_multiple_of(LANES);
+
+        let chunk_frames = input_format.block_size.max(1);
+        let output_format = Format {
+            channels: input_format.channels,
+            block_size: (input_format.block_size * up).div_ceil(down),
+            frame_rate: output_rate,
+        };
+        Ok(Self {
+            up,
+            down,
+            taps,
+            coefs: design_filters(up, down, taps, beta, cutoff),
+            next: 0,
+            history: (0..input_format.channels)
+                .map(|_| {
+                    let mut history = Vec::with_capacity(taps - 1 + chunk_frames);
+                    history.resize(taps - 1, 0.);
+                    history
+                })
+                .collect(),
+            chunk_frames,
+            output_buffer: MultiBuffer::new(output_format.into()),
+            output_capacity: output_format.block_size,
+            output_format,
+        })
+    }
+}
+
+impl AudioProcessor for PolyphaseResampler {
+    type I = f32;
+    type O = f32;
+
+    fn process<'a>(
+        &'a mut self,
+        input: crate::MultiSlice<'a, Self::I>,
+    ) -> crate::Result<crate::MultiSlice<'a, Self::O>> {
+        if input.channels() != self.history.len() {
+            return Err(Error::InvalidShape {
+                want_channels: self.history.len(),
+                want_frames: input.min_len(),
+                got_channels: input.channels(),
+                got_frames: input.min_len(),
+            });
+        }
+        let frames = input.min_len();
+        let end = frames * self.up;
+        let outputs = end.saturating_sub(self.next).div_ceil(self.down);
+        if outputs > self.output_capacity {
+            self.output_buffer = MultiBuffer::new(Shape {
+                channels: self.output_format.channels,
+                frames: outputs,
+            });
+            self.output_capacity = outputs;
+        }
+
+        let (step, step_frac) = (self.down / self.up, self.down % self.up);
+        let mut output = self.output_buffer.as_multi_slice().into_indexes(0..outputs);
+        for ((in_ch, history), out_ch) in input
+            .iter()
+            .zip(self.history.iter_mut())
+            .zip(output.iter_mut())
+        {
+            let mut next = self.next;
+            let mut out_ch = &mut out_ch[..];
+            for chunk in in_ch[..frames].chunks(self.chunk_frames) {
+                history.extend_from_slice(chunk);
+                let chunk_end = chunk.len() * self.up;
+                let chunk_outputs = chunk_end.saturating_sub(next).div_ceil(self.down);
+                let (out, rest) = out_ch.split_at_mut(chunk_outputs);
+                let (mut i, mut phase) = (next / self.up, next % self.up);
+                for y in out.iter_mut() {
+                    let filter = &self.coefs[phase * self.taps..(phase + 1) * self.taps];
+                    *y = dot(&history[i..i + self.taps], filter);
+                    i += step;
+                    phase += step_frac;
+                    if phase >= self.up {
+                        phase -= self.up;
+                        i += 1;
+                    }
+                }
+                history.drain(..chunk.len());
+                next = next + chunk_outputs * self.down - chunk_end;
+                out_ch = rest;
+            }
+        }
+        self.next = self.next + outputs * self.down - end;
+
+        Ok(output)
+    }
+
+    fn get_output_format(&self) -> Format {
+        self.output_format
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use std::f64::consts::PI;
+
+    use super::PolyphaseResampler;
+    use super::ResampleQuality;
+    use crate::AudioProcessor;
+    use crate::Format;
+    use crate::MultiBuffer;
+    use crate::Shape;
+
+    fn new_resampler(
+        channels: usize,
+        block_size: usize,
+        in_rate: usize,
+        out_rate: usize,
+        quality: ResampleQuality,
+    ) -> PolyphaseResampler {
+        PolyphaseResampler::new(
+            Format {
+                channels,
+                block_size,
+                frame_rate: in_rate,
+            },
+            out_rate,
+            quality,
+        )
+        .unwrap()
+    }
+
+    /// Resamples `input` in blocks of `block_sizes`, repeated.
+    fn resample(p: &mut PolyphaseResampler, input: &[f32], block_sizes: &[usize]) -> Vec<f32> {
+        let mut output = Vec::new();
+        let mut x = 0;
+        for &n in block_sizes.iter().cycle() {
+            if x == input.len() {
+                break;
+            }
+            let n = n.min(input.len() - x);
+            let mut block = MultiBuffer::from(vec![input[x..x + n].to_vec()]);
+            output.extend_from_slice(
+                p.process(block.as_multi_slice())
+                    .unwrap()
+                    .iter()
+                    .next()
+                    .unwrap(),
+            );
+            x += n;
+        }
+        output
+    }
+
+    fn sine(freq: f64, rate: usize, frames: usize, delay: f64) -> Vec<f32> {
+        (0..frames)
+            .map(|i| (2. * PI * freq * (i as f64 - delay) / rate as f64).sin() as f32)
+            .collect()
+    }
+
+    #[test]
+    fn synchronous_output() {
+        for (channels, in_frames, in_rate, out_rate) in [
+            (1, 441, 44100, 48000),
+            (2, 441, 44100, 48000),
+            (1, 480, 48000, 44100),
+            (1, 160, 16000, 48000),
+            (1, 480, 48000, 16000),
+            (1, 1, 16000, 48000),
+            (1, 3, 48000, 16000),
+            (1, 2, 16000, 24000),
+            (1, 3, 24000, 16000),
+        ] {
+            let mut p = new_resampler(channels, in_frames, in_rate, out_rate, Default::default());
+            let mut input = MultiBuffer::<f32>::new(Shape {
+                channels,
+                frames: in_frames,
+            });
+            for _ in 0..3 {
+                let output = p.process(input.as_multi_slice()).unwrap();
+                assert_eq!(output.channels(), channels);
+                assert_eq!(in_rate * output.min_len(), out_rate * in_frames);
+            }
+        }
+    }
+
+    #[test]
+    fn fractional_block_size() {
+        let mut p = new_resampler(1, 256, 48000, 16000, Default::default());
+        assert_eq!(p.get_output_format().block_size, 86);
+
+        let mut input = MultiBuffer::<f32>::new(Shape {
+            channels: 1,
+            frames: 256,
+        });
+        let sizes: Vec<usize> = (0..6)
+            .map(|_| p.process(input.as_multi_slice()).unwrap().min_len())
+            .collect();
+        assert_eq!(sizes, [86, 85, 85, 86, 85, 85]);
+    }
+
+    #[test]
+    fn block_sizes_do_not_matter() {
+        let input = sine(440., 44100, 4410, 0.);
+        let mut p = new_resampler(1, 441, 44100, 48000, Default::default());
+        let want = resample(&mut p, &input, &[441]);
+        assert_eq!(want.len(), 4800);
+
+        let mut p = new_resampler(1, 441, 44100, 48000, Default::default());
+        let capacity = p.history[0].capacity();
+        let got = resample(&mut p, &input, &[1, 7, 0, 300, 1000]);
+        assert_eq!(got, want);
+        // Blocks larger than the block size are processed in chunks.
+        assert_eq!(p.history[0].capacity(), capacity);
+    }
+
+    #[test]
+    fn dc() {
+        for quality in [
+            ResampleQuality::Low,
+            ResampleQuality::Medium,
+            ResampleQuality::High,
+        ] {
+            let mut p = new_resampler(1, 480, 48000, 44100, quality);
+            let output = resample(&mut p, &[1.; 4800], &[480]);
+            for y in &output[output.len() / 2..] {
+                assert!((y - 1.).abs() < 1e-5, "{quality:?}: {y}");
+            }
+        }
+    }
+
+    #[test]
+    fn sine_accuracy() {
+        for (in_rate, out_rate) in [(48000, 16000), (16000, 48000), (44100, 48000)] {
+            let mut p = new_resampler(1, in_rate / 100, in_rate, out_rate, Default::default());
+            let delay = (p.taps / 2) as f64 * out_rate as f64 / in_rate as f64;
+            let output = resample(&mut p, &sine(1000., in_rate, in_rate, 0.), &[in_rate / 100]);
+            let want = sine(1000., out_rate, output.len(), delay);
+            // Skip the filter warm up.
+            for (i, (y, w)) in output
+                .iter()
+                .zip(want.iter())
+                .enumerate()
+                .skip(out_rate / 100)
+            {
+                assert!(
+                    (y - w).abs() < 2e-3,
+                    "{in_rate} -> {out_rate}: #{i}: {y} != {w}"
+                );
+            }
+        }
+    }
+
+    #[test]
+    fn anti_aliasing() {
+        // 12 kHz is above the Nyquist frequency of 16 kHz.
+        let mut p = new_resampler(1, 480, 48000, 16000, Default::default());
+        let output = resample(&mut p, &sine(12000., 48000, 48000, 0.), &[480]);
+        let tail = &output[160..];
+        let rms = (tail.iter().map(|y| y * y).sum::<f32>() / tail.len() as f32).sqrt();
+        assert!(rms < 1e-3, "{rms}");
+    }
+
+    #[test]
+    fn too_many_phases() {
+        assert!(PolyphaseResampler::new(
+            Format {
+                channels: 1,
+                block_size: 480,
+                frame_rate: 48000,
+            },
+            47999,
+            Default::default(),
+        )
+        .is_err());
+    }
+}
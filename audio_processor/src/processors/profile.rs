@@ -3,7 +3,10 @@
 // found in the LICENSE file.
 
 use std::fmt::Display;
+use std::sync::atomic::AtomicU64;
+use std::sync::atomic::Ordering;
 use std::sync::mpsc::Sender;
+use std::sync::Arc;
 use std::time::Duration;
 use std::time::Instant;
 
@@ -15,6 +18,7 @@ pub struct Profile<T: AudioProcessor> {
     pub inner: T,
     pub stats: ProfileStats,
     sender: Option<Sender<ProfileStats>>,
+    live: Option<Arc<LiveStats>>,
 }
 
 #[derive(Clone)]
@@ -44,6 +48,14 @@ impl<T: AudioProcessor> AudioProcessor for Profile<T> {
         self.stats.measurements.cpu_time.add(cpu_time);
         self.stats.measurements.wall_time.add(wall_time);
         self.stats.frames_generated += output.min_len();
+        if let Some(live) = &self.live {
+            live.add(
+                cpu_time,
+                wall_time,
+                output.min_len(),
+                self.stats.output_format.frame_rate,
+            );
+        }
 
         Ok(output)
     }
@@ -65,6 +77,7 @@ impl<T: AudioProcessor> Profile<T> {
                 measurements: Measurements::default(),
             },
             sender: None,
+            live: None,
         }
     }
 
@@ -79,6 +92,13 @@ impl<T: AudioProcessor> Profile<T> {
         self.sender = Some(sender);
         self
     }
+
+    /// Configure `self` to also record each block in `live`, which can be
+    /// read while `self` is running.
+    pub fn set_live_stats(&mut self, live: Arc<LiveStats>) -> &mut Self {
+        self.live = Some(live);
+        self
+    }
 }
 
 impl<T: AudioProcessor> Drop for Profile<T> {
@@ -145,28 +165,202 @@ impl Display for Measurement {
     }
 }
 
-fn cpu_time() -> Duration {
-    let usage = nix::sys::resource::getrusage(nix::sys::resource::UsageWho::RUSAGE_SELF)
-        .expect("getrusage for SELF should never fail");
+/// Number of buckets of the [`LiveStats`] CPU time histogram. Blocks up to
+/// 4us have a bucket each, then every power of two is split in 4 buckets, up
+/// to 16s.
+pub const HISTOGRAM_BUCKETS: usize = 4 + 22 * 4;
+
+/// Returns the histogram bucket of a block which took `us` microseconds.
+fn bucket_index(us: u64) -> usize {
+    if us < 4 {
+        return us as usize;
+    }
+    let log2 = 63 - us.leading_zeros() as usize;
+    let sub = ((us >> (log2 - 2)) & 3) as usize;
+    (4 + (log2 - 2) * 4 + sub).min(HISTOGRAM_BUCKETS - 1)
+}
+
+/// Returns the exclusive upper bound of bucket `index`, in microseconds.
+fn bucket_limit(index: usize) -> u64 {
+    if index < 4 {
+        return index as u64 + 1;
+    }
+    let log2 = (index - 4) / 4 + 2;
+    let sub = ((index - 4) % 4) as u64;
+    (5 + sub) << (log2 - 2)
+}
 
-    duration_from_timeval(usage.user_time()).expect("cannot convert timeval to Duration")
+/// Per-block statistics of a profiled processor, readable while it runs.
+/// Updated with relaxed atomics so the processing thread never blocks.
+pub struct LiveStats {
+    key: String,
+    blocks: AtomicU64,
+    frames: AtomicU64,
+    cpu_sum_us: AtomicU64,
+    cpu_max_us: AtomicU64,
+    cpu_histogram: [AtomicU64; HISTOGRAM_BUCKETS],
+    wall_max_us: AtomicU64,
+    // Wall time over the duration of the audio in the block, in 1/1000.
+    deadline_ratio_max_permille: AtomicU64,
+    over_deadline: AtomicU64,
 }
 
-fn duration_from_timeval(
-    value: nix::sys::time::TimeVal,
-) -> Result<Duration, <i64 as TryFrom<u64>>::Error> {
-    Ok(Duration::from_secs(value.tv_sec().try_into()?)
-        + Duration::from_micros(value.tv_usec().try_into()?))
+/// A point in time copy of [`LiveStats`].
+#[derive(Clone, Debug, Default, PartialEq)]
+pub struct LiveStatsSnapshot {
+    pub key: String,
+    pub blocks: u64,
+    pub frames: u64,
+    pub cpu_avg_us: u64,
+    /// Percentiles are the upper bound of their histogram bucket.
+    pub cpu_p50_us: u64,
+    pub cpu_p99_us: u64,
+    pub cpu_max_us: u64,
+    pub wall_max_us: u64,
+    /// The largest ratio of the wall time to process a block over the
+    /// duration of the audio in it. Above 1 the stage cannot keep up.
+    pub deadline_ratio_max: f64,
+    /// Number of blocks with a deadline ratio above 1.
+    pub over_deadline: u64,
+}
+
+impl LiveStats {
+    pub fn new(key: String) -> Self {
+        Self {
+            key,
+            blocks: AtomicU64::new(0),
+            frames: AtomicU64::new(0),
+            cpu_sum_us: AtomicU64::new(0),
+            cpu_max_us: AtomicU64::new(0),
+            cpu_histogram: std::array::from_fn(|_| AtomicU64::new(0)),
+            wall_max_us: AtomicU64::new(0),
+            deadline_ratio_max_permille: AtomicU64::new(0),
+            over_deadline: AtomicU64::new(0),
+        }
+    }
+
+    pub fn key(&self) -> &str {
+        &self.key
+    }
+
+    /// Record a block of `frames` at `frame_rate` processed in `cpu` and
+    /// `wall` time.
+    fn add(&self, cpu: Duration, wall: Duration, frames: usize, frame_rate: usize) {
+        let cpu_us = cpu.as_micros() as u64;
+        let wall_us = wall.as_micros() as u64;
+        self.blocks.fetch_add(1, Ordering::Relaxed);
+        self.frames.fetch_add(frames as u64, Ordering::Relaxed);
+        self.cpu_sum_us.fetch_add(cpu_us, Ordering::Relaxed);
+        self.cpu_max_us.fetch_max(cpu_us, Ordering::Relaxed);
+        self.cpu_histogram[bucket_index(cpu_us)].fetch_add(1, Ordering::Relaxed);
+        self.wall_max_us.fetch_max(wall_us, Ordering::Relaxed);
+        if frames > 0 && frame_rate > 0 {
+            let permille = wall.as_nanos() * frame_rate as u128 / frames as u128 / 1_000_000;
+            self.deadline_ratio_max_permille
+                .fetch_max(permille as u64, Ordering::Relaxed);
+            if permille > 1000 {
+                self.over_deadline.fetch_add(1, Ordering::Relaxed);
+            }
+        }
+    }
+
+    /// Returns the smallest bucket limit below which at least `quantile`
+    /// of the `total` blocks in `histogram` are.
+    fn percentile(histogram: &[u64], total: u64, quantile: f64) -> u64 {
+        if total == 0 {
+            return 0;
+        }
+        let target = ((total as f64 * quantile).ceil() as u64).max(1);
+        let mut seen = 0;
+        for (i, count) in histogram.iter().enumerate() {
+            seen += count;
+            if seen >= target {
+                return bucket_limit(i);
+            }
+        }
+        bucket_limit(histogram.len() - 1)
+    }
+
+    pub fn snapshot(&self) -> LiveStatsSnapshot {
+        let histogram: Vec<u64> = self
+            .cpu_histogram
+            .iter()
+            .map(|b| b.load(Ordering::Relaxed))
+            .collect();
+        // Blocks recorded while taking the snapshot may be missing from
+        // some fields, which is fine for monitoring.
+        let total = histogram.iter().sum();
+        let blocks = self.blocks.load(Ordering::Relaxed);
+        LiveStatsSnapshot {
+            key: self.key.clone(),
+            blocks,
+            frames: self.frames.load(Ordering::Relaxed),
+            cpu_avg_us: self
+                .cpu_sum_us
+                .load(Ordering::Relaxed)
+                .checked_div(blocks)
+                .unwrap_or(0),
+            cpu_p50_us: Self::percentile(&histogram, total, 0.5),
+            cpu_p99_us: Self::percentile(&histogram, total, 0.99),
+            cpu_max_us: self.cpu_max_us.load(Ordering::Relaxed),
+            wall_max_us: self.wall_max_us.load(Ordering::Relaxed),
+            deadline_ratio_max: self.deadline_ratio_max_permille.load(Ordering::Relaxed) as f64
+                / 1000.,
+            over_deadline: self.over_deadline.load(Ordering::Relaxed),
+        }
+    }
+}
+
+impl Display for LiveStatsSnapshot {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        write!(
+            f,
+            "{}: blocks={} frames={} cpu_us avg={} p50<{} p99<{} max={} wall_max_us={} \
+             deadline_ratio_max={:.3} over_deadline={}",
+            self.key,
+            self.blocks,
+            self.frames,
+            self.cpu_avg_us,
+            self.cpu_p50_us,
+            self.cpu_p99_us,
+            self.cpu_max_us,
+            self.wall_max_us,
+            self.deadline_ratio_max,
+            self.over_deadline,
+        )
+    }
+}
+
+/// Returns the CPU time used by the calling thread. Unlike the time of the
+/// whole process, it is not affected by other threads, and is precise enough
+/// to time a single block.
+pub fn cpu_time() -> Duration {
+    let mut ts = libc::timespec {
+        tv_sec: 0,
+        tv_nsec: 0,
+    };
+    // SAFETY: `ts` is a valid timespec to write to.
+    let rc = unsafe { libc::clock_gettime(libc::CLOCK_THREAD_CPUTIME_ID, &mut ts) };
+    assert_eq!(
+        rc, 0,
+        "clock_gettime(CLOCK_THREAD_CPUTIME_ID) should never fail"
+    );
+    Duration::new(ts.tv_sec as u64, ts.tv_nsec as u32)
 }
 
 #[cfg(test)]
 mod tests {
     use std::sync::mpsc::channel;
+    use std::sync::Arc;
     use std::time::Duration;
     use std::time::Instant;
 
+    use super::bucket_index;
+    use super::bucket_limit;
+    use super::LiveStats;
     use super::Measurement;
     use super::Profile;
+    use super::HISTOGRAM_BUCKETS;
     use crate::processors::profile::cpu_time;
     use crate::processors::InPlaceNegateAudioProcessor;
     use crate::processors::SpeexResampler;
@@ -213,13 +407,77 @@ mod tests {
     }
 
     #[test]
-    fn duration_from_timeval() {
+    fn histogram_buckets() {
+        for us in [0, 1, 3, 4, 7, 8, 9, 10, 100, 1000, 12345, 1 << 23] {
+            let i = bucket_index(us);
+            assert!(us < bucket_limit(i), "{us} in bucket {i}");
+            assert!(i == 0 || us >= bucket_limit(i - 1), "{us} in bucket {i}");
+        }
+        assert_eq!(bucket_index(u64::MAX), HISTOGRAM_BUCKETS - 1);
+    }
+
+    #[test]
+    fn live_stats() {
+        let live = LiveStats::new(String::from("foo"));
+        assert_eq!(live.snapshot().cpu_p99_us, 0);
+
+        // 480 frames at 48kHz is a 10ms deadline.
+        for _ in 0..198 {
+            live.add(
+                Duration::from_micros(100),
+                Duration::from_micros(200),
+                480,
+                48000,
+            );
+        }
+        for _ in 0..2 {
+            live.add(
+                Duration::from_millis(9),
+                Duration::from_millis(15),
+                480,
+                48000,
+            );
+        }
+
+        let snapshot = live.snapshot();
+        assert_eq!(snapshot.key, "foo");
+        assert_eq!(snapshot.blocks, 200);
+        assert_eq!(snapshot.frames, 96000);
+        assert!((100..=112).contains(&snapshot.cpu_p50_us), "{snapshot:?}");
+        assert!((100..=112).contains(&snapshot.cpu_p99_us), "{snapshot:?}");
+        assert_eq!(snapshot.cpu_max_us, 9000);
+        assert_eq!(snapshot.wall_max_us, 15000);
+        assert_eq!(snapshot.deadline_ratio_max, 1.5);
+        assert_eq!(snapshot.over_deadline, 2);
         assert_eq!(
-            super::duration_from_timeval(nix::sys::time::TimeVal::new(1, 500_000)).unwrap(),
-            Duration::from_millis(1500)
+            snapshot.to_string(),
+            format!(
+                "foo: blocks=200 frames=96000 cpu_us avg=189 p50<{0} p99<{0} max=9000 \
+                 wall_max_us=15000 deadline_ratio_max=1.500 over_deadline=2",
+                snapshot.cpu_p50_us
+            )
         );
     }
 
+    #[test]
+    fn profile_live_stats() {
+        let live = Arc::new(LiveStats::new(String::from("negate")));
+        let mut p = Profile::new(InPlaceNegateAudioProcessor::<i32>::new(Format {
+            channels: 1,
+            block_size: 4,
+            frame_rate: 48000,
+        }));
+        p.set_live_stats(live.clone());
+
+        let mut buf = MultiBuffer::from(vec![vec![1i32, 2, 3, 4]]);
+        p.process(buf.as_multi_slice()).unwrap();
+        p.process(buf.as_multi_slice()).unwrap();
+
+        let snapshot = live.snapshot();
+        assert_eq!(snapshot.blocks, 2);
+        assert_eq!(snapshot.frames, 8);
+    }
+
     #[test]
     fn get_output_format() {
         let p = Profile::new(
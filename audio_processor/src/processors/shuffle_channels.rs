@@ -11,6 +11,9 @@ use crate::Shape;
 /// ChannelMap is a processor that shuffles channels.
 pub struct ShuffleChannels {
     channel_indexes: Vec<usize>,
+    // Whether output[i] is the first use of input[channel_indexes[i]]. Such
+    // channels are passed through without copying.
+    first_use: Vec<bool>,
     buffer: MultiBuffer<f32>,
     output_format: Format,
 }
@@ -25,8 +28,14 @@ impl ShuffleChannels {
                 "channel out of bounds! channel_indexes={channel_indexes:?}, input_format={input_format:?}",
             );
         }
+        let first_use = channel_indexes
+            .iter()
+            .enumerate()
+            .map(|(i, channel)| !channel_indexes[..i].contains(channel))
+            .collect();
         Self {
             channel_indexes: Vec::from(channel_indexes),
+            first_use,
             buffer: MultiBuffer::new(Shape {
                 channels: channel_indexes.len(),
                 frames: input_format.block_size,
@@ -47,15 +56,43 @@ impl AudioProcessor for ShuffleChannels {
         &'a mut self,
         input: MultiSlice<'a, Self::I>,
     ) -> crate::Result<MultiSlice<'a, Self::O>> {
-        for (data, &index) in self
+        let frames = input.min_len();
+        if frames > self.output_format.block_size {
+            return Err(crate::Error::InvalidShape {
+                want_channels: self.output_format.channels,
+                want_frames: self.output_format.block_size,
+                got_channels: input.channels(),
+                got_frames: frames,
+            });
+        }
+
+        // Copy repeated channels before the input slices are moved to the
+        // output.
+        let mut output = self
             .buffer
             .as_multi_slice()
+            .into_indexes(0..frames)
+            .into_raw();
+        let mut input = input.into_raw();
+        for ((data, &index), &first_use) in output
+            .iter_mut()
+            .zip(self.channel_indexes.iter())
+            .zip(self.first_use.iter())
+        {
+            if !first_use {
+                data.clone_from_slice(&input[index][..frames]);
+            }
+        }
+        for ((data, &index), &first_use) in output
             .iter_mut()
             .zip(self.channel_indexes.iter())
+            .zip(self.first_use.iter())
         {
-            data.clone_from_slice(&input[index]);
+            if first_use {
+                *data = &mut std::mem::take(&mut input[index])[..frames];
+            }
         }
-        Ok(self.buffer.as_multi_slice())
+        Ok(MultiSlice::from_raw(output))
     }
 
     fn get_output_format(&self) -> Format {
@@ -85,4 +122,25 @@ mod tests {
         let output = p.process(input.as_multi_slice()).unwrap();
         assert_eq!(output.into_raw(), [[3., 4.], [1., 2.], [3., 4.]]);
     }
+
+    #[test]
+    fn select_in_place() {
+        let mut p = ShuffleChannels::new(
+            &[1],
+            Format {
+                channels: 2,
+                block_size: 2,
+                frame_rate: 48000,
+            },
+        );
+
+        let mut input = MultiBuffer::from(vec![vec![1., 2.], vec![3., 4.]]);
+        let mut output = p.process(input.as_multi_slice()).unwrap();
+        for x in output.iter_mut().flat_map(|ch| ch.iter_mut()) {
+            *x *= 10.;
+        }
+        assert_eq!(output.into_raw(), [[30., 40.]]);
+        // The selected channel is not copied.
+        assert_eq!(input.to_vecs(), [[1., 2.], [30., 40.]]);
+    }
 }
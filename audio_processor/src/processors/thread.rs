@@ -2,41 +2,286 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
-use std::marker::PhantomData;
-use std::sync::mpsc::Receiver;
-use std::sync::mpsc::Sender;
+use std::cell::UnsafeCell;
+use std::sync::atomic::AtomicBool;
+use std::sync::atomic::AtomicU64;
+use std::sync::atomic::AtomicUsize;
+use std::sync::atomic::Ordering;
+use std::sync::Arc;
+use std::sync::Condvar;
+use std::sync::Mutex;
+use std::thread::Thread;
 
-use anyhow::Context;
+use anyhow::anyhow;
 
 use crate::util::set_thread_priority;
 use crate::AudioProcessor;
+use crate::Error;
 use crate::Format;
 use crate::MultiBuffer;
+use crate::MultiSlice;
 use crate::Result;
+use crate::Sample;
 use crate::Shape;
 
+/// Counters describing how well the processing thread keeps up.
+///
+/// # Members
+///    * `blocks` - Number of blocks submitted to the processing thread.
+///    * `queue_depth` - Number of blocks waiting or being processed when the
+///                      last block was submitted.
+///    * `max_queue_depth` - Largest `queue_depth` seen.
+///    * `deadline_misses` - Number of times a processed block was not ready
+///                          after `delay_blocks` blocks. The caller either
+///                          waited for it or passed the input through.
+///    * `passthrough_blocks` - Number of blocks returned unprocessed.
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct ThreadedProcessorStats {
+    pub blocks: u64,
+    pub queue_depth: usize,
+    pub max_queue_depth: usize,
+    pub deadline_misses: u64,
+    pub passthrough_blocks: u64,
+}
+
+/// A block in flight between the caller and the processing thread.
+struct Slot<I: Sample, O: Sample> {
+    input: MultiBuffer<I>,
+    input_frames: usize,
+    output: MultiBuffer<O>,
+    output_frames: usize,
+    error: Option<Error>,
+}
+
+impl<I: Sample, O: Sample> Slot<I, O> {
+    fn process<T: AudioProcessor<I = I, O = O>>(&mut self, inner: &mut T) {
+        let Slot {
+            input,
+            input_frames,
+            output,
+            output_frames,
+            error,
+        } = self;
+        *error = None;
+        let processed = match inner.process(input.as_multi_slice().into_indexes(0..*input_frames)) {
+            Ok(processed) => processed,
+            Err(err) => {
+                *error = Some(err);
+                return;
+            }
+        };
+
+        let mut output = output.as_multi_slice();
+        let frames = processed.min_len();
+        if processed.channels() != output.channels() || frames > output.min_len() {
+            *error = Some(Error::InvalidShape {
+                want_channels: output.channels(),
+                want_frames: output.min_len(),
+                got_channels: processed.channels(),
+                got_frames: frames,
+            });
+            return;
+        }
+        output.indexes(0..frames).clone_from_multi_slice(&processed);
+        *output_frames = frames;
+    }
+}
+
+/// State shared between the caller and the processing thread.
+///
+/// Slot `n % slots.len()` holds the `n`-th block. It belongs to the caller
+/// while `n >= submitted`, to the processing thread while
+/// `completed <= n < submitted` and to the caller again once
+/// `n < completed`, until the caller reuses it for block
+/// `n + slots.len()`.
+struct Shared<I: Sample, O: Sample> {
+    slots: Box<[UnsafeCell<Slot<I, O>>]>,
+    submitted: AtomicUsize,
+    completed: AtomicUsize,
+    // Set by the caller to stop the processing thread.
+    stop: AtomicBool,
+    // Set when the processing thread exits, including by panicking.
+    exited: AtomicBool,
+    // Only used to wait for `completed` to advance.
+    lock: Mutex<()>,
+    completed_cond: Condvar,
+    max_queue_depth: AtomicUsize,
+    deadline_misses: AtomicU64,
+}
+
+// SAFETY: Slots are only accessed by the side owning them, see `Shared`.
+unsafe impl<I: Sample, O: Sample> Sync for Shared<I, O> {}
+
+impl<I: Sample, O: Sample> Shared<I, O> {
+    fn notify_completed(&self) {
+        // Take the lock so that a waiter can't miss the notification
+        // between checking `completed` and waiting.
+        drop(self.lock.lock().unwrap());
+        self.completed_cond.notify_one();
+    }
+
+    fn is_completed(&self, n: usize) -> bool {
+        self.completed.load(Ordering::Acquire) > n
+    }
+
+    /// Blocks until block `n` is completed. Returns false if the processing
+    /// thread exited before.
+    fn wait_completed(&self, n: usize) -> bool {
+        if self.is_completed(n) {
+            return true;
+        }
+        self.deadline_misses.fetch_add(1, Ordering::Relaxed);
+        let mut guard = self.lock.lock().unwrap();
+        loop {
+            if self.completed.load(Ordering::Acquire) > n {
+                return true;
+            }
+            if self.exited.load(Ordering::Acquire) {
+                return false;
+            }
+            guard = self.completed_cond.wait(guard).unwrap();
+        }
+    }
+}
+
+/// Marks the processing thread as exited when dropped.
+struct ExitGuard<'a, I: Sample, O: Sample>(&'a Shared<I, O>);
+
+impl<I: Sample, O: Sample> Drop for ExitGuard<'_, I, O> {
+    fn drop(&mut self) {
+        self.0.exited.store(true, Ordering::Release);
+        self.0.notify_completed();
+    }
+}
+
+fn run<T: AudioProcessor>(mut inner: T, shared: &Shared<T::I, T::O>) {
+    let _guard = ExitGuard(shared);
+    let mut next = 0;
+
+    loop {
+        while shared.submitted.load(Ordering::Acquire) == next {
+            if shared.stop.load(Ordering::Acquire) {
+                return;
+            }
+            std::thread::park();
+        }
+
+        // SAFETY: `next < submitted` and `next >= completed`, the slot is
+        // owned by this thread.
+        let slot = unsafe { &mut *shared.slots[next % shared.slots.len()].get() };
+        slot.process(&mut inner);
+
+        next += 1;
+        shared.completed.store(next, Ordering::Release);
+        shared.notify_completed();
+    }
+}
+
+/// A block given to `process`, kept until its output is due.
+struct Pending<O: Sample> {
+    // The block of `Shared` holding it, None if it was not submitted.
+    submitted_as: Option<usize>,
+    // A copy of the input returned if the block is not processed in time.
+    // Empty without passthrough.
+    dry: MultiBuffer<O>,
+    dry_frames: usize,
+}
+
+/// Copies an input block to a `Pending` block to pass it through.
+type CopyDryFn<I, O> = fn(&MultiSlice<I>, &mut MultiSlice<O>);
+
+fn copy_dry<S: Sample>(src: &MultiSlice<S>, dst: &mut MultiSlice<S>) {
+    dst.clone_from_multi_slice(src);
+}
+
+/// Runs the wrapped processor on a dedicated thread, delaying the output by
+/// `delay_blocks` blocks.
+///
+/// Blocks are passed through a ring of `delay_blocks + 1` buffers allocated
+/// up front, so no memory is allocated per block. Input blocks may be shorter
+/// than `input_format.block_size` but not longer.
+///
+/// With passthrough, a block not processed when it is due is returned
+/// unprocessed instead of waiting for it, and no block is given to the
+/// processing thread until it caught up. The caller never blocks on the
+/// processing thread, which keeps the added latency fixed.
 pub struct ThreadedProcessor<T: AudioProcessor> {
-    phantom: PhantomData<T>,
+    shared: Arc<Shared<T::I, T::O>>,
+    thread: Thread,
     join_handle: Option<std::thread::JoinHandle<()>>,
-    intx: Option<Sender<MultiBuffer<T::I>>>,
-    outrx: Receiver<Result<MultiBuffer<T::O>>>,
-    outbuf: MultiBuffer<T::O>,
+    delay_blocks: usize,
+    input_format: Format,
+    // Number of blocks submitted to `shared`, only written by the caller.
+    submitted: usize,
+    // Number of blocks given to `process`.
+    blocks: usize,
+    // Block `n` given to `process` is `pending[n % pending.len()]`.
+    pending: Box<[Pending<T::O>]>,
+    copy_dry: Option<CopyDryFn<T::I, T::O>>,
+    // Set after a deadline miss with passthrough, until the processing
+    // thread completed all submitted blocks.
+    bypass: bool,
+    passthrough_blocks: u64,
+    // Returned while the delay is being filled.
+    silence: MultiBuffer<T::O>,
     output_format: Format,
 }
 
-impl<T: AudioProcessor + Send + 'static> ThreadedProcessor<T> {
-    pub fn new(mut inner: T, delay_blocks: usize) -> Self {
+impl<S: Sample, T: AudioProcessor<I = S, O = S> + Send + 'static> ThreadedProcessor<T> {
+    /// Like `new`, but blocks not processed in time are passed through.
+    /// Passthrough is not used if the input and output shapes differ.
+    pub fn new_with_passthrough(inner: T, input_format: Format, delay_blocks: usize) -> Self {
         let output_format = inner.get_output_format();
-        let (intx, inrx) = std::sync::mpsc::channel::<MultiBuffer<T::I>>();
-        let (outtx, outrx) = std::sync::mpsc::channel();
+        let copy_dry: Option<CopyDryFn<S, S>> = if output_format.channels == input_format.channels
+            && output_format.block_size == input_format.block_size
+        {
+            Some(copy_dry::<S>)
+        } else {
+            log::warn!(
+                "ThreadedProcessor: no passthrough from {input_format:?} to {output_format:?}"
+            );
+            None
+        };
+        Self::new_inner(inner, input_format, delay_blocks, copy_dry)
+    }
+}
 
-        // Populate delay_blocks.
-        for _ in 0..delay_blocks {
-            outtx
-                .send(Ok(MultiBuffer::new(output_format.into())))
-                .unwrap();
-        }
+impl<T: AudioProcessor + Send + 'static> ThreadedProcessor<T> {
+    pub fn new(inner: T, input_format: Format, delay_blocks: usize) -> Self {
+        Self::new_inner(inner, input_format, delay_blocks, None)
+    }
 
+    fn new_inner(
+        inner: T,
+        input_format: Format,
+        delay_blocks: usize,
+        copy_dry: Option<CopyDryFn<T::I, T::O>>,
+    ) -> Self {
+        let output_format = inner.get_output_format();
+        let slots = (0..delay_blocks + 1)
+            .map(|_| {
+                UnsafeCell::new(Slot {
+                    input: MultiBuffer::new(input_format.into()),
+                    input_frames: 0,
+                    output: MultiBuffer::new(output_format.into()),
+                    output_frames: 0,
+                    error: None,
+                })
+            })
+            .collect();
+        let shared = Arc::new(Shared {
+            slots,
+            submitted: AtomicUsize::new(0),
+            completed: AtomicUsize::new(0),
+            stop: AtomicBool::new(false),
+            exited: AtomicBool::new(false),
+            lock: Mutex::new(()),
+            completed_cond: Condvar::new(),
+            max_queue_depth: AtomicUsize::new(0),
+            deadline_misses: AtomicU64::new(0),
+        });
+
+        let thread_shared = shared.clone();
         let builder = std::thread::Builder::new().name("ThreadedProcessor".into());
         let join_handle = builder
             .spawn(move || {
@@ -45,34 +290,116 @@ impl<T: AudioProcessor + Send + 'static> ThreadedProcessor<T> {
                     log::error!("set_thread_priority: {err:#}");
                 }
 
-                for mut buf in inrx.iter() {
-                    match inner.process(buf.as_multi_slice()) {
-                        Err(err) => outtx.send(Err(err)).unwrap(),
-                        Ok(slice) => outtx.send(Ok(MultiBuffer::from(slice))).unwrap(),
-                    }
-                }
+                run(inner, &thread_shared);
             })
             .expect("cannot spawn ThreadedProcessor thread");
-        ThreadedProcessor {
-            phantom: PhantomData,
-            join_handle: Some(join_handle),
-            intx: Some(intx),
-            outrx,
-            outbuf: MultiBuffer::new(Shape {
+        let dry_shape = match copy_dry {
+            Some(_) => output_format.into(),
+            None => Shape {
                 channels: 0,
                 frames: 0,
-            }),
+            },
+        };
+        let pending = (0..delay_blocks + 1)
+            .map(|_| Pending {
+                submitted_as: None,
+                dry: MultiBuffer::new(dry_shape),
+                dry_frames: 0,
+            })
+            .collect();
+        ThreadedProcessor {
+            shared,
+            thread: join_handle.thread().clone(),
+            join_handle: Some(join_handle),
+            delay_blocks,
+            input_format,
+            submitted: 0,
+            blocks: 0,
+            pending,
+            copy_dry,
+            bypass: false,
+            passthrough_blocks: 0,
+            silence: MultiBuffer::new(output_format.into()),
             output_format,
         }
     }
 }
 
+impl<T: AudioProcessor> ThreadedProcessor<T> {
+    pub fn stats(&self) -> ThreadedProcessorStats {
+        let completed = self.shared.completed.load(Ordering::Acquire);
+        ThreadedProcessorStats {
+            blocks: self.blocks as u64,
+            queue_depth: self.submitted.saturating_sub(completed),
+            max_queue_depth: self.shared.max_queue_depth.load(Ordering::Relaxed),
+            deadline_misses: self.shared.deadline_misses.load(Ordering::Relaxed),
+            passthrough_blocks: self.passthrough_blocks,
+        }
+    }
+
+    fn check_input(&self, input: &MultiSlice<T::I>) -> Result<()> {
+        let frames = input.min_len();
+        if input.channels() != self.input_format.channels || frames > self.input_format.block_size {
+            return Err(Error::InvalidShape {
+                want_channels: self.input_format.channels,
+                want_frames: self.input_format.block_size,
+                got_channels: input.channels(),
+                got_frames: frames,
+            });
+        }
+        Ok(())
+    }
+
+    /// Returns whether the next block can be submitted without waiting for
+    /// the processing thread.
+    fn can_submit(&mut self) -> bool {
+        if self.copy_dry.is_none() {
+            // The previous call to `process` waited for the slot to be free.
+            return true;
+        }
+        let completed = self.shared.completed.load(Ordering::Acquire);
+        if self.bypass {
+            if completed < self.submitted {
+                return false;
+            }
+            self.bypass = false;
+        }
+        completed + self.shared.slots.len() > self.submitted
+    }
+
+    /// Copies `input` into the next free slot and hands it to the processing
+    /// thread. Returns the number of the submitted block.
+    fn submit(&mut self, input: &MultiSlice<T::I>) -> usize {
+        let n = self.submitted;
+        // SAFETY: `n >= submitted` so the slot is owned by the caller. Its
+        // previous block, `n - slots.len()`, was completed as checked by
+        // `can_submit`.
+        let slot = unsafe { &mut *self.shared.slots[n % self.shared.slots.len()].get() };
+        let frames = input.min_len();
+        slot.input
+            .as_multi_slice()
+            .indexes(0..frames)
+            .clone_from_multi_slice(input);
+        slot.input_frames = frames;
+
+        let queue_depth = n - self.shared.completed.load(Ordering::Acquire);
+        self.shared
+            .max_queue_depth
+            .fetch_max(queue_depth + 1, Ordering::Relaxed);
+        self.submitted = n + 1;
+        self.shared.submitted.store(n + 1, Ordering::Release);
+        self.thread.unpark();
+        n
+    }
+}
+
 impl<T: AudioProcessor> Drop for ThreadedProcessor<T> {
     fn drop(&mut self) {
-        // Close the sender by dropping.
-        self.intx = None;
+        self.shared.stop.store(true, Ordering::Release);
+        self.thread.unpark();
 
         _ = self.join_handle.take().unwrap().join();
+        log::info!("ThreadedProcessor dropped: {:?}", self.stats());
     }
 }
 
@@ -82,20 +409,65 @@ impl<T: AudioProcessor> AudioProcessor for ThreadedProcessor<T> {
 
     fn process<'a>(
         &'a mut self,
-        input: crate::MultiSlice<'a, Self::I>,
-    ) -> crate::Result<crate::MultiSlice<'a, Self::O>> {
-        self.intx
-            .as_ref()
-            .expect("intx")
-            .send(MultiBuffer::from(input))
-            .expect("intx.send");
-        match self.outrx.recv().context("outrx.recv")? {
-            Ok(buf) => {
-                self.outbuf = buf;
-                Ok(self.outbuf.as_multi_slice())
+        input: MultiSlice<'a, Self::I>,
+    ) -> Result<MultiSlice<'a, Self::O>> {
+        self.check_input(&input)?;
+        let b = self.blocks;
+        self.blocks += 1;
+
+        let submitted_as = if self.can_submit() {
+            Some(self.submit(&input))
+        } else {
+            None
+        };
+        let pending_len = self.pending.len();
+        let pending = &mut self.pending[b % pending_len];
+        pending.submitted_as = submitted_as;
+        if let Some(copy_dry) = self.copy_dry {
+            let frames = input.min_len();
+            copy_dry(&input, &mut pending.dry.as_multi_slice().indexes(0..frames));
+            pending.dry_frames = frames;
+        }
+
+        // Output blocks are delayed by `delay_blocks`.
+        let Some(due) = b.checked_sub(self.delay_blocks) else {
+            // The caller may have modified the previous silence in place.
+            for ch in self.silence.as_multi_slice().iter_mut() {
+                ch.fill(T::O::default());
             }
-            Err(err) => Err(err),
+            return Ok(self.silence.as_multi_slice());
+        };
+
+        let pending = &mut self.pending[due % pending_len];
+        let n = match pending.submitted_as {
+            Some(n) if self.copy_dry.is_none() => {
+                if !self.shared.wait_completed(n) {
+                    return Err(anyhow!("ThreadedProcessor thread exited").into());
+                }
+                n
+            }
+            Some(n) if self.shared.is_completed(n) => n,
+            submitted_as => {
+                if submitted_as.is_some() {
+                    self.shared.deadline_misses.fetch_add(1, Ordering::Relaxed);
+                    self.bypass = true;
+                }
+                self.passthrough_blocks += 1;
+                return Ok(pending
+                    .dry
+                    .as_multi_slice()
+                    .into_indexes(0..pending.dry_frames));
+            }
+        };
+        // SAFETY: `n < completed` so the slot is owned by the caller.
+        let slot = unsafe { &mut *self.shared.slots[n % self.shared.slots.len()].get() };
+        if let Some(err) = slot.error.take() {
+            return Err(err);
         }
+        Ok(slot
+            .output
+            .as_multi_slice()
+            .into_indexes(0..slot.output_frames))
     }
 
     fn get_output_format(&self) -> Format {
@@ -105,11 +477,21 @@ impl<T: AudioProcessor> AudioProcessor for ThreadedProcessor<T> {
 
 #[cfg(test)]
 mod tests {
+    use std::time::Duration;
+
+    use crate::processors::InPlaceNegateAudioProcessor;
     use crate::processors::NegateAudioProcessor;
     use crate::processors::ThreadedProcessor;
     use crate::AudioProcessor;
     use crate::Format;
     use crate::MultiBuffer;
+    use crate::MultiSlice;
+
+    const FORMAT: Format = Format {
+        channels: 2,
+        block_size: 4,
+        frame_rate: 48000,
+    };
 
     #[test]
     fn process() {
@@ -117,14 +499,7 @@ mod tests {
             MultiBuffer::from(vec![vec![1., 2., 3., 4.], vec![5., 6., 7., 8.]]);
         let mut input2: MultiBuffer<f32> =
             MultiBuffer::from(vec![vec![11., 22., 33., 44.], vec![55., 66., 77., 88.]]);
-        let mut ap = ThreadedProcessor::new(
-            NegateAudioProcessor::new(Format {
-                channels: 2,
-                block_size: 4,
-                frame_rate: 48000,
-            }),
-            1,
-        );
+        let mut ap = ThreadedProcessor::new(NegateAudioProcessor::new(FORMAT), FORMAT, 1);
 
         let output1 = ap.process(input1.as_multi_slice()).unwrap();
 
@@ -138,4 +513,146 @@ mod tests {
             [[-1., -2., -3., -4.], [-5., -6., -7., -8.]]
         );
     }
+
+    #[test]
+    fn process_delay_blocks() {
+        let mut ap = ThreadedProcessor::new(NegateAudioProcessor::new(FORMAT), FORMAT, 3);
+        for i in 0..20 {
+            let mut input = MultiBuffer::from(vec![vec![i as f32; 4]; 2]);
+            let output = ap.process(input.as_multi_slice()).unwrap().into_raw();
+            let want = if i < 3 { 0. } else { -(i as f32 - 3.) };
+            assert_eq!(output, [[want; 4]; 2], "block {i}");
+        }
+        let stats = ap.stats();
+        assert_eq!(stats.blocks, 20);
+        assert!(stats.max_queue_depth <= 4, "{stats:?}");
+    }
+
+    #[test]
+    fn process_short_blocks() {
+        let mut ap = ThreadedProcessor::new(InPlaceNegateAudioProcessor::new(FORMAT), FORMAT, 1);
+        let mut input = MultiBuffer::from(vec![vec![1., 2.], vec![3., 4.]]);
+        ap.process(input.as_multi_slice()).unwrap();
+        let mut input = MultiBuffer::from(vec![vec![5.], vec![6.]]);
+        let output = ap.process(input.as_multi_slice()).unwrap();
+        assert_eq!(output.into_raw(), [[-1., -2.], [-3., -4.]]);
+    }
+
+    #[test]
+    fn process_block_too_large() {
+        let mut ap = ThreadedProcessor::new(NegateAudioProcessor::new(FORMAT), FORMAT, 1);
+        let mut input = MultiBuffer::from(vec![vec![0.; 5], vec![0.; 5]]);
+        let err = ap.process(input.as_multi_slice()).unwrap_err();
+        assert!(err.to_string().contains("want 2x4; got 2x5"), "{err}");
+    }
+
+    struct SlowProcessor(Duration);
+
+    impl AudioProcessor for SlowProcessor {
+        type I = f32;
+        type O = f32;
+
+        fn process<'a>(
+            &'a mut self,
+            input: MultiSlice<'a, f32>,
+        ) -> crate::Result<MultiSlice<'a, f32>> {
+            std::thread::sleep(self.0);
+            Ok(input)
+        }
+
+        fn get_output_format(&self) -> Format {
+            FORMAT
+        }
+    }
+
+    #[test]
+    fn deadline_misses() {
+        let mut ap = ThreadedProcessor::new(SlowProcessor(Duration::from_millis(5)), FORMAT, 1);
+        for _ in 0..4 {
+            let mut input = MultiBuffer::from(vec![vec![1.; 4]; 2]);
+            ap.process(input.as_multi_slice()).unwrap();
+        }
+        let stats = ap.stats();
+        assert_eq!(stats.blocks, 4);
+        // All but the first block had to be waited for.
+        assert_eq!(stats.deadline_misses, 3, "{stats:?}");
+        assert_eq!(stats.max_queue_depth, 2, "{stats:?}");
+    }
+
+    /// Negates the input in place after sleeping.
+    struct SlowNegateProcessor(Duration);
+
+    impl AudioProcessor for SlowNegateProcessor {
+        type I = f32;
+        type O = f32;
+
+        fn process<'a>(
+            &'a mut self,
+            mut input: MultiSlice<'a, f32>,
+        ) -> crate::Result<MultiSlice<'a, f32>> {
+            std::thread::sleep(self.0);
+            for ch in input.iter_mut() {
+                for x in ch.iter_mut() {
+                    *x = -*x;
+                }
+            }
+            Ok(input)
+        }
+
+        fn get_output_format(&self) -> Format {
+            FORMAT
+        }
+    }
+
+    #[test]
+    fn passthrough_on_deadline_miss() {
+        let mut ap = ThreadedProcessor::new_with_passthrough(
+            SlowNegateProcessor(Duration::from_millis(50)),
+            FORMAT,
+            1,
+        );
+        let process = |ap: &mut ThreadedProcessor<_>, value: f32| {
+            let mut input = MultiBuffer::from(vec![vec![value; 4]; 2]);
+            ap.process(input.as_multi_slice()).unwrap().into_raw()[0][0]
+        };
+
+        assert_eq!(process(&mut ap, 1.), 0.);
+        // Block 1 is not processed yet and is passed through.
+        assert_eq!(process(&mut ap, 2.), 1.);
+        std::thread::sleep(Duration::from_millis(150));
+        // Block 2 was processed, while falling behind.
+        assert_eq!(process(&mut ap, 3.), -2.);
+        assert_eq!(process(&mut ap, 4.), 3.);
+
+        let stats = ap.stats();
+        assert_eq!(stats.blocks, 4);
+        assert_eq!(stats.deadline_misses, 2, "{stats:?}");
+        assert_eq!(stats.passthrough_blocks, 2, "{stats:?}");
+    }
+
+    struct FailingProcessor;
+
+    impl AudioProcessor for FailingProcessor {
+        type I = f32;
+        type O = f32;
+
+        fn process<'a>(
+            &'a mut self,
+            _input: MultiSlice<'a, f32>,
+        ) -> crate::Result<MultiSlice<'a, f32>> {
+            Err(anyhow::anyhow!("failed").into())
+        }
+
+        fn get_output_format(&self) -> Format {
+            FORMAT
+        }
+    }
+
+    #[test]
+    fn process_error() {
+        let mut ap = ThreadedProcessor::new(FailingProcessor, FORMAT, 0);
+        let mut input = MultiBuffer::from(vec![vec![1.; 4]; 2]);
+        let err = ap.process(input.as_multi_slice()).unwrap_err();
+        assert_eq!(err.to_string(), "unrecoverable error: failed");
+    }
 }
@@ -45,10 +45,10 @@ class BM_Alsa : public benchmark::Fixture {
     struct cras_client* client;
     struct cras_iodev_info* target_dev = NULL;
     struct cras_ionode_info* target_node = NULL;
-    struct cras_iodev_info devs[CRAS_MAX_IODEVS];
-    struct cras_ionode_info nodes[CRAS_MAX_IONODES];
-    size_t num_devs = CRAS_MAX_IODEVS;
-    size_t num_nodes = CRAS_MAX_IONODES;
+    struct cras_iodev_info devs[CRAS_MAX_IODEVS_TOTAL];
+    struct cras_ionode_info nodes[CRAS_MAX_IONODES_TOTAL];
+    size_t num_devs = CRAS_MAX_IODEVS_TOTAL;
+    size_t num_nodes = CRAS_MAX_IONODES_TOTAL;
     std::string card_name = "";
     std::string card_idx = "";
     std::string target_dev_name = "";
@@ -24,6 +24,9 @@ class BM_Am : public benchmark::Fixture {
     samples = gen_float_samples(frames, engine);
     output_buf = std::vector<float>(frames, 0);
 
+    num_threads = state.range(1);
+    use_xnnpack = state.range(2) != 0;
+
     int microseconds = state.range(0);
     sleep_duration = std::chrono::duration<double, std::micro>{
         static_cast<double>(microseconds)};
@@ -33,6 +36,10 @@ class BM_Am : public benchmark::Fixture {
 
   // Number of |frames|.
   size_t frames;
+  // Number of threads the interpreter may use.
+  size_t num_threads;
+  // Whether to apply the XNNPACK delegate.
+  bool use_xnnpack;
   // Sleep time in microseconds.
   std::chrono::duration<double, std::micro> sleep_duration;
   // |frames| of samples.
@@ -44,7 +51,8 @@ class BM_Am : public benchmark::Fixture {
 BENCHMARK_DEFINE_F(BM_Am, SR)(benchmark::State& state) {
   const char model_path[] =
       "/run/imageloader/sr-bt-dlc/package/root/btnb.tflite";
-  struct am_context* ctx = am_new(model_path);
+  struct am_context* ctx =
+      am_new_with_options(model_path, num_threads, use_xnnpack);
   if (ctx == nullptr) {
     state.SkipWithError("Model does not exist!");
     return;
@@ -72,11 +80,14 @@ BENCHMARK_DEFINE_F(BM_Am, SR)(benchmark::State& state) {
   am_free(ctx);
 }
 
+// Arguments are the sleep between runs in microseconds, the number of
+// interpreter threads and whether XNNPACK is used. The model runs on blocks
+// of 480 frames, which is 20ms of audio at its 24kHz output rate, so a
+// 20000us sleep matches the period of the audio thread; shorter and longer
+// sleeps show how cache state between runs affects the inference time.
 BENCHMARK_REGISTER_F(BM_Am, SR)
-    ->Arg(5000)
-    ->Arg(10000)
-    ->Arg(20000)
-    ->Arg(40000)
+    ->ArgsProduct({{5000, 10000, 20000, 40000}, {1, 2}, {0, 1}})
+    ->ArgNames({"sleep_us", "threads", "xnnpack"})
     ->UseManualTime();
 
 }  // namespace
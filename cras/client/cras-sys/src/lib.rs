@@ -409,6 +409,9 @@ impl Default for audio_dev_debug_info {
             internal_gain_scaler: 0.0,
             dev_idx: 0,
             channel_layout: [0; 11],
+            tstamp_wake_margin_frames: 0,
+            max_wake_prediction_error: 0,
+            lowest_wake_hw_level: u32::MAX,
         }
     }
 }
@@ -441,6 +444,9 @@ pub struct AudioDevDebugInfo {
     pub longest_wake: Duration,
     pub internal_gain_scaler: f64,
     pub channel_layout: Vec<CRAS_CHANNEL>,
+    pub tstamp_wake_margin_frames: u32,
+    pub max_wake_prediction_error: u32,
+    pub lowest_wake_hw_level: Option<u32>,
 }
 
 impl TryFrom<audio_dev_debug_info> for AudioDevDebugInfo {
@@ -473,6 +479,10 @@ impl TryFrom<audio_dev_debug_info> for AudioDevDebugInfo {
             longest_wake: Duration::new(info.longest_wake_sec.into(), info.longest_wake_nsec),
             internal_gain_scaler: info.internal_gain_scaler,
             channel_layout,
+            tstamp_wake_margin_frames: info.tstamp_wake_margin_frames,
+            max_wake_prediction_error: info.max_wake_prediction_error,
+            lowest_wake_hw_level: (info.lowest_wake_hw_level != u32::MAX)
+                .then_some(info.lowest_wake_hw_level),
         })
     }
 }
@@ -509,6 +519,19 @@ impl fmt::Display for AudioDevDebugInfo {
             write!(f, " {:?}", channel)?;
         }
         writeln!(f)?;
+        writeln!(
+            f,
+            "  Timestamp wake margin: {}",
+            self.tstamp_wake_margin_frames
+        )?;
+        writeln!(
+            f,
+            "  Max wake prediction error: {}",
+            self.max_wake_prediction_error
+        )?;
+        if let Some(level) = self.lowest_wake_hw_level {
+            writeln!(f, "  Lowest hardware level at wake: {}", level)?;
+        }
         Ok(())
     }
 }
@@ -29,6 +29,7 @@ pub enum DBusControlOp {
     GetDefaultOutputBufferSize,
     Introspect,
     GetOutputVolume,
+    DumpProcessorStats,
     SetOutputVolume(i32),
     /// (num_channels, coefficients)
     SetGlobalOutputChannelRemix(u32, Vec<f64>),
@@ -73,6 +74,9 @@ impl DBusControlOp {
             Self::GetOutputVolume => {
                 println!("{}", proxy.get_volume_state().map_err(Error::DBusCall)?.0);
             }
+            Self::DumpProcessorStats => {
+                print!("{}", proxy.dump_processor_stats().map_err(Error::DBusCall)?);
+            }
             Self::SetOutputVolume(volume) => {
                 proxy.set_output_volume(volume).map_err(Error::DBusCall)?;
             }
@@ -32,6 +32,10 @@ pub enum GetCommand {
     /// Get DBus introspect xml for interface org.chromium.cras.Control
     #[command(name = "control_introspect")]
     ControlIntrospect,
+
+    /// Get per-stage CPU usage of the running CRAS processors
+    #[command(name = "processor_stats")]
+    ProcessorStats,
 }
 
 impl GetCommand {
@@ -42,6 +46,7 @@ impl GetCommand {
             OutputVolume => DBusControlOp::GetOutputVolume,
             DefaultOutputBufferSize => DBusControlOp::GetDefaultOutputBufferSize,
             ControlIntrospect => DBusControlOp::Introspect,
+            ProcessorStats => DBusControlOp::DumpProcessorStats,
         }
     }
 
@@ -98,5 +103,11 @@ mod tests {
                 .into_dbus_control(),
             DBusControlOp::GetOutputVolume
         );
+        assert_eq!(
+            get_command(&["cras_tests", "get", "processor_stats"])
+                .unwrap()
+                .into_dbus_control(),
+            DBusControlOp::DumpProcessorStats
+        );
     }
 }
@@ -74,6 +74,7 @@ static int play_short_sound_periods_left = 0;
 static unsigned int effects = 0;
 
 static char* aecdump_file = NULL;
+static char* atlog_trace_file = NULL;
 static char time_str[128];
 
 static enum CRAS_CLIENT_TYPE client_type = CRAS_CLIENT_TYPE_TEST;
@@ -1144,7 +1145,9 @@ static void print_aligned_audio_debug_info(const struct audio_debug_info* info,
         "highest_hw_level: %u\n"
         "runtime: %u.%09u\n"
         "longest_wake: %u.%09u\n"
-        "software_gain_scaler: %lf\n",
+        "software_gain_scaler: %lf\n"
+        "tstamp_wake_margin_frames: %u\n"
+        "max_wake_prediction_error: %u\n",
         (unsigned int)info->devs[i].dev_idx,
         (unsigned int)info->devs[i].buffer_size,
         (unsigned int)info->devs[i].min_buffer_level,
@@ -1162,7 +1165,13 @@ static void print_aligned_audio_debug_info(const struct audio_debug_info* info,
         (unsigned int)info->devs[i].runtime_nsec,
         (unsigned int)info->devs[i].longest_wake_sec,
         (unsigned int)info->devs[i].longest_wake_nsec,
-        info->devs[i].internal_gain_scaler);
+        info->devs[i].internal_gain_scaler,
+        (unsigned int)info->devs[i].tstamp_wake_margin_frames,
+        (unsigned int)info->devs[i].max_wake_prediction_error);
+    if (info->devs[i].lowest_wake_hw_level != UINT32_MAX) {
+      printf("lowest_wake_hw_level: %u\n",
+             (unsigned int)info->devs[i].lowest_wake_hw_level);
+    }
     printf("channel map:");
     for (j = 0; j < CRAS_CH_MAX; j++) {
       printf("%d ", info->devs[i].channel_layout[j]);
@@ -1790,6 +1799,24 @@ static void run_aecdump(struct cras_client* client,
   }
 }
 
+static void run_atlog_trace(struct cras_client* client, int start) {
+  int fd;
+  if (start) {
+    fd = open(atlog_trace_file, O_CREAT | O_RDWR | O_TRUNC, 0666);
+    if (fd == -1) {
+      printf("Fail to open file %s", atlog_trace_file);
+      return;
+    }
+
+    printf("Tracing audio thread to %s, fd %d\n", atlog_trace_file, fd);
+    cras_client_set_atlog_trace(client, 1, fd);
+    close(fd);
+  } else {
+    cras_client_set_atlog_trace(client, 0, -1);
+    printf("Close audio thread trace file %s\n", atlog_trace_file);
+  }
+}
+
 static unsigned int read_dev_idx(int tty) {
   char buf[16];
   int pos = 0;
@@ -2224,6 +2251,78 @@ static void show_atlog(time_t sec_offset,
   }
 }
 
+/*
+ * Prints a trace file written by --atlog_trace in the same format as
+ * --dump_audio_thread.
+ */
+static int decode_atlog_trace(const char* path) {
+  struct audio_thread_trace_header header;
+  struct audio_thread_trace_record rec;
+  struct audio_thread_event_log* log;
+  uint64_t offset_ns;
+  time_t sec_offset;
+  int32_t nsec_offset;
+  FILE* f;
+  int rc = 0;
+
+  f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "Fail to open file %s\n", path);
+    return -errno;
+  }
+  if (fread(&header, sizeof(header), 1, f) != 1 ||
+      header.magic != AUDIO_THREAD_TRACE_MAGIC ||
+      header.version != AUDIO_THREAD_TRACE_VERSION) {
+    fprintf(stderr, "%s is not an audio thread trace\n", path);
+    fclose(f);
+    return -EINVAL;
+  }
+
+  offset_ns = header.realtime_ns - header.monotonic_raw_ns;
+  sec_offset = offset_ns / 1000000000ULL;
+  nsec_offset = offset_ns % 1000000000ULL;
+  printf("Audio Thread Trace:\n");
+  printf("boottime - monotonic_raw offset: %" PRId64 " ns\n",
+         (int64_t)(header.boottime_ns - header.monotonic_raw_ns));
+
+  log = (struct audio_thread_event_log*)calloc(1, sizeof(*log));
+  if (!log) {
+    fclose(f);
+    return -ENOMEM;
+  }
+
+  while (fread(&rec, sizeof(rec), 1, f) == 1) {
+    if (rec.type == AUDIO_THREAD_TRACE_OVERFLOW) {
+      printf("%u events dropped on thread %u\n", rec.count, rec.tid);
+      continue;
+    }
+    if (rec.type != AUDIO_THREAD_TRACE_EVENTS) {
+      fprintf(stderr, "Unknown record type %u\n", rec.type);
+      rc = -EINVAL;
+      break;
+    }
+    printf("Thread %u:\n", rec.tid);
+    while (rec.count) {
+      unsigned int i, n = MIN(rec.count, AUDIO_THREAD_EVENT_LOG_SIZE);
+
+      if (fread(log->log, sizeof(log->log[0]), n, f) != n) {
+        fprintf(stderr, "Truncated trace file %s\n", path);
+        rc = -EINVAL;
+        goto done;
+      }
+      for (i = 0; i < n; i++) {
+        show_alog_tag(log, i, sec_offset, nsec_offset);
+      }
+      rec.count -= n;
+    }
+  }
+
+done:
+  free(log);
+  fclose(f);
+  return rc;
+}
+
 static void unlock_main_thread(struct cras_client* client) {
   signal_done();
 }
@@ -2375,6 +2474,8 @@ static struct option long_options[] = {
 	{"thread_priority",     required_argument,      0, 'W'},
 	{"client_type",         required_argument,      0, 'X'},
 	{"dump_dsp_offload",    no_argument,            0, 'Y'},
+	{"atlog_trace",         required_argument,      0, 'R'},
+	{"decode_atlog_trace",  required_argument,      0, 'S'},
 	{0, 0, 0, 0}
 };
 // clang-format on
@@ -2396,6 +2497,10 @@ static void show_usage() {
   printf(
       "--print_nodes_inlined - "
       "Print nodes table with devices inlined\n");
+  printf(
+      "--atlog_trace <file> - "
+      "Stream the audio thread event log to a file for "
+      "--duration_seconds without losing events.\n");
   printf(
       "--block_size <N> - "
       "The number for frames per callback(dictates latency).\n");
@@ -2427,6 +2532,9 @@ static void show_usage() {
       "          3 - For legacy client in vms.\n"
       "                                      "
       "          4 - For unified client in vms.\n");
+  printf(
+      "--decode_atlog_trace <file> - "
+      "Print a file written by --atlog_trace.\n");
   printf(
       "--dump_audio_thread - "
       "Dumps audio thread info.\n");
@@ -3092,6 +3200,15 @@ int main(int argc, char** argv) {
       case 'Q':
         show_ooo_ts = 1;
         break;
+      case 'R':
+        atlog_trace_file = optarg;
+        break;
+      case 'S':
+        rc = decode_atlog_trace(optarg);
+        if (rc) {
+          goto destroy_exit;
+        }
+        break;
       case 'T':
         rc = parse_unsigned_long(optarg, &ul);
         if (rc < 0) {
@@ -3195,6 +3312,10 @@ int main(int argc, char** argv) {
     run_aecdump(client, stream_id, 1);
     sleep(duration_seconds);
     run_aecdump(client, stream_id, 0);
+  } else if (atlog_trace_file != NULL) {
+    run_atlog_trace(client, 1);
+    sleep(duration_seconds);
+    run_atlog_trace(client, 0);
   }
 
 destroy_exit:
@@ -46,8 +46,7 @@ TEST(ABI, CrasServerState) {
                             deprecated_noise_cancellation_enabled));
   EXPECT_EQ(11016, offsetof(struct cras_server_state,
                             deprecated_dsp_noise_cancellation_supported));
-  EXPECT_EQ(11020, offsetof(struct cras_server_state,
-                            unused_bypass_block_noise_cancellation));
+  EXPECT_EQ(11020, offsetof(struct cras_server_state, sections_magic));
   EXPECT_EQ(11024,
             offsetof(struct cras_server_state, hotword_pause_at_suspend));
   EXPECT_EQ(11028, offsetof(struct cras_server_state, ns_supported));
@@ -69,4 +68,18 @@ TEST(ABI, CrasServerState) {
             offsetof(struct cras_server_state, voice_isolation_supported));
   EXPECT_EQ(11148, offsetof(struct cras_server_state,
                             num_input_streams_with_permission));
+  EXPECT_EQ(11200, offsetof(struct cras_server_state, power_meters));
+  EXPECT_EQ(11712, offsetof(struct cras_server_state, dev_list_update_count));
+  EXPECT_EQ(11716,
+            offsetof(struct cras_server_state, client_list_update_count));
+  EXPECT_EQ(11720, offsetof(struct cras_server_state, num_output_devs_total));
+  EXPECT_EQ(11724, offsetof(struct cras_server_state, num_input_devs_total));
+  EXPECT_EQ(11728, offsetof(struct cras_server_state, num_output_nodes_total));
+  EXPECT_EQ(11732, offsetof(struct cras_server_state, num_input_nodes_total));
+  EXPECT_EQ(11736, offsetof(struct cras_server_state, output_devs_ext));
+  EXPECT_EQ(12744, offsetof(struct cras_server_state, input_devs_ext));
+  EXPECT_EQ(13752, offsetof(struct cras_server_state, output_nodes_ext));
+  EXPECT_EQ(21672, offsetof(struct cras_server_state, input_nodes_ext));
+  EXPECT_EQ(29592, offsetof(struct cras_server_state, bt_debug_info));
+  EXPECT_EQ(1441204, offsetof(struct cras_server_state, audio_thread_health));
 }
@@ -1002,6 +1002,21 @@ const struct main_thread_debug_info* cras_client_get_main_thread_debug_info(
 const struct cras_audio_thread_snapshot_buffer*
 cras_client_get_audio_thread_snapshot_buffer(const struct cras_client* client);
 
+/* Gets the statistics continuously sampled by the audio thread.
+ *
+ * Requires that the connection to the server has been established.
+ * The audio thread keeps updating them while they are read, so a copy may
+ * be slightly inconsistent.
+ *
+ * Args:
+ *    client - The client from cras_client_create.
+ * Returns:
+ *    A pointer to the statistics in the server state shm region, NULL if
+ *    not connected.
+ */
+const struct cras_audio_thread_health* cras_client_get_audio_thread_health(
+    const struct cras_client* client);
+
 /* Gets the number of streams currently attached to the server.
  *
  * This is the total number of capture and playback streams. If the ts argument
@@ -1020,6 +1035,26 @@ cras_client_get_audio_thread_snapshot_buffer(const struct cras_client* client);
 unsigned cras_client_get_num_active_streams(const struct cras_client* client,
                                             struct timespec* ts);
 
+/*
+ * Gets the level meters of the active streams and open devices.
+ *
+ * The meters are read from shared memory, so polling them is cheap and does
+ * not require a capture stream.
+ *
+ * Requires that the connection to the server has been established.
+ *
+ * Args:
+ *    client - The client from cras_client_create.
+ *    meters - Array to fill with the meters in use.
+ *    num_meters - Maximum number of meters to put in the array, filled with
+ *        the number of meters put in the array on return.
+ * Returns:
+ *    0 on success, or a negative error code on failure.
+ */
+int cras_client_get_power_meters(const struct cras_client* client,
+                                 struct cras_power_meter* meters,
+                                 size_t* num_meters);
+
 /*
  * Utility functions.
  */
@@ -1221,6 +1256,15 @@ int cras_client_set_aec_dump(struct cras_client* client,
                              cras_stream_id_t stream_id,
                              int start,
                              int fd);
+/* Starts or stops streaming the audio thread event log to a file on server
+ * side. Unlike cras_client_read_atlog, no event is lost silently: events the
+ * server fails to keep up with are reported as overflow records in the file.
+ * Args:
+ *    client - The client from cras_client_create.
+ *    start - True to start the trace, otherwise to stop it.
+ *    fd - File descriptor of the file to store the trace, -1 when stopping.
+ */
+int cras_client_set_atlog_trace(struct cras_client* client, int start, int fd);
 /*
  * Reloads the aec.ini config file on server side.
  */
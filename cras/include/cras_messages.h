@@ -66,6 +66,7 @@ enum CRAS_SERVER_MESSAGE_ID {
   CRAS_SERVER_SET_AEC_REF,
   CRAS_SERVER_REQUEST_FLOOP,
   CRAS_SERVER_GET_DSP_OFFLOAD_INFO,
+  CRAS_SERVER_SET_ATLOG_TRACE,
 };
 
 enum CRAS_CLIENT_MESSAGE_ID {
@@ -89,6 +90,8 @@ enum CRAS_CLIENT_MESSAGE_ID {
   CRAS_CLIENT_ATLOG_FD_READY,
   CRAS_CLIENT_REQUEST_FLOOP_READY,
   CRAS_CLIENT_GET_DSP_OFFLOAD_INFO_READY,
+  // Several system status messages at once.
+  CRAS_CLIENT_NOTIFICATION_BATCH,
 };
 
 /* Messages that control the server. These are sent from the client to affect
@@ -467,6 +470,20 @@ static inline void cras_fill_set_aec_dump_message(struct cras_set_aec_dump* m,
   m->start = start;
 }
 
+// Start or stop streaming the audio thread event log to a file.
+struct __attribute__((__packed__)) cras_set_atlog_trace {
+  struct cras_server_message header;
+  unsigned int start;
+};
+
+static inline void cras_fill_set_atlog_trace_message(
+    struct cras_set_atlog_trace* m,
+    unsigned int start) {
+  m->header.id = CRAS_SERVER_SET_ATLOG_TRACE;
+  m->header.length = sizeof(*m);
+  m->start = start;
+}
+
 // Reload the aec configuration.
 struct __attribute__((__packed__)) cras_reload_aec_config {
   struct cras_server_message header;
@@ -743,6 +760,20 @@ static inline void cras_fill_client_num_active_streams_changed(
   m->num_active_streams = num_active_streams;
 };
 
+/* System status messages packed back to back, each with its own header.
+ * Sent instead of the individual messages to clients which registered for
+ * CRAS_CLIENT_NOTIFICATION_BATCH.
+ */
+struct __attribute__((__packed__)) cras_client_notification_batch {
+  struct cras_client_message header;
+  uint8_t msgs[CRAS_CLIENT_MAX_MSG_SIZE - sizeof(struct cras_client_message)];
+};
+static inline void cras_init_client_notification_batch(
+    struct cras_client_notification_batch* m) {
+  m->header.id = CRAS_CLIENT_NOTIFICATION_BATCH;
+  m->header.length = sizeof(m->header);
+}
+
 struct __attribute__((__packed__)) cras_client_request_floop_ready {
   struct cras_client_message header;
   // Device index of the flexible loopback or a negative error code (e.g.
@@ -277,6 +277,13 @@ static inline uint32_t node_index_of(cras_node_id_t id) {
 
 #define CRAS_MAX_IODEVS 20
 #define CRAS_MAX_IONODES 20
+/* Devices and nodes past the first CRAS_MAX_IODEVS and CRAS_MAX_IONODES of
+ * each direction are kept in extension tables of cras_server_state.
+ */
+#define CRAS_MAX_IODEVS_EXT 12
+#define CRAS_MAX_IONODES_EXT 44
+#define CRAS_MAX_IODEVS_TOTAL (CRAS_MAX_IODEVS + CRAS_MAX_IODEVS_EXT)
+#define CRAS_MAX_IONODES_TOTAL (CRAS_MAX_IONODES + CRAS_MAX_IONODES_EXT)
 #define CRAS_MAX_ATTACHED_CLIENTS 20
 #define CRAS_MAX_AUDIO_THREAD_SNAPSHOTS 10
 #define CRAS_MAX_HOTWORD_MODEL_NAME_SIZE 12
@@ -285,6 +292,7 @@ static inline uint32_t node_index_of(cras_node_id_t id) {
 #define AUDIO_THREAD_EVENT_LOG_SIZE (1024 * 6)
 #define CRAS_BT_EVENT_LOG_SIZE 1024
 #define MAIN_THREAD_EVENT_LOG_SIZE 1024
+#define CRAS_MAX_POWER_METERS 32
 
 // There are 8 bits of space for events.
 enum AUDIO_THREAD_LOG_EVENTS {
@@ -468,6 +476,37 @@ struct __attribute__((__packed__)) audio_thread_event_log {
   struct audio_thread_event log[AUDIO_THREAD_EVENT_LOG_SIZE];
 };
 
+/* Binary audio thread trace file, written while the audio thread event log is
+ * streamed with CRAS_SERVER_SET_ATLOG_TRACE. The file starts with an
+ * audio_thread_trace_header followed by audio_thread_trace_records.
+ */
+#define AUDIO_THREAD_TRACE_MAGIC 0x43525441  // "ATRC"
+#define AUDIO_THREAD_TRACE_VERSION 1
+
+struct __attribute__((__packed__)) audio_thread_trace_header {
+  uint32_t magic;
+  uint32_t version;
+  /* The same instant read from the clocks below, in nanoseconds. Events are
+   * stamped with CLOCK_MONOTONIC_RAW, use these to map them to wall clock
+   * time or to the CLOCK_BOOTTIME based Perfetto timeline. */
+  uint64_t monotonic_raw_ns;
+  uint64_t boottime_ns;
+  uint64_t realtime_ns;
+};
+
+enum AUDIO_THREAD_TRACE_RECORD_TYPE {
+  // Followed by |count| struct audio_thread_event logged by thread |tid|.
+  AUDIO_THREAD_TRACE_EVENTS,
+  // |count| events logged by thread |tid| were dropped, nothing follows.
+  AUDIO_THREAD_TRACE_OVERFLOW,
+};
+
+struct __attribute__((__packed__)) audio_thread_trace_record {
+  uint32_t type;
+  uint32_t tid;
+  uint32_t count;
+};
+
 struct __attribute__((__packed__)) audio_dev_debug_info {
   char dev_name[CRAS_NODE_NAME_BUFFER_SIZE];
   uint32_t buffer_size;
@@ -491,6 +530,13 @@ struct __attribute__((__packed__)) audio_dev_debug_info {
   double internal_gain_scaler;
   uint32_t dev_idx;
   int8_t channel_layout[CRAS_CH_MAX];
+  // Frames kept in buffer when waking up by hardware timestamp, 0 if the
+  // device uses the default wake up scheduling.
+  uint32_t tstamp_wake_margin_frames;
+  // Largest error of the hw_level predicted from hardware timestamps.
+  uint32_t max_wake_prediction_error;
+  // Lowest hw_level seen at playback wake ups, UINT32_MAX if none.
+  uint32_t lowest_wake_hw_level;
 };
 
 struct __attribute__((__packed__)) audio_stream_debug_info {
@@ -613,6 +659,75 @@ struct __attribute__((__packed__)) cras_audio_thread_snapshot_buffer {
   int pos;
 };
 
+/* Number of buckets in a cras_health_histogram. Bucket 0 counts values of 0,
+ * bucket i counts values in [2^(i-1), 2^i) and the last bucket counts all
+ * larger values.
+ */
+#define CRAS_HEALTH_HISTOGRAM_BUCKETS 24
+// Number of audio thread wake ups kept in cras_audio_thread_health.
+#define CRAS_HEALTH_WAKE_RECORDS 256
+// Number of open devices whose hw_level is sampled.
+#define CRAS_HEALTH_MAX_DEVS 8
+
+// Power of two histogram of samples taken by the audio thread.
+struct __attribute__((__packed__)) cras_health_histogram {
+  // Number of samples.
+  uint32_t count;
+  // Largest sample.
+  uint32_t max;
+  // Sum of the samples.
+  uint64_t sum;
+  uint32_t buckets[CRAS_HEALTH_HISTOGRAM_BUCKETS];
+};
+
+// One audio thread wake up.
+struct __attribute__((__packed__)) cras_health_wake_record {
+  // When the thread woke up.
+  struct cras_timespec wake_ts;
+  // Time in microseconds the thread ran before sleeping again.
+  uint32_t run_us;
+  // Time in microseconds spent in DSP pipelines during the run.
+  uint32_t dsp_us;
+  // Lowest hw_level in frames of an open device, or UINT32_MAX if none
+  // was sampled.
+  uint32_t min_hw_level;
+  // Index of the device with min_hw_level.
+  uint32_t min_hw_level_dev_idx;
+};
+
+// hw_level samples of one open device.
+struct __attribute__((__packed__)) cras_health_dev {
+  // Index of the device.
+  uint32_t dev_idx;
+  // enum CRAS_STREAM_DIRECTION of the device.
+  uint32_t direction;
+  // 1 while the device is open. The samples of a closed device are kept
+  // until the slot is reused.
+  uint32_t open;
+  // Frames in the hardware buffer each time the device was serviced.
+  struct cras_health_histogram hw_level;
+};
+
+/*
+ * Samples continuously taken by the audio thread, so that what led up to a
+ * glitch can be seen at any time. Only the audio thread writes it, readers
+ * may see it partially updated.
+ */
+struct __attribute__((__packed__)) cras_audio_thread_health {
+  // Time in microseconds the audio thread ran in each wake up.
+  struct cras_health_histogram run_us;
+  // Time in microseconds spent in each DSP pipeline run.
+  struct cras_health_histogram dsp_us;
+  // Time in microseconds from requesting audio from an output stream to
+  // its client replying.
+  struct cras_health_histogram stream_cb_us;
+  struct cras_health_dev devs[CRAS_HEALTH_MAX_DEVS];
+  // Total number of wake ups recorded, wakes[(num_wakes - 1) %
+  // CRAS_HEALTH_WAKE_RECORDS] is the latest.
+  uint32_t num_wakes;
+  struct cras_health_wake_record wakes[CRAS_HEALTH_WAKE_RECORDS];
+};
+
 // Flexible loopback parameters
 struct __attribute__((__packed__)) cras_floop_params {
   /* Bitmask of client types whose output streams
@@ -625,12 +740,40 @@ static inline bool cras_floop_params_eq(const struct cras_floop_params* a,
   return a->client_types_mask == b->client_types_mask;
 }
 
+// What a power meter in the server state measures.
+enum CRAS_POWER_METER_SOURCE {
+  // The meter slot is free.
+  CRAS_POWER_METER_NONE,
+  // The meter measures the samples of a stream.
+  CRAS_POWER_METER_STREAM,
+  // The meter measures the samples of an open device.
+  CRAS_POWER_METER_DEVICE,
+};
+
+/* A level meter published in the server state. Slots are claimed and
+ * released by the main thread under update_count, while |power| is written
+ * by the audio thread without bumping update_count, so readers only get
+ * the latest value of each meter rather than a consistent set.
+ */
+struct __attribute__((packed, aligned(4))) cras_power_meter {
+  // One of enum CRAS_POWER_METER_SOURCE.
+  uint32_t source;
+  // Stream id for stream meters, device index for device meters.
+  uint32_t id;
+  // One of enum CRAS_STREAM_DIRECTION.
+  uint32_t direction;
+  // EWMA of the mean square of the samples over 1ms blocks, in the range
+  // [0, 1] relative to full scale.
+  float power;
+};
+
 /* The server state that is shared with clients. Note that any new members must
  * be appended at the tail of the struct. Otherwise, it will be incompatible
  * with the one in other environments where files can't be updated atomically,
  * like ARC++.
  */
 #define CRAS_SERVER_STATE_VERSION 2
+#define CRAS_SERVER_STATE_SECTIONS_MAGIC 0x53454354  // "SECT"
 struct __attribute__((packed, aligned(4))) cras_server_state {
   // Version of this structure.
   uint32_t state_version;
@@ -661,17 +804,17 @@ struct __attribute__((packed, aligned(4))) cras_server_state {
   int32_t aec_group_id;
   // Total number of streams since server started.
   uint32_t num_streams_attached;
-  // Number of available output devices.
+  // Number of available output devices in output_devs.
   uint32_t num_output_devs;
-  // Number of available input devices.
+  // Number of available input devices in input_devs.
   uint32_t num_input_devs;
   // Output audio devices currently attached.
   struct cras_iodev_info output_devs[CRAS_MAX_IODEVS];
   // Input audio devices currently attached.
   struct cras_iodev_info input_devs[CRAS_MAX_IODEVS];
-  // Number of available output nodes.
+  // Number of available output nodes in output_nodes.
   uint32_t num_output_nodes;
-  // Number of available input nodes.
+  // Number of available input nodes in input_nodes.
   uint32_t num_input_nodes;
   // Output nodes currently attached.
   struct cras_ionode_info output_nodes[CRAS_MAX_IONODES];
@@ -707,8 +850,10 @@ struct __attribute__((packed, aligned(4))) cras_server_state {
   int32_t deprecated_noise_cancellation_enabled;
   // Deprecated, don't remove to keep other fields' offsets.
   int32_t deprecated_dsp_noise_cancellation_supported;
-  // Unused, don't remove to keep other fields' offsets.
-  int32_t unused_bypass_block_noise_cancellation;
+  // CRAS_SERVER_STATE_SECTIONS_MAGIC if the server maintains the section
+  // update counts and the extension tables appended below. Was unused before,
+  // so older servers leave it 0 or 1.
+  uint32_t sections_magic;
   // 1 = Pause hotword detection when the system
   // suspends. Hotword detection is resumed after system resumes.
   // 0 = Hotword detection is allowed to continue running after system
@@ -750,6 +895,30 @@ struct __attribute__((packed, aligned(4))) cras_server_state {
   // An array containing numbers of input
   // streams with permission in each client type.
   uint32_t num_input_streams_with_permission[CRAS_NUM_CLIENT_TYPE];
+  // Level meters of the active streams and open devices.
+  struct cras_power_meter power_meters[CRAS_MAX_POWER_METERS];
+  // Incremented twice each time the device and node lists are updated, along
+  // with update_count. Odd during updates. Readers of the lists only need to
+  // retry when this changes.
+  uint32_t dev_list_update_count;
+  // Same as dev_list_update_count, for the attached client list.
+  uint32_t client_list_update_count;
+  // Number of output devices in output_devs followed by output_devs_ext.
+  uint32_t num_output_devs_total;
+  // Number of input devices in input_devs followed by input_devs_ext.
+  uint32_t num_input_devs_total;
+  // Number of output nodes in output_nodes followed by output_nodes_ext.
+  uint32_t num_output_nodes_total;
+  // Number of input nodes in input_nodes followed by input_nodes_ext.
+  uint32_t num_input_nodes_total;
+  // Output devices that don't fit in output_devs.
+  struct cras_iodev_info output_devs_ext[CRAS_MAX_IODEVS_EXT];
+  // Input devices that don't fit in input_devs.
+  struct cras_iodev_info input_devs_ext[CRAS_MAX_IODEVS_EXT];
+  // Output nodes that don't fit in output_nodes.
+  struct cras_ionode_info output_nodes_ext[CRAS_MAX_IONODES_EXT];
+  // Input nodes that don't fit in input_nodes.
+  struct cras_ionode_info input_nodes_ext[CRAS_MAX_IONODES_EXT];
 
   // Start of debug structs which may change frequently.
   // Append new members that are accessed in other environments like ARC++
@@ -766,6 +935,8 @@ struct __attribute__((packed, aligned(4))) cras_server_state {
   // isn't protected against concurrent updating, only one client should
   // use it.
   struct audio_debug_info audio_debug_info;
+  // Continuously sampled audio thread statistics.
+  struct cras_audio_thread_health audio_thread_health;
 };
 
 /* Unique identifier for each active stream.
@@ -16,6 +16,8 @@ PERCETTO_TRACK_DEFINE(CRAS_FLOOP_OUT_WRITE_FRAMES, PERCETTO_TRACK_COUNTER);
 PERCETTO_TRACK_DEFINE(CRAS_FLOOP_IN_READ_FRAMES, PERCETTO_TRACK_COUNTER);
 PERCETTO_TRACK_DEFINE(CRAS_INTERNAL_MIC_READ_FRAMES, PERCETTO_TRACK_COUNTER);
 
+PERCETTO_TRACK_DEFINE(CRAS_PROCESSOR_CPU_US, PERCETTO_TRACK_COUNTER);
+
 int cras_trace_init() {
   PERCETTO_INIT(PERCETTO_CLOCK_DONT_CARE);
   PERCETTO_REGISTER_TRACK(CRAS_SPK_HW_LEVEL);
@@ -27,6 +29,8 @@ int cras_trace_init() {
   PERCETTO_REGISTER_TRACK(CRAS_FLOOP_OUT_WRITE_FRAMES);
   PERCETTO_REGISTER_TRACK(CRAS_FLOOP_IN_READ_FRAMES);
   PERCETTO_REGISTER_TRACK(CRAS_INTERNAL_MIC_READ_FRAMES);
+
+  PERCETTO_REGISTER_TRACK(CRAS_PROCESSOR_CPU_US);
   return 0;
 }
 
@@ -68,6 +72,10 @@ void cras_trace_frames(enum CRAS_NODE_TYPE type, unsigned int nframes) {
   }
 }
 
+void cras_trace_processor_cpu(unsigned int usec) {
+  TRACE_COUNTER(audio, CRAS_PROCESSOR_CPU_US, usec);
+}
+
 void cras_trace_underrun(enum CRAS_NODE_TYPE type,
                          enum CRAS_NODE_POSITION position) {
   char event[50];
@@ -27,6 +27,8 @@ PERCETTO_TRACK_DECLARE(CRAS_FLOOP_OUT_WRITE_FRAMES);
 PERCETTO_TRACK_DECLARE(CRAS_FLOOP_IN_READ_FRAMES);
 PERCETTO_TRACK_DECLARE(CRAS_INTERNAL_MIC_READ_FRAMES);
 
+PERCETTO_TRACK_DECLARE(CRAS_PROCESSOR_CPU_US);
+
 // https://github.com/olvaffe/percetto/pull/34
 #ifdef NPERCETTO
 #define TRACE_EVENT_DATA(category, str_name, ...)
@@ -42,6 +44,11 @@ void cras_trace_hw_level(enum CRAS_NODE_TYPE type, unsigned int hw_level);
 // Log the nframes write to or read from the hardware buffer.
 void cras_trace_frames(enum CRAS_NODE_TYPE type, unsigned int nframes);
 
+// Log the thread CPU time used by one cras_processor block, in microseconds.
+// Only logged when the processor runs on the audio thread. The time of each
+// stage is available through cras_processor_dump_stats.
+void cras_trace_processor_cpu(unsigned int usec);
+
 // Log the underrun event.
 void cras_trace_underrun(enum CRAS_NODE_TYPE type, enum CRAS_NODE_POSITION);
 
@@ -7,13 +7,18 @@
 
 #include <errno.h>
 #include <linux/limits.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
 #include <syslog.h>
 #include <unistd.h>
 
 #include "cras/common/check.h"
+#include "cras/server/cras_thread.h"
 #include "cras_util.h"
 #include "third_party/utlist/utlist.h"
 
@@ -29,8 +34,37 @@ struct cras_main_msg_callback {
   struct cras_main_msg_callback *prev, *next;
 };
 
+// Number of slots in the audio thread message ring. Must be a power of 2.
+#define AUDIO_MSG_RING_SLOTS 64
+
+union audio_msg_slot {
+  struct cras_main_message header;
+  uint8_t buf[CRAS_MAIN_MESSAGE_MAX_LENGTH];
+};
+
+/* Single producer single consumer ring carrying messages from the audio
+ * thread to the main thread. |write_idx| is only advanced by the audio thread
+ * and |read_idx| only by the main thread, both run freely and wrap.
+ * |signaled| is set by the first message queued after the main thread last
+ * started draining, so that the audio thread writes the eventfd at most once
+ * per batch of messages.
+ */
+struct audio_msg_ring {
+  union audio_msg_slot slots[AUDIO_MSG_RING_SLOTS];
+  atomic_uint write_idx;
+  atomic_uint read_idx;
+  atomic_bool signaled;
+  atomic_uint queued;
+  atomic_uint coalesced;
+  atomic_uint dropped;
+  // Value of |dropped| last reported by the main thread.
+  unsigned int dropped_reported;
+  int event_fd;
+};
+
 static int main_msg_fds[2] = {-1, -1};
 static struct cras_main_msg_callback* main_msg_callbacks;
+static struct audio_msg_ring audio_ring = {.event_fd = -1};
 
 int cras_main_message_add_handler(enum CRAS_MAIN_MESSAGE_TYPE type,
                                   cras_message_callback callback,
@@ -76,6 +110,88 @@ int cras_main_message_send(struct cras_main_message* msg) {
   return 0;
 }
 
+/* Returns true if the newest pending message of the type of |msg| in the
+ * ring is identical to |msg|. Only the newest one is compared so a state
+ * change in between is never folded away.
+ */
+static bool audio_ring_has_pending_duplicate(
+    const struct cras_main_message* msg,
+    unsigned int read_idx,
+    unsigned int write_idx) {
+  unsigned int i;
+
+  for (i = write_idx; i != read_idx; i--) {
+    const union audio_msg_slot* slot =
+        &audio_ring.slots[(i - 1) & (AUDIO_MSG_RING_SLOTS - 1)];
+    if (slot->header.type != msg->type) {
+      continue;
+    }
+    return slot->header.length == msg->length &&
+           memcmp(slot->buf, msg, msg->length) == 0;
+  }
+  return false;
+}
+
+int cras_main_message_send_from_audio(struct cras_main_message* msg) {
+  unsigned int read_idx, write_idx;
+
+  CRAS_CHECK(msg->length <= CRAS_MAIN_MESSAGE_MAX_LENGTH && "message too long");
+
+  /* The ring has a single producer. Other threads, or any sender before the
+   * ring is set up, take the pipe.
+   */
+  if (audio_ring.event_fd < 0 || !get_audio_ctx_or_null()) {
+    return cras_main_message_send(msg);
+  }
+
+  write_idx = atomic_load_explicit(&audio_ring.write_idx, memory_order_relaxed);
+  read_idx = atomic_load_explicit(&audio_ring.read_idx, memory_order_acquire);
+
+  if (audio_ring_has_pending_duplicate(msg, read_idx, write_idx)) {
+    atomic_fetch_add_explicit(&audio_ring.coalesced, 1, memory_order_relaxed);
+    return 0;
+  }
+  if (write_idx - read_idx >= AUDIO_MSG_RING_SLOTS) {
+    atomic_fetch_add_explicit(&audio_ring.dropped, 1, memory_order_relaxed);
+    return -EAGAIN;
+  }
+
+  memcpy(audio_ring.slots[write_idx & (AUDIO_MSG_RING_SLOTS - 1)].buf, msg,
+         msg->length);
+  // Pairs with the load in handle_audio_main_messages, and orders against
+  // |signaled| below.
+  atomic_store(&audio_ring.write_idx, write_idx + 1);
+  atomic_fetch_add_explicit(&audio_ring.queued, 1, memory_order_relaxed);
+
+  if (!atomic_exchange(&audio_ring.signaled, true)) {
+    uint64_t one = 1;
+    if (write(audio_ring.event_fd, &one, sizeof(one)) < 0) {
+      return -errno;
+    }
+  }
+  return 0;
+}
+
+void cras_main_message_get_audio_stats(struct cras_main_message_stats* stats) {
+  stats->queued =
+      atomic_load_explicit(&audio_ring.queued, memory_order_relaxed);
+  stats->coalesced =
+      atomic_load_explicit(&audio_ring.coalesced, memory_order_relaxed);
+  stats->dropped =
+      atomic_load_explicit(&audio_ring.dropped, memory_order_relaxed);
+}
+
+static void dispatch_main_message(struct cras_main_message* msg) {
+  struct cras_main_msg_callback* main_msg_cb;
+
+  DL_FOREACH (main_msg_callbacks, main_msg_cb) {
+    if (main_msg_cb->type == msg->type) {
+      main_msg_cb->callback(msg, main_msg_cb->callback_data);
+      break;
+    }
+  }
+}
+
 static int read_main_message(int msg_fd, uint8_t* buf, size_t max_len) {
   int to_read, nread, rc;
   struct cras_main_message* msg = (struct cras_main_message*)buf;
@@ -99,7 +215,6 @@ static int read_main_message(int msg_fd, uint8_t* buf, size_t max_len) {
 void handle_main_messages(void* arg, int revents) {
   uint8_t buf[CRAS_MAIN_MESSAGE_MAX_LENGTH];
   int rc;
-  struct cras_main_msg_callback* main_msg_cb;
   struct cras_main_message* msg = (struct cras_main_message*)buf;
 
   rc = read_main_message(main_msg_fds[0], buf, sizeof(buf));
@@ -108,11 +223,41 @@ void handle_main_messages(void* arg, int revents) {
     return;
   }
 
-  DL_FOREACH (main_msg_callbacks, main_msg_cb) {
-    if (main_msg_cb->type == msg->type) {
-      main_msg_cb->callback(msg, main_msg_cb->callback_data);
-      break;
-    }
+  dispatch_main_message(msg);
+}
+
+void handle_audio_main_messages(void* arg, int revents) {
+  union audio_msg_slot slot;
+  unsigned int read_idx, write_idx, dropped;
+  uint64_t count;
+
+  if (read(audio_ring.event_fd, &count, sizeof(count)) < 0 &&
+      errno != EAGAIN) {
+    syslog(LOG_ERR, "Failed to read audio message eventfd");
+  }
+
+  /* Clear |signaled| before looking at the ring. A message queued after this
+   * point either shows up below or writes the eventfd again.
+   */
+  atomic_store(&audio_ring.signaled, false);
+
+  read_idx = atomic_load_explicit(&audio_ring.read_idx, memory_order_relaxed);
+  while (read_idx != (write_idx = atomic_load(&audio_ring.write_idx))) {
+    const union audio_msg_slot* src =
+        &audio_ring.slots[read_idx & (AUDIO_MSG_RING_SLOTS - 1)];
+    memcpy(&slot, src, src->header.length);
+    // Release the slot before the handler runs so the audio thread can reuse
+    // it while the message is being handled.
+    atomic_store_explicit(&audio_ring.read_idx, ++read_idx,
+                          memory_order_release);
+    dispatch_main_message(&slot.header);
+  }
+
+  dropped = atomic_load_explicit(&audio_ring.dropped, memory_order_relaxed);
+  if (dropped != audio_ring.dropped_reported) {
+    syslog(LOG_WARNING, "Audio thread dropped %u main messages, %u total",
+           dropped - audio_ring.dropped_reported, dropped);
+    audio_ring.dropped_reported = dropped;
   }
 }
 
@@ -129,5 +274,14 @@ int cras_main_message_init() {
   cras_make_fd_nonblocking(main_msg_fds[0]);
   cras_make_fd_nonblocking(main_msg_fds[1]);
 
+  audio_ring.event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (audio_ring.event_fd < 0) {
+    syslog(LOG_ERR, "Failed to create audio message eventfd, using pipe");
+  }
+
   return main_msg_fds[0];
 }
+
+int cras_main_message_audio_fd() {
+  return audio_ring.event_fd;
+}
@@ -75,6 +75,30 @@ typedef void (*cras_message_callback)(struct cras_main_message* msg, void* arg);
 // Sends a message to main thread.
 int cras_main_message_send(struct cras_main_message* msg);
 
+/* Sends a message to main thread from the audio thread without blocking.
+ * The message is copied into a lock-free ring and the main thread is woken
+ * through an eventfd, written at most once until the main thread drains the
+ * ring. If the newest pending message of the same type is identical to |msg|,
+ * |msg| is coalesced into it. Calls from any other thread fall back to
+ * cras_main_message_send().
+ * Returns 0 on success, -EAGAIN if the ring is full and |msg| was dropped,
+ * or another negative error code.
+ */
+int cras_main_message_send_from_audio(struct cras_main_message* msg);
+
+// Counters of the messages sent through cras_main_message_send_from_audio.
+struct cras_main_message_stats {
+  // Messages put in the ring.
+  unsigned int queued;
+  // Messages folded into an identical pending message.
+  unsigned int coalesced;
+  // Messages dropped because the ring was full.
+  unsigned int dropped;
+};
+
+// Gets the counters of the audio thread message ring.
+void cras_main_message_get_audio_stats(struct cras_main_message_stats* stats);
+
 // Registers the handler function for specific type of message.
 int cras_main_message_add_handler(enum CRAS_MAIN_MESSAGE_TYPE type,
                                   cras_message_callback callback,
@@ -86,11 +110,19 @@ void cras_main_message_rm_handler(enum CRAS_MAIN_MESSAGE_TYPE type);
 // Callback for main messages.
 void handle_main_messages(void* arg, int revents);
 
+// Callback for messages sent by cras_main_message_send_from_audio.
+void handle_audio_main_messages(void* arg, int revents);
+
 // Initialize the message handling mechanism in main thread.
 // Returns a fd to POLLIN on.
 // When the fd is ready handle_main_messages should be called.
 int cras_main_message_init();
 
+// Returns the eventfd to POLLIN on for messages from the audio thread, or -1
+// if there is none. When it is ready handle_audio_main_messages should be
+// called. Valid after cras_main_message_init().
+int cras_main_message_audio_fd();
+
 #ifdef __cplusplus
 }
 #endif
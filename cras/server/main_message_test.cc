@@ -0,0 +1,143 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "cras/server/main_message.h"
+
+#include <poll.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+struct test_message {
+  struct cras_main_message header;
+  int value;
+};
+
+std::vector<int> received;
+
+void handle_test_message(struct cras_main_message* msg, void* arg) {
+  received.push_back(((struct test_message*)msg)->value);
+}
+
+int send_from_audio(int value) {
+  struct test_message msg = CRAS_MAIN_MESSAGE_INIT;
+  msg.header.type = CRAS_MAIN_METRICS;
+  msg.header.length = sizeof(msg);
+  msg.value = value;
+  return cras_main_message_send_from_audio(&msg.header);
+}
+
+bool fd_readable(int fd) {
+  struct pollfd pfd = {.fd = fd, .events = POLLIN};
+  return poll(&pfd, 1, 0) == 1;
+}
+
+class MainMessageTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    received.clear();
+    pipe_fd_ = cras_main_message_init();
+    ASSERT_GE(pipe_fd_, 0);
+    audio_fd_ = cras_main_message_audio_fd();
+    ASSERT_GE(audio_fd_, 0);
+    ASSERT_EQ(0, cras_main_message_add_handler(CRAS_MAIN_METRICS,
+                                               handle_test_message, nullptr));
+    cras_main_message_get_audio_stats(&stats_);
+  }
+
+  void TearDown() override {
+    handle_audio_main_messages(nullptr, POLLIN);
+    cras_main_message_rm_handler(CRAS_MAIN_METRICS);
+    close(pipe_fd_);
+    close(audio_fd_);
+  }
+
+  int pipe_fd_;
+  int audio_fd_;
+  struct cras_main_message_stats stats_;
+};
+
+TEST_F(MainMessageTest, RingDeliversInOrderWithOneWake) {
+  EXPECT_EQ(0, send_from_audio(1));
+  EXPECT_EQ(0, send_from_audio(2));
+  EXPECT_EQ(0, send_from_audio(3));
+
+  uint64_t count = 0;
+  ASSERT_EQ((ssize_t)sizeof(count), read(audio_fd_, &count, sizeof(count)));
+  EXPECT_EQ(1u, count);
+  EXPECT_FALSE(fd_readable(pipe_fd_));
+
+  handle_audio_main_messages(nullptr, POLLIN);
+  EXPECT_EQ(std::vector<int>({1, 2, 3}), received);
+
+  // The next message signals the eventfd again.
+  EXPECT_EQ(0, send_from_audio(4));
+  EXPECT_TRUE(fd_readable(audio_fd_));
+  handle_audio_main_messages(nullptr, POLLIN);
+  EXPECT_FALSE(fd_readable(audio_fd_));
+  EXPECT_EQ(std::vector<int>({1, 2, 3, 4}), received);
+}
+
+TEST_F(MainMessageTest, CoalescesIdenticalPendingMessage) {
+  EXPECT_EQ(0, send_from_audio(1));
+  EXPECT_EQ(0, send_from_audio(1));
+  EXPECT_EQ(0, send_from_audio(0));
+  // Not folded into the first one, the state changed in between.
+  EXPECT_EQ(0, send_from_audio(1));
+  EXPECT_EQ(0, send_from_audio(1));
+
+  handle_audio_main_messages(nullptr, POLLIN);
+  EXPECT_EQ(std::vector<int>({1, 0, 1}), received);
+
+  struct cras_main_message_stats stats;
+  cras_main_message_get_audio_stats(&stats);
+  EXPECT_EQ(3u, stats.queued - stats_.queued);
+  EXPECT_EQ(2u, stats.coalesced - stats_.coalesced);
+  EXPECT_EQ(0u, stats.dropped - stats_.dropped);
+
+  // Nothing is pending anymore, so the same message is queued again.
+  EXPECT_EQ(0, send_from_audio(1));
+  handle_audio_main_messages(nullptr, POLLIN);
+  EXPECT_EQ(std::vector<int>({1, 0, 1, 1}), received);
+}
+
+TEST_F(MainMessageTest, DropsWhenFull) {
+  int sent = 0;
+  while (send_from_audio(sent) == 0) {
+    sent++;
+  }
+  EXPECT_EQ(-EAGAIN, send_from_audio(sent));
+
+  struct cras_main_message_stats stats;
+  cras_main_message_get_audio_stats(&stats);
+  EXPECT_EQ((unsigned int)sent, stats.queued - stats_.queued);
+  EXPECT_EQ(2u, stats.dropped - stats_.dropped);
+
+  handle_audio_main_messages(nullptr, POLLIN);
+  ASSERT_EQ((size_t)sent, received.size());
+  for (int i = 0; i < sent; i++) {
+    EXPECT_EQ(i, received[i]);
+  }
+  EXPECT_EQ(0, send_from_audio(sent));
+}
+
+TEST_F(MainMessageTest, OtherThreadsUsePipe) {
+  int rc = -1;
+  std::thread t([&rc] { rc = send_from_audio(5); });
+  t.join();
+  EXPECT_EQ(0, rc);
+
+  EXPECT_FALSE(fd_readable(audio_fd_));
+  ASSERT_TRUE(fd_readable(pipe_fd_));
+  handle_main_messages(nullptr, POLLIN);
+  EXPECT_EQ(std::vector<int>({5}), received);
+}
+
+}  // namespace
@@ -173,6 +173,37 @@ TEST_P(CrasProcessor, Negate) {
   processor->ops->destroy(processor);
 }
 
+TEST(CrasProcessorStats, Dump) {
+  CrasProcessorConfig cfg = {
+      .channels = 1,
+      .block_size = 480,
+      .frame_rate = 48000,
+      .effect = NoEffects,
+  };
+  auto r = cras_processor_create(&cfg, &noop_processor);
+  plugin_processor* processor = r.plugin_processor;
+  ASSERT_THAT(processor, testing::NotNull());
+
+  std::vector<float> input_buffer(480);
+  multi_slice input = {
+      .channels = 1,
+      .num_frames = 480,
+      .data = {input_buffer.data()},
+  };
+  multi_slice output = {};
+  ASSERT_EQ(processor->ops->run(processor, &input, &output), StatusOk);
+
+  char* dump = cras_processor_dump_stats();
+  EXPECT_THAT(dump, testing::HasSubstr("effect=NoEffects"));
+  EXPECT_THAT(dump, testing::HasSubstr("apm: blocks=1 frames=480"));
+  cras_rust_free_string(dump);
+
+  processor->ops->destroy(processor);
+  dump = cras_processor_dump_stats();
+  EXPECT_THAT(dump, testing::Not(testing::HasSubstr("apm:")));
+  cras_rust_free_string(dump);
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   cras_rust_init_logging();
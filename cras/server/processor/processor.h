@@ -24,6 +24,8 @@ enum CrasProcessorWrapMode {
   WrapModeNone,
   /**
    * Run the processor pipeline in a separate, dedicated thread.
+   * The output is delayed by one block. A block not processed in time is
+   * passed through unprocessed instead of blocking the caller.
    */
   WrapModeDedicatedThread,
   /**
@@ -80,6 +82,12 @@ struct CrasProcessorConfig {
 struct CrasProcessorCreateResult cras_processor_create(const struct CrasProcessorConfig *config,
                                                        struct plugin_processor *apm_plugin_processor);
 
+/**
+ * Returns the per-stage CPU usage of the existing CRAS processors, as text.
+ * The resulting string should be freed with cras_rust_free_string.
+ */
+char *cras_processor_dump_stats(void);
+
 /**
  * Returns true if override is enabled in the system config file.
  */
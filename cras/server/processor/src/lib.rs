@@ -2,22 +2,30 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+use std::collections::BTreeMap;
+use std::ffi::c_char;
+use std::ffi::CString;
+use std::fmt::Write;
 use std::path::Path;
 use std::path::PathBuf;
 use std::ptr::NonNull;
 use std::sync::atomic::AtomicUsize;
 use std::sync::atomic::Ordering;
+use std::sync::Arc;
+use std::sync::Mutex;
 
 use anyhow::ensure;
 use anyhow::Context;
 use audio_processor::cdcfg;
 use audio_processor::cdcfg::ResolverContext;
+use audio_processor::config::LiveStatsCollector;
 use audio_processor::config::PipelineBuilder;
 use audio_processor::config::PreloadedProcessor;
 use audio_processor::config::Processor;
 use audio_processor::processors::binding::plugin_processor;
 use audio_processor::processors::export_plugin;
 use audio_processor::processors::peer::AudioWorkerSubprocessFactory;
+use audio_processor::processors::profile::LiveStats;
 use audio_processor::processors::CheckShape;
 use audio_processor::processors::PluginProcessor;
 use audio_processor::processors::ThreadedProcessor;
@@ -37,6 +45,8 @@ mod proto;
 pub enum CrasProcessorWrapMode {
     WrapModeNone,
     /// Run the processor pipeline in a separate, dedicated thread.
+    /// The output is delayed by one block. A block not processed in time is
+    /// passed through unprocessed instead of blocking the caller.
     WrapModeDedicatedThread,
     /// Run the processor pipeline with a ChunkWrapper with the inner block
     /// size set to  [`CrasProcessorConfig::block_size`].
@@ -125,6 +135,32 @@ impl audio_processor::cdcfg::ResolverContext for CrasProcessorResolverContext {
 
 static GLOBAL_ID_COUNTER: AtomicUsize = AtomicUsize::new(0);
 
+/// Live stats of the stages of a CrasProcessor.
+struct CrasProcessorLiveStats {
+    config: CrasProcessorConfig,
+    stages: Vec<Arc<LiveStats>>,
+}
+
+/// Live stats of the existing CrasProcessors, by id.
+static LIVE_STATS: Mutex<BTreeMap<usize, CrasProcessorLiveStats>> = Mutex::new(BTreeMap::new());
+
+fn dump_live_stats() -> String {
+    let mut out = String::new();
+    for (id, stats) in LIVE_STATS.lock().unwrap().iter() {
+        let config = &stats.config;
+        let _ = writeln!(
+            out,
+            "CrasProcessor #{id}: effect={:?} wrap_mode={:?} channels={} block_size={} \
+             frame_rate={}",
+            config.effect, config.wrap_mode, config.channels, config.block_size, config.frame_rate
+        );
+        for stage in &stats.stages {
+            let _ = writeln!(out, "  {}", stage.snapshot());
+        }
+    }
+    out
+}
+
 fn get_noise_cancellation_pipeline_decl(
     context: &dyn ResolverContext,
 ) -> anyhow::Result<Processor> {
@@ -297,6 +333,7 @@ impl CrasProcessor {
                 if override_config.frame_rate != 0 {
                     decl.push(Processor::Resample {
                         output_frame_rate: override_config.frame_rate as usize,
+                        quality: Default::default(),
                     });
                 }
                 let plugin = Processor::Plugin {
@@ -317,6 +354,7 @@ impl CrasProcessor {
         // Resample to input rate.
         decl.push(Processor::Resample {
             output_frame_rate: config.frame_rate,
+            quality: Default::default(),
         });
 
         // Check that the input format is the same as the output format.
@@ -350,6 +388,7 @@ impl CrasProcessor {
         }
 
         let decl_debug = format!("{pipeline:?}");
+        let live_stats = LiveStatsCollector::default();
         let pipeline = PipelineBuilder::new(Format {
             block_size: if matches!(config.wrap_mode, CrasProcessorWrapMode::WrapModePeerChunk) {
                 assert_ne!(config.max_block_size, 0);
@@ -361,11 +400,23 @@ impl CrasProcessor {
         })
         // TODO(b/349784210): Use a hardened worker factory.
         .with_worker_factory(AudioWorkerSubprocessFactory::default().with_set_thread_priority())
+        .with_live_stats(live_stats.clone())
         .build(pipeline)
         .context("failed to build pipeline")?;
+        LIVE_STATS.lock().unwrap().insert(
+            id,
+            CrasProcessorLiveStats {
+                config: config.clone(),
+                stages: live_stats.take(),
+            },
+        );
 
         log::info!("CrasProcessor #{id} created with: {config:?}");
         log::info!("CrasProcessor #{id} pipeline: {decl_debug}");
+        log::info!(
+            "CrasProcessor #{id} plugin latency: {} frames",
+            pipeline.latency_frames
+        );
 
         Ok(CrasProcessor {
             id,
@@ -377,6 +428,7 @@ impl CrasProcessor {
 
 impl Drop for CrasProcessor {
     fn drop(&mut self) {
+        LIVE_STATS.lock().unwrap().remove(&self.id);
         log::info!("CrasProcessor #{} dropped", self.id);
     }
 }
@@ -467,7 +519,8 @@ pub unsafe extern "C" fn cras_processor_create(
         config.wrap_mode,
         CrasProcessorWrapMode::WrapModeDedicatedThread
     ) {
-        let threaded_processor = ThreadedProcessor::new(processor, 1);
+        let threaded_processor =
+            ThreadedProcessor::new_with_passthrough(processor, config.format(), 1);
         export_plugin(threaded_processor)
     } else {
         export_plugin(processor)
@@ -478,6 +531,15 @@ pub unsafe extern "C" fn cras_processor_create(
     }
 }
 
+/// Returns the per-stage CPU usage of the existing CRAS processors, as text.
+/// The resulting string should be freed with cras_rust_free_string.
+#[no_mangle]
+pub extern "C" fn cras_processor_dump_stats() -> *mut c_char {
+    CString::new(dump_live_stats())
+        .expect("CString::new")
+        .into_raw()
+}
+
 /// Returns true if override is enabled in the system config file.
 #[no_mangle]
 pub extern "C" fn cras_processor_is_override_enabled() -> bool {
@@ -30,6 +30,20 @@ struct rate_estimator *rate_estimator_create(unsigned int rate,
                                              const struct timespec *window_size,
                                              double smooth_factor);
 
+/**
+ * Creates a rate estimator that tracks the device with a Kalman filter and
+ * rejects outlying level measurements. Takes the same arguments as
+ * rate_estimator_create.
+ *
+ * # Safety
+ *
+ * To use this function safely, `window_size` must be a valid pointer to a
+ * timespec.
+ */
+struct rate_estimator *rate_estimator_create_robust(unsigned int rate,
+                                                    const struct timespec *window_size,
+                                                    double smooth_factor);
+
 /**
  * Create a stub rate estimator for testing.
  */
@@ -0,0 +1,313 @@
+// Copyright 2024 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+use std::time::Duration;
+
+use crate::rate_estimator::Error;
+use crate::rate_estimator::RateEstimator;
+use crate::rate_estimator::Result;
+use crate::rate_estimator::MAX_RATE_SKEW;
+
+/// Standard deviation of a buffer level measurement, expressed as a duration
+/// of audio. Covers scheduling jitter between the level read and its
+/// timestamp, and period or packet granularity of the level itself.
+const MEASUREMENT_STDDEV_SECS: f64 = 0.0005;
+
+/// How fast the true rate of a device is expected to wander, in Hz per
+/// square root of a second. Crystal drift changes slowly with temperature.
+const RATE_NOISE_DENSITY: f64 = 0.05;
+
+/// Measurements further than this many standard deviations away from the
+/// prediction are treated as outliers and ignored.
+const OUTLIER_GATE_SIGMAS: f64 = 4.0;
+
+/// After this many consecutive outliers the frame count is assumed to have
+/// genuinely jumped, e.g. after frames were dropped without being reported,
+/// and the filter resynchronizes to the measurement while keeping its rate.
+const MAX_CONSECUTIVE_OUTLIERS: u32 = 10;
+
+/// A rate estimator tracking the number of frames processed by the device
+/// with a two state (frames, rate) Kalman filter.
+///
+/// Compared to `RateEstimatorImpl`, which fits a fresh least squares slope in
+/// every window, the filter carries its state across windows and rejects
+/// measurements that disagree with its prediction by more than
+/// `OUTLIER_GATE_SIGMAS`. A late wake up or a bad timestamp therefore does not
+/// bend the estimate. All the work is constant time and allocation free.
+///
+/// # Members
+///    * `nominal_rate` - The rate the estimator was reset to.
+///    * `last_level` - Buffer level of the audio device at last check time.
+///    * `level_diff` - Number of frames written to or read from audio device
+///                     since the last check time.
+///    * `origin` - Time of the first check after reset.
+///    * `last_time` - Time of the last check, relative to `origin`.
+///    * `processed` - Frames processed by the device since `origin`.
+///    * `frames` - Filtered estimate of `processed`.
+///    * `rate` - Filtered estimate of the device rate.
+///    * `cov` - Covariance of (`frames`, `rate`), row major.
+///    * `consecutive_outliers` - Number of measurements rejected in a row.
+///    * `num_updates` - Number of measurements accepted in current window.
+///    * `window_start` - The start time of the current window.
+///    * `window_size` - The size of the window.
+///    * `smooth_factor` - The coefficient used to average the previous and new
+///                        rate estimates.
+///    * `estimated_rate` - The estimated rate reported to the caller.
+pub struct KalmanRateEstimator {
+    nominal_rate: f64,
+    last_level: i32,
+    level_diff: i32,
+    origin: Option<Duration>,
+    last_time: f64,
+    processed: f64,
+    frames: f64,
+    rate: f64,
+    cov: [f64; 4],
+    consecutive_outliers: u32,
+    num_updates: u32,
+    window_start: Duration,
+    window_size: Duration,
+    smooth_factor: f64,
+    estimated_rate: f64,
+}
+
+impl KalmanRateEstimator {
+    /// Creates a Kalman filter based rate estimator.
+    ///
+    /// # Arguments
+    ///    * `rate` - The initial value to estimate rate from.
+    ///    * `window_size` - How often the reported rate is refreshed.
+    ///    * `smooth_factor` - The coefficient used to calculate moving average
+    ///                        from old estimated rate values. Must be between
+    ///                        0.0 and 1.0
+    ///
+    /// # Errors
+    ///    * If `smooth_factor` is not between 0.0 and 1.0
+    pub fn try_new(rate: u32, window_size: Duration, smooth_factor: f64) -> Result<Self> {
+        if !(0.0..=1.0).contains(&smooth_factor) {
+            return Err(Error::InvalidSmoothFactor(smooth_factor));
+        }
+
+        let mut re = KalmanRateEstimator {
+            nominal_rate: 0.0,
+            last_level: 0,
+            level_diff: 0,
+            origin: None,
+            last_time: 0.0,
+            processed: 0.0,
+            frames: 0.0,
+            rate: 0.0,
+            cov: [0.0; 4],
+            consecutive_outliers: 0,
+            num_updates: 0,
+            window_start: Duration::ZERO,
+            window_size,
+            smooth_factor,
+            estimated_rate: 0.0,
+        };
+        re.reset_rate(rate);
+        Ok(re)
+    }
+
+    fn measurement_variance(&self) -> f64 {
+        let stddev = self.nominal_rate * MEASUREMENT_STDDEV_SECS;
+        stddev * stddev
+    }
+
+    /// Advances the filter state by `dt` seconds.
+    fn predict(&mut self, dt: f64) {
+        let [p00, p01, p10, p11] = self.cov;
+        let q = RATE_NOISE_DENSITY * RATE_NOISE_DENSITY;
+
+        self.frames += self.rate * dt;
+        self.cov = [
+            p00 + dt * (p01 + p10) + dt * dt * p11 + q * dt * dt * dt / 3.0,
+            p01 + dt * p11 + q * dt * dt / 2.0,
+            p10 + dt * p11 + q * dt * dt / 2.0,
+            p11 + q * dt,
+        ];
+    }
+
+    /// Corrects the filter state with a measurement of the processed frames.
+    /// Returns false if the measurement was rejected as an outlier.
+    fn correct(&mut self, measured: f64) -> bool {
+        let [p00, p01, p10, p11] = self.cov;
+        let r = self.measurement_variance();
+        let innovation = measured - self.frames;
+        let s = p00 + r;
+
+        if innovation * innovation > OUTLIER_GATE_SIGMAS * OUTLIER_GATE_SIGMAS * s {
+            self.consecutive_outliers += 1;
+            if self.consecutive_outliers >= MAX_CONSECUTIVE_OUTLIERS {
+                self.frames = measured;
+                self.cov = [r, 0.0, 0.0, p11];
+                self.consecutive_outliers = 0;
+            }
+            return false;
+        }
+        self.consecutive_outliers = 0;
+
+        let k0 = p00 / s;
+        let k1 = p10 / s;
+        self.frames += k0 * innovation;
+        self.rate += k1 * innovation;
+        self.cov = [
+            (1.0 - k0) * p00,
+            (1.0 - k0) * p01,
+            p10 - k1 * p00,
+            p11 - k1 * p01,
+        ];
+        true
+    }
+}
+
+impl RateEstimator for KalmanRateEstimator {
+    fn reset_rate(&mut self, rate: u32) {
+        self.nominal_rate = rate as f64;
+        self.last_level = 0;
+        self.level_diff = 0;
+        self.origin = None;
+        self.last_time = 0.0;
+        self.processed = 0.0;
+        self.frames = 0.0;
+        self.rate = rate as f64;
+        self.cov = [
+            self.measurement_variance(),
+            0.0,
+            0.0,
+            MAX_RATE_SKEW * MAX_RATE_SKEW,
+        ];
+        self.consecutive_outliers = 0;
+        self.num_updates = 0;
+        self.window_start = Duration::ZERO;
+        self.estimated_rate = rate as f64;
+    }
+
+    fn add_frames(&mut self, frames: i32) -> bool {
+        match self.level_diff.checked_add(frames) {
+            Some(d) => {
+                self.level_diff = d;
+                true
+            }
+            None => {
+                log::error!(
+                    "rate_estimator frames overflow, current_frames={}, additional_frames={}",
+                    self.level_diff,
+                    frames
+                );
+                false
+            }
+        }
+    }
+
+    fn get_estimated_rate(&self) -> f64 {
+        self.estimated_rate
+    }
+
+    fn update_estimated_rate(&mut self, level: i32, now: Duration) -> bool {
+        let origin = match self.origin {
+            None => {
+                self.origin = Some(now);
+                self.window_start = now;
+                self.last_level = level;
+                self.level_diff = 0;
+                return false;
+            }
+            Some(t) => t,
+        };
+
+        let elapsed = match now.checked_sub(origin) {
+            Some(d) => d.as_secs_f64(),
+            None => return false,
+        };
+        let dt = elapsed - self.last_time;
+        if dt <= 0.0 {
+            return false;
+        }
+
+        self.processed += (self.last_level - level + self.level_diff).unsigned_abs() as f64;
+        self.level_diff = 0;
+        self.last_level = level;
+        self.last_time = elapsed;
+
+        self.predict(dt);
+        if self.correct(self.processed) {
+            self.num_updates += 1;
+        }
+
+        let in_window = now
+            .checked_sub(self.window_start)
+            .is_some_and(|d| d <= self.window_size);
+        if in_window || self.num_updates <= 1 {
+            return false;
+        }
+
+        if (self.estimated_rate - self.rate).abs() < MAX_RATE_SKEW {
+            self.estimated_rate =
+                self.rate * (1.0 - self.smooth_factor) + self.estimated_rate * self.smooth_factor;
+        }
+        self.window_start = now;
+        self.num_updates = 0;
+        true
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const WINDOW: Duration = Duration::from_millis(500);
+
+    /// Simulates an output device consuming at `true_rate`, woken every 10ms
+    /// and topped up to 30ms of queued audio. `jitter` is the error of the
+    /// level timestamp of each wake up, in seconds.
+    fn run_output(true_rate: f64, jitter: impl Fn(u32) -> f64) -> KalmanRateEstimator {
+        let mut re = KalmanRateEstimator::try_new(48000, WINDOW, 0.0).unwrap();
+        let mut written: i64 = 960;
+        for i in 0..1000 {
+            let t = i as f64 * 0.01;
+            let consumed = ((t + jitter(i)) * true_rate) as i64;
+            let level = (written - consumed) as i32;
+            re.update_estimated_rate(level, Duration::from_secs_f64(1.0 + t));
+            let to_write = 1440 - level;
+            re.add_frames(to_write);
+            written += to_write as i64;
+        }
+        re
+    }
+
+    #[test]
+    fn invalid_smooth_factor() {
+        assert!(KalmanRateEstimator::try_new(48000, WINDOW, 1.5).is_err());
+    }
+
+    #[test]
+    fn tracks_skewed_rate() {
+        let re = run_output(48010.0, |_| 0.0);
+        assert!((re.get_estimated_rate() - 48010.0).abs() < 0.5);
+    }
+
+    #[test]
+    fn rejects_timestamp_outliers() {
+        // Every 25th wake up reports a level 5ms off.
+        let re = run_output(47995.0, |i| if i % 25 == 7 { 0.005 } else { 0.0 });
+        assert!((re.get_estimated_rate() - 47995.0).abs() < 0.5);
+    }
+
+    #[test]
+    fn first_window_not_reported() {
+        let mut re = KalmanRateEstimator::try_new(48000, WINDOW, 0.0).unwrap();
+        assert!(!re.update_estimated_rate(0, Duration::from_secs(1)));
+        assert!(!re.update_estimated_rate(0, Duration::from_millis(1100)));
+        assert_eq!(re.get_estimated_rate(), 48000.0);
+    }
+
+    #[test]
+    fn reset_restores_nominal_rate() {
+        let mut re = run_output(48020.0, |_| 0.0);
+        re.reset_rate(44100);
+        assert_eq!(re.get_estimated_rate(), 44100.0);
+        assert!(!re.update_estimated_rate(100, Duration::from_secs(30)));
+    }
+}
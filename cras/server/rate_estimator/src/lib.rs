@@ -2,5 +2,11 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+mod kalman_rate_estimator;
 mod rate_estimator;
 pub mod rate_estimator_bindings;
+pub mod replay;
+
+pub use kalman_rate_estimator::KalmanRateEstimator;
+pub use rate_estimator::RateEstimator;
+pub use rate_estimator::RateEstimatorImpl;
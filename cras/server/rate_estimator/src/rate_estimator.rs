@@ -22,27 +22,27 @@ impl fmt::Display for Error {
     }
 }
 
-type Result<T> = std::result::Result<T, Error>;
+pub(crate) type Result<T> = std::result::Result<T, Error>;
 
-const MAX_RATE_SKEW: f64 = 100.0;
+pub(crate) const MAX_RATE_SKEW: f64 = 100.0;
 
 /// Hold information to calculate linear least square from
 /// several (x, y) samples.
 #[derive(Debug, Default)]
-struct LeastSquares {
+pub(crate) struct LeastSquares {
     sum_x: f64,
     sum_y: f64,
     sum_xy: f64,
     sum_x2: f64,
-    num_samples: u32,
+    pub(crate) num_samples: u32,
 }
 
 impl LeastSquares {
-    fn new() -> Self {
+    pub(crate) fn new() -> Self {
         Self::default()
     }
 
-    fn add_sample(&mut self, x: f64, y: f64) {
+    pub(crate) fn add_sample(&mut self, x: f64, y: f64) {
         self.sum_x += x;
         self.sum_y += y;
         self.sum_xy += x * y;
@@ -50,7 +50,7 @@ impl LeastSquares {
         self.num_samples += 1;
     }
 
-    fn best_fit_slope(&self) -> f64 {
+    pub(crate) fn best_fit_slope(&self) -> f64 {
         let num = self.num_samples as f64 * self.sum_xy - self.sum_x * self.sum_y;
         let den = self.num_samples as f64 * self.sum_x2 - self.sum_x * self.sum_x;
         num / den
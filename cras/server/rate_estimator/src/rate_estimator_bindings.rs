@@ -6,6 +6,7 @@ use std::time::Duration;
 
 use libc;
 
+use crate::kalman_rate_estimator::KalmanRateEstimator;
 use crate::rate_estimator::RateEstimator;
 use crate::rate_estimator::RateEstimatorImpl;
 use crate::rate_estimator::RateEstimatorStub;
@@ -37,6 +38,33 @@ pub unsafe extern "C" fn rate_estimator_create(
     }
 }
 
+/// Creates a rate estimator that tracks the device with a Kalman filter and
+/// rejects outlying level measurements. Takes the same arguments as
+/// rate_estimator_create.
+///
+/// # Safety
+///
+/// To use this function safely, `window_size` must be a valid pointer to a
+/// timespec.
+#[no_mangle]
+pub unsafe extern "C" fn rate_estimator_create_robust(
+    rate: libc::c_uint,
+    window_size: *const libc::timespec,
+    smooth_factor: libc::c_double,
+) -> *mut RateEstimatorHandle {
+    if window_size.is_null() {
+        return std::ptr::null_mut::<RateEstimatorHandle>();
+    }
+
+    let ts = &*window_size;
+    let window = Duration::new(ts.tv_sec as u64, ts.tv_nsec as u32);
+
+    match KalmanRateEstimator::try_new(rate, window, smooth_factor) {
+        Ok(re) => Box::into_raw(Box::new(Box::new(re))),
+        Err(_) => std::ptr::null_mut::<RateEstimatorHandle>(),
+    }
+}
+
 /// Create a stub rate estimator for testing.
 #[no_mangle]
 pub extern "C" fn rate_estimator_create_stub() -> *mut RateEstimatorHandle {
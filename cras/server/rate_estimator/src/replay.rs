@@ -0,0 +1,356 @@
+// Copyright 2024 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//! Replays recorded buffer level traces through a rate estimator to compare
+//! estimator implementations offline.
+
+use std::time::Duration;
+
+use crate::rate_estimator::LeastSquares;
+use crate::rate_estimator::RateEstimator;
+
+/// One wake up of the audio thread for a device: the rate estimator is checked
+/// with `level` at `time`, then `frames` are added to it.
+#[derive(Clone, Copy, Debug, PartialEq)]
+pub struct TraceSample {
+    pub time: Duration,
+    pub level: i32,
+    pub frames: i32,
+}
+
+/// Summary of how an estimator behaved over a trace.
+///
+/// # Members
+///    * `reference_rate` - Average rate of the device over the whole trace.
+///    * `num_updates` - Number of times the estimated rate was refreshed.
+///    * `convergence_time` - Time from the start of the trace after which the
+///                           estimated rate stayed within tolerance of
+///                           `reference_rate`, None if it never settled.
+///    * `final_rate` - Estimated rate at the end of the trace.
+///    * `ratio_mean` - Mean of estimated rate / nominal rate, after
+///                     convergence if the estimator converged.
+///    * `ratio_variance` - Variance of the same ratio.
+#[derive(Debug)]
+pub struct ReplayReport {
+    pub reference_rate: f64,
+    pub num_updates: usize,
+    pub convergence_time: Option<Duration>,
+    pub final_rate: f64,
+    pub ratio_mean: f64,
+    pub ratio_variance: f64,
+}
+
+/// Computes the average rate at which the device processed frames in `trace`
+/// as the least squares slope of processed frames over the whole trace, using
+/// the same level accounting as the estimators.
+fn reference_rate(trace: &[TraceSample]) -> f64 {
+    let start = match trace.first() {
+        Some(s) => s.time,
+        None => return 0.0,
+    };
+    let mut lsq = LeastSquares::new();
+    let mut processed = 0.0;
+    lsq.add_sample(0.0, 0.0);
+    for w in trace.windows(2) {
+        processed += (w[0].level - w[1].level + w[0].frames).unsigned_abs() as f64;
+        lsq.add_sample(w[1].time.saturating_sub(start).as_secs_f64(), processed);
+    }
+    if lsq.num_samples < 2 {
+        return 0.0;
+    }
+    lsq.best_fit_slope()
+}
+
+/// Feeds `trace` through `re`, which must have been created with
+/// `nominal_rate`, and reports how quickly and how steadily it converged.
+/// The estimator is considered converged once every later estimate is
+/// within `tolerance` Hz of the reference rate.
+pub fn replay(
+    re: &mut dyn RateEstimator,
+    nominal_rate: u32,
+    trace: &[TraceSample],
+    tolerance: f64,
+) -> ReplayReport {
+    let reference = reference_rate(trace);
+    let start = trace.first().map(|s| s.time).unwrap_or_default();
+    let mut updates: Vec<(Duration, f64)> = Vec::new();
+
+    re.reset_rate(nominal_rate);
+    for sample in trace {
+        if re.update_estimated_rate(sample.level, sample.time) {
+            updates.push((sample.time.saturating_sub(start), re.get_estimated_rate()));
+        }
+        re.add_frames(sample.frames);
+    }
+
+    let settled = updates
+        .iter()
+        .rposition(|(_, rate)| (rate - reference).abs() > tolerance)
+        .map_or(0, |i| i + 1);
+    let convergence_time = updates.get(settled).map(|(t, _)| *t);
+    let stable = if convergence_time.is_some() {
+        &updates[settled..]
+    } else {
+        &updates[..]
+    };
+
+    let ratios: Vec<f64> = stable
+        .iter()
+        .map(|(_, rate)| rate / nominal_rate as f64)
+        .collect();
+    let (ratio_mean, ratio_variance) = if ratios.is_empty() {
+        (1.0, 0.0)
+    } else {
+        let n = ratios.len() as f64;
+        let mean = ratios.iter().sum::<f64>() / n;
+        let var = ratios.iter().map(|r| (r - mean) * (r - mean)).sum::<f64>() / n;
+        (mean, var)
+    };
+
+    ReplayReport {
+        reference_rate: reference,
+        num_updates: updates.len(),
+        convergence_time,
+        final_rate: re.get_estimated_rate(),
+        ratio_mean,
+        ratio_variance,
+    }
+}
+
+/// Returns the value of a `key:value` token in `line`.
+fn field<'a>(line: &'a str, key: &str) -> Option<&'a str> {
+    line.split_whitespace()
+        .find_map(|tok| tok.strip_prefix(key)?.strip_prefix(':'))
+}
+
+/// Parses the `tstamp: HH:MM:SS.nnnnnnnnn` printed by
+/// `cras_test_client --dump_audio_thread`.
+fn parse_tstamp(line: &str) -> Option<Duration> {
+    let (_, rest) = line.split_once("tstamp:")?;
+    let tok = rest.split_whitespace().next()?;
+    let (hms, nsec) = tok.split_once('.')?;
+    let mut secs = 0u64;
+    for part in hms.split(':') {
+        secs = secs * 60 + part.parse::<u64>().ok()?;
+    }
+    Some(Duration::new(secs, nsec.parse().ok()?))
+}
+
+/// Appends `sample`, read from line `lineno` of the input, to `trace` unless it
+/// is older than the last sample, which would make time run backwards.
+fn push_sample(trace: &mut Vec<TraceSample>, sample: TraceSample, lineno: usize) {
+    if let Some(last) = trace.last() {
+        if sample.time < last.time {
+            log::warn!(
+                "line {}: skipping sample at {:?}, before the previous sample at {:?}",
+                lineno,
+                sample.time,
+                last.time
+            );
+            return;
+        }
+    }
+    trace.push(sample);
+}
+
+/// Parses a trace in either of two formats:
+///
+/// * One sample per line: `<seconds> <level> <frames>`, where `frames` is
+///   negative for capture.
+/// * The audio thread log printed by `cras_test_client --dump_audio_thread`.
+///   Playback samples are built from the FILL_AUDIO_TSTAMP, FILL_AUDIO and
+///   FILL_AUDIO_DONE events of device `dev`, or of the first device seen if
+///   `dev` is None.
+///
+/// Lines matching neither format are ignored. Samples whose timestamp is
+/// before the previous sample are logged and dropped.
+pub fn parse_trace(input: &str, dev: Option<u32>) -> Vec<TraceSample> {
+    let mut trace = Vec::new();
+    let mut dev = dev;
+    let mut tstamp: Option<Duration> = None;
+    let mut pending: Option<(Duration, i32)> = None;
+    // Dump timestamps only carry the time of day.
+    let mut day_offset = Duration::ZERO;
+    let mut last_time = Duration::ZERO;
+
+    for (i, line) in input.lines().enumerate() {
+        let toks: Vec<&str> = line.split_whitespace().collect();
+        if let [t, level, frames] = toks[..] {
+            if let (Ok(t), Ok(level), Ok(frames)) =
+                (t.parse::<f64>(), level.parse(), frames.parse())
+            {
+                let sample = TraceSample {
+                    time: Duration::from_secs_f64(t),
+                    level,
+                    frames,
+                };
+                push_sample(&mut trace, sample, i + 1);
+                continue;
+            }
+        }
+
+        let Some(tag) = toks.iter().find(|t| t.starts_with("FILL_AUDIO")) else {
+            continue;
+        };
+        let line_dev = field(line, "dev").and_then(|d| d.parse::<u32>().ok());
+        match *tag {
+            "FILL_AUDIO_TSTAMP" => {
+                if dev.is_none() {
+                    dev = line_dev;
+                }
+                tstamp = if line_dev == dev {
+                    parse_tstamp(line)
+                } else {
+                    None
+                };
+            }
+            "FILL_AUDIO" => {
+                pending = None;
+                if line_dev != dev {
+                    continue;
+                }
+                let (Some(mut t), Some(level)) = (
+                    tstamp.take(),
+                    field(line, "hw_level").and_then(|l| l.parse().ok()),
+                ) else {
+                    continue;
+                };
+                t += day_offset;
+                if t + Duration::from_secs(12 * 3600) < last_time {
+                    day_offset += Duration::from_secs(24 * 3600);
+                    t += Duration::from_secs(24 * 3600);
+                }
+                last_time = t;
+                pending = Some((t, level));
+            }
+            "FILL_AUDIO_DONE" => {
+                let Some((time, level)) = pending.take() else {
+                    continue;
+                };
+                let frames = field(line, "total_written")
+                    .and_then(|f| f.parse().ok())
+                    .unwrap_or(0);
+                let sample = TraceSample {
+                    time,
+                    level,
+                    frames,
+                };
+                push_sample(&mut trace, sample, i + 1);
+            }
+            _ => {}
+        }
+    }
+    trace
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::kalman_rate_estimator::KalmanRateEstimator;
+    use crate::rate_estimator::RateEstimatorImpl;
+
+    const WINDOW: Duration = Duration::from_secs(1);
+
+    /// A playback trace of a device running at `rate`, woken every 10ms.
+    fn synthetic_trace(rate: f64, seconds: u32) -> Vec<TraceSample> {
+        let mut written: i64 = 960;
+        (0..seconds * 100)
+            .map(|i| {
+                let t = i as f64 * 0.01;
+                let level = (written - (t * rate) as i64) as i32;
+                let frames = 1440 - level;
+                written += frames as i64;
+                TraceSample {
+                    time: Duration::from_secs_f64(1.0 + t),
+                    level,
+                    frames,
+                }
+            })
+            .collect()
+    }
+
+    #[test]
+    fn parse_plain_trace() {
+        let trace = parse_trace("1.5 480 240\n# comment\n1.51 -20 -480\n", None);
+        assert_eq!(
+            trace,
+            vec![
+                TraceSample {
+                    time: Duration::from_millis(1500),
+                    level: 480,
+                    frames: 240
+                },
+                TraceSample {
+                    time: Duration::from_millis(1510),
+                    level: -20,
+                    frames: -480
+                },
+            ]
+        );
+    }
+
+    #[test]
+    fn parse_drops_samples_going_backwards() {
+        let trace = parse_trace("1.5 480 240\n1.4 460 240\n1.51 -20 -480\n", None);
+        assert_eq!(trace.len(), 2);
+        assert_eq!(trace[0].time, Duration::from_millis(1500));
+        assert_eq!(trace[1].time, Duration::from_millis(1510));
+    }
+
+    #[test]
+    fn parse_audio_thread_dump() {
+        let dump = "\
+2024-01-01T10:00:00.000000000 cras atlog  FILL_AUDIO_TSTAMP              dev:7 tstamp: 10:00:00.010000000
+2024-01-01T10:00:00.000000000 cras atlog  FILL_AUDIO                     dev:7 hw_level:900 min_cb_level:480
+2024-01-01T10:00:00.000000000 cras atlog  FILL_AUDIO_DONE                hw_level:1440 total_written:540 power:-90.0 dBFS
+2024-01-01T10:00:00.000000000 cras atlog  FILL_AUDIO_TSTAMP              dev:8 tstamp: 10:00:00.012000000
+2024-01-01T10:00:00.000000000 cras atlog  FILL_AUDIO                     dev:8 hw_level:100 min_cb_level:480
+2024-01-01T10:00:00.000000000 cras atlog  FILL_AUDIO_DONE                hw_level:480 total_written:380 power:-90.0 dBFS
+";
+        let trace = parse_trace(dump, None);
+        assert_eq!(
+            trace,
+            vec![TraceSample {
+                time: Duration::new(36000, 10_000_000),
+                level: 900,
+                frames: 540
+            }]
+        );
+        assert_eq!(parse_trace(dump, Some(8))[0].level, 100);
+    }
+
+    #[test]
+    fn replay_reports_convergence() {
+        let trace = synthetic_trace(48012.0, 30);
+        let mut lsq = RateEstimatorImpl::try_new(48000, WINDOW, 0.3).unwrap();
+        let mut kalman = KalmanRateEstimator::try_new(48000, WINDOW, 0.3).unwrap();
+
+        for re in [&mut lsq as &mut dyn RateEstimator, &mut kalman] {
+            let report = replay(re, 48000, &trace, 1.0);
+            assert!((report.reference_rate - 48012.0).abs() < 0.1);
+            assert!(report.num_updates > 20);
+            assert!(report.convergence_time.unwrap() < Duration::from_secs(15));
+            assert!((report.final_rate - 48012.0).abs() < 1.0);
+            assert!(report.ratio_variance < 1e-9);
+        }
+    }
+
+    #[test]
+    fn replay_non_monotonic_trace() {
+        let mut trace = synthetic_trace(48000.0, 5);
+        trace.swap(0, 1);
+        let mut re = KalmanRateEstimator::try_new(48000, WINDOW, 0.3).unwrap();
+        let report = replay(&mut re, 48000, &trace, 1.0);
+        assert!(report.num_updates > 0);
+    }
+
+    #[test]
+    fn replay_empty_trace() {
+        let mut re = KalmanRateEstimator::try_new(48000, WINDOW, 0.3).unwrap();
+        let report = replay(&mut re, 48000, &[], 1.0);
+        assert_eq!(report.num_updates, 0);
+        assert_eq!(report.convergence_time, None);
+        assert_eq!(report.final_rate, 48000.0);
+    }
+}
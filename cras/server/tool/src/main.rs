@@ -2,10 +2,18 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+use std::path::PathBuf;
+use std::time::Duration;
+
 use clap::Args;
 use clap::Parser;
 use cras_dlc::download_dlcs_until_installed;
 use cras_dlc::CrasDlcId128;
+use cras_rate_estimator::replay::parse_trace;
+use cras_rate_estimator::replay::replay;
+use cras_rate_estimator::KalmanRateEstimator;
+use cras_rate_estimator::RateEstimator;
+use cras_rate_estimator::RateEstimatorImpl;
 use cras_s2::global::cras_s2_init;
 use cras_s2::S2;
 #[derive(Parser)]
@@ -16,6 +24,9 @@ enum Cli {
 
     /// Install all CRAS managed DLCs.
     InstallDlcs(InstallDlcsCommand),
+
+    /// Replay a recorded buffer level trace through the rate estimators.
+    ReplayRateEstimator(ReplayRateEstimatorCommand),
 }
 
 trait Command {
@@ -27,6 +38,7 @@ impl Command for Cli {
         match self {
             Cli::LabelAudioBeamforming(c) => c.run(),
             Cli::InstallDlcs(c) => c.run(),
+            Cli::ReplayRateEstimator(c) => c.run(),
         }
     }
 }
@@ -54,6 +66,75 @@ impl Command for InstallDlcsCommand {
     }
 }
 
+#[derive(Args)]
+struct ReplayRateEstimatorCommand {
+    /// Trace file: `<seconds> <level> <frames>` lines, or the output of
+    /// `cras_test_client --dump_audio_thread`.
+    trace: PathBuf,
+
+    /// Nominal rate of the device.
+    #[arg(long, default_value_t = 48000)]
+    rate: u32,
+
+    /// Device index to take from an audio thread dump.
+    #[arg(long)]
+    dev: Option<u32>,
+
+    /// Estimation window in seconds.
+    #[arg(long, default_value_t = 5.0)]
+    window: f64,
+
+    /// Smooth factor passed to the estimators.
+    #[arg(long, default_value_t = 0.3)]
+    smooth_factor: f64,
+
+    /// Distance to the reference rate, in Hz, counted as converged.
+    #[arg(long, default_value_t = 1.0)]
+    tolerance: f64,
+}
+
+impl Command for ReplayRateEstimatorCommand {
+    fn run(self) -> anyhow::Result<()> {
+        let trace = parse_trace(&std::fs::read_to_string(&self.trace)?, self.dev);
+        anyhow::ensure!(trace.len() > 1, "no samples found in {:?}", self.trace);
+        let window = Duration::from_secs_f64(self.window);
+
+        let estimators: [(&str, Box<dyn RateEstimator>); 2] = [
+            (
+                "least_squares",
+                Box::new(RateEstimatorImpl::try_new(
+                    self.rate,
+                    window,
+                    self.smooth_factor,
+                )?),
+            ),
+            (
+                "robust",
+                Box::new(KalmanRateEstimator::try_new(
+                    self.rate,
+                    window,
+                    self.smooth_factor,
+                )?),
+            ),
+        ];
+        println!("samples: {}", trace.len());
+        for (name, mut re) in estimators {
+            let report = replay(re.as_mut(), self.rate, &trace, self.tolerance);
+            println!("{name}:");
+            println!("  reference_rate: {:.3}", report.reference_rate);
+            println!("  final_rate: {:.3}", report.final_rate);
+            println!("  updates: {}", report.num_updates);
+            match report.convergence_time {
+                Some(t) => println!("  convergence_time: {:.3}s", t.as_secs_f64()),
+                None => println!("  convergence_time: not converged"),
+            }
+            println!("  ratio_mean: {:.9}", report.ratio_mean);
+            println!("  ratio_variance: {:e}", report.ratio_variance);
+        }
+        Ok(())
+    }
+}
+
 extern "C" fn dlc_no_op_callback(_id: CrasDlcId128, _elapsed_seconds: i32) -> libc::c_int {
     0
 }
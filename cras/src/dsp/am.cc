@@ -10,6 +10,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <syslog.h>
+#include <tensorflow/lite/delegates/xnnpack/xnnpack_delegate.h>
 #include <tensorflow/lite/interpreter.h>
 #include <tensorflow/lite/kernels/register.h>
 #include <tensorflow/lite/model.h>
@@ -22,6 +23,8 @@ struct am_context {
   std::unique_ptr<tflite::FlatBufferModel> model;
   // the tflite interpreter.
   std::unique_ptr<tflite::Interpreter> interpreter;
+  // the XNNPACK delegate, must outlive the interpreter. NULL if not used.
+  TfLiteDelegate* xnnpack_delegate;
 };
 
 static inline const char* get_tflite_error_string(const TfLiteStatus status) {
@@ -54,6 +57,16 @@ static inline struct am_context* am_new_failed(struct am_context* am_context) {
 }
 
 struct am_context* am_new(const char* model_path) {
+  return am_new_with_options(model_path, 1, false);
+}
+
+struct am_context* am_new_with_options(const char* model_path,
+                                       size_t num_threads,
+                                       bool use_xnnpack) {
+  if (num_threads == 0) {
+    num_threads = 1;
+  }
+
   struct am_context* am_context =
       static_cast<struct am_context*>(calloc(1, sizeof(*am_context)));
   if (!am_context) {
@@ -67,7 +80,9 @@ struct am_context* am_new(const char* model_path) {
     return am_new_failed(am_context);
   }
 
-  tflite::ops::builtin::BuiltinOpResolver resolver;
+  // The delegate is applied explicitly below, so that it is only used when
+  // asked for and with the requested number of threads.
+  tflite::ops::builtin::BuiltinOpResolverWithoutDefaultDelegates resolver;
   tflite::InterpreterBuilder builder(*am_context->model, resolver);
   if (const TfLiteStatus status = builder(&am_context->interpreter);
       status != kTfLiteOk) {
@@ -75,7 +90,28 @@ struct am_context* am_new(const char* model_path) {
            get_tflite_error_string(status));
     return am_new_failed(am_context);
   }
-  am_context->interpreter->SetNumThreads(1);
+  am_context->interpreter->SetNumThreads(num_threads);
+
+  if (use_xnnpack) {
+    TfLiteXNNPackDelegateOptions options =
+        TfLiteXNNPackDelegateOptionsDefault();
+    options.num_threads = num_threads;
+    am_context->xnnpack_delegate = TfLiteXNNPackDelegateCreate(&options);
+    if (!am_context->xnnpack_delegate) {
+      syslog(LOG_WARNING, "TfLiteXNNPackDelegateCreate got NULL.");
+    } else if (const TfLiteStatus status =
+                   am_context->interpreter->ModifyGraphWithDelegate(
+                       am_context->xnnpack_delegate);
+               status == kTfLiteDelegateError) {
+      // The interpreter is restored to use the builtin kernels.
+      syslog(LOG_WARNING, "ModifyGraphWithDelegate got not ok status: %s.",
+             get_tflite_error_string(status));
+    } else if (status != kTfLiteOk) {
+      syslog(LOG_ERR, "ModifyGraphWithDelegate got not ok status: %s.",
+             get_tflite_error_string(status));
+      return am_new_failed(am_context);
+    }
+  }
 
   if (const TfLiteStatus status = am_context->interpreter->AllocateTensors();
       status != kTfLiteOk) {
@@ -91,6 +127,9 @@ void am_free(struct am_context* am_context) {
   if (am_context) {
     am_context->interpreter.reset(nullptr);
     am_context->model.reset(nullptr);
+    if (am_context->xnnpack_delegate) {
+      TfLiteXNNPackDelegateDelete(am_context->xnnpack_delegate);
+    }
     free(am_context);
   }
 }
@@ -6,6 +6,7 @@
 #ifndef CRAS_SRC_DSP_AM_H_
 #define CRAS_SRC_DSP_AM_H_
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -19,6 +20,18 @@ struct am_context;
 // Creates an am context.
 struct am_context* am_new(const char* model_path);
 
+/* Creates an am context with the given interpreter options.
+ *
+ * Args:
+ *    model_path - The path to the tflite model.
+ *    num_threads - The number of threads used by the interpreter, 0 for 1.
+ *    use_xnnpack - Whether to run the supported ops with the XNNPACK delegate.
+ *      Falls back to the builtin kernels if the delegate cannot be applied.
+ */
+struct am_context* am_new_with_options(const char* model_path,
+                                       size_t num_threads,
+                                       bool use_xnnpack);
+
 // Frees the am context.
 void am_free(struct am_context* am_context);
 
@@ -600,6 +600,56 @@ int dsp_util_interleave(float* const* input,
   return 0;
 }
 
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+
+void dsp_util_scale_clamp(const float* input,
+                          float* output,
+                          float gain,
+                          int frames) {
+  const float32x4_t lo = vdupq_n_f32(-1.0f);
+  const float32x4_t hi = vdupq_n_f32(1.0f);
+  // Process 4 samples each loop.
+  for (; frames >= 4; frames -= 4, input += 4, output += 4) {
+    float32x4_t x = vmulq_n_f32(vld1q_f32(input), gain);
+    vst1q_f32(output, vminq_f32(vmaxq_f32(x, lo), hi));
+  }
+  for (; frames > 0; frames--) {
+    *output++ = max(-1.0f, min(1.0f, *input++ * gain));
+  }
+}
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+
+void dsp_util_scale_clamp(const float* input,
+                          float* output,
+                          float gain,
+                          int frames) {
+  const __m128 g = _mm_set1_ps(gain);
+  const __m128 lo = _mm_set1_ps(-1.0f);
+  const __m128 hi = _mm_set1_ps(1.0f);
+  /* Process 4 samples each loop. minps and maxps return the second operand
+   * when either is NaN, so keep the sample second to pass NaN through like
+   * the scalar path does. */
+  for (; frames >= 4; frames -= 4, input += 4, output += 4) {
+    __m128 x = _mm_mul_ps(_mm_loadu_ps(input), g);
+    _mm_storeu_ps(output, _mm_min_ps(hi, _mm_max_ps(lo, x)));
+  }
+  for (; frames > 0; frames--) {
+    *output++ = max(-1.0f, min(1.0f, *input++ * gain));
+  }
+}
+#else
+void dsp_util_scale_clamp(const float* input,
+                          float* output,
+                          float gain,
+                          int frames) {
+  for (; frames > 0; frames--) {
+    *output++ = max(-1.0f, min(1.0f, *input++ * gain));
+  }
+}
+#endif
+
 void dsp_enable_flush_denormal_to_zero() {
 #if defined(__i386__) || defined(__x86_64__)
   unsigned int mxcsr;
@@ -49,6 +49,18 @@ int dsp_util_interleave(float* const* input,
                         snd_pcm_format_t format,
                         int frames);
 
+/* Multiplies float samples by a gain and clamps them to [-1.0, 1.0].
+ * Args:
+ *    input - The samples to scale.
+ *    output - The buffer for the scaled samples, can be the same as |input|.
+ *    gain - The gain to apply.
+ *    frames - The number of samples to scale.
+ */
+void dsp_util_scale_clamp(const float* input,
+                          float* output,
+                          float gain,
+                          int frames);
+
 /* Disables denormal numbers in floating point calculation. Denormal numbers
  * happens often in IIR filters, and it can be very slow.
  */
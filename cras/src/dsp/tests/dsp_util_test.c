@@ -163,9 +163,77 @@ void TestRounding(float in, int16_t expected, int samples) {
   free(out_shorts_opt);
 }
 
+void dsp_util_scale_clamp_reference(const float* input,
+                                    float* output,
+                                    float gain,
+                                    int frames) {
+  int i;
+
+  for (i = 0; i < frames; i++) {
+    float f = input[i] * gain;
+    output[i] = f < -1 ? -1 : (f > 1 ? 1 : f);
+  }
+}
+
+// Returns 1 if |a| and |b| differ, counting any two NaNs as equal.
+static int compare_samples(const float* a, const float* b, int samples) {
+  for (int i = 0; i < samples; i++) {
+    if (a[i] != b[i] && !(isnan(a[i]) && isnan(b[i]))) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Returns 1 if dsp_util_scale_clamp does not match the reference.
+int TestScaleClamp(float gain, int samples) {
+  uint64_t diff_c, diff_opt;
+  struct timespec start, end;
+  float* in = (float*)malloc(MAXSAMPLES * 4);
+  float* out_c = (float*)malloc(MAXSAMPLES * 4);
+  float* out_opt = (float*)malloc(MAXSAMPLES * 4);
+  int i, fail;
+
+  for (i = 0; i < samples; i++) {
+    in[i] = (i % 64 - 32) / 16.0f;
+  }
+  // Put a NaN in both the SIMD and the scalar part of the input.
+  in[0] = NAN;
+  in[samples - 1] = NAN;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < ITERATIONS; ++i) {
+    dsp_util_scale_clamp_reference(in, out_c, gain, samples);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  diff_c = (BILLION * (end.tv_sec - start.tv_sec) + end.tv_nsec -
+            start.tv_nsec) /
+           1000000;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < ITERATIONS; ++i) {
+    dsp_util_scale_clamp(in, out_opt, gain, samples);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  diff_opt = (BILLION * (end.tv_sec - start.tv_sec) + end.tv_nsec -
+              start.tv_nsec) /
+             1000000;
+
+  fail = compare_samples(out_c, out_opt, samples);
+  printf("scale_clamp  gain = %f size = %6d, ORIG %llu ms SIMD %llu ms %s\n",
+         gain, samples, (long long unsigned int)diff_c,
+         (long long unsigned int)diff_opt, fail ? "FAIL" : "PASS");
+
+  free(in);
+  free(out_c);
+  free(out_opt);
+  return fail;
+}
+
 int main(int argc, char** argv) {
   float e = 0.000000001f;
   int samples = 16;
+  int failed = 0;
 
   dsp_enable_flush_denormal_to_zero();
 
@@ -268,6 +336,11 @@ int main(int argc, char** argv) {
   nan.ieee.mantissa = 0x000001;  // Signalling NaN
   TestRounding(nan.f, EXPECTED_NAN_RESULT, samples);
 
+  // Test gain and clamp, including sizes not a multiple of the SIMD width.
+  failed |= TestScaleClamp(1.0f, 480);
+  failed |= TestScaleClamp(0.5f, 481);
+  failed |= TestScaleClamp(3.0f, 3);
+
   // Test Performance
   uint64_t diff;
   struct timespec start, end;
@@ -383,5 +456,5 @@ int main(int argc, char** argv) {
   free(out_shorts_c);
   free(out_shorts_opt);
 
-  return 0;
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
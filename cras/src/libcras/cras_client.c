@@ -1543,31 +1543,69 @@ static int start_aud_thread(struct client_stream* stream) {
  * Client thread.
  */
 
-// Gets the update_count of the server state shm region.
-static inline unsigned begin_server_state_read(
-    const struct cras_server_state* state) {
+/* Waits for an update count in the server state shm region to be even and
+ * returns it.
+ */
+static inline unsigned begin_update_count_read(const uint32_t* update_count) {
   unsigned count;
 
   // Version will be odd when the server is writing.
-  while ((count = *(volatile unsigned*)&state->update_count) & 1) {
+  while ((count = *(volatile const unsigned*)update_count) & 1) {
     sched_yield();
   }
   __sync_synchronize();
   return count;
 }
 
-/* Checks if the update count of the server state shm region has changed from
+/* Checks if an update count in the server state shm region has changed from
  * count.  Returns 0 if the count still matches.
  */
-static inline int end_server_state_read(const struct cras_server_state* state,
+static inline int end_update_count_read(const uint32_t* update_count,
                                         unsigned count) {
   __sync_synchronize();
-  if (count != *(volatile unsigned*)&state->update_count) {
+  if (count != *(volatile const unsigned*)update_count) {
     return -EAGAIN;
   }
   return 0;
 }
 
+// Gets the update_count of the server state shm region.
+static inline unsigned begin_server_state_read(
+    const struct cras_server_state* state) {
+  return begin_update_count_read(&state->update_count);
+}
+
+/* Checks if the update count of the server state shm region has changed from
+ * count.  Returns 0 if the count still matches.
+ */
+static inline int end_server_state_read(const struct cras_server_state* state,
+                                        unsigned count) {
+  return end_update_count_read(&state->update_count, count);
+}
+
+/* Returns true if the server maintains the section update counts and the
+ * extension tables of the server state. Older servers don't, and only
+ * update_count and the fixed tables may be read.
+ */
+static inline bool server_state_has_sections(
+    const struct cras_server_state* state) {
+  return state->sections_magic == CRAS_SERVER_STATE_SECTIONS_MAGIC;
+}
+
+// Returns the update count guarding the device and node lists.
+static inline const uint32_t* dev_list_update_count(
+    const struct cras_server_state* state) {
+  return server_state_has_sections(state) ? &state->dev_list_update_count
+                                          : &state->update_count;
+}
+
+// Returns the update count guarding the attached client list.
+static inline const uint32_t* client_list_update_count(
+    const struct cras_server_state* state) {
+  return server_state_has_sections(state) ? &state->client_list_update_count
+                                          : &state->update_count;
+}
+
 // Release shm areas if references to them are held.
 static void free_shm(struct client_stream* stream) {
   cras_audio_shm_destroy(stream->shm);
@@ -1914,6 +1952,135 @@ static void cras_client_get_dsp_offload_info_ready(
   client->get_dsp_offload_info_cb = NULL;
 }
 
+// Passes a system status message from the server to the observer ops.
+static void handle_notification_from_server(
+    struct cras_client* client,
+    const struct cras_client_message* msg) {
+  switch (msg->id) {
+    case CRAS_CLIENT_OUTPUT_VOLUME_CHANGED: {
+      const struct cras_client_volume_changed* cmsg =
+          (const struct cras_client_volume_changed*)msg;
+      if (client->observer_ops.output_volume_changed) {
+        client->observer_ops.output_volume_changed(client->observer_context,
+                                                   cmsg->volume);
+      }
+      break;
+    }
+    case CRAS_CLIENT_OUTPUT_MUTE_CHANGED: {
+      const struct cras_client_mute_changed* cmsg =
+          (const struct cras_client_mute_changed*)msg;
+      if (client->observer_ops.output_mute_changed) {
+        client->observer_ops.output_mute_changed(client->observer_context,
+                                                 cmsg->muted, cmsg->user_muted,
+                                                 cmsg->mute_locked);
+      }
+      break;
+    }
+    case CRAS_CLIENT_CAPTURE_GAIN_CHANGED: {
+      const struct cras_client_volume_changed* cmsg =
+          (const struct cras_client_volume_changed*)msg;
+      if (client->observer_ops.capture_gain_changed) {
+        client->observer_ops.capture_gain_changed(client->observer_context,
+                                                  cmsg->volume);
+      }
+      break;
+    }
+    case CRAS_CLIENT_CAPTURE_MUTE_CHANGED: {
+      const struct cras_client_mute_changed* cmsg =
+          (const struct cras_client_mute_changed*)msg;
+      if (client->observer_ops.capture_mute_changed) {
+        client->observer_ops.capture_mute_changed(
+            client->observer_context, cmsg->muted, cmsg->mute_locked);
+      }
+      break;
+    }
+    case CRAS_CLIENT_NODES_CHANGED: {
+      if (client->observer_ops.nodes_changed) {
+        client->observer_ops.nodes_changed(client->observer_context);
+      }
+      break;
+    }
+    case CRAS_CLIENT_ACTIVE_NODE_CHANGED: {
+      const struct cras_client_active_node_changed* cmsg =
+          (const struct cras_client_active_node_changed*)msg;
+      enum CRAS_STREAM_DIRECTION direction =
+          (enum CRAS_STREAM_DIRECTION)cmsg->direction;
+      if (client->observer_ops.active_node_changed) {
+        client->observer_ops.active_node_changed(client->observer_context,
+                                                 direction, cmsg->node_id);
+      }
+      break;
+    }
+    case CRAS_CLIENT_OUTPUT_NODE_VOLUME_CHANGED: {
+      const struct cras_client_node_value_changed* cmsg =
+          (const struct cras_client_node_value_changed*)msg;
+      if (client->observer_ops.output_node_volume_changed) {
+        client->observer_ops.output_node_volume_changed(
+            client->observer_context, cmsg->node_id, cmsg->value);
+      }
+      break;
+    }
+    case CRAS_CLIENT_NODE_LEFT_RIGHT_SWAPPED_CHANGED: {
+      const struct cras_client_node_value_changed* cmsg =
+          (const struct cras_client_node_value_changed*)msg;
+      if (client->observer_ops.node_left_right_swapped_changed) {
+        client->observer_ops.node_left_right_swapped_changed(
+            client->observer_context, cmsg->node_id, cmsg->value);
+      }
+      break;
+    }
+    case CRAS_CLIENT_INPUT_NODE_GAIN_CHANGED: {
+      const struct cras_client_node_value_changed* cmsg =
+          (const struct cras_client_node_value_changed*)msg;
+      if (client->observer_ops.input_node_gain_changed) {
+        client->observer_ops.input_node_gain_changed(
+            client->observer_context, cmsg->node_id, cmsg->value);
+      }
+      break;
+    }
+    case CRAS_CLIENT_NUM_ACTIVE_STREAMS_CHANGED: {
+      const struct cras_client_num_active_streams_changed* cmsg =
+          (const struct cras_client_num_active_streams_changed*)msg;
+      enum CRAS_STREAM_DIRECTION direction =
+          (enum CRAS_STREAM_DIRECTION)cmsg->direction;
+      if (client->observer_ops.num_active_streams_changed) {
+        client->observer_ops.num_active_streams_changed(
+            client->observer_context, direction, cmsg->num_active_streams);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+/* Handles each of the notifications packed in |msg|. Returns -EIO if they do
+ * not fill the batch exactly.
+ */
+static int handle_notification_batch(
+    struct cras_client* client,
+    const struct cras_client_message* msg) {
+  const uint8_t* buf = (const uint8_t*)msg + sizeof(*msg);
+  const struct cras_client_message* sub;
+  uint32_t left;
+
+  if (msg->length < sizeof(*msg)) {
+    return -EIO;
+  }
+  left = msg->length - sizeof(*msg);
+  while (left) {
+    sub = (const struct cras_client_message*)buf;
+    if (left < sizeof(*sub) || sub->length < sizeof(*sub) ||
+        sub->length > left) {
+      return -EIO;
+    }
+    handle_notification_from_server(client, sub);
+    buf += sub->length;
+    left -= sub->length;
+  }
+  return 0;
+}
+
 // Handles messages from the cras server.
 static int handle_message_from_server(struct cras_client* client) {
   uint8_t buf[CRAS_CLIENT_MAX_MSG_SIZE];
@@ -2009,99 +2176,10 @@ static int handle_message_from_server(struct cras_client* client) {
                                              cmsg->infos);
       break;
     }
-    case CRAS_CLIENT_OUTPUT_VOLUME_CHANGED: {
-      struct cras_client_volume_changed* cmsg =
-          (struct cras_client_volume_changed*)msg;
-      if (client->observer_ops.output_volume_changed) {
-        client->observer_ops.output_volume_changed(client->observer_context,
-                                                   cmsg->volume);
-      }
-      break;
-    }
-    case CRAS_CLIENT_OUTPUT_MUTE_CHANGED: {
-      struct cras_client_mute_changed* cmsg =
-          (struct cras_client_mute_changed*)msg;
-      if (client->observer_ops.output_mute_changed) {
-        client->observer_ops.output_mute_changed(client->observer_context,
-                                                 cmsg->muted, cmsg->user_muted,
-                                                 cmsg->mute_locked);
-      }
-      break;
-    }
-    case CRAS_CLIENT_CAPTURE_GAIN_CHANGED: {
-      struct cras_client_volume_changed* cmsg =
-          (struct cras_client_volume_changed*)msg;
-      if (client->observer_ops.capture_gain_changed) {
-        client->observer_ops.capture_gain_changed(client->observer_context,
-                                                  cmsg->volume);
-      }
-      break;
-    }
-    case CRAS_CLIENT_CAPTURE_MUTE_CHANGED: {
-      struct cras_client_mute_changed* cmsg =
-          (struct cras_client_mute_changed*)msg;
-      if (client->observer_ops.capture_mute_changed) {
-        client->observer_ops.capture_mute_changed(
-            client->observer_context, cmsg->muted, cmsg->mute_locked);
-      }
-      break;
-    }
-    case CRAS_CLIENT_NODES_CHANGED: {
-      if (client->observer_ops.nodes_changed) {
-        client->observer_ops.nodes_changed(client->observer_context);
-      }
-      break;
-    }
-    case CRAS_CLIENT_ACTIVE_NODE_CHANGED: {
-      struct cras_client_active_node_changed* cmsg =
-          (struct cras_client_active_node_changed*)msg;
-      enum CRAS_STREAM_DIRECTION direction =
-          (enum CRAS_STREAM_DIRECTION)cmsg->direction;
-      if (client->observer_ops.active_node_changed) {
-        client->observer_ops.active_node_changed(client->observer_context,
-                                                 direction, cmsg->node_id);
-      }
-      break;
-    }
-    case CRAS_CLIENT_OUTPUT_NODE_VOLUME_CHANGED: {
-      struct cras_client_node_value_changed* cmsg =
-          (struct cras_client_node_value_changed*)msg;
-      if (client->observer_ops.output_node_volume_changed) {
-        client->observer_ops.output_node_volume_changed(
-            client->observer_context, cmsg->node_id, cmsg->value);
-      }
-      break;
-    }
-    case CRAS_CLIENT_NODE_LEFT_RIGHT_SWAPPED_CHANGED: {
-      struct cras_client_node_value_changed* cmsg =
-          (struct cras_client_node_value_changed*)msg;
-      if (client->observer_ops.node_left_right_swapped_changed) {
-        client->observer_ops.node_left_right_swapped_changed(
-            client->observer_context, cmsg->node_id, cmsg->value);
-      }
-      break;
-    }
-    case CRAS_CLIENT_INPUT_NODE_GAIN_CHANGED: {
-      struct cras_client_node_value_changed* cmsg =
-          (struct cras_client_node_value_changed*)msg;
-      if (client->observer_ops.input_node_gain_changed) {
-        client->observer_ops.input_node_gain_changed(
-            client->observer_context, cmsg->node_id, cmsg->value);
-      }
-      break;
-    }
-    case CRAS_CLIENT_NUM_ACTIVE_STREAMS_CHANGED: {
-      struct cras_client_num_active_streams_changed* cmsg =
-          (struct cras_client_num_active_streams_changed*)msg;
-      enum CRAS_STREAM_DIRECTION direction =
-          (enum CRAS_STREAM_DIRECTION)cmsg->direction;
-      if (client->observer_ops.num_active_streams_changed) {
-        client->observer_ops.num_active_streams_changed(
-            client->observer_context, direction, cmsg->num_active_streams);
-      }
-      break;
-    }
+    case CRAS_CLIENT_NOTIFICATION_BATCH:
+      return handle_notification_batch(client, msg);
     default:
+      handle_notification_from_server(client, msg);
       break;
   }
 
@@ -3069,6 +3147,21 @@ cras_client_get_audio_thread_snapshot_buffer(const struct cras_client* client) {
   return snapshot_buffer;
 }
 
+const struct cras_audio_thread_health* cras_client_get_audio_thread_health(
+    const struct cras_client* client) {
+  const struct cras_audio_thread_health* health;
+  int lock_rc;
+
+  lock_rc = server_state_rdlock(client);
+  if (lock_rc) {
+    return NULL;
+  }
+
+  health = &client->server_state->audio_thread_health;
+  server_state_unlock(client, lock_rc);
+  return health;
+}
+
 unsigned cras_client_get_num_active_streams(const struct cras_client* client,
                                             struct timespec* ts) {
   unsigned num_streams, version, i;
@@ -3101,6 +3194,37 @@ read_active_streams_again:
   return num_streams;
 }
 
+int cras_client_get_power_meters(const struct cras_client* client,
+                                 struct cras_power_meter* meters,
+                                 size_t* num_meters) {
+  const struct cras_server_state* state;
+  unsigned version, i;
+  size_t filled;
+  int lock_rc;
+
+  lock_rc = server_state_rdlock(client);
+  if (lock_rc) {
+    return -EINVAL;
+  }
+  state = client->server_state;
+
+read_power_meters_again:
+  version = begin_server_state_read(state);
+  filled = 0;
+  for (i = 0; i < CRAS_MAX_POWER_METERS && filled < *num_meters; i++) {
+    if (state->power_meters[i].source != CRAS_POWER_METER_NONE) {
+      memcpy(&meters[filled++], &state->power_meters[i], sizeof(*meters));
+    }
+  }
+  if (end_server_state_read(state, version)) {
+    goto read_power_meters_again;
+  }
+  server_state_unlock(client, lock_rc);
+
+  *num_meters = filled;
+  return 0;
+}
+
 int cras_client_run_thread(struct cras_client* client) {
   int rc;
 
@@ -3159,30 +3283,58 @@ void cras_client_set_thread_priority_cb(struct cras_client* client,
   client->thread_priority_cb = cb;
 }
 
+/* Fills |dst| with the visible devices of the |src_devs| devices in |src|
+ * followed by |src_ext|.
+ */
 static void fill_iodev_info(const struct cras_client* client,
                             struct cras_iodev_info* dst,
                             size_t* dst_devs,
                             const struct cras_iodev_info* src,
+                            const struct cras_iodev_info* src_ext,
                             size_t src_devs) {
+  const struct cras_iodev_info* dev;
   size_t i, filled;
 
+  src_devs = MIN(src_devs, CRAS_MAX_IODEVS_TOTAL);
   for (i = 0, filled = 0; i < src_devs && filled < *dst_devs; i++) {
+    dev = i < CRAS_MAX_IODEVS ? &src[i] : &src_ext[i - CRAS_MAX_IODEVS];
     if (client->client_type != CRAS_CLIENT_TYPE_TEST &&
-        src[i].visibility == CRAS_IODEV_HIDDEN) {
+        dev->visibility == CRAS_IODEV_HIDDEN) {
       continue;
     }
-    dst[filled++] = src[i];
+    dst[filled++] = *dev;
   }
   *dst_devs = filled;
 }
 
+/* Copies the first |*dst_nodes| of the |src_nodes| nodes in |src| followed
+ * by |src_ext| to |dst|, and sets |*dst_nodes| to the number copied.
+ */
+static void fill_ionode_info(struct cras_ionode_info* dst,
+                             size_t* dst_nodes,
+                             const struct cras_ionode_info* src,
+                             const struct cras_ionode_info* src_ext,
+                             size_t src_nodes) {
+  size_t num = MIN(*dst_nodes, MIN(src_nodes, CRAS_MAX_IONODES_TOTAL));
+
+  if (num <= CRAS_MAX_IONODES) {
+    memcpy(dst, src, num * sizeof(*dst));
+  } else {
+    memcpy(dst, src, CRAS_MAX_IONODES * sizeof(*dst));
+    memcpy(dst + CRAS_MAX_IONODES, src_ext,
+           (num - CRAS_MAX_IONODES) * sizeof(*dst));
+  }
+  *dst_nodes = num;
+}
+
 int cras_client_get_output_devices(const struct cras_client* client,
                                    struct cras_iodev_info* devs,
                                    struct cras_ionode_info* nodes,
                                    size_t* num_devs,
                                    size_t* num_nodes) {
   const struct cras_server_state* state;
-  unsigned avail_nodes, version;
+  size_t max_devs = *num_devs, max_nodes = *num_nodes;
+  unsigned version;
   int lock_rc;
 
   lock_rc = server_state_rdlock(client);
@@ -3192,18 +3344,24 @@ int cras_client_get_output_devices(const struct cras_client* client,
   state = client->server_state;
 
 read_outputs_again:
-  version = begin_server_state_read(state);
+  version = begin_update_count_read(dev_list_update_count(state));
+  *num_devs = max_devs;
   fill_iodev_info(client, devs, num_devs, state->output_devs,
-                  state->num_output_devs);
-  avail_nodes = MIN(*num_nodes, state->num_output_nodes);
-  memcpy(nodes, state->output_nodes, avail_nodes * sizeof(*nodes));
-  if (end_server_state_read(state, version)) {
+                  state->output_devs_ext,
+                  server_state_has_sections(state)
+                      ? state->num_output_devs_total
+                      : state->num_output_devs);
+  *num_nodes = max_nodes;
+  fill_ionode_info(nodes, num_nodes, state->output_nodes,
+                   state->output_nodes_ext,
+                   server_state_has_sections(state)
+                       ? state->num_output_nodes_total
+                       : state->num_output_nodes);
+  if (end_update_count_read(dev_list_update_count(state), version)) {
     goto read_outputs_again;
   }
   server_state_unlock(client, lock_rc);
 
-  *num_nodes = avail_nodes;
-
   return 0;
 }
 
@@ -3213,7 +3371,8 @@ int cras_client_get_input_devices(const struct cras_client* client,
                                   size_t* num_devs,
                                   size_t* num_nodes) {
   const struct cras_server_state* state;
-  unsigned avail_nodes, version;
+  size_t max_devs = *num_devs, max_nodes = *num_nodes;
+  unsigned version;
   int lock_rc;
 
   lock_rc = server_state_rdlock(client);
@@ -3223,18 +3382,24 @@ int cras_client_get_input_devices(const struct cras_client* client,
   state = client->server_state;
 
 read_inputs_again:
-  version = begin_server_state_read(state);
+  version = begin_update_count_read(dev_list_update_count(state));
+  *num_devs = max_devs;
   fill_iodev_info(client, devs, num_devs, state->input_devs,
-                  state->num_input_devs);
-  avail_nodes = MIN(*num_nodes, state->num_input_nodes);
-  memcpy(nodes, state->input_nodes, avail_nodes * sizeof(*nodes));
-  if (end_server_state_read(state, version)) {
+                  state->input_devs_ext,
+                  server_state_has_sections(state)
+                      ? state->num_input_devs_total
+                      : state->num_input_devs);
+  *num_nodes = max_nodes;
+  fill_ionode_info(nodes, num_nodes, state->input_nodes,
+                   state->input_nodes_ext,
+                   server_state_has_sections(state)
+                       ? state->num_input_nodes_total
+                       : state->num_input_nodes);
+  if (end_update_count_read(dev_list_update_count(state), version)) {
     goto read_inputs_again;
   }
   server_state_unlock(client, lock_rc);
 
-  *num_nodes = avail_nodes;
-
   return 0;
 }
 
@@ -3252,10 +3417,10 @@ int cras_client_get_attached_clients(const struct cras_client* client,
   state = client->server_state;
 
 read_clients_again:
-  version = begin_server_state_read(state);
+  version = begin_update_count_read(client_list_update_count(state));
   num = MIN(max_clients, state->num_attached_clients);
   memcpy(clients, state->client_info, num * sizeof(*clients));
-  if (end_server_state_read(state, version)) {
+  if (end_update_count_read(client_list_update_count(state), version)) {
     goto read_clients_again;
   }
   server_state_unlock(client, lock_rc);
@@ -3288,18 +3453,19 @@ static int cras_client_find_output_node(const struct cras_client* client,
     goto quit;
   }
 
-  devs = (struct cras_iodev_info*)malloc(CRAS_MAX_IODEVS * sizeof(*devs));
+  devs = (struct cras_iodev_info*)malloc(CRAS_MAX_IODEVS_TOTAL * sizeof(*devs));
   if (!devs) {
     goto quit;
   }
 
-  nodes = (struct cras_ionode_info*)malloc(CRAS_MAX_IONODES * sizeof(*nodes));
+  nodes = (struct cras_ionode_info*)malloc(CRAS_MAX_IONODES_TOTAL *
+                                           sizeof(*nodes));
   if (!nodes) {
     goto quit;
   }
 
-  ndevs = CRAS_MAX_IODEVS;
-  nnodes = CRAS_MAX_IONODES;
+  ndevs = CRAS_MAX_IODEVS_TOTAL;
+  nnodes = CRAS_MAX_IONODES_TOTAL;
   rc = cras_client_get_output_devices(client, devs, nodes, &ndevs, &nnodes);
   if (rc < 0) {
     goto quit;
@@ -3349,20 +3515,21 @@ int cras_client_get_node_by_id(const struct cras_client* client,
     goto quit;
   }
 
-  devs = (struct cras_iodev_info*)malloc(CRAS_MAX_IODEVS * sizeof(*devs));
+  devs = (struct cras_iodev_info*)malloc(CRAS_MAX_IODEVS_TOTAL * sizeof(*devs));
   if (!devs) {
     rc = -ENOMEM;
     goto quit;
   }
 
-  nodes = (struct cras_ionode_info*)malloc(CRAS_MAX_IONODES * sizeof(*nodes));
+  nodes = (struct cras_ionode_info*)malloc(CRAS_MAX_IONODES_TOTAL *
+                                           sizeof(*nodes));
   if (!nodes) {
     rc = -ENOMEM;
     goto quit;
   }
 
-  ndevs = CRAS_MAX_IODEVS;
-  nnodes = CRAS_MAX_IONODES;
+  ndevs = CRAS_MAX_IODEVS_TOTAL;
+  nnodes = CRAS_MAX_IONODES_TOTAL;
   if (input) {
     rc = cras_client_get_input_devices(client, devs, nodes, &ndevs, &nnodes);
   } else {
@@ -3671,20 +3838,21 @@ int cras_client_get_max_supported_channels(const struct cras_client* client,
     goto quit;
   }
 
-  devs = (struct cras_iodev_info*)malloc(CRAS_MAX_IODEVS * sizeof(*devs));
+  devs = (struct cras_iodev_info*)malloc(CRAS_MAX_IODEVS_TOTAL * sizeof(*devs));
   if (!devs) {
     rc = -ENOMEM;
     goto quit;
   }
 
-  nodes = (struct cras_ionode_info*)malloc(CRAS_MAX_IONODES * sizeof(*nodes));
+  nodes = (struct cras_ionode_info*)malloc(CRAS_MAX_IONODES_TOTAL *
+                                           sizeof(*nodes));
   if (!nodes) {
     rc = -ENOMEM;
     goto quit;
   }
 
-  ndevs = CRAS_MAX_IODEVS;
-  nnodes = CRAS_MAX_IONODES;
+  ndevs = CRAS_MAX_IODEVS_TOTAL;
+  nnodes = CRAS_MAX_IONODES_TOTAL;
   rc = cras_client_get_output_devices(client, devs, nodes, &ndevs, &nnodes);
   if (rc < 0) {
     goto quit;
@@ -3777,6 +3945,8 @@ int cras_client_get_first_node_type_idx(const struct cras_client* client,
   unsigned int version;
   unsigned int i;
   const struct cras_ionode_info* node_list;
+  const struct cras_ionode_info* node_list_ext;
+  const struct cras_ionode_info* node;
   unsigned int num_nodes;
   int lock_rc;
 
@@ -3787,23 +3957,29 @@ int cras_client_get_first_node_type_idx(const struct cras_client* client,
   state = client->server_state;
 
 read_nodes_again:
-  version = begin_server_state_read(state);
+  version = begin_update_count_read(dev_list_update_count(state));
   if (direction == CRAS_STREAM_OUTPUT) {
     node_list = state->output_nodes;
-    num_nodes = state->num_output_nodes;
+    node_list_ext = state->output_nodes_ext;
+    num_nodes = server_state_has_sections(state) ? state->num_output_nodes_total
+                                                 : state->num_output_nodes;
   } else {
     node_list = state->input_nodes;
-    num_nodes = state->num_input_nodes;
+    node_list_ext = state->input_nodes_ext;
+    num_nodes = server_state_has_sections(state) ? state->num_input_nodes_total
+                                                 : state->num_input_nodes;
   }
+  num_nodes = MIN(num_nodes, CRAS_MAX_IONODES_TOTAL);
   for (i = 0; i < num_nodes; i++) {
-    if ((enum CRAS_NODE_TYPE)node_list[i].type_enum == type) {
-      *node_id =
-          cras_make_node_id(node_list[i].iodev_idx, node_list[i].ionode_idx);
+    node = i < CRAS_MAX_IONODES ? &node_list[i]
+                                : &node_list_ext[i - CRAS_MAX_IONODES];
+    if ((enum CRAS_NODE_TYPE)node->type_enum == type) {
+      *node_id = cras_make_node_id(node->iodev_idx, node->ionode_idx);
       server_state_unlock(client, lock_rc);
       return 0;
     }
   }
-  if (end_server_state_read(state, version)) {
+  if (end_update_count_read(dev_list_update_count(state), version)) {
     goto read_nodes_again;
   }
   server_state_unlock(client, lock_rc);
@@ -3870,6 +4046,20 @@ int cras_client_set_aec_dump(struct cras_client* client,
   }
 }
 
+int cras_client_set_atlog_trace(struct cras_client* client,
+                                int start,
+                                int fd) {
+  struct cras_set_atlog_trace msg;
+
+  cras_fill_set_atlog_trace_message(&msg, start);
+
+  if (fd != -1) {
+    return cras_send_with_fds(client->server_fd, &msg, sizeof(msg), &fd, 1);
+  } else {
+    return write_message_to_server(client, &msg.header);
+  }
+}
+
 int cras_client_reload_aec_config(struct cras_client* client) {
   struct cras_reload_aec_config msg;
 
@@ -4092,6 +4282,13 @@ int cras_client_set_num_active_streams_changed_callback(
 static int reregister_notifications(struct cras_client* client) {
   int rc;
 
+  // Let the server pack the notifications it has for us into one message.
+  rc = cras_send_register_notification(client, CRAS_CLIENT_NOTIFICATION_BATCH,
+                                       1);
+  if (rc != 0) {
+    return rc;
+  }
+
   if (client->observer_ops.output_volume_changed) {
     rc = cras_client_set_output_volume_changed_callback(
         client, client->observer_ops.output_volume_changed);
@@ -4269,9 +4466,9 @@ int get_nodes(struct cras_client* client,
               enum CRAS_STREAM_DIRECTION direction,
               struct libcras_node_info*** nodes,
               size_t* num) {
-  struct cras_iodev_info iodevs[CRAS_MAX_IODEVS];
-  struct cras_ionode_info ionodes[CRAS_MAX_IONODES];
-  size_t num_devs = CRAS_MAX_IODEVS, num_nodes = CRAS_MAX_IONODES;
+  struct cras_iodev_info iodevs[CRAS_MAX_IODEVS_TOTAL];
+  struct cras_ionode_info ionodes[CRAS_MAX_IONODES_TOTAL];
+  size_t num_devs = CRAS_MAX_IODEVS_TOTAL, num_nodes = CRAS_MAX_IONODES_TOTAL;
   int rc, i, j;
 
   *num = 0;
@@ -23,6 +23,8 @@
 
 #include "cras/common/check.h"
 #include "cras/server/cras_thread.h"
+#include "cras/server/platform/features/features.h"
+#include "cras/src/server/audio_thread_health.h"
 #include "cras/src/server/audio_thread_log.h"
 #include "cras/src/server/cras_audio_thread_monitor.h"
 #include "cras/src/server/cras_device_monitor.h"
@@ -314,6 +316,8 @@ static int thread_add_open_dev(struct audio_thread* thread,
 
   adev = (struct open_dev*)calloc(1, sizeof(*adev));
   adev->dev = iodev;
+  adev->health =
+      audio_thread_health_add_dev(iodev->info.idx, iodev->direction);
 
   /*
    * Start output devices by padding the output. This avoids a burst of
@@ -321,6 +325,7 @@ static int thread_add_open_dev(struct audio_thread* thread,
    */
   if (iodev->direction == CRAS_STREAM_OUTPUT) {
     fill_odevs_zeros_min_level(iodev);
+    adev->share_mix = cras_feature_enabled(CrOSLateBootCrasOutputMixGroup);
   }
 
   ATLOG(atlog, AUDIO_THREAD_DEV_ADDED, iodev->info.idx, 0, 0);
@@ -425,6 +430,9 @@ static int thread_disconnect_stream(struct audio_thread* thread,
   }
 
   rc = dev_io_remove_stream(&thread->open_devs[stream->direction], stream, dev);
+  if (stream->direction == CRAS_STREAM_OUTPUT) {
+    dev_io_update_mix_groups(thread->open_devs[CRAS_STREAM_OUTPUT]);
+  }
 
   return rc;
 }
@@ -491,6 +499,7 @@ static int thread_add_streams(struct audio_thread* thread,
       return rc;
     }
   }
+  dev_io_update_mix_groups(thread->open_devs[CRAS_STREAM_OUTPUT]);
 
   return 0;
 }
@@ -543,6 +552,9 @@ static void append_dev_dump_info(struct audio_dev_debug_info* di,
   di->num_severe_underruns = cras_iodev_get_num_severe_underruns(adev->dev);
   di->num_samples_dropped = cras_iodev_get_num_samples_dropped(adev->dev);
   di->highest_hw_level = adev->dev->highest_hw_level;
+  di->tstamp_wake_margin_frames = adev->dev->tstamp_wake_margin_frames;
+  di->max_wake_prediction_error = adev->dev->max_wake_prediction_error;
+  di->lowest_wake_hw_level = adev->dev->lowest_wake_hw_level;
   di->internal_gain_scaler = (adev->dev->direction == CRAS_STREAM_INPUT)
                                  ? adev->dev->internal_gain_scaler
                                  : 0.0f;
@@ -1019,7 +1031,9 @@ static void* audio_io_thread(void* arg) {
     __sync_synchronize();
     atlog->sync_write_pos = atlog->write_pos;
 
+    audio_thread_health_sleep();
     rc = ppoll(thread->pollfds, thread->num_pollfds, wait_ts, NULL);
+    audio_thread_health_wake();
     ATLOG(atlog, AUDIO_THREAD_WAKE, rc, 0, 0);
     if (wait_ts) {
       check_wake_delay(&sleep_until);
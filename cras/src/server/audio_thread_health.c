@@ -0,0 +1,159 @@
+/* Copyright 2026 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "cras/src/server/audio_thread_health.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "cras_timespec.h"
+#include "cras_util.h"
+
+// Where samples are recorded, NULL when disabled.
+static struct cras_audio_thread_health* health;
+
+// When the current wake up started.
+static struct timespec wake_ts;
+// DSP time and lowest hw_level seen during the current wake up.
+static uint32_t wake_dsp_us;
+static uint32_t wake_min_hw_level = UINT32_MAX;
+static uint32_t wake_min_hw_level_dev_idx;
+
+// Returns the microseconds from |start| to now, 0 if |start| is later.
+static uint32_t us_since(const struct timespec* start) {
+  struct timespec now, diff;
+
+  clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+  if (!timespec_after(&now, start)) {
+    return 0;
+  }
+  subtract_timespecs(&now, start, &diff);
+  if (diff.tv_sec >= UINT32_MAX / 1000000) {
+    return UINT32_MAX;
+  }
+  return diff.tv_sec * 1000000 + diff.tv_nsec / 1000;
+}
+
+void audio_thread_health_init(struct cras_audio_thread_health* h) {
+  health = h;
+  wake_ts.tv_sec = wake_ts.tv_nsec = 0;
+  if (health) {
+    memset(health, 0, sizeof(*health));
+  }
+}
+
+void cras_health_histogram_add(struct cras_health_histogram* hist,
+                               uint32_t value) {
+  unsigned int bucket;
+
+  // Bucket i > 0 holds [2^(i-1), 2^i), which is the bit length of value.
+  bucket = value ? 32 - __builtin_clz(value) : 0;
+  if (bucket >= CRAS_HEALTH_HISTOGRAM_BUCKETS) {
+    bucket = CRAS_HEALTH_HISTOGRAM_BUCKETS - 1;
+  }
+  hist->buckets[bucket]++;
+  hist->count++;
+  hist->sum += value;
+  if (value > hist->max) {
+    hist->max = value;
+  }
+}
+
+void audio_thread_health_wake() {
+  if (!health) {
+    return;
+  }
+  clock_gettime(CLOCK_MONOTONIC_RAW, &wake_ts);
+  wake_dsp_us = 0;
+  wake_min_hw_level = UINT32_MAX;
+  wake_min_hw_level_dev_idx = 0;
+}
+
+void audio_thread_health_sleep() {
+  struct cras_health_wake_record* rec;
+  uint32_t run_us;
+
+  if (!health || (wake_ts.tv_sec == 0 && wake_ts.tv_nsec == 0)) {
+    return;
+  }
+
+  run_us = us_since(&wake_ts);
+  cras_health_histogram_add(&health->run_us, run_us);
+
+  rec = &health->wakes[health->num_wakes % CRAS_HEALTH_WAKE_RECORDS];
+  cras_timespec_from_timespec(&rec->wake_ts, &wake_ts);
+  rec->run_us = run_us;
+  rec->dsp_us = wake_dsp_us;
+  rec->min_hw_level = wake_min_hw_level;
+  rec->min_hw_level_dev_idx = wake_min_hw_level_dev_idx;
+  // Publish the record before counting it.
+  __atomic_store_n(&health->num_wakes, health->num_wakes + 1,
+                   __ATOMIC_RELEASE);
+}
+
+void audio_thread_health_dsp_start(struct timespec* start) {
+  if (!health) {
+    start->tv_sec = start->tv_nsec = 0;
+    return;
+  }
+  clock_gettime(CLOCK_MONOTONIC_RAW, start);
+}
+
+void audio_thread_health_dsp_done(const struct timespec* start) {
+  uint32_t us;
+
+  if (!health || (start->tv_sec == 0 && start->tv_nsec == 0)) {
+    return;
+  }
+  us = us_since(start);
+  cras_health_histogram_add(&health->dsp_us, us);
+  wake_dsp_us += us;
+}
+
+void audio_thread_health_stream_replied(const struct timespec* requested) {
+  if (!health || (requested->tv_sec == 0 && requested->tv_nsec == 0)) {
+    return;
+  }
+  cras_health_histogram_add(&health->stream_cb_us, us_since(requested));
+}
+
+struct cras_health_dev* audio_thread_health_add_dev(uint32_t dev_idx,
+                                                    uint32_t direction) {
+  struct cras_health_dev* dev;
+  unsigned int i;
+
+  if (!health) {
+    return NULL;
+  }
+  for (i = 0; i < CRAS_HEALTH_MAX_DEVS; i++) {
+    dev = &health->devs[i];
+    if (!dev->open) {
+      memset(dev, 0, sizeof(*dev));
+      dev->dev_idx = dev_idx;
+      dev->direction = direction;
+      dev->open = 1;
+      return dev;
+    }
+  }
+  return NULL;
+}
+
+void audio_thread_health_rm_dev(struct cras_health_dev* dev) {
+  if (dev) {
+    dev->open = 0;
+  }
+}
+
+void audio_thread_health_hw_level(struct cras_health_dev* dev,
+                                  uint32_t hw_level) {
+  if (!dev) {
+    return;
+  }
+  cras_health_histogram_add(&dev->hw_level, hw_level);
+  if (hw_level < wake_min_hw_level) {
+    wake_min_hw_level = hw_level;
+    wake_min_hw_level_dev_idx = dev->dev_idx;
+  }
+}
@@ -0,0 +1,71 @@
+/* Copyright 2026 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Samples the audio thread into struct cras_audio_thread_health. Apart from
+ * audio_thread_health_init, these functions must only be called from the
+ * audio thread. They do nothing until audio_thread_health_init is called.
+ */
+
+#ifndef CRAS_SRC_SERVER_AUDIO_THREAD_HEALTH_H_
+#define CRAS_SRC_SERVER_AUDIO_THREAD_HEALTH_H_
+
+#include <stdint.h>
+#include <time.h>
+
+#include "cras_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Sets where the samples are recorded, usually in the shared server state.
+ * Must be called before the audio thread starts. Pass NULL to stop recording.
+ */
+void audio_thread_health_init(struct cras_audio_thread_health* health);
+
+// Adds |value| to |hist|.
+void cras_health_histogram_add(struct cras_health_histogram* hist,
+                               uint32_t value);
+
+// Marks that the audio thread woke up.
+void audio_thread_health_wake();
+
+// Marks that the audio thread is about to sleep, recording the wake up.
+void audio_thread_health_sleep();
+
+/* Marks the start of a DSP pipeline run.
+ * Args:
+ *    start - Filled with the start time, to pass to
+ *        audio_thread_health_dsp_done.
+ */
+void audio_thread_health_dsp_start(struct timespec* start);
+
+// Records a DSP pipeline run which started at |start|.
+void audio_thread_health_dsp_done(const struct timespec* start);
+
+/* Records a stream client replying to a request made at |requested|.
+ * Args:
+ *    requested - The time from CLOCK_MONOTONIC_RAW of the request.
+ */
+void audio_thread_health_stream_replied(const struct timespec* requested);
+
+/* Claims a slot for sampling the hw_level of a device.
+ * Returns:
+ *    The slot, or NULL if sampling is disabled or all slots are in use.
+ */
+struct cras_health_dev* audio_thread_health_add_dev(uint32_t dev_idx,
+                                                    uint32_t direction);
+
+// Releases a slot returned by audio_thread_health_add_dev. NULL is ignored.
+void audio_thread_health_rm_dev(struct cras_health_dev* dev);
+
+// Records |hw_level| frames in |dev|. NULL is ignored.
+void audio_thread_health_hw_level(struct cras_health_dev* dev,
+                                  uint32_t hw_level);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // CRAS_SRC_SERVER_AUDIO_THREAD_HEALTH_H_
@@ -13,6 +13,7 @@
 #include <sys/mman.h>
 #include <syslog.h>
 
+#include "cras/src/server/audio_thread_trace.h"
 #include "cras_shm.h"
 #include "cras_types.h"
 
@@ -91,6 +92,13 @@ static inline void audio_thread_event_log_data(
   log->log[pos_mod_len].data3 = data3;
 
   log->write_pos++;
+
+  struct audio_thread_trace* trace =
+      __atomic_load_n(&atlog_trace, __ATOMIC_ACQUIRE);
+  if (trace) {
+    trace->log(trace, log->log[pos_mod_len].tag_sec, now.tv_nsec, data1, data2,
+               data3);
+  }
 }
 
 #ifdef __cplusplus
@@ -0,0 +1,322 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "cras/src/server/audio_thread_trace.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <sys/syscall.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cras_types.h"
+#include "cras_util.h"
+
+// Events buffered per thread between two flushes. Must be a power of 2.
+#define TRACE_RING_SIZE (1 << 14)
+// Threads that can log to one trace, usually only the audio thread does.
+#define MAX_TRACE_THREADS 8
+
+// How often the writer thread drains the rings.
+static const struct timespec trace_flush_interval = {
+    0, 20 * 1000 * 1000  // 20 msec.
+};
+
+/* Single producer single consumer ring of events from one logging thread.
+ * Members:
+ *    tid - Thread id of the producer, 0 until the ring is claimed.
+ *    write_pos - Position of the next event, written by the producer.
+ *    read_pos - Position of the next event to flush, written by the writer.
+ *    dropped - Events discarded because the ring was full.
+ */
+struct trace_ring {
+  uint32_t tid;
+  uint64_t write_pos;
+  uint64_t read_pos;
+  uint64_t dropped;
+  struct audio_thread_event events[TRACE_RING_SIZE];
+};
+
+/* Members:
+ *    base - Published through atlog_trace while running.
+ *    fd - The trace file.
+ *    running - Whether a trace is running, only used by the main thread.
+ *    stop - Set to make the writer thread flush and exit.
+ *    generation - Incremented on each start, invalidates per thread rings.
+ *    num_loggers - Number of threads inside trace_log.
+ *    num_claimed - Number of rings handed out, may exceed MAX_TRACE_THREADS.
+ *    unclaimed_dropped - Events dropped because no ring was left.
+ *    writer - The thread writing rings to |fd|.
+ *    rings - One ring per logging thread.
+ */
+struct trace_state {
+  struct audio_thread_trace base;
+  int fd;
+  bool running;
+  int stop;
+  uint32_t generation;
+  uint32_t num_loggers;
+  uint32_t num_claimed;
+  uint64_t unclaimed_dropped;
+  pthread_t writer;
+  struct trace_ring rings[MAX_TRACE_THREADS];
+};
+
+struct audio_thread_trace* atlog_trace;
+
+/* Allocated on first use and never freed, a logging thread may still hold
+ * a pointer to it when the trace is stopped. */
+static struct trace_state* trace;
+
+static __thread struct trace_ring* thread_ring;
+static __thread uint32_t thread_ring_generation;
+
+static struct trace_ring* claim_ring(struct trace_state* t) {
+  uint32_t idx = __atomic_fetch_add(&t->num_claimed, 1, __ATOMIC_RELAXED);
+  struct trace_ring* ring;
+
+  if (idx >= MAX_TRACE_THREADS) {
+    return NULL;
+  }
+  ring = &t->rings[idx];
+  __atomic_store_n(&ring->tid, (uint32_t)syscall(SYS_gettid),
+                   __ATOMIC_RELEASE);
+  return ring;
+}
+
+static void trace_log(struct audio_thread_trace* base,
+                      uint32_t tag_sec,
+                      uint32_t nsec,
+                      uint32_t data1,
+                      uint32_t data2,
+                      uint32_t data3) {
+  struct trace_state* t = (struct trace_state*)base;
+  uint32_t generation;
+  struct trace_ring* ring = thread_ring;
+  struct audio_thread_event* ev;
+  uint64_t w, r;
+
+  /* Announce the logger before checking the trace is still running, so that
+   * audio_thread_trace_stop either waits for it or makes it return here. */
+  __atomic_fetch_add(&t->num_loggers, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&atlog_trace, __ATOMIC_SEQ_CST) != base) {
+    goto out;
+  }
+
+  generation = __atomic_load_n(&t->generation, __ATOMIC_ACQUIRE);
+  if (!ring || thread_ring_generation != generation) {
+    ring = claim_ring(t);
+    thread_ring = ring;
+    thread_ring_generation = generation;
+  }
+  if (!ring) {
+    __atomic_fetch_add(&t->unclaimed_dropped, 1, __ATOMIC_RELAXED);
+    goto out;
+  }
+
+  w = ring->write_pos;
+  r = __atomic_load_n(&ring->read_pos, __ATOMIC_ACQUIRE);
+  if (w - r >= TRACE_RING_SIZE) {
+    __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+    goto out;
+  }
+
+  ev = &ring->events[w & (TRACE_RING_SIZE - 1)];
+  ev->tag_sec = tag_sec;
+  ev->nsec = nsec;
+  ev->data1 = data1;
+  ev->data2 = data2;
+  ev->data3 = data3;
+  __atomic_store_n(&ring->write_pos, w + 1, __ATOMIC_RELEASE);
+out:
+  __atomic_fetch_sub(&t->num_loggers, 1, __ATOMIC_RELEASE);
+}
+
+static int write_all(int fd, const void* buf, size_t len) {
+  const uint8_t* p = (const uint8_t*)buf;
+
+  while (len) {
+    ssize_t rc = write(fd, p, len);
+    if (rc < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -errno;
+    }
+    p += rc;
+    len -= rc;
+  }
+  return 0;
+}
+
+static int write_overflow(int fd, uint32_t tid, uint64_t dropped) {
+  struct audio_thread_trace_record rec = {
+      .type = AUDIO_THREAD_TRACE_OVERFLOW,
+      .tid = tid,
+      .count = MIN(dropped, UINT32_MAX),
+  };
+
+  if (!dropped) {
+    return 0;
+  }
+  return write_all(fd, &rec, sizeof(rec));
+}
+
+static int flush_ring(int fd, struct trace_ring* ring) {
+  uint32_t tid = __atomic_load_n(&ring->tid, __ATOMIC_ACQUIRE);
+  uint64_t w, r;
+  int rc;
+
+  if (!tid) {
+    return 0;
+  }
+
+  w = __atomic_load_n(&ring->write_pos, __ATOMIC_ACQUIRE);
+  r = ring->read_pos;
+  while (r != w) {
+    uint64_t offset = r & (TRACE_RING_SIZE - 1);
+    uint32_t count = MIN(w - r, TRACE_RING_SIZE - offset);
+    struct audio_thread_trace_record rec = {
+        .type = AUDIO_THREAD_TRACE_EVENTS,
+        .tid = tid,
+        .count = count,
+    };
+
+    rc = write_all(fd, &rec, sizeof(rec));
+    if (rc) {
+      return rc;
+    }
+    rc = write_all(fd, &ring->events[offset], count * sizeof(ring->events[0]));
+    if (rc) {
+      return rc;
+    }
+    r += count;
+    __atomic_store_n(&ring->read_pos, r, __ATOMIC_RELEASE);
+  }
+
+  return write_overflow(
+      fd, tid, __atomic_exchange_n(&ring->dropped, 0, __ATOMIC_RELAXED));
+}
+
+static int flush_all(struct trace_state* t) {
+  uint32_t num_rings = MIN(__atomic_load_n(&t->num_claimed, __ATOMIC_RELAXED),
+                           MAX_TRACE_THREADS);
+  unsigned int i;
+  int rc;
+
+  for (i = 0; i < num_rings; i++) {
+    rc = flush_ring(t->fd, &t->rings[i]);
+    if (rc) {
+      return rc;
+    }
+  }
+  return write_overflow(
+      t->fd, 0,
+      __atomic_exchange_n(&t->unclaimed_dropped, 0, __ATOMIC_RELAXED));
+}
+
+static void* trace_writer(void* arg) {
+  struct trace_state* t = (struct trace_state*)arg;
+  int rc = 0;
+
+  while (!__atomic_load_n(&t->stop, __ATOMIC_ACQUIRE)) {
+    nanosleep(&trace_flush_interval, NULL);
+    rc = flush_all(t);
+    if (rc) {
+      break;
+    }
+  }
+  if (!rc) {
+    rc = flush_all(t);
+  }
+  if (rc) {
+    syslog(LOG_ERR, "Failed to write audio thread trace: %d", rc);
+    // Stop logging, the main thread still has to call stop to clean up.
+    __atomic_store_n(&atlog_trace, NULL, __ATOMIC_RELEASE);
+  }
+  return NULL;
+}
+
+static uint64_t clock_ns(clockid_t clk) {
+  struct timespec ts;
+
+  clock_gettime(clk, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int audio_thread_trace_start(int fd) {
+  struct audio_thread_trace_header header = {
+      .magic = AUDIO_THREAD_TRACE_MAGIC,
+      .version = AUDIO_THREAD_TRACE_VERSION,
+  };
+  unsigned int i;
+  int rc;
+
+  if (trace && trace->running) {
+    close(fd);
+    return -EBUSY;
+  }
+  if (!trace) {
+    trace = (struct trace_state*)calloc(1, sizeof(*trace));
+    if (!trace) {
+      close(fd);
+      return -ENOMEM;
+    }
+    trace->base.log = trace_log;
+  }
+
+  header.monotonic_raw_ns = clock_ns(CLOCK_MONOTONIC_RAW);
+  header.boottime_ns = clock_ns(CLOCK_BOOTTIME);
+  header.realtime_ns = clock_ns(CLOCK_REALTIME);
+  rc = write_all(fd, &header, sizeof(header));
+  if (rc) {
+    close(fd);
+    return rc;
+  }
+
+  for (i = 0; i < MAX_TRACE_THREADS; i++) {
+    trace->rings[i].tid = 0;
+    trace->rings[i].write_pos = 0;
+    trace->rings[i].read_pos = 0;
+    trace->rings[i].dropped = 0;
+  }
+  trace->num_claimed = 0;
+  trace->unclaimed_dropped = 0;
+  trace->fd = fd;
+  trace->stop = 0;
+  __atomic_fetch_add(&trace->generation, 1, __ATOMIC_RELEASE);
+
+  rc = pthread_create(&trace->writer, NULL, trace_writer, trace);
+  if (rc) {
+    syslog(LOG_ERR, "Failed to create audio thread trace writer: %d", rc);
+    close(fd);
+    return -rc;
+  }
+  trace->running = true;
+  __atomic_store_n(&atlog_trace, &trace->base, __ATOMIC_RELEASE);
+  return 0;
+}
+
+void audio_thread_trace_stop() {
+  if (!trace || !trace->running) {
+    return;
+  }
+  __atomic_store_n(&atlog_trace, NULL, __ATOMIC_SEQ_CST);
+  // The rings are reset on the next start, no logger may be left using them.
+  while (__atomic_load_n(&trace->num_loggers, __ATOMIC_SEQ_CST)) {
+    sched_yield();
+  }
+  __atomic_store_n(&trace->stop, 1, __ATOMIC_RELEASE);
+  pthread_join(trace->writer, NULL);
+  close(trace->fd);
+  trace->fd = -1;
+  trace->running = false;
+}
@@ -0,0 +1,58 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Streams audio thread log events to a file without losing them silently.
+ * While a trace is running every thread that logs with ATLOG gets its own
+ * ring, which a background thread drains into the trace file. Events that
+ * don't fit in a full ring are counted and reported in the file as
+ * AUDIO_THREAD_TRACE_OVERFLOW records.
+ */
+
+#ifndef CRAS_SRC_SERVER_AUDIO_THREAD_TRACE_H_
+#define CRAS_SRC_SERVER_AUDIO_THREAD_TRACE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct audio_thread_trace;
+
+/* Logs one event to the running trace. Called through
+ * audio_thread_event_log_data so that files using ATLOG don't need to link
+ * the trace.
+ */
+typedef void (*audio_thread_trace_log_t)(struct audio_thread_trace* trace,
+                                         uint32_t tag_sec,
+                                         uint32_t nsec,
+                                         uint32_t data1,
+                                         uint32_t data2,
+                                         uint32_t data3);
+
+struct audio_thread_trace {
+  audio_thread_trace_log_t log;
+};
+
+/* The running trace, NULL when not tracing. Read by audio_thread_log.h. */
+extern struct audio_thread_trace* atlog_trace;
+
+/* Starts streaming audio thread log events to |fd|. The trace takes ownership
+ * of |fd| and closes it when stopped.
+ * Returns:
+ *    0 on success, -EBUSY if a trace is already running, or other negative
+ *    error code.
+ */
+int audio_thread_trace_start(int fd);
+
+/* Stops the running trace, writing out all buffered events first. Does
+ * nothing if no trace is running.
+ */
+void audio_thread_trace_stop();
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // CRAS_SRC_SERVER_AUDIO_THREAD_TRACE_H_
@@ -12,6 +12,7 @@ TEST(BoardConfigTest, Defaults) {
   ASSERT_TRUE(config);
   EXPECT_EQ(config->hw_echo_ref_disabled, 1);
   EXPECT_EQ(config->default_output_buffer_size, 512);
+  EXPECT_EQ(config->tstamp_wake_margin_us, 0);
   cras_board_config_destroy(config);
 }
 
@@ -23,6 +24,7 @@ TEST(BoardConfigTest, Load) {
   EXPECT_EQ(config->aec_supported, 1);
   EXPECT_EQ(config->aec_group_id, 3);
   EXPECT_EQ(config->default_output_buffer_size, 256);
+  EXPECT_EQ(config->tstamp_wake_margin_us, 500);
   EXPECT_STREQ(config->ucm_ignore_suffix, "Ignore Suffix");
   cras_board_config_destroy(config);
 }
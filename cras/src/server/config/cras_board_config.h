@@ -37,6 +37,7 @@ struct cras_board_config {
   char* dsp_offload_map;
   int32_t using_default_volume_curve_for_usb_audio_device;
   int32_t spatial_supported;
+  int32_t tstamp_wake_margin_us;
 };
 
 /* Creates a configuration based on the config file specified.
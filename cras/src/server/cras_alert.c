@@ -9,9 +9,12 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "cras/server/cras_thread.h"
 #include "cras/server/main_message.h"
+#include "cras/src/server/cras_tm.h"
+#include "cras_util.h"
 #include "third_party/utlist/utlist.h"
 
 // A list of callbacks for an alert
@@ -24,6 +27,8 @@ struct cras_alert_cb_list {
 // A list of data args to callbacks. Variable-length structure.
 struct cras_alert_data {
   struct cras_alert_data *prev, *next;
+  // Pending data with the same key replace each other.
+  uint64_t key;
   // This field must be the last in this structure.
   char buf[];
 };
@@ -34,13 +39,29 @@ struct cras_alert {
   cras_alert_prepare prepare;
   struct cras_alert_cb_list* callbacks;
   struct cras_alert_data* data;
+  // Minimum interval between two runs of the callbacks, 0 if not limited.
+  unsigned int min_interval_ms;
+  struct cras_tm* tm;
+  // Armed while the callbacks are held back by |min_interval_ms|.
+  struct cras_timer* timer;
+  // When the callbacks last ran.
+  struct timespec last_run;
   struct cras_alert *prev, *next;
 };
 
+// A list of functions to call after pending alerts are processed.
+struct cras_alert_flush_cb_list {
+  cras_alert_flush_cb callback;
+  void* arg;
+  struct cras_alert_flush_cb_list *prev, *next;
+};
+
 // A list of all alerts in the system
 static struct cras_alert* all_alerts;
 // If there is any alert pending.
 static int has_alert_pending;
+// Called after pending alerts are processed.
+static struct cras_alert_flush_cb_list* flush_callbacks;
 
 struct cras_alert* cras_alert_create(cras_alert_prepare prepare,
                                      unsigned int flags) {
@@ -95,13 +116,60 @@ int cras_alert_rm_callback(struct cras_alert* alert,
   return -ENOENT;
 }
 
+void cras_alert_set_min_interval(struct cras_alert* alert,
+                                 struct cras_tm* tm,
+                                 unsigned int ms) {
+  alert->tm = tm;
+  alert->min_interval_ms = tm ? ms : 0;
+}
+
+static void min_interval_timeout(struct cras_timer* timer, void* arg) {
+  struct cras_alert* alert = (struct cras_alert*)arg;
+
+  // The timer is freed by cras_tm after this callback returns.
+  alert->timer = NULL;
+  has_alert_pending = 1;
+}
+
+/* Returns 1 if the callbacks of |alert| have to wait for its minimum
+ * interval to pass, arming a timer to process it then.
+ */
+static int cras_alert_held_back(struct cras_alert* alert) {
+  struct timespec now, elapsed;
+  unsigned int elapsed_ms;
+
+  if (alert->timer) {
+    return 1;
+  }
+  if (!alert->min_interval_ms) {
+    return 0;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+  if (alert->last_run.tv_sec || alert->last_run.tv_nsec) {
+    subtract_timespecs(&now, &alert->last_run, &elapsed);
+    elapsed_ms = timespec_to_ms(&elapsed);
+    if (elapsed_ms < alert->min_interval_ms) {
+      alert->timer =
+          cras_tm_create_timer(alert->tm, alert->min_interval_ms - elapsed_ms,
+                               min_interval_timeout, alert);
+      // Run now rather than lose the alert if no timer could be armed.
+      if (alert->timer) {
+        return 1;
+      }
+    }
+  }
+  alert->last_run = now;
+  return 0;
+}
+
 /* Checks if the alert is pending, and invoke the prepare function and callbacks
  * if so. */
 static void cras_alert_process(struct cras_alert* alert) {
   struct cras_alert_cb_list* cb;
   struct cras_alert_data* data;
 
-  if (!alert->pending) {
+  if (!alert->pending || cras_alert_held_back(alert)) {
     return;
   }
 
@@ -145,11 +213,17 @@ static void pending_event_on_main(struct cras_main_ctx* mctx,
   }
 
   struct cras_alert_data* d = event.data;
-
-  if (!(alert->flags & CRAS_ALERT_FLAG_KEEP_ALL_DATA) && alert->data) {
-    // There will never be more than one item in the list.
-    free(alert->data);
-    alert->data = NULL;
+  struct cras_alert_data* prev;
+
+  if (!(alert->flags & CRAS_ALERT_FLAG_KEEP_ALL_DATA)) {
+    // There will never be more than one item per key in the list.
+    DL_FOREACH (alert->data, prev) {
+      if (prev->key == d->key) {
+        DL_DELETE(alert->data, prev);
+        free(prev);
+        break;
+      }
+    }
   }
 
   /* Even when there is only one item, it is important to use DL_APPEND
@@ -190,8 +264,16 @@ void cras_alert_pending(struct cras_alert* alert) {
 void cras_alert_pending_data(struct cras_alert* alert,
                              void* data,
                              size_t data_size) {
+  cras_alert_pending_keyed_data(alert, 0, data, data_size);
+}
+
+void cras_alert_pending_keyed_data(struct cras_alert* alert,
+                                   uint64_t key,
+                                   void* data,
+                                   size_t data_size) {
   struct cras_alert_data* d =
       calloc(1, offsetof(struct cras_alert_data, buf) + data_size);
+  d->key = key;
   memcpy(d->buf, data, data_size);
 
   struct cras_alert_event event = {
@@ -203,13 +285,59 @@ void cras_alert_pending_data(struct cras_alert* alert,
 
 void cras_alert_process_all_pending_alerts() {
   struct cras_alert* alert;
+  struct cras_alert_flush_cb_list* flush;
+  int processed = 0;
 
   while (has_alert_pending) {
     has_alert_pending = 0;
+    processed = 1;
     DL_FOREACH (all_alerts, alert) {
       cras_alert_process(alert);
     }
   }
+
+  if (!processed) {
+    return;
+  }
+  DL_FOREACH (flush_callbacks, flush) {
+    flush->callback(flush->arg);
+  }
+}
+
+int cras_alert_add_flush_callback(cras_alert_flush_cb cb, void* arg) {
+  struct cras_alert_flush_cb_list* flush;
+
+  if (cb == NULL) {
+    return -EINVAL;
+  }
+
+  DL_FOREACH (flush_callbacks, flush) {
+    if (flush->callback == cb && flush->arg == arg) {
+      return -EEXIST;
+    }
+  }
+
+  flush = calloc(1, sizeof(*flush));
+  if (flush == NULL) {
+    return -ENOMEM;
+  }
+  flush->callback = cb;
+  flush->arg = arg;
+  DL_APPEND(flush_callbacks, flush);
+  return 0;
+}
+
+int cras_alert_rm_flush_callback(cras_alert_flush_cb cb, void* arg) {
+  struct cras_alert_flush_cb_list* flush;
+
+  DL_FOREACH (flush_callbacks, flush) {
+    if (flush->callback == cb && flush->arg == arg) {
+      DL_DELETE(flush_callbacks, flush);
+      free(flush);
+      return 0;
+    }
+  }
+  return -ENOENT;
 }
 
 void cras_alert_destroy(struct cras_alert* alert) {
@@ -230,6 +358,10 @@ void cras_alert_destroy(struct cras_alert* alert) {
     free(data);
   }
 
+  if (alert->timer) {
+    cras_tm_cancel_timer(alert->tm, alert->timer);
+  }
+
   alert->callbacks = NULL;
   DL_DELETE(all_alerts, alert);
   free(alert);
@@ -237,9 +369,15 @@ void cras_alert_destroy(struct cras_alert* alert) {
 
 void cras_alert_destroy_all() {
   struct cras_alert* alert;
+  struct cras_alert_flush_cb_list* flush;
+
   DL_FOREACH (all_alerts, alert) {
     cras_alert_destroy(alert);
   }
+  DL_FOREACH (flush_callbacks, flush) {
+    DL_DELETE(flush_callbacks, flush);
+    free(flush);
+  }
 }
 
 void handle_alert_event_message(struct cras_main_message* msg, void* arg) {
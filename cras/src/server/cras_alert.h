@@ -7,6 +7,7 @@
 #define CRAS_SRC_SERVER_CRAS_ALERT_H_
 
 #include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -23,6 +24,11 @@ extern "C" {
  * example, if there are multiple nodes added at the same time, we will only
  * fire the "nodes changed" signal once).
  *
+ * Alerts that change in bursts, like volumes dragged with a slider, can also
+ * be given a minimum interval between two runs of their callbacks. Changes
+ * arriving within the interval are held, latest value wins, and delivered
+ * once the interval has passed.
+ *
  * There is an optional "prepare" function which can be provided when creating
  * an alert. It is called before we invoke the callbacks. This gives the owner
  * of each alert a chance to update the system to a consistent state before
@@ -32,6 +38,7 @@ extern "C" {
  */
 
 struct cras_alert;
+struct cras_tm;
 
 /* Callback functions to be notified when settings change. arg is a user
  * provided argument that will be passed back, data is extra info about the
@@ -39,6 +46,8 @@ struct cras_alert;
  */
 typedef void (*cras_alert_cb)(void* arg, void* data);
 typedef void (*cras_alert_prepare)(struct cras_alert* alert);
+// Called after a round of pending alerts has been processed.
+typedef void (*cras_alert_flush_cb)(void* arg);
 
 // Flags for alerts.
 enum CRAS_ALERT_FLAGS {
@@ -87,6 +96,18 @@ int cras_alert_rm_callback(struct cras_alert* alert,
                            cras_alert_cb cb,
                            void* arg);
 
+/* Limits how often the callbacks of an alert run. When the alert becomes
+ * pending within |ms| of the last run, the callbacks are delayed until |ms|
+ * have passed. Data queued meanwhile is coalesced as usual.
+ * Args:
+ *    alert - A pointer to the alert.
+ *    tm - Timer manager used to run the delayed callbacks.
+ *    ms - Minimum interval between two runs, 0 to disable the limit.
+ */
+void cras_alert_set_min_interval(struct cras_alert* alert,
+                                 struct cras_tm* tm,
+                                 unsigned int ms);
+
 /* Marks an alert as pending. We don't call the callbacks immediately when an
  * alert becomes pending, but will do that when
  * cras_alert_process_all_pending_alerts() is called.
@@ -110,6 +131,16 @@ void cras_alert_pending_data(struct cras_alert* alert,
                              void* data,
                              size_t data_size);
 
+/* Like cras_alert_pending_data, but only replaces pending data of the same
+ * |key|, so that the callbacks still run once per key. For example, volume
+ * changes of different nodes do not override each other. Has the same effect
+ * as cras_alert_pending_data for alerts with CRAS_ALERT_FLAG_KEEP_ALL_DATA.
+ */
+void cras_alert_pending_keyed_data(struct cras_alert* alert,
+                                   uint64_t key,
+                                   void* data,
+                                   size_t data_size);
+
 /* Processes all alerts that are pending.
  *
  * For all pending alerts, its prepare function will be called, then the
@@ -118,13 +149,30 @@ void cras_alert_pending_data(struct cras_alert* alert,
  */
 void cras_alert_process_all_pending_alerts();
 
+/* Adds a function called each time cras_alert_process_all_pending_alerts()
+ * has run callbacks, once no alert is pending anymore. Lets callbacks that
+ * buffer their work flush it once per round.
+ * Args:
+ *    cb - The flush function.
+ *    arg - Passed to |cb|.
+ * Returns:
+ *    0 on success or negative error code on failure.
+ */
+int cras_alert_add_flush_callback(cras_alert_flush_cb cb, void* arg);
+
+/* Removes a function added with cras_alert_add_flush_callback.
+ * Returns:
+ *    0 on success or negative error code on failure.
+ */
+int cras_alert_rm_flush_callback(cras_alert_flush_cb cb, void* arg);
+
 /* Frees the resources used by an alert.
  * Args:
  *    alert - A pointer to the alert.
  */
 void cras_alert_destroy(struct cras_alert* alert);
 
-// Frees the resources used by all alerts in the system.
+// Frees the resources used by all alerts and flush callbacks in the system.
 void cras_alert_destroy_all();
 
 // Initialize the alert message handler.
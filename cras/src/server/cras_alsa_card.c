@@ -73,6 +73,10 @@ struct cras_alsa_card {
   struct cras_card_config* config;
   enum CRAS_ALSA_CARD_TYPE card_type;
   struct cras_alsa_iodev_ops* ops;
+  // Control handle kept open between probe and attach.
+  snd_ctl_t* ctl;
+  // Name of the card reported by ALSA, valid between probe and attach.
+  char* card_name;
 };
 
 static struct cras_alsa_iodev_ops cras_alsa_iodev_ops_internal_ops = {
@@ -592,26 +596,28 @@ static void configure_echo_reference_dev(struct cras_alsa_card* alsa_card) {
  * Exported Interface.
  */
 
-struct cras_alsa_card* cras_alsa_card_create(struct cras_alsa_card_info* info,
-                                             const char* device_config_dir,
-                                             const char* ucm_suffix) {
-  snd_ctl_t* handle = NULL;
-  int rc, n;
+int cras_alsa_card_probe(struct cras_alsa_card_info* info,
+                         const char* device_config_dir,
+                         const char* ucm_suffix,
+                         struct cras_alsa_card** card) {
+  int rc;
   snd_ctl_card_info_t* card_info;
   const char* card_name;
   struct cras_alsa_card* alsa_card;
 
+  *card = NULL;
   if (info->card_index >= MAX_ALSA_CARDS) {
     syslog(LOG_ERR, "Invalid alsa card index %u", info->card_index);
-    return NULL;
+    return -EINVAL;
   }
 
   snd_ctl_card_info_alloca(&card_info);
 
   alsa_card = calloc(1, sizeof(*alsa_card));
   if (alsa_card == NULL) {
-    return NULL;
+    return -ENOMEM;
   }
+  *card = alsa_card;
   alsa_card->card_index = info->card_index;
   alsa_card->card_type = info->card_type;
 
@@ -621,13 +627,14 @@ struct cras_alsa_card* cras_alsa_card_create(struct cras_alsa_card_info* info,
     alsa_card->ops = &cras_alsa_iodev_ops_usb_ops;
   }
 
-  rc = snd_ctl_open(&handle, alsa_card->name.str, 0);
+  rc = snd_ctl_open(&alsa_card->ctl, alsa_card->name.str, 0);
   if (rc < 0) {
     syslog(LOG_ERR, "Fail opening control %s.", alsa_card->name.str);
+    alsa_card->ctl = NULL;
     goto error_bail;
   }
 
-  rc = snd_ctl_card_info(handle, card_info);
+  rc = snd_ctl_card_info(alsa_card->ctl, card_info);
   if (rc < 0) {
     syslog(LOG_WARNING, "Error getting card info.");
     goto error_bail;
@@ -638,6 +645,11 @@ struct cras_alsa_card* cras_alsa_card_create(struct cras_alsa_card_info* info,
     syslog(LOG_WARNING, "Error getting card name.");
     goto error_bail;
   }
+  alsa_card->card_name = strdup(card_name);
+  if (alsa_card->card_name == NULL) {
+    goto error_bail;
+  }
+  card_name = alsa_card->card_name;
 
   if (info->card_type == ALSA_CARD_TYPE_USB ||
       cras_system_check_ignore_ucm_suffix(card_name)) {
@@ -706,6 +718,26 @@ struct cras_alsa_card* cras_alsa_card_create(struct cras_alsa_card_info* info,
     syslog(LOG_WARNING, "Fail opening mixer for %s.", alsa_card->name.str);
     goto error_bail;
   }
+
+  return 0;
+
+error_bail:
+  /* Leave the partially probed card to the caller. Destroying it releases
+   * controls from the global control list, which is only safe on the main
+   * thread. */
+  return rc < 0 ? rc : -EIO;
+}
+
+int cras_alsa_card_attach(struct cras_alsa_card* alsa_card,
+                          struct cras_alsa_card_info* info) {
+  const char* card_name = alsa_card->card_name;
+  snd_ctl_t* handle = alsa_card->ctl;
+  int rc, n;
+
+  if (handle == NULL || card_name == NULL) {
+    return -EINVAL;
+  }
+
 #if CRAS_ALWAYS_ADD_CONTROLS_AND_IODEVS_WITH_UCM
   rc = add_controls_and_iodevs_with_ucm(info, alsa_card, card_name, handle);
 #else
@@ -717,7 +749,7 @@ struct cras_alsa_card* cras_alsa_card_create(struct cras_alsa_card_info* info,
   }
 #endif
   if (rc) {
-    goto error_bail;
+    return rc;
   }
 
   configure_echo_reference_dev(alsa_card);
@@ -730,8 +762,7 @@ struct cras_alsa_card* cras_alsa_card_create(struct cras_alsa_card_info* info,
 
     pollfds = malloc(n * sizeof(*pollfds));
     if (pollfds == NULL) {
-      rc = -ENOMEM;
-      goto error_bail;
+      return -ENOMEM;
     }
 
     n = snd_hctl_poll_descriptors(alsa_card->hctl, pollfds, n);
@@ -739,8 +770,7 @@ struct cras_alsa_card* cras_alsa_card_create(struct cras_alsa_card_info* info,
       registered_fd = calloc(1, sizeof(*registered_fd));
       if (registered_fd == NULL) {
         free(pollfds);
-        rc = -ENOMEM;
-        goto error_bail;
+        return -ENOMEM;
       }
       registered_fd->fd = pollfds[i].fd;
       DL_APPEND(alsa_card->hctl_poll_fds, registered_fd);
@@ -749,21 +779,30 @@ struct cras_alsa_card* cras_alsa_card_create(struct cras_alsa_card_info* info,
       if (rc < 0) {
         DL_DELETE(alsa_card->hctl_poll_fds, registered_fd);
         free(pollfds);
-        goto error_bail;
+        return rc;
       }
     }
     free(pollfds);
   }
 
-  snd_ctl_close(handle);
-  return alsa_card;
+  snd_ctl_close(alsa_card->ctl);
+  alsa_card->ctl = NULL;
+  free(alsa_card->card_name);
+  alsa_card->card_name = NULL;
+  return 0;
+}
 
-error_bail:
-  if (handle != NULL) {
-    snd_ctl_close(handle);
+struct cras_alsa_card* cras_alsa_card_create(struct cras_alsa_card_info* info,
+                                             const char* device_config_dir,
+                                             const char* ucm_suffix) {
+  struct cras_alsa_card* alsa_card;
+
+  if (cras_alsa_card_probe(info, device_config_dir, ucm_suffix, &alsa_card) ||
+      cras_alsa_card_attach(alsa_card, info)) {
+    cras_alsa_card_destroy(alsa_card);
+    return NULL;
   }
-  cras_alsa_card_destroy(alsa_card);
-  return NULL;
+  return alsa_card;
 }
 
 void cras_alsa_card_destroy(struct cras_alsa_card* alsa_card) {
@@ -796,6 +835,10 @@ void cras_alsa_card_destroy(struct cras_alsa_card* alsa_card) {
   if (alsa_card->config) {
     cras_card_config_destroy(alsa_card->config);
   }
+  if (alsa_card->ctl) {
+    snd_ctl_close(alsa_card->ctl);
+  }
+  free(alsa_card->card_name);
   cras_alsa_config_release_controls_on_card(alsa_card->card_index);
   free(alsa_card);
 }
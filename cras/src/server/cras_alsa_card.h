@@ -57,6 +57,39 @@ struct cras_alsa_card* cras_alsa_card_create(struct cras_alsa_card_info* info,
                                              const char* device_config_dir,
                                              const char* ucm_suffix);
 
+/* First half of cras_alsa_card_create.  Opens the card and loads its config,
+ * UCM, hctl and mixer without touching the iodev list or the main thread's
+ * select fds, so it may run on a worker thread while other cards are probed.
+ * Args:
+ *    card_info - Contains the card index, type, and priority.
+ *    device_config_dir - The directory of device configs which contains the
+ *                        volume curves.
+ *    ucm_suffix - The ucm config name is formed as <card-name>.<suffix>
+ *    card - Filled with the probed card. On error it may still point to a
+ *           partially probed card.
+ * Returns:
+ *    0 on success, negative error code otherwise.  A non-NULL *card must be
+ *    passed to cras_alsa_card_attach or freed with cras_alsa_card_destroy,
+ *    both on the main thread, even when the probe failed.
+ */
+int cras_alsa_card_probe(struct cras_alsa_card_info* info,
+                         const char* device_config_dir,
+                         const char* ucm_suffix,
+                         struct cras_alsa_card** card);
+
+/* Second half of cras_alsa_card_create.  Creates the iodevs of a card
+ * returned by cras_alsa_card_probe and registers its control fds.  Must be
+ * called from the main thread.
+ * Args:
+ *    alsa_card - The card returned by cras_alsa_card_probe.
+ *    card_info - The same info passed to cras_alsa_card_probe.
+ * Returns:
+ *    0 on success, negative error code otherwise.  On error the card must be
+ *    freed with cras_alsa_card_destroy.
+ */
+int cras_alsa_card_attach(struct cras_alsa_card* alsa_card,
+                          struct cras_alsa_card_info* info);
+
 /* Destroys a cras_alsa_card that was returned from cras_alsa_card_create.
  * Args:
  *    alsa_card - The cras_alsa_card pointer returned from
@@ -4,24 +4,36 @@
  */
 #include "cras/src/server/cras_alsa_common_io.h"
 
+#include <errno.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
 #include <syslog.h>
 #include <time.h>
 
+#include "cras/common/check.h"
 #include "cras/common/rust_common.h"
+#include "cras/server/cras_trace.h"
 #include "cras/server/s2/s2.h"
 #include "cras/src/common/cras_alsa_card_info.h"
+#include "cras/src/common/cras_string.h"
 #include "cras/src/server/audio_thread.h"
 #include "cras/src/server/cras_alsa_helpers.h"
 #include "cras/src/server/cras_alsa_jack.h"
+#include "cras/src/server/cras_alsa_mixer.h"
 #include "cras/src/server/cras_alsa_ucm.h"
 #include "cras/src/server/cras_iodev.h"
 #include "cras/src/server/cras_iodev_list.h"
 #include "cras/src/server/cras_server_metrics.h"
 #include "cras/src/server/cras_system_state.h"
+#include "cras/src/server/cras_volume_curve.h"
 #include "cras_iodev_info.h"
 #include "cras_types.h"
+#include "cras_util.h"
+#include "third_party/strlcpy/strlcpy.h"
+#include "third_party/superfasthash/sfh.h"
 #include "third_party/utlist/utlist.h"
 
 struct cras_ionode* first_plugged_node(struct cras_iodev* iodev) {
@@ -149,6 +161,116 @@ int cras_alsa_common_set_hwparams(struct cras_iodev* iodev, int period_wakeup) {
   return 0;
 }
 
+/*
+ * Hardware timestamps older than this are not used to schedule wake ups,
+ * the device has likely stopped updating hw_ptr.
+ */
+static const struct timespec tstamp_wake_max_age = {
+    0, 20 * 1000 * 1000  // 20 msec.
+};
+
+/*
+ * Records the error between the hw_level predicted from the last
+ * observation and the measured one.
+ */
+static void update_wake_prediction_error(struct alsa_common_io* aio,
+                                         unsigned int hw_level,
+                                         const struct timespec* hw_tstamp) {
+  struct alsa_common_wake_cadence* cadence = &aio->wake_cadence;
+  struct timespec elapsed;
+  unsigned int consumed, predicted, error;
+
+  if (!timespec_after(hw_tstamp, &cadence->last_hw_tstamp)) {
+    return;
+  }
+  subtract_timespecs(hw_tstamp, &cadence->last_hw_tstamp, &elapsed);
+  if (timespec_after(&elapsed, &tstamp_wake_max_age)) {
+    return;
+  }
+  consumed = cras_time_to_frames(&elapsed, aio->base.format->frame_rate);
+  predicted =
+      cadence->last_hw_level > consumed ? cadence->last_hw_level - consumed : 0;
+  error = predicted > hw_level ? predicted - hw_level : hw_level - predicted;
+  aio->base.max_wake_prediction_error =
+      MAX(aio->base.max_wake_prediction_error, error);
+}
+
+/*
+ * Records a playback hw_level observation. The hardware consumes frames in
+ * bursts, so the smallest non-zero drop of hw_level within a window
+ * approximates the amount consumed per hw_ptr update.
+ */
+static void update_wake_cadence(struct alsa_common_io* aio,
+                                unsigned int hw_level,
+                                const struct timespec* hw_tstamp) {
+  struct alsa_common_wake_cadence* cadence = &aio->wake_cadence;
+  unsigned int step;
+
+  if (cadence->has_last_hw_level && aio->policy.tstamp_wake_margin_us) {
+    update_wake_prediction_error(aio, hw_level, hw_tstamp);
+  }
+  if (cadence->has_last_hw_level && cadence->last_hw_level > hw_level) {
+    step = cadence->last_hw_level - hw_level;
+    if (!cadence->window_samples || step < cadence->window_min_step) {
+      cadence->window_min_step = step;
+    }
+    if (++cadence->window_samples >= ALSA_WAKE_CADENCE_WINDOW) {
+      cadence->packet_frames = cadence->window_min_step;
+      cadence->window_samples = 0;
+    }
+  }
+  cadence->has_last_hw_level = true;
+  cadence->last_hw_level = hw_level;
+  cadence->last_hw_tstamp = *hw_tstamp;
+}
+
+void cras_alsa_common_reset_wake_cadence(struct alsa_common_io* aio) {
+  unsigned int packet_frames = aio->wake_cadence.packet_frames;
+
+  /* Keep the last estimate. Only the current observation is invalid after
+   * appl_ptr moves, the hardware cadence does not change. */
+  memset(&aio->wake_cadence, 0, sizeof(aio->wake_cadence));
+  aio->wake_cadence.packet_frames = packet_frames;
+}
+
+unsigned int cras_alsa_common_frames_to_play_in_sleep(
+    struct cras_iodev* odev,
+    unsigned int* hw_level,
+    struct timespec* hw_tstamp) {
+  struct alsa_common_io* aio = (struct alsa_common_io*)odev;
+  struct timespec age;
+  unsigned int frames, pad;
+
+  if (!aio->policy.tstamp_wake_margin_us) {
+    frames =
+        cras_iodev_default_frames_to_play_in_sleep(odev, hw_level, hw_tstamp);
+  } else {
+    frames = cras_iodev_frames_to_play_in_sleep_until(
+        odev, hw_level, hw_tstamp, odev->tstamp_wake_margin_frames);
+    /* hw_level was sampled at the hardware timestamp, which can be well
+     * before it was read. Count the sleep from there so the wake up lands
+     * right before the predicted deadline. */
+    if (odev->streams && timespec_is_nonzero(&aio->hardware_timestamp) &&
+        !timespec_after(&aio->hardware_timestamp, hw_tstamp)) {
+      subtract_timespecs(hw_tstamp, &aio->hardware_timestamp, &age);
+      if (!timespec_after(&age, &tstamp_wake_max_age)) {
+        *hw_tstamp = aio->hardware_timestamp;
+      }
+    }
+  }
+  if (!odev->streams || !aio->policy.adaptive_wake) {
+    return frames;
+  }
+
+  /* Bound the padding so a bogus measurement can not make the audio thread
+   * wake up much more often than the streams need. */
+  pad = MIN(aio->wake_cadence.packet_frames, odev->min_cb_level / 2);
+  if (frames > pad) {
+    frames -= pad;
+  }
+  return frames;
+}
+
 int cras_alsa_common_frames_queued(const struct cras_iodev* iodev,
                                    struct timespec* tstamp) {
   struct alsa_common_io* aio = (struct alsa_common_io*)iodev;
@@ -174,6 +296,10 @@ int cras_alsa_common_frames_queued(const struct cras_iodev* iodev,
   }
 
   // For output, return number of frames that are used.
+  if (aio->policy.adaptive_wake || aio->policy.tstamp_wake_margin_us) {
+    update_wake_cadence(aio, iodev->buffer_size - frames,
+                        &aio->hardware_timestamp);
+  }
   return iodev->buffer_size - frames;
 }
 int cras_alsa_common_set_active_node(struct cras_iodev* iodev,
@@ -233,6 +359,7 @@ int cras_alsa_common_close_dev(const struct cras_iodev* iodev) {
   aio->free_running = 0;
   aio->filled_zeros_for_draining = 0;
   aio->hwparams_set = 0;
+  memset(&aio->wake_cadence, 0, sizeof(aio->wake_cadence));
   cras_iodev_free_format(&aio->base);
   cras_iodev_free_audio_area(&aio->base);
   free(aio->sample_buf);
@@ -321,3 +448,687 @@ struct alsa_common_node* cras_alsa_get_node_from_jack(
   DL_SEARCH_SCALAR_WITH_CAST(aio->base.nodes, node, anode, mixer, mixer);
   return anode;
 }
+
+/*
+ * Check if ALSA device is opened by checking if handle is valid.
+ * Note that to fully open a cras_iodev, ALSA device is opened first, then there
+ * are some device init settings to be done in init_device_settings.
+ * Therefore, when setting volume/mute/gain in init_device_settings,
+ * cras_iodev is not in CRAS_IODEV_STATE_OPEN yet. We need to check if handle
+ * is valid when setting those properties, instead of checking
+ * cras_iodev_is_open.
+ */
+static int has_handle(const struct alsa_common_io* aio) {
+  return !!aio->handle;
+}
+
+const struct cras_volume_curve* cras_alsa_common_get_curve_for_output_node(
+    const struct alsa_common_io* aio,
+    const struct alsa_common_node* node) {
+  if (node && node->volume_curve) {
+    return node->volume_curve;
+  }
+  return aio->default_volume_curve;
+}
+
+static const struct cras_volume_curve* get_curve_for_active_output(
+    const struct alsa_common_io* aio) {
+  return cras_alsa_common_get_curve_for_output_node(
+      aio, (const struct alsa_common_node*)aio->base.active_node);
+}
+
+/*
+ * Informs the system of the volume limits for this device.
+ */
+static void set_volume_limits(const struct alsa_common_io* aio) {
+  const struct cras_volume_curve* curve;
+
+  // Only set the limits if the dev is active.
+  if (!has_handle(aio)) {
+    return;
+  }
+
+  curve = get_curve_for_active_output(aio);
+  cras_system_set_volume_limits(curve->get_dBFS(curve, 1),  // min
+                                curve->get_dBFS(curve, CRAS_MAX_SYSTEM_VOLUME));
+}
+
+void cras_alsa_common_set_volume(struct cras_iodev* iodev) {
+  const struct alsa_common_io* aio = (const struct alsa_common_io*)iodev;
+  const struct cras_volume_curve* curve;
+  size_t volume;
+  struct alsa_common_node* aout;
+
+  CRAS_CHECK(aio);
+  if (aio->mixer == NULL) {
+    return;
+  }
+
+  volume = cras_system_get_volume();
+  curve = get_curve_for_active_output(aio);
+  if (curve == NULL) {
+    return;
+  }
+  aout = (struct alsa_common_node*)iodev->active_node;
+  if (aout) {
+    volume = cras_iodev_adjust_node_volume(&aout->base, volume);
+  }
+
+  /* Samples get scaled for devices using software volume, set alsa
+   * volume to 100. */
+  if (cras_iodev_software_volume_needed(iodev)) {
+    volume = 100;
+  }
+
+  cras_alsa_mixer_set_dBFS(aio->mixer, curve->get_dBFS(curve, volume),
+                           aout ? aout->mixer : NULL);
+}
+
+void cras_alsa_common_set_mute(struct cras_iodev* iodev) {
+  const struct alsa_common_io* aio = (const struct alsa_common_io*)iodev;
+  struct alsa_common_node* aout;
+
+  if (!has_handle(aio)) {
+    return;
+  }
+
+  aout = (struct alsa_common_node*)iodev->active_node;
+  cras_alsa_mixer_set_mute(aio->mixer, cras_system_get_mute(),
+                           aout ? aout->mixer : NULL);
+}
+
+/*
+ * Sets the capture gain according to the current active node's
+ * |internal_capture_gain| in dBFS. Multiple nodes could share common
+ * mixer controls so this needs to be called every time when active
+ * node changes.
+ */
+static void set_capture_gain(struct cras_iodev* iodev) {
+  const struct alsa_common_io* aio = (const struct alsa_common_io*)iodev;
+  struct alsa_common_node* ain;
+  long min_capture_gain, max_capture_gain, gain;
+  CRAS_CHECK(aio);
+  if (aio->mixer == NULL) {
+    return;
+  }
+
+  // Only set the volume if the dev is active.
+  if (!has_handle(aio)) {
+    return;
+  }
+
+  if (aio->policy.keep_capture_gain_without_ucm && !aio->ucm) {
+    return;
+  }
+
+  ain = (struct alsa_common_node*)iodev->active_node;
+  struct mixer_control* mixer = ain ? ain->mixer : NULL;
+
+  // Set hardware gain to 0dB if software gain is needed.
+  if (cras_iodev_software_volume_needed(iodev)) {
+    gain = 0;
+  } else {
+    min_capture_gain = cras_alsa_mixer_get_minimum_capture_gain(aio->mixer,
+                                                                mixer);
+    max_capture_gain = cras_alsa_mixer_get_maximum_capture_gain(aio->mixer,
+                                                                mixer);
+    gain = MAX(iodev->active_node->internal_capture_gain, min_capture_gain);
+    gain = MIN(gain, max_capture_gain);
+  }
+
+  cras_alsa_mixer_set_capture_dBFS(aio->mixer, gain, mixer);
+}
+
+void cras_alsa_common_init_device_settings(struct alsa_common_io* aio) {
+  /* Register for volume/mute callback and set initial volume/mute for
+   * the device. */
+  if (aio->base.direction == CRAS_STREAM_OUTPUT) {
+    set_volume_limits(aio);
+    cras_alsa_common_set_volume(&aio->base);
+    cras_alsa_common_set_mute(&aio->base);
+  } else {
+    set_capture_gain(&aio->base);
+  }
+}
+
+int cras_alsa_common_set_node_swapped(struct cras_iodev* iodev,
+                                      struct cras_ionode* node,
+                                      int enable) {
+  const struct alsa_common_io* aio = (const struct alsa_common_io*)iodev;
+  const struct alsa_common_node* anode = (const struct alsa_common_node*)node;
+  CRAS_CHECK(aio);
+  return ucm_enable_swap_mode(aio->ucm, anode->ucm_name, enable);
+}
+
+/*
+ * Reads an integer flag from the UCM config. Returns 0 if the device has no
+ * UCM config or the flag is not set.
+ */
+static int get_ucm_flag_integer(const struct alsa_common_io* aio,
+                                const char* flag_name) {
+  char* value;
+  int i;
+
+  if (!aio->ucm) {
+    return 0;
+  }
+
+  value = ucm_get_flag(aio->ucm, flag_name);
+  if (!value) {
+    return 0;
+  }
+
+  int rc = parse_int(value, &i);
+  free(value);
+  if (rc < 0) {
+    return 0;
+  }
+  return i;
+}
+
+int cras_alsa_common_no_create_default_node(const struct alsa_common_io* aio) {
+  return get_ucm_flag_integer(aio, aio->base.direction == CRAS_STREAM_OUTPUT
+                                       ? "NoCreateDefaultOutputNode"
+                                       : "NoCreateDefaultInputNode");
+}
+
+void cras_alsa_common_check_auto_unplug_node(struct alsa_common_io* aio,
+                                             struct cras_ionode* node,
+                                             int plugged) {
+  struct cras_ionode* tmp;
+  const char* internal_name;
+
+  if (aio->base.direction == CRAS_STREAM_OUTPUT) {
+    if (!get_ucm_flag_integer(aio, "AutoUnplugOutputNode")) {
+      return;
+    }
+    internal_name = INTERNAL_SPEAKER;
+  } else {
+    if (!get_ucm_flag_integer(aio, "AutoUnplugInputNode")) {
+      return;
+    }
+    internal_name = INTERNAL_MICROPHONE;
+  }
+
+  /* Auto unplug the internal speaker or mic if any other node has been
+   * created. */
+  if (!strcmp(node->name, internal_name) && plugged) {
+    DL_FOREACH (aio->base.nodes, tmp) {
+      if (tmp->plugged && (tmp != node)) {
+        cras_iodev_set_node_plugged(node, 0);
+      }
+    }
+  } else {
+    DL_FOREACH (aio->base.nodes, tmp) {
+      if (!strcmp(tmp->name, internal_name)) {
+        cras_iodev_set_node_plugged(tmp, !plugged);
+      }
+    }
+  }
+}
+
+static void set_input_default_node_gain(struct alsa_common_io* aio,
+                                        struct alsa_common_node* input) {
+  long gain;
+  struct cras_ionode* node = &input->base;
+
+  node->internal_capture_gain = DEFAULT_CAPTURE_GAIN;
+  node->ui_gain_scaler = 1.0f;
+
+  if (!aio->ucm) {
+    return;
+  }
+
+  if (ucm_get_default_node_gain(aio->ucm, input->ucm_name, &gain) == 0) {
+    node->internal_capture_gain = gain;
+  }
+}
+
+static void set_input_node_intrinsic_sensitivity(
+    struct alsa_common_io* aio,
+    struct alsa_common_node* input) {
+  struct cras_ionode* node = &input->base;
+  long sensitivity;
+  int rc;
+
+  node->intrinsic_sensitivity = 0;
+
+  if (aio->ucm) {
+    rc = ucm_get_intrinsic_sensitivity(aio->ucm, input->ucm_name,
+                                       &sensitivity);
+    if (rc) {
+      return;
+    }
+  } else if (aio->policy.keep_capture_gain_without_ucm) {
+    // Trust the default capture gain, so the software gain is 0.
+    sensitivity = DEFAULT_CAPTURE_VOLUME_DBFS;
+  } else {
+    return;
+  }
+  node->intrinsic_sensitivity = sensitivity;
+  node->internal_capture_gain = DEFAULT_CAPTURE_VOLUME_DBFS - sensitivity;
+  syslog(LOG_DEBUG,
+         "card type: %s, Use software gain %ld for %s because "
+         "IntrinsicSensitivity %ld is specified in UCM",
+         cras_card_type_to_string(aio->card_type), node->internal_capture_gain,
+         node->name, sensitivity);
+}
+
+void cras_alsa_common_init_node(struct alsa_common_io* aio,
+                                struct alsa_common_node* anode,
+                                struct mixer_control* mixer,
+                                const char* name) {
+  struct cras_iodev* iodev = &aio->base;
+  struct cras_ionode* node = &anode->base;
+  int err;
+
+  node->dev = iodev;
+  node->idx = aio->next_ionode_index++;
+  node->stable_id = SuperFastHash(name, strlen(name), iodev->info.stable_id);
+  anode->mixer = mixer;
+  strlcpy(node->name, name, sizeof(node->name));
+  strlcpy(anode->ucm_name, name, sizeof(anode->ucm_name));
+
+  if (iodev->direction == CRAS_STREAM_INPUT) {
+    set_input_default_node_gain(aio, anode);
+    set_input_node_intrinsic_sensitivity(aio, anode);
+  }
+
+  if (!aio->ucm) {
+    return;
+  }
+
+  // Check if channel map is specified in UCM.
+  anode->channel_layout =
+      (int8_t*)malloc(CRAS_CH_MAX * sizeof(*anode->channel_layout));
+  if (iodev->direction == CRAS_STREAM_OUTPUT) {
+    err = ucm_get_playback_chmap_for_dev(aio->ucm, name,
+                                         anode->channel_layout);
+  } else {
+    err = ucm_get_capture_chmap_for_dev(aio->ucm, name, anode->channel_layout);
+  }
+  if (err) {
+    free(anode->channel_layout);
+    anode->channel_layout = 0;
+  }
+
+  if (iodev->direction == CRAS_STREAM_INPUT &&
+      ucm_get_preempt_hotword(aio->ucm, name)) {
+    iodev->pre_open_iodev_hook = cras_iodev_list_suspend_hotword_streams;
+    iodev->post_close_iodev_hook = cras_iodev_list_resume_hotword_stream;
+  }
+
+  node->dsp_name = ucm_get_dsp_name_for_dev(aio->ucm, name);
+
+  // Do we have a specified latency offset
+  int latency = 0;
+  if (!ucm_get_latency_offset_ms(aio->ucm, name, &latency)) {
+    node->latency_offset_ms = latency;
+  }
+}
+
+void cras_alsa_common_add_node(struct alsa_common_io* aio,
+                               struct alsa_common_node* anode) {
+  struct cras_ionode* node = &anode->base;
+
+  if (aio->base.direction == CRAS_STREAM_INPUT) {
+    node->nc_providers = cras_alsa_common_get_nc_providers(aio->ucm, node);
+  }
+  cras_iodev_add_node(&aio->base, node);
+  cras_alsa_common_check_auto_unplug_node(aio, node, node->plugged);
+}
+
+int cras_alsa_common_get_buffer(struct cras_iodev* iodev,
+                                struct cras_audio_area** area,
+                                unsigned* frames) {
+  struct alsa_common_io* aio = (struct alsa_common_io*)iodev;
+  snd_pcm_uframes_t nframes = MIN(iodev->buffer_size, *frames);
+
+  aio->mmap_offset = 0;
+  size_t format_bytes = cras_get_format_bytes(iodev->format);
+
+  int rc = cras_alsa_mmap_begin(aio->handle, format_bytes, &aio->mmap_buf,
+                                &aio->mmap_offset, &nframes);
+  if (rc < 0) {
+    aio->mmap_buf = NULL;
+    return rc;
+  }
+  iodev->area->frames = nframes;
+  // Copy mmap_buf data to local memory for faster manipulation.
+  // Check `cras_bench --benchmark_filter=BM_Alsa/MmapBuffer` for analysis.
+  if (iodev->direction == CRAS_STREAM_INPUT) {
+    if (nframes > iodev->input_dsp_offset) {
+      if (!aio->sample_buf) {
+        syslog(LOG_WARNING, "sample_buf is NULL");
+        return -EINVAL;
+      }
+      if (iodev->active_node) {
+        cras_trace_frames(iodev->active_node->type, nframes);
+      }
+      memcpy(aio->sample_buf + iodev->input_dsp_offset * format_bytes,
+             aio->mmap_buf + iodev->input_dsp_offset * format_bytes,
+             (nframes - iodev->input_dsp_offset) * format_bytes);
+    }
+  }
+
+  *area = iodev->area;
+  *frames = nframes;
+
+  return rc;
+}
+
+int cras_alsa_common_put_buffer(struct cras_iodev* iodev, unsigned nwritten) {
+  struct alsa_common_io* aio = (struct alsa_common_io*)iodev;
+
+  size_t format_bytes = cras_get_format_bytes(iodev->format);
+  if (iodev->direction == CRAS_STREAM_OUTPUT) {
+    if (!aio->sample_buf) {
+      syslog(LOG_WARNING, "sample_buf is NULL");
+      return -EINVAL;
+    }
+    if (!aio->mmap_buf) {
+      syslog(LOG_WARNING, "mmap_buf is NULL");
+      return -EINVAL;
+    }
+    if (nwritten > iodev->area->frames) {
+      syslog(LOG_ERR, "nwritten: %d > iodev->area->frames: %d", nwritten,
+             iodev->area->frames);
+      return -EINVAL;
+    }
+
+    if (iodev->active_node) {
+      cras_trace_frames(iodev->active_node->type, nwritten);
+    }
+
+    size_t total_size = (size_t)nwritten * (size_t)format_bytes;
+    if (aio->policy.bytewise_mmap_copy) {
+      // Perform the copy byte-by-byte
+      char* src = (char*)aio->sample_buf;
+      char* dest = (char*)aio->mmap_buf;
+      for (size_t i = 0; i < total_size; ++i) {
+        dest[i] = src[i];
+      }
+    } else {
+      memcpy(aio->mmap_buf, aio->sample_buf, total_size);
+    }
+
+    unsigned int max_offset = cras_iodev_max_stream_offset(iodev);
+    if (max_offset) {
+      memmove(aio->sample_buf, aio->sample_buf + nwritten * format_bytes,
+              max_offset * format_bytes);
+    }
+    aio->wake_cadence.last_hw_level += nwritten;
+  } else {
+    // CRAS applied input DSP on the uncommitted data, move then to the
+    // beginning.
+    if (iodev->input_dsp_offset) {
+      memmove(aio->sample_buf, aio->sample_buf + nwritten * format_bytes,
+              iodev->input_dsp_offset * format_bytes);
+    }
+  }
+
+  return cras_alsa_mmap_commit(aio->handle, aio->mmap_offset, nwritten);
+}
+
+int cras_alsa_common_flush_buffer(struct cras_iodev* iodev) {
+  struct alsa_common_io* aio = (struct alsa_common_io*)iodev;
+  snd_pcm_uframes_t nframes;
+
+  if (iodev->direction == CRAS_STREAM_INPUT) {
+    nframes = snd_pcm_forwardable(aio->handle);
+    return snd_pcm_forward(aio->handle, nframes);
+  }
+  return 0;
+}
+
+int cras_alsa_common_fill_whole_buffer_with_zeros(struct cras_iodev* iodev) {
+  struct alsa_common_io* aio = (struct alsa_common_io*)iodev;
+  int rc;
+  uint8_t* dst = NULL;
+  size_t format_bytes;
+
+  // Fill whole buffer with zeros.
+  rc = cras_alsa_mmap_get_whole_buffer(aio->handle, &dst);
+
+  if (rc < 0) {
+    syslog(LOG_WARNING, "card type: %s, Failed to get whole buffer: %s",
+           cras_card_type_to_string(aio->card_type), snd_strerror(rc));
+    return rc;
+  }
+  format_bytes = cras_get_format_bytes(iodev->format);
+  memset(dst, 0, iodev->buffer_size * format_bytes);
+  cras_iodev_stream_offset_reset_all(iodev);
+
+  return iodev->buffer_size;
+}
+
+/*
+ * Move appl_ptr to min_buffer_level + min_cb_level frames ahead of hw_ptr
+ * when resuming from free run.
+ */
+static int adjust_appl_ptr_for_leaving_free_run(struct cras_iodev* odev) {
+  struct alsa_common_io* aio = (struct alsa_common_io*)odev;
+  snd_pcm_uframes_t ahead;
+
+  ahead = odev->min_buffer_level + odev->min_cb_level;
+  cras_alsa_common_reset_wake_cadence(aio);
+  return cras_alsa_resume_appl_ptr(aio->handle, ahead, NULL);
+}
+
+/*
+ * Move appl_ptr to min_buffer_level + min_cb_level * 1.5 frames ahead of
+ * hw_ptr when adjusting appl_ptr from underrun.
+ */
+static int adjust_appl_ptr_for_underrun(struct cras_iodev* odev) {
+  struct alsa_common_io* aio = (struct alsa_common_io*)odev;
+  snd_pcm_uframes_t ahead;
+  int actual_appl_ptr_displacement = 0;
+  int rc;
+
+  ahead = odev->min_buffer_level + odev->min_cb_level + odev->min_cb_level / 2;
+  cras_alsa_common_reset_wake_cadence(aio);
+  rc = cras_alsa_resume_appl_ptr(aio->handle, ahead,
+                                 &actual_appl_ptr_displacement);
+  /* If appl_ptr is actually adjusted, report the glitch.
+   * The duration of the glitch is calculated using the number of frames that
+   * the appl_ptr is actually adjusted by*/
+  if (actual_appl_ptr_displacement > 0) {
+    cras_iodev_update_underrun_duration(odev, actual_appl_ptr_displacement);
+  }
+
+  return rc;
+}
+
+/* This function is for leaving no-stream state but still not in free run yet.
+ * The device may have valid samples remaining. We need to adjust appl_ptr to
+ * the correct position, which is MAX(min_cb_level + min_buffer_level,
+ * valid_sample) */
+static int adjust_appl_ptr_samples_remaining(struct cras_iodev* odev) {
+  struct alsa_common_io* aio = (struct alsa_common_io*)odev;
+  int rc;
+  unsigned int real_hw_level, valid_sample, offset;
+  struct timespec hw_tstamp;
+
+  /* Get the amount of valid samples which haven't been played yet.
+   * The real_hw_level is the real hw_level in device buffer. It doesn't
+   * subtract min_buffer_level. */
+  valid_sample = 0;
+  rc = odev->frames_queued(odev, &hw_tstamp);
+  if (rc < 0) {
+    return rc;
+  }
+  real_hw_level = rc;
+
+  /*
+   * If underrun happened, handle it. Because output_underrun function
+   * has already called adjust_appl_ptr, we don't need to call it again.
+   */
+  if (real_hw_level <= odev->min_buffer_level) {
+    return cras_iodev_output_underrun(odev, real_hw_level, 0);
+  }
+
+  if (real_hw_level > aio->filled_zeros_for_draining) {
+    valid_sample = real_hw_level - aio->filled_zeros_for_draining;
+  }
+
+  offset = MAX(odev->min_buffer_level + odev->min_cb_level, valid_sample);
+
+  // Fill zeros to make sure there are enough zero samples in device buffer.
+  if (offset > real_hw_level) {
+    rc = cras_iodev_fill_odev_zeros(odev, offset - real_hw_level, true);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+  cras_alsa_common_reset_wake_cadence(aio);
+  return cras_alsa_resume_appl_ptr(aio->handle, offset, NULL);
+}
+
+int cras_alsa_common_output_underrun(struct cras_iodev* odev) {
+  int rc, filled_frames;
+
+  /* Fill whole buffer with zeros. This avoids samples left in buffer causing
+   * noise when device plays them. */
+  filled_frames = cras_alsa_common_fill_whole_buffer_with_zeros(odev);
+  if (filled_frames < 0) {
+    return filled_frames;
+  }
+
+  // Adjust appl_ptr to leave underrun.
+  rc = adjust_appl_ptr_for_underrun(odev);
+  if (rc < 0) {
+    return rc;
+  }
+
+  return filled_frames;
+}
+
+static int possibly_enter_free_run(struct cras_iodev* odev) {
+  struct alsa_common_io* aio = (struct alsa_common_io*)odev;
+  int rc;
+  unsigned int real_hw_level, fr_to_write;
+  struct timespec hw_tstamp;
+
+  if (aio->free_running) {
+    return 0;
+  }
+
+  /* Check if all valid samples are played. If all valid samples are played,
+   * fill whole buffer with zeros. The real_hw_level is the real hw_level in
+   * device buffer. It doesn't subtract min_buffer_level.*/
+  rc = odev->frames_queued(odev, &hw_tstamp);
+  if (rc < 0) {
+    return rc;
+  }
+  real_hw_level = rc;
+
+  // If underrun happened, handle it and enter free run state.
+  if (real_hw_level <= odev->min_buffer_level) {
+    rc = cras_iodev_output_underrun(odev, real_hw_level, 0);
+    if (rc < 0) {
+      return rc;
+    }
+    aio->free_running = 1;
+    return 0;
+  }
+
+  if (real_hw_level <= aio->filled_zeros_for_draining || real_hw_level == 0) {
+    rc = cras_alsa_common_fill_whole_buffer_with_zeros(odev);
+    if (rc < 0) {
+      return rc;
+    }
+    aio->free_running = 1;
+    return 0;
+  }
+
+  // Fill zeros to drain valid samples.
+  fr_to_write = MIN(cras_time_to_frames(&no_stream_fill_zeros_duration,
+                                        odev->format->frame_rate),
+                    odev->buffer_size - real_hw_level);
+  rc = cras_iodev_fill_odev_zeros(odev, fr_to_write, true);
+  if (rc < 0) {
+    return rc;
+  }
+  aio->filled_zeros_for_draining += fr_to_write;
+
+  return 0;
+}
+
+static int leave_free_run(struct cras_iodev* odev) {
+  struct alsa_common_io* aio = (struct alsa_common_io*)odev;
+  int rc;
+
+  /* Restart rate estimation because free run internval should not
+   * be included. */
+  cras_iodev_reset_rate_estimator(odev);
+
+  if (aio->free_running) {
+    rc = adjust_appl_ptr_for_leaving_free_run(odev);
+  } else {
+    rc = adjust_appl_ptr_samples_remaining(odev);
+  }
+  if (rc < 0) {
+    syslog(LOG_WARNING, "device %s failed to leave free run, rc = %d",
+           odev->info.name, rc);
+    return rc;
+  }
+  aio->free_running = 0;
+  aio->filled_zeros_for_draining = 0;
+
+  return 0;
+}
+
+/*
+ * Free run state is the optimization of no_stream playback on alsa_io.
+ * The whole buffer will be filled with zeros. Device can play these zeros
+ * indefinitely. When there is new meaningful sample, appl_ptr should be
+ * resumed to some distance ahead of hw_ptr.
+ */
+int cras_alsa_common_no_stream(struct cras_iodev* odev, int enable) {
+  if (enable) {
+    return possibly_enter_free_run(odev);
+  } else {
+    return leave_free_run(odev);
+  }
+}
+
+int cras_alsa_common_is_free_running(const struct cras_iodev* odev) {
+  const struct alsa_common_io* aio = (const struct alsa_common_io*)odev;
+
+  return aio->free_running;
+}
+
+unsigned int cras_alsa_common_get_num_severe_underruns(
+    const struct cras_iodev* iodev) {
+  const struct alsa_common_io* aio = (const struct alsa_common_io*)iodev;
+  return aio->num_severe_underruns;
+}
+
+int cras_alsa_common_get_valid_frames(struct cras_iodev* odev,
+                                      struct timespec* tstamp) {
+  struct alsa_common_io* aio = (struct alsa_common_io*)odev;
+  int rc;
+  unsigned int real_hw_level;
+
+  /*
+   * Get the amount of valid frames which haven't been played yet.
+   * The real_hw_level is the real hw_level in device buffer. It doesn't
+   * subtract min_buffer_level.
+   */
+  if (aio->free_running) {
+    clock_gettime(CLOCK_MONOTONIC_RAW, tstamp);
+    return 0;
+  }
+
+  rc = odev->frames_queued(odev, tstamp);
+  if (rc < 0) {
+    return rc;
+  }
+  real_hw_level = rc;
+
+  if (real_hw_level > aio->filled_zeros_for_draining) {
+    return real_hw_level - aio->filled_zeros_for_draining;
+  }
+
+  return 0;
+}
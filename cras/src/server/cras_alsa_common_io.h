@@ -83,6 +83,50 @@ static const struct timespec no_stream_fill_zeros_duration = {
     0, 50 * 1000 * 1000  // 50 msec.
 };
 
+/*
+ * Number of hw_level observations the playback cadence tracker collects
+ * before it refreshes its estimate of frames consumed per hw_ptr update.
+ */
+#define ALSA_WAKE_CADENCE_WINDOW 32
+
+/*
+ * Per device class behavior of the shared ALSA iodev implementation.
+ */
+struct alsa_common_policy {
+  // Copy playback samples into the mmap area one byte at a time instead of
+  // memcpy. Used for DMA buffers that may be mapped as device memory.
+  bool bytewise_mmap_copy;
+  // Wake up earlier by the measured hw_ptr update granularity for playback.
+  // Used by devices whose hw_ptr advances in bursts (e.g. one USB URB).
+  bool adaptive_wake;
+  // If non-zero, schedule playback wake ups from the hardware timestamp of
+  // the last hw_ptr update and keep this much audio, in microseconds, in the
+  // buffer at wake up instead of the default 1ms.
+  unsigned int tstamp_wake_margin_us;
+  // Without a UCM config, leave the hardware capture gain as is and apply
+  // no software gain. Used by devices whose default gain can be trusted.
+  bool keep_capture_gain_without_ucm;
+};
+
+/*
+ * Tracks how many frames the hardware consumes per hw_ptr update so the
+ * playback wake up time can be padded accordingly.
+ */
+struct alsa_common_wake_cadence {
+  // Whether last_hw_level holds a valid observation.
+  bool has_last_hw_level;
+  // hw_level of last observation plus the frames written since then.
+  unsigned int last_hw_level;
+  // Hardware timestamp of the last observation.
+  struct timespec last_hw_tstamp;
+  // Smallest non-zero consumption seen in the current window.
+  unsigned int window_min_step;
+  // Number of non-zero consumption samples in the current window.
+  unsigned int window_samples;
+  // Estimated frames consumed per hw_ptr update, 0 if unknown.
+  unsigned int packet_frames;
+};
+
 struct alsa_common_io {
   // The cras_iodev structure "base class".
   struct cras_iodev base;
@@ -152,6 +196,10 @@ struct alsa_common_io {
   // Pointer to sample buffer. It's malloc in configure_dev() and
   // free in close_dev().
   uint8_t* sample_buf;
+  // Behavior differences between the device classes sharing this code.
+  struct alsa_common_policy policy;
+  // Measured playback hw_ptr cadence, used when policy.adaptive_wake is set.
+  struct alsa_common_wake_cadence wake_cadence;
 };
 
 struct alsa_common_node {
@@ -166,6 +214,8 @@ struct alsa_common_node {
   const struct cras_alsa_jack* jack;
   // Customized channel layout with the node.
   int8_t* channel_layout;
+  // Volume curve for this node, only used by output nodes.
+  struct cras_volume_curve* volume_curve;
 };
 
 struct cras_ionode* first_plugged_node(struct cras_iodev* iodev);
@@ -193,6 +243,54 @@ int cras_alsa_common_open_dev(struct cras_iodev* iodev, const char* pcm_name);
 int cras_alsa_common_get_htimestamp(const struct cras_iodev* iodev,
                                     struct timespec* ts);
 int cras_alsa_get_fixed_rate(struct alsa_common_io* aio);
+int cras_alsa_common_get_buffer(struct cras_iodev* iodev,
+                                struct cras_audio_area** area,
+                                unsigned* frames);
+int cras_alsa_common_put_buffer(struct cras_iodev* iodev, unsigned nwritten);
+int cras_alsa_common_flush_buffer(struct cras_iodev* iodev);
+
+/*
+ * Fills the whole device buffer with zeros. Returns the number of frames
+ * filled or a negative error code.
+ */
+int cras_alsa_common_fill_whole_buffer_with_zeros(struct cras_iodev* iodev);
+
+/*
+ * Handles playback underrun by filling the buffer with zeros and moving
+ * appl_ptr ahead of hw_ptr. Returns the number of zero frames filled.
+ */
+int cras_alsa_common_output_underrun(struct cras_iodev* odev);
+
+/*
+ * Enters or leaves the free run state used for no_stream playback.
+ */
+int cras_alsa_common_no_stream(struct cras_iodev* odev, int enable);
+int cras_alsa_common_is_free_running(const struct cras_iodev* odev);
+unsigned int cras_alsa_common_get_num_severe_underruns(
+    const struct cras_iodev* iodev);
+int cras_alsa_common_get_valid_frames(struct cras_iodev* odev,
+                                      struct timespec* tstamp);
+
+/*
+ * Forgets the measured playback cadence. Called whenever appl_ptr is moved
+ * outside of put_buffer so that the jump is not taken as consumption.
+ */
+void cras_alsa_common_reset_wake_cadence(struct alsa_common_io* aio);
+
+/*
+ * frames_to_play_in_sleep for devices with policy.adaptive_wake or
+ * policy.tstamp_wake_margin_us.
+ * With adaptive_wake, pads the wake up time by the measured hw_ptr update
+ * granularity so the audio thread wakes before the last full packet in the
+ * buffer is taken.
+ * With tstamp_wake_margin_us, the sleep is counted from the hardware
+ * timestamp of hw_level rather than from the time it was read, and the
+ * audio thread wakes when the predicted level reaches the margin.
+ */
+unsigned int cras_alsa_common_frames_to_play_in_sleep(
+    struct cras_iodev* odev,
+    unsigned int* hw_level,
+    struct timespec* hw_tstamp);
 size_t cras_alsa_get_fixed_channels(struct alsa_common_io* aio);
 
 /*
@@ -202,6 +300,70 @@ struct alsa_common_node* cras_alsa_get_node_from_jack(
     struct alsa_common_io* aio,
     const struct cras_alsa_jack* jack);
 
+/*
+ * Gets the curve for an output node. If the node doesn't have volume curve
+ * specified, return the default volume curve of the common iodev.
+ */
+const struct cras_volume_curve* cras_alsa_common_get_curve_for_output_node(
+    const struct alsa_common_io* aio,
+    const struct alsa_common_node* node);
+
+/*
+ * Sets the volume of the playback device to the specified level. Receives a
+ * volume index from the system settings, ranging from 0 to 100, converts it to
+ * dB using the volume curve, and sends the dB value to alsa.
+ */
+void cras_alsa_common_set_volume(struct cras_iodev* iodev);
+
+/*
+ * Sets the alsa mute control for this iodev.
+ */
+void cras_alsa_common_set_mute(struct cras_iodev* iodev);
+
+/*
+ * Initializes the device settings according to system volume, mute, and
+ * the active node's gain settings.
+ */
+void cras_alsa_common_init_device_settings(struct alsa_common_io* aio);
+
+/*
+ * Swaps the left and right channels of the given node.
+ */
+int cras_alsa_common_set_node_swapped(struct cras_iodev* iodev,
+                                      struct cras_ionode* node,
+                                      int enable);
+
+/*
+ * Returns non-zero if UCM suppresses the default node for the direction of
+ * this device.
+ */
+int cras_alsa_common_no_create_default_node(const struct alsa_common_io* aio);
+
+/*
+ * If UCM asks for it, unplugs the internal speaker or mic when another node
+ * of the device is plugged, and plugs it back when that node is unplugged.
+ */
+void cras_alsa_common_check_auto_unplug_node(struct alsa_common_io* aio,
+                                             struct cras_ionode* node,
+                                             int plugged);
+
+/*
+ * Fills in a newly allocated node: index, stable id, name, mixer control,
+ * the default capture gain for inputs and the per device UCM settings.
+ * The caller then sets the node type and plugged state, and adds it with
+ * cras_alsa_common_add_node().
+ */
+void cras_alsa_common_init_node(struct alsa_common_io* aio,
+                                struct alsa_common_node* anode,
+                                struct mixer_control* mixer,
+                                const char* name);
+
+/*
+ * Adds a node set up by cras_alsa_common_init_node() to the iodev.
+ */
+void cras_alsa_common_add_node(struct alsa_common_io* aio,
+                               struct alsa_common_node* anode);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
@@ -64,8 +64,6 @@
  */
 struct alsa_output_node {
   struct alsa_common_node common;
-  // Volume curve for this node.
-  struct cras_volume_curve* volume_curve;
 };
 
 struct alsa_input_node {
@@ -102,8 +100,6 @@ struct alsa_io_group {
   struct alsa_io* nodes_owner;
 };
 
-static void init_device_settings(struct alsa_io* aio);
-
 static int alsa_iodev_set_active_node(struct cras_iodev* iodev,
                                       struct cras_ionode* ionode,
                                       unsigned dev_enabled);
@@ -305,6 +301,9 @@ static int configure_dev(struct cras_iodev* iodev) {
   aio->common.filled_zeros_for_draining = 0;
   aio->common.severe_underrun_frames =
       SEVERE_UNDERRUN_MS * iodev->format->frame_rate / 1000;
+  iodev->tstamp_wake_margin_frames =
+      (uint64_t)aio->common.policy.tstamp_wake_margin_us *
+      iodev->format->frame_rate / 1000000;
 
   size_t fmt_bytes = cras_get_format_bytes(iodev->format);
   cras_iodev_init_audio_area(iodev);
@@ -353,7 +352,7 @@ static int configure_dev(struct cras_iodev* iodev) {
   }
 
   // Initialize device settings.
-  init_device_settings(aio);
+  cras_alsa_common_init_device_settings(&aio->common);
 
   if (iodev->active_node->type == CRAS_NODE_TYPE_HOTWORD) {
     struct pollfd* ufds;
@@ -406,19 +405,6 @@ static int configure_dev(struct cras_iodev* iodev) {
   return 0;
 }
 
-/*
- * Check if ALSA device is opened by checking if handle is valid.
- * Note that to fully open a cras_iodev, ALSA device is opened first, then there
- * are some device init settings to be done in init_device_settings.
- * Therefore, when setting volume/mute/gain in init_device_settings,
- * cras_iodev is not in CRAS_IODEV_STATE_OPEN yet. We need to check if handle
- * is valid when setting those properties, instead of checking
- * cras_iodev_is_open.
- */
-static int has_handle(const struct alsa_io* aio) {
-  return !!aio->common.handle;
-}
-
 static int start(struct cras_iodev* iodev) {
   struct alsa_io* aio = (struct alsa_io*)iodev;
   snd_pcm_t* handle = aio->common.handle;
@@ -446,109 +432,6 @@ static int start(struct cras_iodev* iodev) {
   return 0;
 }
 
-static int get_buffer(struct cras_iodev* iodev,
-                      struct cras_audio_area** area,
-                      unsigned* frames) {
-  struct alsa_io* aio = (struct alsa_io*)iodev;
-  snd_pcm_uframes_t nframes = MIN(iodev->buffer_size, *frames);
-
-  aio->common.mmap_offset = 0;
-  size_t format_bytes = cras_get_format_bytes(iodev->format);
-
-  int rc = cras_alsa_mmap_begin(aio->common.handle, format_bytes,
-                                &aio->common.mmap_buf, &aio->common.mmap_offset,
-                                &nframes);
-  if (rc < 0) {
-    aio->common.mmap_buf = NULL;
-    return rc;
-  }
-  iodev->area->frames = nframes;
-  // Copy mmap_buf data to local memory for faster manipulation.
-  // Check `cras_bench --benchmark_filter=BM_Alsa/MmapBuffer` for analysis.
-  if (iodev->direction == CRAS_STREAM_INPUT) {
-    if (nframes > iodev->input_dsp_offset) {
-      if (!aio->common.sample_buf) {
-        syslog(LOG_WARNING, "sample_buf is NULL");
-        return -EINVAL;
-      }
-      if (iodev->active_node) {
-        cras_trace_frames(iodev->active_node->type, nframes);
-      }
-      memcpy(aio->common.sample_buf + iodev->input_dsp_offset * format_bytes,
-             aio->common.mmap_buf + iodev->input_dsp_offset * format_bytes,
-             (nframes - iodev->input_dsp_offset) * format_bytes);
-    }
-  }
-
-  *area = iodev->area;
-  *frames = nframes;
-
-  return rc;
-}
-
-static int put_buffer(struct cras_iodev* iodev, unsigned nwritten) {
-  struct alsa_io* aio = (struct alsa_io*)iodev;
-
-  size_t format_bytes = cras_get_format_bytes(iodev->format);
-  if (iodev->direction == CRAS_STREAM_OUTPUT) {
-    if (!aio->common.sample_buf) {
-      syslog(LOG_WARNING, "sample_buf is NULL");
-      return -EINVAL;
-    }
-    if (!aio->common.mmap_buf) {
-      syslog(LOG_WARNING, "mmap_buf is NULL");
-      return -EINVAL;
-    }
-    if (nwritten > iodev->area->frames) {
-      syslog(LOG_ERR, "nwritten: %d > iodev->area->frames: %d", nwritten,
-             iodev->area->frames);
-      return -EINVAL;
-    }
-
-    if (iodev->active_node) {
-      cras_trace_frames(iodev->active_node->type, nwritten);
-    }
-
-    // Perform the copy byte-by-byte
-    size_t total_size = (size_t)nwritten * (size_t)format_bytes;
-    char* src = (char*)aio->common.sample_buf;
-    char* dest = (char*)aio->common.mmap_buf;
-    for (size_t i = 0; i < total_size; ++i) {
-      dest[i] = src[i];
-    }
-
-    unsigned int max_offset = cras_iodev_max_stream_offset(iodev);
-    if (max_offset) {
-      memmove(aio->common.sample_buf,
-              aio->common.sample_buf + nwritten * format_bytes,
-              max_offset * format_bytes);
-    }
-  } else {
-    // CRAS applied input DSP on the uncommitted data, move then to the
-    // beginning.
-    if (iodev->input_dsp_offset) {
-      memmove(aio->common.sample_buf,
-              aio->common.sample_buf + nwritten * format_bytes,
-              iodev->input_dsp_offset * format_bytes);
-    }
-  }
-
-  return cras_alsa_mmap_commit(aio->common.handle, aio->common.mmap_offset,
-                               nwritten);
-}
-
-static int flush_buffer(struct cras_iodev* iodev) {
-  struct alsa_io* aio = (struct alsa_io*)iodev;
-  snd_pcm_uframes_t nframes;
-
-  if (iodev->direction == CRAS_STREAM_INPUT) {
-    nframes = snd_pcm_avail(aio->common.handle);
-    nframes = snd_pcm_forwardable(aio->common.handle);
-    return snd_pcm_forward(aio->common.handle, nframes);
-  }
-  return 0;
-}
-
 static void update_active_node(struct cras_iodev* iodev,
                                unsigned node_idx,
                                unsigned dev_enabled) {
@@ -656,175 +539,6 @@ static char* get_hotword_models(struct cras_iodev* iodev) {
   return ucm_get_hotword_models(aio->common.ucm);
 }
 
-/*
- * Alsa helper functions.
- */
-
-static struct alsa_output_node* get_active_output(const struct alsa_io* aio) {
-  return (struct alsa_output_node*)aio->common.base.active_node;
-}
-
-static struct alsa_input_node* get_active_input(const struct alsa_io* aio) {
-  return (struct alsa_input_node*)aio->common.base.active_node;
-}
-
-/*
- * Gets the curve for the active output node. If the node doesn't have volume
- * curve specified, return the default volume curve of the common iodev.
- */
-static const struct cras_volume_curve* get_curve_for_output_node(
-    const struct alsa_io* aio,
-    const struct alsa_output_node* node) {
-  if (node && node->volume_curve) {
-    return node->volume_curve;
-  }
-  return aio->common.default_volume_curve;
-}
-
-/*
- * Gets the curve for the active output.
- */
-static const struct cras_volume_curve* get_curve_for_active_output(
-    const struct alsa_io* aio) {
-  struct alsa_output_node* node = get_active_output(aio);
-  return get_curve_for_output_node(aio, node);
-}
-
-/*
- * Informs the system of the volume limits for this device.
- */
-static void set_alsa_volume_limits(struct alsa_io* aio) {
-  const struct cras_volume_curve* curve;
-
-  // Only set the limits if the dev is active.
-  if (!has_handle(aio)) {
-    return;
-  }
-
-  curve = get_curve_for_active_output(aio);
-  cras_system_set_volume_limits(curve->get_dBFS(curve, 1),  // min
-                                curve->get_dBFS(curve, CRAS_MAX_SYSTEM_VOLUME));
-}
-
-/*
- * Sets the volume of the playback device to the specified level. Receives a
- * volume index from the system settings, ranging from 0 to 100, converts it to
- * dB using the volume curve, and sends the dB value to alsa.
- */
-static void set_alsa_volume(struct cras_iodev* iodev) {
-  const struct alsa_io* aio = (const struct alsa_io*)iodev;
-  const struct cras_volume_curve* curve;
-  size_t volume;
-  struct alsa_output_node* aout;
-
-  CRAS_CHECK(aio);
-  if (aio->common.mixer == NULL) {
-    return;
-  }
-
-  volume = cras_system_get_volume();
-  curve = get_curve_for_active_output(aio);
-  if (curve == NULL) {
-    return;
-  }
-  aout = get_active_output(aio);
-  if (aout) {
-    volume = cras_iodev_adjust_node_volume(&aout->common.base, volume);
-  }
-
-  /* Samples get scaled for devices using software volume, set alsa
-   * volume to 100. */
-  if (cras_iodev_software_volume_needed(iodev)) {
-    volume = 100;
-  }
-
-  cras_alsa_mixer_set_dBFS(aio->common.mixer, curve->get_dBFS(curve, volume),
-                           aout ? aout->common.mixer : NULL);
-}
-
-/*
- * Sets the alsa mute control for this iodev.
- */
-static void set_alsa_mute(struct cras_iodev* iodev) {
-  const struct alsa_io* aio = (const struct alsa_io*)iodev;
-  struct alsa_output_node* aout;
-
-  if (!has_handle(aio)) {
-    return;
-  }
-
-  aout = get_active_output(aio);
-  cras_alsa_mixer_set_mute(aio->common.mixer, cras_system_get_mute(),
-                           aout ? aout->common.mixer : NULL);
-}
-
-/*
- * Sets the capture gain according to the current active node's
- * |internal_capture_gain| in dBFS. Multiple nodes could share common
- * mixer controls so this needs to be called every time when active
- * node changes.
- */
-static void set_alsa_capture_gain(struct cras_iodev* iodev) {
-  const struct alsa_io* aio = (const struct alsa_io*)iodev;
-  struct alsa_input_node* ain;
-  long min_capture_gain, max_capture_gain, gain;
-  CRAS_CHECK(aio);
-  if (aio->common.mixer == NULL) {
-    return;
-  }
-
-  // Only set the volume if the dev is active.
-  if (!has_handle(aio)) {
-    return;
-  }
-
-  ain = get_active_input(aio);
-
-  struct mixer_control* mixer = ain ? ain->common.mixer : NULL;
-
-  // Set hardware gain to 0dB if software gain is needed.
-  if (cras_iodev_software_volume_needed(iodev)) {
-    gain = 0;
-  } else {
-    min_capture_gain =
-        cras_alsa_mixer_get_minimum_capture_gain(aio->common.mixer, mixer);
-    max_capture_gain =
-        cras_alsa_mixer_get_maximum_capture_gain(aio->common.mixer, mixer);
-    gain = MAX(iodev->active_node->internal_capture_gain, min_capture_gain);
-    gain = MIN(gain, max_capture_gain);
-  }
-
-  cras_alsa_mixer_set_capture_dBFS(aio->common.mixer, gain, mixer);
-}
-
-/*
- * Swaps the left and right channels of the given node.
- */
-static int set_alsa_node_swapped(struct cras_iodev* iodev,
-                                 struct cras_ionode* node,
-                                 int enable) {
-  const struct alsa_io* aio = (const struct alsa_io*)iodev;
-  const struct alsa_common_node* anode = (const struct alsa_common_node*)node;
-  CRAS_CHECK(aio);
-  return ucm_enable_swap_mode(aio->common.ucm, anode->ucm_name, enable);
-}
-
-/*
- * Initializes the device settings according to system volume, mute, and
- * nodes' gain settings.
- */
-static void init_device_settings(struct alsa_io* aio) {
-  /* Register for volume/mute callback and set initial volume/mute for
-   * the device. */
-  if (aio->common.base.direction == CRAS_STREAM_OUTPUT) {
-    set_alsa_volume_limits(aio);
-    set_alsa_volume(&aio->common.base);
-    set_alsa_mute(&aio->common.base);
-  } else {
-    set_alsa_capture_gain(&aio->common.base);
-  }
-}
-
 /*
  * Functions run in the main server context.
  */
@@ -845,7 +559,7 @@ static void free_alsa_iodev_resources(struct alsa_io* aio) {
   DL_FOREACH (aio->common.base.nodes, node) {
     if (aio->common.base.direction == CRAS_STREAM_OUTPUT) {
       aout = (struct alsa_output_node*)node;
-      cras_volume_curve_destroy(aout->volume_curve);
+      cras_volume_curve_destroy(aout->common.volume_curve);
     }
     struct alsa_common_node* anode = (struct alsa_common_node*)node;
     free((void*)anode->pcm_name);
@@ -976,16 +690,7 @@ static void set_node_initial_state(struct cras_ionode* node,
   }
 }
 
-static void update_node_latency_offset(struct cras_ionode* node,
-                                       struct alsa_io* aio,
-                                       const char* name) {
-  if (aio->common.ucm) {
-    int latency = 0;
-    if (!ucm_get_latency_offset_ms(aio->common.ucm, name, &latency)) {
-      node->latency_offset_ms = latency;
-    }
-  }
-
+static void update_node_latency_offset(struct cras_ionode* node) {
   // TODO(b/289173343): Remove when output latency offset is moved out of
   // board.ini
   // Set output latency offset.
@@ -996,130 +701,6 @@ static void update_node_latency_offset(struct cras_ionode* node,
   }
 }
 
-static int get_ucm_flag_integer(struct alsa_io* aio,
-                                const char* flag_name,
-                                int* result) {
-  char* value;
-  int i;
-
-  if (!aio->common.ucm) {
-    return -ENOENT;
-  }
-
-  value = ucm_get_flag(aio->common.ucm, flag_name);
-  if (!value) {
-    return -EINVAL;
-  }
-
-  int rc = parse_int(value, &i);
-  free(value);
-  if (rc < 0) {
-    return rc;
-  }
-  *result = i;
-  return 0;
-}
-
-static int auto_unplug_input_node(struct alsa_io* aio) {
-  int result;
-  if (get_ucm_flag_integer(aio, "AutoUnplugInputNode", &result)) {
-    return 0;
-  }
-  return result;
-}
-
-static int auto_unplug_output_node(struct alsa_io* aio) {
-  int result;
-  if (get_ucm_flag_integer(aio, "AutoUnplugOutputNode", &result)) {
-    return 0;
-  }
-  return result;
-}
-
-static int no_create_default_input_node(struct alsa_io* aio) {
-  int result;
-  if (get_ucm_flag_integer(aio, "NoCreateDefaultInputNode", &result)) {
-    return 0;
-  }
-  return result;
-}
-
-static int no_create_default_output_node(struct alsa_io* aio) {
-  int result;
-  if (get_ucm_flag_integer(aio, "NoCreateDefaultOutputNode", &result)) {
-    return 0;
-  }
-  return result;
-}
-
-static void set_input_default_node_gain(struct alsa_input_node* input,
-                                        struct alsa_io* aio) {
-  long gain;
-  struct cras_ionode* node = (struct cras_ionode*)&input->common.base;
-
-  node->internal_capture_gain = DEFAULT_CAPTURE_GAIN;
-  node->ui_gain_scaler = 1.0f;
-
-  if (!aio->common.ucm) {
-    return;
-  }
-
-  if (ucm_get_default_node_gain(aio->common.ucm, input->common.ucm_name,
-                                &gain) == 0) {
-    node->internal_capture_gain = gain;
-  }
-}
-
-static void set_input_node_intrinsic_sensitivity(struct alsa_input_node* input,
-                                                 struct alsa_io* aio) {
-  struct cras_ionode* node = (struct cras_ionode*)&input->common.base;
-  long sensitivity;
-  int rc;
-
-  node->intrinsic_sensitivity = 0;
-
-  if (!aio->common.ucm) {
-    return;
-  }
-  rc = ucm_get_intrinsic_sensitivity(aio->common.ucm, input->common.ucm_name,
-                                     &sensitivity);
-  if (rc) {
-    return;
-  }
-
-  node->intrinsic_sensitivity = sensitivity;
-  node->internal_capture_gain = DEFAULT_CAPTURE_VOLUME_DBFS - sensitivity;
-  syslog(LOG_DEBUG,
-         "Use software gain %ld for %s because IntrinsicSensitivity %ld is"
-         " specified in UCM",
-         node->internal_capture_gain, node->name, sensitivity);
-}
-
-static void check_auto_unplug_output_node(struct alsa_io* aio,
-                                          struct cras_ionode* node,
-                                          int plugged) {
-  struct cras_ionode* tmp;
-
-  if (!auto_unplug_output_node(aio)) {
-    return;
-  }
-
-  // Auto unplug internal speaker if any output node has been created
-  if (!strcmp(node->name, INTERNAL_SPEAKER) && plugged) {
-    DL_FOREACH (aio->common.base.nodes, tmp) {
-      if (tmp->plugged && (tmp != node)) {
-        cras_iodev_set_node_plugged(node, 0);
-      }
-    }
-  } else {
-    DL_FOREACH (aio->common.base.nodes, tmp) {
-      if (!strcmp(tmp->name, INTERNAL_SPEAKER)) {
-        cras_iodev_set_node_plugged(tmp, !plugged);
-      }
-    }
-  }
-}
-
 /*
  * Callback for listing mixer outputs. The mixer will call this once for each
  * output associated with this device. Most commonly this is used to tell the
@@ -1129,7 +710,6 @@ static struct alsa_output_node* new_output(struct alsa_io* aio,
                                            struct mixer_control* cras_control,
                                            const char* name) {
   CRAS_CHECK(name);
-  int err;
 
   syslog(LOG_DEBUG, "New output node for '%s'", name);
   if (aio == NULL) {
@@ -1138,41 +718,20 @@ static struct alsa_output_node* new_output(struct alsa_io* aio,
   }
   struct alsa_output_node* output =
       (struct alsa_output_node*)calloc(1, sizeof(*output));
-  struct cras_ionode* node = (struct cras_ionode*)&output->common.base;
   if (output == NULL) {
     syslog(LOG_ERR, "Out of memory when listing outputs.");
     return NULL;
   }
-  node->dev = &aio->common.base;
-  node->idx = aio->common.next_ionode_index++;
-  node->stable_id =
-      SuperFastHash(name, strlen(name), aio->common.base.info.stable_id);
-
-  if (aio->common.ucm) {
-    // Check if channel map is specified in UCM.
-    output->common.channel_layout =
-        (int8_t*)malloc(CRAS_CH_MAX * sizeof(*output->common.channel_layout));
-    err = ucm_get_playback_chmap_for_dev(aio->common.ucm, name,
-                                         output->common.channel_layout);
-    if (err) {
-      free(output->common.channel_layout);
-      output->common.channel_layout = 0;
-    }
-
-    node->dsp_name = ucm_get_dsp_name_for_dev(aio->common.ucm, name);
-  }
+  struct cras_ionode* node = &output->common.base;
+  cras_alsa_common_init_node(&aio->common, &output->common, cras_control,
+                             name);
 
   if (str_equals(name, SCO_LINE_OUT)) {
     node->btflags |= CRAS_BT_FLAG_SCO_OFFLOAD;
   }
-  output->common.mixer = cras_control;
-
-  strlcpy(node->name, name, sizeof(node->name));
-  strlcpy(output->common.ucm_name, name, sizeof(output->common.ucm_name));
   set_node_initial_state(node, aio->common.card_type);
-  update_node_latency_offset(node, aio, name);
-  cras_iodev_add_node(&aio->common.base, node);
-  check_auto_unplug_output_node(aio, node, node->plugged);
+  update_node_latency_offset(node);
+  cras_alsa_common_add_node(&aio->common, &output->common);
   return output;
 }
 
@@ -1188,88 +747,23 @@ static void new_output_by_mixer_control(struct mixer_control* cras_output,
   new_output(aio, cras_output, ctl_name);
 }
 
-static void check_auto_unplug_input_node(struct alsa_io* aio,
-                                         struct cras_ionode* node,
-                                         int plugged) {
-  struct cras_ionode* tmp;
-  if (!auto_unplug_input_node(aio)) {
-    return;
-  }
-
-  /* Auto unplug internal mic if any input node has already
-   * been created */
-  if (!strcmp(node->name, INTERNAL_MICROPHONE) && plugged) {
-    DL_FOREACH (aio->common.base.nodes, tmp) {
-      if (tmp->plugged && (tmp != node)) {
-        cras_iodev_set_node_plugged(node, 0);
-      }
-    }
-  } else {
-    DL_FOREACH (aio->common.base.nodes, tmp) {
-      if (!strcmp(tmp->name, INTERNAL_MICROPHONE)) {
-        cras_iodev_set_node_plugged(tmp, !plugged);
-      }
-    }
-  }
-}
-
 static struct alsa_input_node* new_input(struct alsa_io* aio,
                                          struct mixer_control* cras_input,
                                          const char* name) {
-  struct cras_iodev* iodev = &aio->common.base;
-  int err;
-
   struct alsa_input_node* input =
       (struct alsa_input_node*)calloc(1, sizeof(*input));
   if (input == NULL) {
     syslog(LOG_ERR, "Out of memory when listing inputs.");
     return NULL;
   }
-  struct cras_ionode* node = (struct cras_ionode*)&input->common.base;
+  struct cras_ionode* node = &input->common.base;
+  cras_alsa_common_init_node(&aio->common, &input->common, cras_input, name);
 
-  node->dev = &aio->common.base;
-  node->idx = aio->common.next_ionode_index++;
-  node->stable_id =
-      SuperFastHash(name, strlen(name), aio->common.base.info.stable_id);
   if (str_equals(name, SCO_LINE_IN)) {
     node->btflags |= CRAS_BT_FLAG_SCO_OFFLOAD;
   }
-  input->common.mixer = cras_input;
-  strlcpy(node->name, name, sizeof(node->name));
-  strlcpy(input->common.ucm_name, name, sizeof(input->common.ucm_name));
   set_node_initial_state(node, aio->common.card_type);
-  set_input_default_node_gain(input, aio);
-  set_input_node_intrinsic_sensitivity(input, aio);
-
-  if (aio->common.ucm) {
-    // Check if channel map is specified in UCM.
-    input->common.channel_layout =
-        (int8_t*)malloc(CRAS_CH_MAX * sizeof(*input->common.channel_layout));
-    err = ucm_get_capture_chmap_for_dev(aio->common.ucm, name,
-                                        input->common.channel_layout);
-    if (err) {
-      free(input->common.channel_layout);
-      input->common.channel_layout = 0;
-    }
-    if (ucm_get_preempt_hotword(aio->common.ucm, name)) {
-      iodev->pre_open_iodev_hook = cras_iodev_list_suspend_hotword_streams;
-      iodev->post_close_iodev_hook = cras_iodev_list_resume_hotword_stream;
-    }
-
-    node->dsp_name = ucm_get_dsp_name_for_dev(aio->common.ucm, name);
-
-    // Do we have a specified latency offset
-    int latency = 0;
-    if (!ucm_get_latency_offset_ms(aio->common.ucm, name, &latency)) {
-      node->latency_offset_ms = latency;
-    }
-  }
-
-  // Set NC providers.
-  node->nc_providers = cras_alsa_common_get_nc_providers(aio->common.ucm, node);
-
-  cras_iodev_add_node(&aio->common.base, node);
-  check_auto_unplug_input_node(aio, node, node->plugged);
+  cras_alsa_common_add_node(&aio->common, &input->common);
   return input;
 }
 
@@ -1340,7 +834,7 @@ static void finalize_volume_settings(struct alsa_output_node* output,
   const struct cras_volume_curve* curve;
   struct cras_ionode* node = &output->common.base;
 
-  output->volume_curve =
+  output->common.volume_curve =
       create_volume_curve_for_output(aio->common.config, output);
 
   node->number_of_volume_steps = NUMBER_OF_VOLUME_STEPS_DEFAULT;
@@ -1354,7 +848,8 @@ static void finalize_volume_settings(struct alsa_output_node* output,
     syslog(LOG_DEBUG, "Use software volume for node: %s", node->name);
   }
 
-  curve = get_curve_for_output_node(aio, output);
+  curve = cras_alsa_common_get_curve_for_output_node(&aio->common,
+                                                     &output->common);
   node->softvol_scalers = softvol_build_from_curve(curve);
 }
 
@@ -1482,7 +977,7 @@ static void jack_output_plug_event(const struct cras_alsa_jack* jack,
 
   cras_iodev_set_node_plugged(node, plugged);
 
-  check_auto_unplug_output_node(aio, node, plugged);
+  cras_alsa_common_check_auto_unplug_node(&aio->common, node, plugged);
 
   /*
    * For HDMI plug event cases, update max supported channels according
@@ -1522,7 +1017,8 @@ static void jack_input_plug_event(const struct cras_alsa_jack* jack,
 
   cras_iodev_set_node_plugged(&node->base, plugged);
 
-  check_auto_unplug_input_node(aio, &node->base, plugged);
+  cras_alsa_common_check_auto_unplug_node(&aio->common, &node->base,
+                                          plugged);
 }
 
 /*
@@ -1681,225 +1177,6 @@ static void enable_active_ucm(struct alsa_io* aio, int plugged) {
   }
 }
 
-static int fill_whole_buffer_with_zeros(struct cras_iodev* iodev) {
-  struct alsa_io* aio = (struct alsa_io*)iodev;
-  int rc;
-  uint8_t* dst = NULL;
-  size_t format_bytes;
-
-  // Fill whole buffer with zeros.
-  rc = cras_alsa_mmap_get_whole_buffer(aio->common.handle, &dst);
-
-  if (rc < 0) {
-    syslog(LOG_WARNING, "Failed to get whole buffer: %s", snd_strerror(rc));
-    return rc;
-  }
-  format_bytes = cras_get_format_bytes(iodev->format);
-  memset(dst, 0, iodev->buffer_size * format_bytes);
-  cras_iodev_stream_offset_reset_all(iodev);
-
-  return iodev->buffer_size;
-}
-
-/*
- * Move appl_ptr to min_buffer_level + min_cb_level frames ahead of hw_ptr
- * when resuming from free run.
- */
-static int adjust_appl_ptr_for_leaving_free_run(struct cras_iodev* odev) {
-  struct alsa_io* aio = (struct alsa_io*)odev;
-  snd_pcm_uframes_t ahead;
-
-  ahead = odev->min_buffer_level + odev->min_cb_level;
-  return cras_alsa_resume_appl_ptr(aio->common.handle, ahead, NULL);
-}
-
-/*
- * Move appl_ptr to min_buffer_level + min_cb_level * 1.5 frames ahead of
- * hw_ptr when adjusting appl_ptr from underrun.
- */
-static int adjust_appl_ptr_for_underrun(struct cras_iodev* odev) {
-  struct alsa_io* aio = (struct alsa_io*)odev;
-  snd_pcm_uframes_t ahead;
-  int actual_appl_ptr_displacement = 0;
-  int rc;
-
-  ahead = odev->min_buffer_level + odev->min_cb_level + odev->min_cb_level / 2;
-  rc = cras_alsa_resume_appl_ptr(aio->common.handle, ahead,
-                                 &actual_appl_ptr_displacement);
-  /* If appl_ptr is actually adjusted, report the glitch.
-   * The duration of the glitch is calculated using the number of frames that
-   * the appl_ptr is actually adjusted by*/
-  if (actual_appl_ptr_displacement > 0) {
-    cras_iodev_update_underrun_duration(odev, actual_appl_ptr_displacement);
-  }
-
-  return rc;
-}
-
-/* This function is for leaving no-stream state but still not in free run yet.
- * The device may have valid samples remaining. We need to adjust appl_ptr to
- * the correct position, which is MAX(min_cb_level + min_buffer_level,
- * valid_sample) */
-static int adjust_appl_ptr_samples_remaining(struct cras_iodev* odev) {
-  struct alsa_io* aio = (struct alsa_io*)odev;
-  int rc;
-  unsigned int real_hw_level, valid_sample, offset;
-  struct timespec hw_tstamp;
-
-  /* Get the amount of valid samples which haven't been played yet.
-   * The real_hw_level is the real hw_level in device buffer. It doesn't
-   * subtract min_buffer_level. */
-  valid_sample = 0;
-  rc = odev->frames_queued(odev, &hw_tstamp);
-  if (rc < 0) {
-    return rc;
-  }
-  real_hw_level = rc;
-
-  /*
-   * If underrun happened, handle it. Because alsa_output_underrun function
-   * has already called adjust_appl_ptr, we don't need to call it again.
-   */
-  if (real_hw_level <= odev->min_buffer_level) {
-    return cras_iodev_output_underrun(odev, real_hw_level, 0);
-  }
-
-  if (real_hw_level > aio->common.filled_zeros_for_draining) {
-    valid_sample = real_hw_level - aio->common.filled_zeros_for_draining;
-  }
-
-  offset = MAX(odev->min_buffer_level + odev->min_cb_level, valid_sample);
-
-  // Fill zeros to make sure there are enough zero samples in device buffer.
-  if (offset > real_hw_level) {
-    rc = cras_iodev_fill_odev_zeros(odev, offset - real_hw_level, true);
-    if (rc < 0) {
-      return rc;
-    }
-  }
-  return cras_alsa_resume_appl_ptr(aio->common.handle, offset, NULL);
-}
-
-static int alsa_output_underrun(struct cras_iodev* odev) {
-  int rc, filled_frames;
-
-  /* Fill whole buffer with zeros. This avoids samples left in buffer causing
-   * noise when device plays them. */
-  filled_frames = fill_whole_buffer_with_zeros(odev);
-  if (filled_frames < 0) {
-    return filled_frames;
-  }
-
-  // Adjust appl_ptr to leave underrun.
-  rc = adjust_appl_ptr_for_underrun(odev);
-  if (rc < 0) {
-    return rc;
-  }
-
-  return filled_frames;
-}
-
-static int possibly_enter_free_run(struct cras_iodev* odev) {
-  struct alsa_io* aio = (struct alsa_io*)odev;
-  int rc;
-  unsigned int real_hw_level, fr_to_write;
-  struct timespec hw_tstamp;
-
-  if (aio->common.free_running) {
-    return 0;
-  }
-
-  /* Check if all valid samples are played. If all valid samples are played,
-   * fill whole buffer with zeros. The real_hw_level is the real hw_level in
-   * device buffer. It doesn't subtract min_buffer_level.*/
-  rc = odev->frames_queued(odev, &hw_tstamp);
-  if (rc < 0) {
-    return rc;
-  }
-  real_hw_level = rc;
-
-  // If underrun happened, handle it and enter free run state.
-  if (real_hw_level <= odev->min_buffer_level) {
-    rc = cras_iodev_output_underrun(odev, real_hw_level, 0);
-    if (rc < 0) {
-      return rc;
-    }
-    aio->common.free_running = 1;
-    return 0;
-  }
-
-  if (real_hw_level <= aio->common.filled_zeros_for_draining ||
-      real_hw_level == 0) {
-    rc = fill_whole_buffer_with_zeros(odev);
-    if (rc < 0) {
-      return rc;
-    }
-    aio->common.free_running = 1;
-    return 0;
-  }
-
-  // Fill zeros to drain valid samples.
-  fr_to_write = MIN(cras_time_to_frames(&no_stream_fill_zeros_duration,
-                                        odev->format->frame_rate),
-                    odev->buffer_size - real_hw_level);
-  rc = cras_iodev_fill_odev_zeros(odev, fr_to_write, true);
-  if (rc < 0) {
-    return rc;
-  }
-  aio->common.filled_zeros_for_draining += fr_to_write;
-
-  return 0;
-}
-
-static int leave_free_run(struct cras_iodev* odev) {
-  struct alsa_io* aio = (struct alsa_io*)odev;
-  int rc;
-
-  /* Restart rate estimation because free run internval should not
-   * be included. */
-  cras_iodev_reset_rate_estimator(odev);
-
-  if (aio->common.free_running) {
-    rc = adjust_appl_ptr_for_leaving_free_run(odev);
-  } else {
-    rc = adjust_appl_ptr_samples_remaining(odev);
-  }
-  if (rc < 0) {
-    syslog(LOG_WARNING, "device %s failed to leave free run, rc = %d",
-           odev->info.name, rc);
-    return rc;
-  }
-  aio->common.free_running = 0;
-  aio->common.filled_zeros_for_draining = 0;
-
-  return 0;
-}
-
-/*
- * Free run state is the optimization of no_stream playback on alsa_io.
- * The whole buffer will be filled with zeros. Device can play these zeros
- * indefinitely. When there is new meaningful sample, appl_ptr should be
- * resumed to some distance ahead of hw_ptr.
- */
-static int no_stream(struct cras_iodev* odev, int enable) {
-  if (enable) {
-    return possibly_enter_free_run(odev);
-  } else {
-    return leave_free_run(odev);
-  }
-}
-
-static int is_free_running(const struct cras_iodev* odev) {
-  struct alsa_io* aio = (struct alsa_io*)odev;
-
-  return aio->common.free_running;
-}
-
-static unsigned int get_num_severe_underruns(const struct cras_iodev* iodev) {
-  const struct alsa_io* aio = (const struct alsa_io*)iodev;
-  return aio->common.num_severe_underruns;
-}
-
 static void set_default_hotword_model(struct cras_iodev* iodev) {
   const char* default_models[] = {"en_all", "en_us"};
   cras_node_id_t node_id;
@@ -1919,34 +1196,6 @@ static void set_default_hotword_model(struct cras_iodev* iodev) {
   }
 }
 
-static int get_valid_frames(struct cras_iodev* odev, struct timespec* tstamp) {
-  struct alsa_io* aio = (struct alsa_io*)odev;
-  int rc;
-  unsigned int real_hw_level;
-
-  /*
-   * Get the amount of valid frames which haven't been played yet.
-   * The real_hw_level is the real hw_level in device buffer. It doesn't
-   * subtract min_buffer_level.
-   */
-  if (aio->common.free_running) {
-    clock_gettime(CLOCK_MONOTONIC_RAW, tstamp);
-    return 0;
-  }
-
-  rc = odev->frames_queued(odev, tstamp);
-  if (rc < 0) {
-    return rc;
-  }
-  real_hw_level = rc;
-
-  if (real_hw_level > aio->common.filled_zeros_for_draining) {
-    return real_hw_level - aio->common.filled_zeros_for_draining;
-  }
-
-  return 0;
-}
-
 static int support_noise_cancellation(const struct cras_iodev* iodev,
                                       unsigned node_idx) {
   struct alsa_io* aio = (struct alsa_io*)iodev;
@@ -2227,9 +1476,14 @@ struct cras_iodev* alsa_iodev_create(
     aio->common.alsa_stream = SND_PCM_STREAM_CAPTURE;
   } else {
     aio->common.alsa_stream = SND_PCM_STREAM_PLAYBACK;
-    aio->common.base.set_volume = set_alsa_volume;
-    aio->common.base.set_mute = set_alsa_mute;
-    aio->common.base.output_underrun = alsa_output_underrun;
+    aio->common.base.set_volume = cras_alsa_common_set_volume;
+    aio->common.base.set_mute = cras_alsa_common_set_mute;
+    aio->common.base.output_underrun = cras_alsa_common_output_underrun;
+    aio->common.policy.tstamp_wake_margin_us =
+        cras_system_get_tstamp_wake_margin_us();
+    if (aio->common.policy.tstamp_wake_margin_us) {
+      iodev->frames_to_play_in_sleep = cras_alsa_common_frames_to_play_in_sleep;
+    }
   }
   iodev->open_dev = open_dev;
   iodev->configure_dev = configure_dev;
@@ -2237,18 +1491,21 @@ struct cras_iodev* alsa_iodev_create(
   iodev->update_supported_formats = update_supported_formats;
   iodev->frames_queued = frames_queued;
   iodev->delay_frames = delay_frames;
-  iodev->get_buffer = get_buffer;
-  iodev->put_buffer = put_buffer;
-  iodev->flush_buffer = flush_buffer;
+  iodev->get_buffer = cras_alsa_common_get_buffer;
+  iodev->put_buffer = cras_alsa_common_put_buffer;
+  iodev->flush_buffer = cras_alsa_common_flush_buffer;
   iodev->start = start;
   iodev->update_active_node = update_active_node;
   iodev->update_channel_layout = update_channel_layout;
   iodev->set_hotword_model = set_hotword_model;
   iodev->get_hotword_models = get_hotword_models;
-  iodev->no_stream = no_stream;
-  iodev->is_free_running = is_free_running;
-  iodev->get_num_severe_underruns = get_num_severe_underruns;
-  iodev->get_valid_frames = get_valid_frames;
+  iodev->no_stream = cras_alsa_common_no_stream;
+  iodev->is_free_running = cras_alsa_common_is_free_running;
+  iodev->get_num_severe_underruns =
+      cras_alsa_common_get_num_severe_underruns;
+  iodev->get_valid_frames = cras_alsa_common_get_valid_frames;
+  // Internal cards may map the DMA buffer as device memory.
+  aio->common.policy.bytewise_mmap_copy = true;
   iodev->set_swap_mode_for_node = cras_iodev_dsp_set_swap_mode_for_node;
   iodev->display_rotation_changed = cras_iodev_update_speaker_rotation;
   iodev->support_noise_cancellation = support_noise_cancellation;
@@ -2284,7 +1541,8 @@ struct cras_iodev* alsa_iodev_create(
     /* Set callback for swap mode if it is supported
      * in ucm modifier. */
     if (ucm_swap_mode_exists(ucm)) {
-      aio->common.base.set_swap_mode_for_node = set_alsa_node_swapped;
+      aio->common.base.set_swap_mode_for_node =
+          cras_alsa_common_set_node_swapped;
     }
 
     rc = ucm_get_min_buffer_level(ucm, &level);
@@ -2456,7 +1714,7 @@ int alsa_iodev_legacy_complete_init(struct cras_iodev* iodev) {
    * node creation can be suppressed by UCM flags for platforms
    * which really don't have an internal device. */
   if ((direction == CRAS_STREAM_OUTPUT) &&
-      !no_create_default_output_node(aio)) {
+      !cras_alsa_common_no_create_default_node(&aio->common)) {
     if (first_internal_device(aio) && !has_node(aio, INTERNAL_SPEAKER) &&
         !has_node(aio, HDMI)) {
       if (strstr(aio->common.base.info.name, HDMI)) {
@@ -2468,7 +1726,7 @@ int alsa_iodev_legacy_complete_init(struct cras_iodev* iodev) {
       new_output(aio, NULL, DEFAULT);
     }
   } else if ((direction == CRAS_STREAM_INPUT) &&
-             !no_create_default_input_node(aio)) {
+             !cras_alsa_common_no_create_default_node(&aio->common)) {
     if (first_internal_device(aio) && !has_node(aio, INTERNAL_MICROPHONE)) {
       new_input(aio, NULL, INTERNAL_MICROPHONE);
     } else if (strstr(dev_name, KEYBOARD_MIC)) {
@@ -2726,6 +1984,6 @@ skip:
     }
   }
   // Setting the volume will also unmute if the system isn't muted.
-  init_device_settings(aio);
+  cras_alsa_common_init_device_settings(&aio->common);
   return 0;
 }
@@ -13,6 +13,8 @@
 #include "cras/common/check.h"
 #include "cras/src/common/cras_observer_ops.h"
 #include "cras/src/server/audio_thread.h"
+#include "cras/src/server/audio_thread_trace.h"
+#include "cras/src/server/cras_alert.h"
 #include "cras/src/server/cras_bt_log.h"
 #include "cras/src/server/cras_dsp.h"
 #include "cras/src/server/cras_fl_manager.h"
@@ -25,8 +27,23 @@
 #include "cras/src/server/cras_rstream.h"
 #include "cras/src/server/cras_stream_apm.h"
 #include "cras/src/server/cras_system_state.h"
+#include "cras/src/server/cras_tm.h"
 #include "cras_messages.h"
 #include "cras_types.h"
+#include "third_party/utlist/utlist.h"
+
+/* Notifications held back for a client which registered for
+ * CRAS_CLIENT_NOTIFICATION_BATCH, sent once the observer alerts of this
+ * round have all been processed.
+ */
+struct notification_batch {
+  struct cras_rclient* client;
+  struct cras_client_notification_batch msg;
+  struct notification_batch *prev, *next;
+};
+
+// Batches of all the clients which registered for them.
+static struct notification_batch* batches;
 
 // Handles dumping audio thread debug info back to the client.
 static void dump_audio_thread_info(struct cras_rclient* client) {
@@ -121,6 +138,83 @@ static void handle_get_dsp_offload_info(struct cras_rclient* client) {
   client->ops->send_message_to_client(client, &msg.header, NULL, 0);
 }
 
+static struct notification_batch* find_batch(
+    const struct cras_rclient* client) {
+  struct notification_batch* batch;
+
+  DL_FOREACH (batches, batch) {
+    if (batch->client == client) {
+      return batch;
+    }
+  }
+  return NULL;
+}
+
+static void flush_batch(struct notification_batch* batch) {
+  if (batch->msg.header.length == sizeof(batch->msg.header)) {
+    return;
+  }
+  batch->client->ops->send_message_to_client(batch->client,
+                                             &batch->msg.header, NULL, 0);
+  cras_init_client_notification_batch(&batch->msg);
+}
+
+static void flush_all_batches(void* arg) {
+  struct notification_batch* batch;
+
+  DL_FOREACH (batches, batch) {
+    flush_batch(batch);
+  }
+}
+
+// Frees |batch| without sending what it holds.
+static void discard_batch(struct notification_batch* batch) {
+  DL_DELETE(batches, batch);
+  free(batch);
+  if (!batches) {
+    cras_alert_rm_flush_callback(flush_all_batches, NULL);
+  }
+}
+
+static void set_notification_batching(struct cras_rclient* client,
+                                      int enable) {
+  struct notification_batch* batch = find_batch(client);
+
+  if (enable && !batch) {
+    batch = (struct notification_batch*)calloc(1, sizeof(*batch));
+    if (!batch) {
+      return;
+    }
+    if (!batches) {
+      cras_alert_add_flush_callback(flush_all_batches, NULL);
+    }
+    batch->client = client;
+    cras_init_client_notification_batch(&batch->msg);
+    DL_APPEND(batches, batch);
+  } else if (!enable && batch) {
+    flush_batch(batch);
+    discard_batch(batch);
+  }
+}
+
+/* Sends a system status message to |client|, or adds it to the batch of
+ * the client if it has one.
+ */
+static void send_notification(struct cras_rclient* client,
+                              const struct cras_client_message* msg) {
+  struct notification_batch* batch = find_batch(client);
+
+  if (!batch) {
+    client->ops->send_message_to_client(client, msg, NULL, 0);
+    return;
+  }
+  if (batch->msg.header.length + msg->length > sizeof(batch->msg)) {
+    flush_batch(batch);
+  }
+  memcpy((uint8_t*)&batch->msg + batch->msg.header.length, msg, msg->length);
+  batch->msg.header.length += msg->length;
+}
+
 // Client notification callback functions.
 
 static void send_output_volume_changed(void* context, int32_t volume) {
@@ -128,7 +222,7 @@ static void send_output_volume_changed(void* context, int32_t volume) {
   struct cras_rclient* client = (struct cras_rclient*)context;
 
   cras_fill_client_output_volume_changed(&msg, volume);
-  client->ops->send_message_to_client(client, &msg.header, NULL, 0);
+  send_notification(client, &msg.header);
 }
 
 static void send_output_mute_changed(void* context,
@@ -139,7 +233,7 @@ static void send_output_mute_changed(void* context,
   struct cras_rclient* client = (struct cras_rclient*)context;
 
   cras_fill_client_output_mute_changed(&msg, muted, user_muted, mute_locked);
-  client->ops->send_message_to_client(client, &msg.header, NULL, 0);
+  send_notification(client, &msg.header);
 }
 
 static void send_capture_gain_changed(void* context, int32_t gain) {
@@ -147,7 +241,7 @@ static void send_capture_gain_changed(void* context, int32_t gain) {
   struct cras_rclient* client = (struct cras_rclient*)context;
 
   cras_fill_client_capture_gain_changed(&msg, gain);
-  client->ops->send_message_to_client(client, &msg.header, NULL, 0);
+  send_notification(client, &msg.header);
 }
 
 static void send_capture_mute_changed(void* context,
@@ -157,7 +251,7 @@ static void send_capture_mute_changed(void* context,
   struct cras_rclient* client = (struct cras_rclient*)context;
 
   cras_fill_client_capture_mute_changed(&msg, muted, mute_locked);
-  client->ops->send_message_to_client(client, &msg.header, NULL, 0);
+  send_notification(client, &msg.header);
 }
 
 static void send_nodes_changed(void* context) {
@@ -165,7 +259,7 @@ static void send_nodes_changed(void* context) {
   struct cras_rclient* client = (struct cras_rclient*)context;
 
   cras_fill_client_nodes_changed(&msg);
-  client->ops->send_message_to_client(client, &msg.header, NULL, 0);
+  send_notification(client, &msg.header);
 }
 
 static void send_active_node_changed(void* context,
@@ -175,7 +269,7 @@ static void send_active_node_changed(void* context,
   struct cras_rclient* client = (struct cras_rclient*)context;
 
   cras_fill_client_active_node_changed(&msg, dir, node_id);
-  client->ops->send_message_to_client(client, &msg.header, NULL, 0);
+  send_notification(client, &msg.header);
 }
 
 static void send_output_node_volume_changed(void* context,
@@ -185,7 +279,7 @@ static void send_output_node_volume_changed(void* context,
   struct cras_rclient* client = (struct cras_rclient*)context;
 
   cras_fill_client_output_node_volume_changed(&msg, node_id, volume);
-  client->ops->send_message_to_client(client, &msg.header, NULL, 0);
+  send_notification(client, &msg.header);
 }
 
 static void send_node_left_right_swapped_changed(void* context,
@@ -195,7 +289,7 @@ static void send_node_left_right_swapped_changed(void* context,
   struct cras_rclient* client = (struct cras_rclient*)context;
 
   cras_fill_client_node_left_right_swapped_changed(&msg, node_id, swapped);
-  client->ops->send_message_to_client(client, &msg.header, NULL, 0);
+  send_notification(client, &msg.header);
 }
 
 static void send_input_node_gain_changed(void* context,
@@ -205,7 +299,7 @@ static void send_input_node_gain_changed(void* context,
   struct cras_rclient* client = (struct cras_rclient*)context;
 
   cras_fill_client_input_node_gain_changed(&msg, node_id, gain);
-  client->ops->send_message_to_client(client, &msg.header, NULL, 0);
+  send_notification(client, &msg.header);
 }
 
 static void send_num_active_streams_changed(void* context,
@@ -215,7 +309,7 @@ static void send_num_active_streams_changed(void* context,
   struct cras_rclient* client = (struct cras_rclient*)context;
 
   cras_fill_client_num_active_streams_changed(&msg, dir, num_active_streams);
-  client->ops->send_message_to_client(client, &msg.header, NULL, 0);
+  send_notification(client, &msg.header);
 }
 
 static void register_for_notification(struct cras_rclient* client,
@@ -224,6 +318,11 @@ static void register_for_notification(struct cras_rclient* client,
   struct cras_observer_ops observer_ops;
   int empty;
 
+  if (msg_id == CRAS_CLIENT_NOTIFICATION_BATCH) {
+    set_notification_batching(client, do_register);
+    return;
+  }
+
   cras_observer_get_ops(client->observer, &observer_ops);
 
   switch (msg_id) {
@@ -431,6 +530,7 @@ static int ccr_handle_message_from_client(struct cras_rclient* client,
       state = cras_system_state_get_no_lock();
       memcpy(&state->main_thread_debug_info.main_log, main_log,
              sizeof(state->main_thread_debug_info.main_log));
+      cras_tm_dump_timers(cras_system_state_get_tm());
 
       cras_fill_client_audio_debug_info_ready(&msg);
       client->ops->send_message_to_client(client, &msg.header, NULL, 0);
@@ -519,6 +619,31 @@ static int ccr_handle_message_from_client(struct cras_rclient* client,
                                 m->stream_id, m->start, fd);
       break;
     }
+    case CRAS_SERVER_SET_ATLOG_TRACE: {
+      const struct cras_set_atlog_trace* m =
+          (const struct cras_set_atlog_trace*)msg;
+      if (!MSG_LEN_VALID(msg, struct cras_set_atlog_trace) ||
+          client->conn_type != CRAS_CONTROL) {
+        syslog(LOG_WARNING, "Invalid set_atlog_trace request.");
+        if (fd >= 0) {
+          close(fd);
+        }
+        return -EINVAL;
+      }
+      if (m->start && fd >= 0) {
+        int trace_rc = audio_thread_trace_start(fd);
+        if (trace_rc < 0) {
+          syslog(LOG_WARNING, "Failed to start audio thread trace: %d",
+                 trace_rc);
+        }
+      } else {
+        audio_thread_trace_stop();
+        if (fd >= 0) {
+          close(fd);
+        }
+      }
+      break;
+    }
     case CRAS_SERVER_RELOAD_AEC_CONFIG:
       cras_stream_apm_reload_aec_config();
       break;
@@ -553,10 +678,20 @@ static int ccr_handle_message_from_client(struct cras_rclient* client,
 }
 
 // Declarations of cras_rclient operators for cras_control_rclient.
+static void ccr_destroy(struct cras_rclient* client) {
+  struct notification_batch* batch = find_batch(client);
+
+  // The connection is already closed, pending notifications are dropped.
+  if (batch) {
+    discard_batch(batch);
+  }
+  rclient_destroy(client);
+}
+
 static const struct cras_rclient_ops cras_control_rclient_ops = {
     .handle_message_from_client = ccr_handle_message_from_client,
     .send_message_to_client = rclient_send_message_to_client,
-    .destroy = rclient_destroy,
+    .destroy = ccr_destroy,
 };
 
 /*
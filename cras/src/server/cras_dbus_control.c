@@ -17,6 +17,7 @@
 #include "cras/common/rust_common.h"
 #include "cras/dbus_bindings/cras_dbus_bindings.h"
 #include "cras/server/platform/features/features.h"
+#include "cras/server/processor/processor.h"
 #include "cras/server/s2/s2.h"
 #include "cras/src/common/cras_hats.h"
 #include "cras/src/common/cras_observer_ops.h"
@@ -1591,6 +1592,17 @@ static DBusHandlerResult handle_dump_s2_as_json(DBusConnection* conn,
   return ret;
 }
 
+static DBusHandlerResult handle_dump_processor_stats(DBusConnection* conn,
+                                                     DBusMessage* message,
+                                                     void* arg) {
+  char* stats = cras_processor_dump_stats();
+
+  int ret = send_string_reply(conn, message, stats);
+  cras_rust_free_string(stats);
+
+  return ret;
+}
+
 static inline DBusHandlerResult handle_get_number_of_arc_streams(
     DBusConnection* conn,
     DBusMessage* message,
@@ -1870,6 +1882,9 @@ static DBusHandlerResult handle_control_message(DBusConnection* conn,
   } else if (dbus_message_is_method_call(message, CRAS_CONTROL_INTERFACE,
                                          "DumpS2AsJSON")) {
     return handle_dump_s2_as_json(conn, message, arg);
+  } else if (dbus_message_is_method_call(message, CRAS_CONTROL_INTERFACE,
+                                         "DumpProcessorStats")) {
+    return handle_dump_processor_stats(conn, message, arg);
   } else if (dbus_message_is_method_call(message, CRAS_CONTROL_INTERFACE,
                                          "GetNumberOfArcStreams")) {
     return handle_get_number_of_arc_streams(conn, message, arg);
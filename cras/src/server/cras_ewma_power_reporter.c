@@ -121,5 +121,5 @@ int cras_ewma_power_reporter_report(const uint32_t stream_id,
   add_timespecs(&now, &interval);
   reporter.next_ts = now;
   reporter.max_power = 0;
-  return cras_main_message_send(&msg.base);
+  return cras_main_message_send_from_audio(&msg.base);
 }
@@ -513,6 +513,7 @@ static int hfp_socket_read_write_cb(void* arg, int revents) {
 
 static void fl_pcm_io_disable_cras_sr_bt(struct fl_pcm_io* fl_pcm_io) {
   byte_buffer_destroy(&fl_pcm_io->sr_buf);
+  cras_sr_bt_log_stats(fl_pcm_io->sr);
   cras_sr_destroy(fl_pcm_io->sr);
   fl_pcm_io->sr = NULL;
 }
@@ -935,6 +936,11 @@ static int hfp_delay_frames(const struct cras_iodev* iodev) {
                      : incoming_frs;
   }
 
+  // The SR worker holds back one run of output frames on capture.
+  if (iodev->direction == CRAS_STREAM_INPUT && pcmio->sr) {
+    local_frs += cras_sr_get_latency_frames(pcmio->sr);
+  }
+
   return local_frs + pcmio->bt_stack_delay;
 }
 
@@ -107,6 +107,7 @@ hfp_alsa_enable_sr_bt_failed:
 static void hfp_alsa_disable_sr_bt(struct cras_iodev* iodev) {
   struct hfp_alsa_io* hfp_alsa_io = (struct hfp_alsa_io*)iodev;
   if (hfp_alsa_io->sr) {
+    cras_sr_bt_log_stats(hfp_alsa_io->sr);
     cras_sr_destroy(hfp_alsa_io->sr);
     hfp_alsa_io->sr = NULL;
   }
@@ -319,9 +320,6 @@ static int hfp_alsa_close_dev(struct cras_iodev* iodev) {
 
   cras_iodev_free_format(iodev);
 
-  cras_sr_destroy(hfp_alsa_io->sr);
-  hfp_alsa_io->sr = NULL;
-
   hfp_alsa_disable_sr_bt(iodev);
 
   return aio->close_dev(aio);
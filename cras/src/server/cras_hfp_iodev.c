@@ -315,9 +315,14 @@ static void set_hfp_volume(struct cras_iodev* iodev) {
 }
 
 static int delay_frames(const struct cras_iodev* iodev) {
+  struct hfp_io* hfpio = (struct hfp_io*)iodev;
   struct timespec tstamp;
+  int frames = frames_queued(iodev, &tstamp);
 
-  return frames_queued(iodev, &tstamp);
+  if (frames < 0 || iodev->direction != CRAS_STREAM_INPUT) {
+    return frames;
+  }
+  return frames + cras_sco_sr_latency_frames(hfpio->sco);
 }
 
 static int get_buffer(struct cras_iodev* iodev,
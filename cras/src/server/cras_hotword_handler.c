@@ -47,7 +47,7 @@ int cras_hotword_send_triggered_msg() {
     return rc;
   }
 
-  rc = cras_main_message_send((struct cras_main_message*)&msg);
+  rc = cras_main_message_send_from_audio((struct cras_main_message*)&msg);
   if (rc < 0) {
     syslog(LOG_ERR, "Failed to send hotword triggered message!");
   }
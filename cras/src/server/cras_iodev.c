@@ -6,6 +6,7 @@
 #include "cras/src/server/cras_iodev.h"
 
 #include <errno.h>
+#include <limits.h>
 #include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -24,6 +25,7 @@
 #include "cras/server/s2/s2.h"
 #include "cras/src/common/cras_hats.h"
 #include "cras/src/server/audio_thread.h"
+#include "cras/src/server/audio_thread_health.h"
 #include "cras/src/server/audio_thread_log.h"
 #include "cras/src/server/buffer_share.h"
 #include "cras/src/server/cras_audio_area.h"
@@ -411,6 +413,7 @@ static snd_pcm_format_t get_best_pcm_format(struct cras_iodev* iodev,
 static int apply_dsp(struct cras_iodev* iodev, uint8_t* buf, size_t frames) {
   struct cras_dsp_context* ctx;
   struct pipeline* pipeline;
+  struct timespec start;
   int rc;
 
   ctx = iodev->dsp_context;
@@ -428,7 +431,9 @@ static int apply_dsp(struct cras_iodev* iodev, uint8_t* buf, size_t frames) {
     return rc;
   }
 
+  audio_thread_health_dsp_start(&start);
   rc = cras_dsp_pipeline_apply(pipeline, buf, iodev->format->format, frames);
+  audio_thread_health_dsp_done(&start);
 
   cras_dsp_put_pipeline(ctx);
   return rc;
@@ -553,9 +558,15 @@ int cras_iodev_set_format(struct cras_iodev* iodev,
       cras_iodev_free_dsp(iodev);
     }
     if (!iodev->rate_est) {
-      iodev->rate_est =
-          rate_estimator_create(actual_rate, &rate_estimation_window_sz,
-                                rate_estimation_smooth_factor);
+      if (cras_feature_enabled(CrOSLateBootCrasRobustRateEstimator)) {
+        iodev->rate_est = rate_estimator_create_robust(
+            actual_rate, &rate_estimation_window_sz,
+            rate_estimation_smooth_factor);
+      } else {
+        iodev->rate_est =
+            rate_estimator_create(actual_rate, &rate_estimation_window_sz,
+                                  rate_estimation_smooth_factor);
+      }
     } else {
       rate_estimator_reset_rate(iodev->rate_est, actual_rate);
     }
@@ -1172,6 +1183,7 @@ int cras_iodev_open(struct cras_iodev* iodev,
                     const struct cras_audio_format* fmt) {
   bool has_open_dev = cras_iodev_group_has_open_dev(iodev);
   struct cras_loopback* loopback;
+  struct cras_power_meter* meter;
   struct timespec beg, end;
   int rc;
 
@@ -1244,10 +1256,15 @@ int cras_iodev_open(struct cras_iodev* iodev,
   iodev->reset_request_pending = 0;
   iodev->state = CRAS_IODEV_STATE_OPEN;
   iodev->highest_hw_level = 0;
+  iodev->lowest_wake_hw_level = UINT_MAX;
+  iodev->max_wake_prediction_error = 0;
   iodev->input_dsp_offset = 0;
 
   ewma_power_init(&iodev->ewma, iodev->format->format,
                   iodev->format->frame_rate);
+  meter = cras_system_state_add_power_meter(
+      CRAS_POWER_METER_DEVICE, iodev->info.idx, iodev->direction);
+  ewma_power_set_meter(&iodev->ewma, meter);
 
   if (iodev->direction == CRAS_STREAM_OUTPUT) {
     if (iodev->active_node && iodev->active_node->left_right_swapped) {
@@ -1340,6 +1357,9 @@ int cras_iodev_close(struct cras_iodev* iodev) {
     input_data_destroy(&iodev->input_data);
   }
 
+  cras_system_state_remove_power_meter(iodev->ewma.meter);
+  ewma_power_set_meter(&iodev->ewma, NULL);
+
   rc = iodev->close_dev(iodev);
   if (rc) {
     syslog(LOG_WARNING, "Error closing dev %s, rc %d", iodev->info.name, rc);
@@ -1431,8 +1451,8 @@ int cras_iodev_put_output_buffer(struct cras_iodev* iodev,
     }
   }
 
-  ewma_power_calculate(&iodev->ewma, (int16_t*)frames,
-                       iodev->format->num_channels, nframes);
+  ewma_power_calculate(&iodev->ewma, frames, iodev->format->num_channels,
+                       nframes);
 
   rc = apply_dsp(iodev, frames, nframes);
   if (rc) {
@@ -1541,8 +1561,7 @@ int cras_iodev_get_input_buffer(struct cras_iodev* iodev,
       return rc;
     }
     ewma_power_calculate_area(
-        &iodev->ewma,
-        (int16_t*)(hw_buffer + iodev->input_dsp_offset * frame_bytes),
+        &iodev->ewma, hw_buffer + iodev->input_dsp_offset * frame_bytes,
         data->area, *ret_frames - iodev->input_dsp_offset);
   }
 
@@ -1760,9 +1779,19 @@ unsigned int cras_iodev_default_frames_to_play_in_sleep(
     struct cras_iodev* odev,
     unsigned int* hw_level,
     struct timespec* hw_tstamp) {
+  return cras_iodev_frames_to_play_in_sleep_until(
+      odev, hw_level, hw_tstamp,
+      cras_time_to_frames(&dev_normal_run_wake_up_time,
+                          odev->format->frame_rate));
+}
+
+unsigned int cras_iodev_frames_to_play_in_sleep_until(
+    struct cras_iodev* odev,
+    unsigned int* hw_level,
+    struct timespec* hw_tstamp,
+    unsigned int wakeup_frames) {
   int rc = cras_iodev_frames_queued(odev, hw_tstamp);
   unsigned int level = (rc < 0) ? 0 : rc;
-  unsigned int wakeup_frames;
   *hw_level = level;
 
   if (odev->streams) {
@@ -1771,7 +1800,7 @@ unsigned int cras_iodev_default_frames_to_play_in_sleep(
      * waiting to be played, audio thread will wake up when hw_level drops
      * to min_cb_level. This situation only happens when hardware buffer is
      * smaller than the client stream buffer. The second one is waking up
-     * when hw_level drops to dev_normal_run_wake_up_time. It is a default
+     * when hw_level drops to wakeup_frames. It is a default
      * behavior. This wake up time is the bottom line to avoid underrun.
      * Normally, the audio thread does not wake up at that time because the
      * streams should wake it up before then.
@@ -1780,8 +1809,6 @@ unsigned int cras_iodev_default_frames_to_play_in_sleep(
       return *hw_level - odev->min_cb_level;
     }
 
-    wakeup_frames = cras_time_to_frames(&dev_normal_run_wake_up_time,
-                                        odev->format->frame_rate);
     if (level > wakeup_frames) {
       return level - wakeup_frames;
     } else {
@@ -1795,10 +1822,10 @@ unsigned int cras_iodev_default_frames_to_play_in_sleep(
    * fill zeros to it. We also need to consider min_cb_level in order to avoid
    * busyloop when device buffer size is smaller than wake up time.
    */
-  wakeup_frames = cras_time_to_frames(&dev_no_stream_wake_up_time,
-                                      odev->format->frame_rate);
-  if (level > MIN(odev->min_cb_level, wakeup_frames)) {
-    return level - MIN(odev->min_cb_level, wakeup_frames);
+  unsigned int no_stream_wakeup_frames = cras_time_to_frames(
+      &dev_no_stream_wake_up_time, odev->format->frame_rate);
+  if (level > MIN(odev->min_cb_level, no_stream_wakeup_frames)) {
+    return level - MIN(odev->min_cb_level, no_stream_wakeup_frames);
   } else {
     return 0;
   }
@@ -386,6 +386,15 @@ struct cras_iodev {
   unsigned int max_cb_level;
   // The highest hardware level of the device.
   unsigned int highest_hw_level;
+  // The lowest hardware level seen when the audio thread wakes up to write
+  // the device, i.e. how close playback came to an underrun.
+  unsigned int lowest_wake_hw_level;
+  // Frames kept in the buffer when the wake up time is scheduled from the
+  // hardware timestamp. 0 if the device doesn't schedule that way.
+  unsigned int tstamp_wake_margin_frames;
+  // Largest difference in frames between the hw_level predicted from the
+  // last hardware timestamp and the measured one.
+  unsigned int max_wake_prediction_error;
   // The callback level when the device was opened.
   unsigned int open_cb_level;
   // The largest callback level of streams attached to this
@@ -848,6 +857,17 @@ unsigned int cras_iodev_default_frames_to_play_in_sleep(
     unsigned int* hw_level,
     struct timespec* hw_tstamp);
 
+/*
+ * Same as cras_iodev_default_frames_to_play_in_sleep but wakes up when
+ * hw_level drops to `wakeup_frames` in normal run, instead of the default
+ * 1ms of frames.
+ */
+unsigned int cras_iodev_frames_to_play_in_sleep_until(
+    struct cras_iodev* odev,
+    unsigned int* hw_level,
+    struct timespec* hw_tstamp,
+    unsigned int wakeup_frames);
+
 /* Gets the number of frames to play when audio thread sleeps.
  * Args:
  *    iodev[in] - The device.
@@ -262,18 +262,27 @@ static int rm_dev_from_list(struct cras_iodev* dev) {
 }
 
 // Fills a dev_info array from the iodev_list.
-static void fill_dev_list(struct iodev_list* list,
-                          struct cras_iodev_info* dev_info,
-                          size_t out_size) {
-  int i = 0;
+/* Fills a dev_info array from the iodev_list, starting after the first
+ * |skip| devices. Returns the number of devices filled.
+ */
+static size_t fill_dev_list(struct iodev_list* list,
+                            size_t skip,
+                            struct cras_iodev_info* dev_info,
+                            size_t out_size) {
+  size_t i = 0;
   struct cras_iodev* tmp;
   DL_FOREACH (list->iodevs, tmp) {
-    memcpy(&dev_info[i], &tmp->info, sizeof(dev_info[0]));
-    i++;
+    if (skip) {
+      skip--;
+      continue;
+    }
     if (i == out_size) {
-      return;
+      break;
     }
+    memcpy(&dev_info[i], &tmp->info, sizeof(dev_info[0]));
+    i++;
   }
+  return i;
 }
 
 // Auxiliary information for fill_node_list.
@@ -294,9 +303,11 @@ static struct fill_node_list_auxiliary get_fill_node_list_auxiliary() {
   return aux;
 }
 
-// Fills an ionode_info array from the iodev_list.
+// Fills an ionode_info array from the iodev_list, starting after the first
+// |skip| nodes. Returns the number of nodes filled.
 // Must not block.
 static int fill_node_list(struct iodev_list* list,
+                          size_t skip,
                           struct cras_ionode_info node_info[],
                           size_t out_size,
                           const struct fill_node_list_auxiliary* aux) {
@@ -304,8 +315,16 @@ static int fill_node_list(struct iodev_list* list,
   struct cras_iodev* dev;
   struct cras_ionode* node;
 
+  if (out_size == 0) {
+    return 0;
+  }
+
   DL_FOREACH (list->iodevs, dev) {
     DL_FOREACH (dev->nodes, node) {
+      if (skip) {
+        skip--;
+        continue;
+      }
       node_info->iodev_idx = dev->info.idx;
       node_info->ionode_idx = node->idx;
       node_info->plugged = node->plugged;
@@ -376,7 +395,7 @@ static int get_dev_list(struct iodev_list* list,
     return -ENOMEM;
   }
 
-  fill_dev_list(list, dev_info, list->size);
+  fill_dev_list(list, 0, dev_info, list->size);
 
   *list_out = dev_info;
   return list->size;
@@ -2016,25 +2035,44 @@ cras_node_id_t cras_iodev_list_get_active_node_id(
 void cras_iodev_list_update_device_list() {
   struct fill_node_list_auxiliary aux = get_fill_node_list_auxiliary();
 
-  struct cras_server_state* state = cras_system_state_update_begin();
+  struct iodev_list* out = &devs[CRAS_STREAM_OUTPUT];
+  struct iodev_list* in = &devs[CRAS_STREAM_INPUT];
+
+  struct cras_server_state* state =
+      cras_system_state_update_section_begin(CRAS_SERVER_STATE_DEV_LIST);
   if (!state) {
     return;
   }
 
-  state->num_output_devs = devs[CRAS_STREAM_OUTPUT].size;
-  state->num_input_devs = devs[CRAS_STREAM_INPUT].size;
-  fill_dev_list(&devs[CRAS_STREAM_OUTPUT], &state->output_devs[0],
-                CRAS_MAX_IODEVS);
-  fill_dev_list(&devs[CRAS_STREAM_INPUT], &state->input_devs[0],
-                CRAS_MAX_IODEVS);
+  /* The first devices and nodes go to the tables old clients know about,
+   * the rest to the extension tables. */
+  state->num_output_devs =
+      fill_dev_list(out, 0, state->output_devs, CRAS_MAX_IODEVS);
+  state->num_output_devs_total =
+      state->num_output_devs +
+      fill_dev_list(out, CRAS_MAX_IODEVS, state->output_devs_ext,
+                    CRAS_MAX_IODEVS_EXT);
+  state->num_input_devs =
+      fill_dev_list(in, 0, state->input_devs, CRAS_MAX_IODEVS);
+  state->num_input_devs_total =
+      state->num_input_devs + fill_dev_list(in, CRAS_MAX_IODEVS,
+                                            state->input_devs_ext,
+                                            CRAS_MAX_IODEVS_EXT);
 
   state->num_output_nodes =
-      fill_node_list(&devs[CRAS_STREAM_OUTPUT], &state->output_nodes[0],
-                     CRAS_MAX_IONODES, &aux);
-  state->num_input_nodes = fill_node_list(
-      &devs[CRAS_STREAM_INPUT], &state->input_nodes[0], CRAS_MAX_IONODES, &aux);
-
-  cras_system_state_update_complete();
+      fill_node_list(out, 0, state->output_nodes, CRAS_MAX_IONODES, &aux);
+  state->num_output_nodes_total =
+      state->num_output_nodes +
+      fill_node_list(out, CRAS_MAX_IONODES, state->output_nodes_ext,
+                     CRAS_MAX_IONODES_EXT, &aux);
+  state->num_input_nodes =
+      fill_node_list(in, 0, state->input_nodes, CRAS_MAX_IONODES, &aux);
+  state->num_input_nodes_total =
+      state->num_input_nodes + fill_node_list(in, CRAS_MAX_IONODES,
+                                              state->input_nodes_ext,
+                                              CRAS_MAX_IONODES_EXT, &aux);
+
+  cras_system_state_update_section_complete(CRAS_SERVER_STATE_DEV_LIST);
 }
 
 // Look up the first hotword stream and the device it pins to.
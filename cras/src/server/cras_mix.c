@@ -174,6 +174,19 @@ void cras_mix_add(snd_pcm_format_t fmt,
   ops->add(fmt, dst, src, count, index, mute, mix_vol);
 }
 
+void cras_mix_add_ramp(snd_pcm_format_t fmt,
+                       uint8_t* dst,
+                       uint8_t* src,
+                       unsigned int frame,
+                       int mute,
+                       float scaler,
+                       float increment,
+                       float target,
+                       int channel) {
+  ops->add_ramp(fmt, dst, src, frame * channel, mute, scaler, increment,
+                target, channel);
+}
+
 void cras_mix_add_scale_stride(snd_pcm_format_t fmt,
                                uint8_t* dst,
                                uint8_t* src,
@@ -73,6 +73,30 @@ void cras_mix_add(snd_pcm_format_t fmt,
                   int mute,
                   float mix_vol);
 
+/* Add src buffer to dst, scaling with the provided scaler and increment.
+ * Used to smooth a change of the mix volume over a number of frames.
+ * Args:
+ *    fmt - The format (SND_PCM_FORMAT_*)
+ *    dst - Buffer of samples to mix to.
+ *    src - Buffer of samples to mix from.
+ *    frame - The number of frames to mix.
+ *    mute - Is the stream providing the buffer muted.
+ *    scaler - Amount to scale the first frame.
+ *    increment - The increment(+/-) of scaler at each frame. The scaler after
+ *                increasing/decreasing will be clipped at target.
+ *    target - The value at which to clip the scaler.
+ *    channel - Number of samples in a frame.
+ */
+void cras_mix_add_ramp(snd_pcm_format_t fmt,
+                       uint8_t* dst,
+                       uint8_t* src,
+                       unsigned int frame,
+                       int mute,
+                       float scaler,
+                       float increment,
+                       float target,
+                       int channel);
+
 /* Add src buffer to dst with independent channel strides.
  * Args:
  *    fmt - The format (SND_PCM_FORMAT_*)
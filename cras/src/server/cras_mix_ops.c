@@ -34,6 +34,16 @@ static inline int need_to_scale(float scaler) {
   return (scaler < 0.99 || scaler > 1.01);
 }
 
+/* Returns the scaler of a ramp, clipped at target once the increment has
+ * moved it past target. */
+static inline float ramp_scaler(float scaler, float increment, float target) {
+  if ((scaler > target && increment > 0) ||
+      (scaler < target && increment < 0)) {
+    return target;
+  }
+  return scaler;
+}
+
 /*
  * Signed 16 bit little endian functions.
  */
@@ -175,6 +185,26 @@ static void cras_mix_add_s16_le(uint8_t* dst,
   scale_add_clip_s16_le(out, in, count, mix_vol);
 }
 
+/* Adds src into dst, scaling each frame of step samples by a scaler which
+ * moves by increment per frame and stops at target. */
+static void cras_mix_add_ramp_s16_le(uint8_t* dst,
+                                     uint8_t* src,
+                                     unsigned int count,
+                                     float scaler,
+                                     float increment,
+                                     float target,
+                                     int step) {
+  int16_t* out = (int16_t*)dst;
+  int16_t* in = (int16_t*)src;
+  unsigned int i;
+
+  for (i = 0; i + step <= count; i += step) {
+    scale_add_clip_s16_le(out + i, in + i, step,
+                          ramp_scaler(scaler, increment, target));
+    scaler += increment;
+  }
+}
+
 static void cras_mix_add_scale_stride_s16_le(uint8_t* dst,
                                              uint8_t* src,
                                              unsigned int dst_stride,
@@ -386,6 +416,26 @@ static void cras_mix_add_s24_le(uint8_t* dst,
   scale_add_clip_s24_le(out, in, count, mix_vol);
 }
 
+/* Adds src into dst, scaling each frame of step samples by a scaler which
+ * moves by increment per frame and stops at target. */
+static void cras_mix_add_ramp_s24_le(uint8_t* dst,
+                                     uint8_t* src,
+                                     unsigned int count,
+                                     float scaler,
+                                     float increment,
+                                     float target,
+                                     int step) {
+  int32_t* out = (int32_t*)dst;
+  int32_t* in = (int32_t*)src;
+  unsigned int i;
+
+  for (i = 0; i + step <= count; i += step) {
+    scale_add_clip_s24_le(out + i, in + i, step,
+                          ramp_scaler(scaler, increment, target));
+    scaler += increment;
+  }
+}
+
 static void cras_mix_add_scale_stride_s24_le(uint8_t* dst,
                                              uint8_t* src,
                                              unsigned int dst_stride,
@@ -573,6 +623,26 @@ static void cras_mix_add_s32_le(uint8_t* dst,
   scale_add_clip_s32_le(out, in, count, mix_vol);
 }
 
+/* Adds src into dst, scaling each frame of step samples by a scaler which
+ * moves by increment per frame and stops at target. */
+static void cras_mix_add_ramp_s32_le(uint8_t* dst,
+                                     uint8_t* src,
+                                     unsigned int count,
+                                     float scaler,
+                                     float increment,
+                                     float target,
+                                     int step) {
+  int32_t* out = (int32_t*)dst;
+  int32_t* in = (int32_t*)src;
+  unsigned int i;
+
+  for (i = 0; i + step <= count; i += step) {
+    scale_add_clip_s32_le(out + i, in + i, step,
+                          ramp_scaler(scaler, increment, target));
+    scaler += increment;
+  }
+}
+
 static void cras_mix_add_scale_stride_s32_le(uint8_t* dst,
                                              uint8_t* src,
                                              unsigned int dst_stride,
@@ -794,6 +864,24 @@ static void cras_mix_add_s24_3le(uint8_t* dst,
   scale_add_clip_s24_3le(out, in, count, mix_vol);
 }
 
+/* Adds src into dst, scaling each frame of step samples by a scaler which
+ * moves by increment per frame and stops at target. */
+static void cras_mix_add_ramp_s24_3le(uint8_t* dst,
+                                      uint8_t* src,
+                                      unsigned int count,
+                                      float scaler,
+                                      float increment,
+                                      float target,
+                                      int step) {
+  unsigned int i;
+
+  for (i = 0; i + step <= count; i += step) {
+    scale_add_clip_s24_3le(dst + i * 3, src + i * 3, step,
+                           ramp_scaler(scaler, increment, target));
+    scaler += increment;
+  }
+}
+
 static void cras_mix_add_scale_stride_s24_3le(uint8_t* dst,
                                               uint8_t* src,
                                               unsigned int dst_stride,
@@ -889,6 +977,37 @@ static void mix_add(snd_pcm_format_t fmt,
   }
 }
 
+static void mix_add_ramp(snd_pcm_format_t fmt,
+                         uint8_t* dst,
+                         uint8_t* src,
+                         unsigned int count,
+                         int mute,
+                         float scaler,
+                         float increment,
+                         float target,
+                         int step) {
+  if (mute) {
+    return;
+  }
+
+  switch (fmt) {
+    case SND_PCM_FORMAT_S16_LE:
+      return cras_mix_add_ramp_s16_le(dst, src, count, scaler, increment,
+                                      target, step);
+    case SND_PCM_FORMAT_S24_LE:
+      return cras_mix_add_ramp_s24_le(dst, src, count, scaler, increment,
+                                      target, step);
+    case SND_PCM_FORMAT_S32_LE:
+      return cras_mix_add_ramp_s32_le(dst, src, count, scaler, increment,
+                                      target, step);
+    case SND_PCM_FORMAT_S24_3LE:
+      return cras_mix_add_ramp_s24_3le(dst, src, count, scaler, increment,
+                                       target, step);
+    default:
+      break;
+  }
+}
+
 static void mix_add_scale_stride(snd_pcm_format_t fmt,
                                  uint8_t* dst,
                                  uint8_t* src,
@@ -923,6 +1042,7 @@ const struct cras_mix_ops OPS(mixer_ops) = {
     .scale_buffer = scale_buffer,
     .scale_buffer_increment = scale_buffer_increment,
     .add = mix_add,
+    .add_ramp = mix_add_ramp,
     .add_scale_stride = mix_add_scale_stride,
     .mute_buffer = mix_mute_buffer,
 };
@@ -48,6 +48,16 @@ struct cras_mix_ops {
               unsigned int index,
               int mute,
               float mix_vol);
+  // See cras_mix_add_ramp.
+  void (*add_ramp)(snd_pcm_format_t fmt,
+                   uint8_t* dst,
+                   uint8_t* src,
+                   unsigned int count,
+                   int mute,
+                   float scaler,
+                   float increment,
+                   float target,
+                   int step);
   // See cras_mix_add_scale_stride.
   void (*add_scale_stride)(snd_pcm_format_t fmt,
                            uint8_t* dst,
@@ -33,7 +33,7 @@ int cras_non_empty_audio_send_msg(int32_t non_empty) {
   init_non_empty_audio_msg(&msg);
   msg.non_empty = non_empty;
 
-  rc = cras_main_message_send((struct cras_main_message*)&msg);
+  rc = cras_main_message_send_from_audio((struct cras_main_message*)&msg);
   if (rc < 0) {
     syslog(LOG_ERR, "Failed to send non-empty audio message!");
   }
@@ -5,6 +5,7 @@
 
 #include "cras/src/server/cras_observer.h"
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,9 +14,23 @@
 #include "cras/src/common/cras_observer_ops.h"
 #include "cras/src/server/cras_alert.h"
 #include "cras/src/server/cras_iodev_list.h"
+#include "cras/src/server/cras_system_state.h"
 #include "cras_types.h"
 #include "third_party/utlist/utlist.h"
 
+/* Minimum interval between two notifications of values that change in
+ * bursts, like volumes dragged with a slider.
+ */
+#define CRAS_OBSERVER_MIN_INTERVAL_MS 20
+
+// Number of function pointers in struct cras_observer_ops.
+#define CRAS_OBSERVER_NUM_OPS \
+  (sizeof(struct cras_observer_ops) / sizeof(void (*)(void)))
+
+// Index of |op| among the function pointers in struct cras_observer_ops.
+#define CRAS_OBSERVER_OP_INDEX(op) \
+  (offsetof(struct cras_observer_ops, op) / sizeof(void (*)(void)))
+
 struct cras_observer_client {
   struct cras_observer_ops ops;
   void* context;
@@ -60,6 +75,10 @@ struct cras_observer_alerts {
 struct cras_observer_server {
   struct cras_observer_alerts alerts;
   struct cras_observer_client* clients;
+  /* Number of clients with each op set. Updated on the main thread, read
+   * by notifiers on any thread to skip changes no one is subscribed to.
+   */
+  unsigned int subscribers[CRAS_OBSERVER_NUM_OPS];
 };
 
 struct cras_observer_alert_data_volume {
@@ -530,11 +549,32 @@ static int cras_observer_server_set_alert(struct cras_alert** alert,
       goto error;                                                             \
   } while (0)
 
+// Adds |delta| to the subscriber count of each op set in |ops|.
+static void update_subscribers(const struct cras_observer_ops* ops,
+                               int delta) {
+  void (*op)(void);
+  size_t i;
+
+  for (i = 0; i < CRAS_OBSERVER_NUM_OPS; i++) {
+    memcpy(&op, (const char*)ops + i * sizeof(op), sizeof(op));
+    if (op) {
+      __atomic_fetch_add(&g_observer->subscribers[i], delta,
+                         __ATOMIC_RELAXED);
+    }
+  }
+}
+
+// Returns true if any client is subscribed to |op|.
+#define CRAS_OBSERVER_HAS_SUBSCRIBER(op)                                \
+  (__atomic_load_n(&g_observer->subscribers[CRAS_OBSERVER_OP_INDEX(op)], \
+                   __ATOMIC_RELAXED) > 0)
+
 /*
  * Public interface
  */
 
 int cras_observer_server_init() {
+  struct cras_tm* tm;
   int rc;
 
   memset(&g_empty_ops, 0, sizeof(g_empty_ops));
@@ -577,6 +617,19 @@ int cras_observer_server_init() {
   CRAS_OBSERVER_SET_ALERT_WITH_DIRECTION(num_active_streams,
                                          CRAS_STREAM_POST_MIX_PRE_DSP);
 
+  // Coalesce the values which flood clients while being dragged or polled.
+  tm = cras_system_state_get_tm();
+  cras_alert_set_min_interval(g_observer->alerts.output_volume, tm,
+                              CRAS_OBSERVER_MIN_INTERVAL_MS);
+  cras_alert_set_min_interval(g_observer->alerts.capture_gain, tm,
+                              CRAS_OBSERVER_MIN_INTERVAL_MS);
+  cras_alert_set_min_interval(g_observer->alerts.output_node_volume, tm,
+                              CRAS_OBSERVER_MIN_INTERVAL_MS);
+  cras_alert_set_min_interval(g_observer->alerts.input_node_gain, tm,
+                              CRAS_OBSERVER_MIN_INTERVAL_MS);
+  cras_alert_set_min_interval(g_observer->alerts.ewma_power_reported, tm,
+                              CRAS_OBSERVER_MIN_INTERVAL_MS);
+
   return 0;
 
 error:
@@ -644,11 +697,13 @@ void cras_observer_set_ops(struct cras_observer_client* client,
   if (!client) {
     return;
   }
+  update_subscribers(&client->ops, -1);
   if (!ops) {
     memset(&client->ops, 0, sizeof(client->ops));
   } else {
     memcpy(&client->ops, ops, sizeof(client->ops));
   }
+  update_subscribers(&client->ops, 1);
 }
 
 struct cras_observer_client* cras_observer_add(
@@ -670,6 +725,7 @@ void cras_observer_remove(struct cras_observer_client* client) {
   if (!client) {
     return;
   }
+  update_subscribers(&client->ops, -1);
   DL_DELETE(g_observer->clients, client);
   free(client);
 }
@@ -681,6 +737,9 @@ void cras_observer_remove(struct cras_observer_client* client) {
 void cras_observer_notify_output_volume(int32_t volume) {
   struct cras_observer_alert_data_volume data;
 
+  if (!CRAS_OBSERVER_HAS_SUBSCRIBER(output_volume_changed)) {
+    return;
+  }
   data.volume = volume;
   cras_alert_pending_data(g_observer->alerts.output_volume, &data,
                           sizeof(data));
@@ -700,6 +759,9 @@ void cras_observer_notify_output_mute(int muted,
 void cras_observer_notify_capture_gain(int32_t gain) {
   struct cras_observer_alert_data_volume data;
 
+  if (!CRAS_OBSERVER_HAS_SUBSCRIBER(capture_gain_changed)) {
+    return;
+  }
   data.volume = gain;
   cras_alert_pending_data(g_observer->alerts.capture_gain, &data, sizeof(data));
 }
@@ -730,30 +792,39 @@ void cras_observer_notify_output_node_volume(cras_node_id_t node_id,
                                              int32_t volume) {
   struct cras_observer_alert_data_node_volume data;
 
+  if (!CRAS_OBSERVER_HAS_SUBSCRIBER(output_node_volume_changed)) {
+    return;
+  }
   data.node_id = node_id;
   data.volume = volume;
-  cras_alert_pending_data(g_observer->alerts.output_node_volume, &data,
-                          sizeof(data));
+  cras_alert_pending_keyed_data(g_observer->alerts.output_node_volume, node_id,
+                                &data, sizeof(data));
 }
 
 void cras_observer_notify_node_left_right_swapped(cras_node_id_t node_id,
                                                   int swapped) {
   struct cras_observer_alert_data_node_lr_swapped data;
 
+  if (!CRAS_OBSERVER_HAS_SUBSCRIBER(node_left_right_swapped_changed)) {
+    return;
+  }
   data.node_id = node_id;
   data.swapped = swapped;
-  cras_alert_pending_data(g_observer->alerts.node_left_right_swapped, &data,
-                          sizeof(data));
+  cras_alert_pending_keyed_data(g_observer->alerts.node_left_right_swapped,
+                                node_id, &data, sizeof(data));
 }
 
 void cras_observer_notify_input_node_gain(cras_node_id_t node_id,
                                           int32_t gain) {
   struct cras_observer_alert_data_node_volume data;
 
+  if (!CRAS_OBSERVER_HAS_SUBSCRIBER(input_node_gain_changed)) {
+    return;
+  }
   data.node_id = node_id;
   data.volume = gain;
-  cras_alert_pending_data(g_observer->alerts.input_node_gain, &data,
-                          sizeof(data));
+  cras_alert_pending_keyed_data(g_observer->alerts.input_node_gain, node_id,
+                                &data, sizeof(data));
 }
 
 void cras_observer_notify_suspend_changed(int suspended) {
@@ -892,6 +963,9 @@ void cras_observer_notify_num_arc_streams(uint32_t num_arc_streams) {
 void cras_observer_notify_ewma_power_reported(double power) {
   struct cras_observer_alert_data_ewma_power_reported data = {.power = power};
 
+  if (!CRAS_OBSERVER_HAS_SUBSCRIBER(ewma_power_reported)) {
+    return;
+  }
   cras_alert_pending_data(g_observer->alerts.ewma_power_reported, &data,
                           sizeof(data));
 }
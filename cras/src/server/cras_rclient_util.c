@@ -47,6 +47,7 @@ int rclient_validate_message_fds(const struct cras_server_message* msg,
       }
       break;
     case CRAS_SERVER_SET_AEC_DUMP:
+    case CRAS_SERVER_SET_ATLOG_TRACE:
       if (num_fds > 1) {
         goto error;
       }
@@ -18,6 +18,7 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "cras/src/server/audio_thread_health.h"
 #include "cras/src/server/buffer_share.h"
 #include "cras/src/server/cras_audio_area.h"
 #include "cras/src/server/cras_ewma_power_reporter.h"
@@ -277,6 +278,7 @@ static int read_and_handle_client_message(struct cras_rstream* stream) {
    */
   if (stream->direction == CRAS_STREAM_OUTPUT &&
       msg.id == AUDIO_MESSAGE_DATA_READY) {
+    audio_thread_health_stream_replied(&stream->last_fetch_ts);
     clear_pending_reply(stream);
   }
 
@@ -332,6 +334,7 @@ static bool should_honor_apm_effects(const struct cras_rstream_config* config) {
 int cras_rstream_create(struct cras_rstream_config* config,
                         struct cras_rstream** stream_out) {
   struct cras_rstream* stream;
+  struct cras_power_meter* meter;
   int rc;
 
   rc = verify_rstream_parameters(config, stream_out);
@@ -402,6 +405,9 @@ int cras_rstream_create(struct cras_rstream_config* config,
   cras_system_state_stream_added(
       stream->direction, stream->client_type,
       cras_stream_apm_get_effects(stream->stream_apm));
+  meter = cras_system_state_add_power_meter(
+      CRAS_POWER_METER_STREAM, stream->stream_id, stream->direction);
+  ewma_power_set_meter(&stream->ewma, meter);
 
   clock_gettime(CLOCK_MONOTONIC_RAW, &stream->start_ts);
 
@@ -412,6 +418,7 @@ int cras_rstream_create(struct cras_rstream_config* config,
 
 void cras_rstream_destroy(struct cras_rstream* stream) {
   cras_server_metrics_stream_destroy(stream);
+  cras_system_state_remove_power_meter(stream->ewma.meter);
   cras_system_state_stream_removed(
       stream->direction, stream->client_type,
       cras_stream_apm_get_effects(stream->stream_apm));
@@ -566,7 +573,7 @@ void cras_rstream_dev_offset_update(struct cras_rstream* rstream,
 void cras_rstream_update_input_write_pointer(struct cras_rstream* rstream) {
   unsigned int nwritten = buffer_share_get_new_write_point(rstream->buf_state);
 
-  if (cras_ewma_power_reporter_should_calculate(rstream->stream_id)) {
+  if (rstream->ewma.enabled) {
     unsigned int nfr = 0;
     uint8_t* dst;
 
@@ -574,9 +581,11 @@ void cras_rstream_update_input_write_pointer(struct cras_rstream* rstream) {
     // cras_shm_buffer_written
     dst = cras_shm_get_writeable_frames(rstream->shm, nwritten, &nfr);
     if (dst != NULL) {
-      ewma_power_calculate(&rstream->ewma, (int16_t*)dst,
-                           rstream->format.num_channels, nfr);
-      cras_ewma_power_reporter_report(rstream->stream_id, &rstream->ewma);
+      ewma_power_calculate(&rstream->ewma, dst, rstream->format.num_channels,
+                           nfr);
+      if (cras_ewma_power_reporter_should_calculate(rstream->stream_id)) {
+        cras_ewma_power_reporter_report(rstream->stream_id, &rstream->ewma);
+      }
     }
   }
 
@@ -598,8 +607,8 @@ void cras_rstream_update_output_read_pointer(struct cras_rstream* rstream) {
     if (src == NULL) {
       break;
     }
-    ewma_power_calculate(&rstream->ewma, (int16_t*)src,
-                         rstream->format.num_channels, nfr);
+    ewma_power_calculate(&rstream->ewma, src, rstream->format.num_channels,
+                         nfr);
     offset += nfr;
   }
 
@@ -886,11 +886,19 @@ cras_sco_enable_cras_sr_bt_failed:
 
 void cras_sco_disable_cras_sr_bt(struct cras_sco* sco) {
   byte_buffer_destroy(&sco->sr_buf);
+  cras_sr_bt_log_stats(sco->sr);
   cras_sr_destroy(sco->sr);
   sco->sr = NULL;
   sco->is_cras_sr_bt_enabled = false;
 }
 
+unsigned cras_sco_sr_latency_frames(struct cras_sco* sco) {
+  if (!sco->is_cras_sr_bt_enabled) {
+    return 0;
+  }
+  return cras_sr_get_latency_frames(sco->sr);
+}
+
 void cras_sco_set_wbs_logger(struct cras_sco* sco,
                              struct packet_status_logger* wbs_logger) {
   sco->wbs_logger = wbs_logger;
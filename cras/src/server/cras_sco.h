@@ -55,6 +55,15 @@ int cras_sco_enable_cras_sr_bt(struct cras_sco* sco,
  */
 void cras_sco_disable_cras_sr_bt(struct cras_sco* sco);
 
+/* Gets the look-ahead the cras_sr model adds to the capture path.
+ *
+ * Args:
+ *    sco - The cras_sco instance.
+ * Returns:
+ *    The latency in output frames, 0 when cras_sr is not enabled.
+ */
+unsigned cras_sco_sr_latency_frames(struct cras_sco* sco);
+
 // Destroys given cras_sco instance.
 void cras_sco_destroy(struct cras_sco* sco);
 
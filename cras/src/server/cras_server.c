@@ -14,10 +14,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
 #include <sys/param.h>
 #include <sys/poll.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/timerfd.h>
 #include <sys/un.h>
 #include <syslog.h>
 #include <time.h>
@@ -56,6 +58,18 @@
 #include "cras_util.h"
 #include "third_party/utlist/utlist.h"
 
+// Maximum number of ready fds handled per main loop iteration.
+#define MAX_EPOLL_EVENTS 32
+
+/* Something the main loop watches through epoll. The epoll_event of each
+ * watched fd points to one of these, so that a ready fd is dispatched
+ * without searching for its owner.
+ */
+struct server_watch {
+  void (*handler)(void* arg, uint32_t revents);
+  void* arg;
+};
+
 // Store a list of clients that are attached to the server.
 struct attached_client {
   // Unique identifier for this client.
@@ -66,8 +80,8 @@ struct attached_client {
   struct ucred ucred;
   // rclient to handle messages from this client.
   struct cras_rclient* client;
-  // Pointer to struct pollfd for this callback.
-  struct pollfd* pollfd;
+  // Dispatches readiness of |fd|.
+  struct server_watch watch;
   struct attached_client *next, *prev;
 };
 
@@ -84,8 +98,8 @@ struct client_callback {
   void (*callback)(void* data, int revents);
   // Pointer passed to the callback.
   void* callback_data;
-  // Pointer to struct pollfd for this callback.
-  struct pollfd* pollfd;
+  // Dispatches readiness of |select_fd|.
+  struct server_watch watch;
   int deleted;
   // The events to poll for.
   int events;
@@ -104,6 +118,8 @@ struct server_socket {
   struct sockaddr_un addr;
   int fd;
   enum CRAS_CONNECTION_TYPE type;
+  // Dispatches new connections on |fd|.
+  struct server_watch watch;
 };
 
 // Local server data.
@@ -115,11 +131,42 @@ struct server_data {
   size_t num_client_callbacks;
   size_t next_client_id;
   struct server_socket server_sockets[CRAS_NUM_CONN_TYPE];
-} server_instance;
+  // The epoll instance the main loop waits on.
+  int epoll_fd;
+  // Fires when the next cras_tm timer is due.
+  int timer_fd;
+  struct server_watch timer_watch;
+} server_instance = {
+    .epoll_fd = -1,
+    .timer_fd = -1,
+};
+
+/* Starts watching |fd| for |events|, dispatching them to |watch|.
+ * Returns 0 on success or a negative error code.
+ */
+static int server_watch_fd(int fd,
+                           uint32_t events,
+                           struct server_watch* watch) {
+  struct epoll_event ev = {
+      .events = events,
+      .data.ptr = watch,
+  };
+
+  if (epoll_ctl(server_instance.epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    return -errno;
+  }
+  return 0;
+}
+
+static void server_unwatch_fd(int fd) {
+  // Fails harmlessly if |fd| was already closed, which unwatches it.
+  epoll_ctl(server_instance.epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+}
 
 // Cleanup a given server_socket
 static void server_socket_cleanup(struct server_socket* socket) {
   if (socket && socket->fd >= 0) {
+    server_unwatch_fd(socket->fd);
     close(socket->fd);
     socket->fd = -1;
     unlink(socket->addr.sun_path);
@@ -129,6 +176,7 @@ static void server_socket_cleanup(struct server_socket* socket) {
 /* Remove a client from the list and destroy it.  Calling rclient_destroy will
  * also free all the streams owned by the client */
 static void remove_client(struct attached_client* client) {
+  server_unwatch_fd(client->fd);
   close(client->fd);
   DL_DELETE(server_instance.clients_head, client);
   server_instance.num_clients--;
@@ -172,6 +220,13 @@ read_error:
   remove_client(client);
 }
 
+static void handle_client_ready(void* arg, uint32_t revents) {
+  // Errors and hangups are noticed by the read and remove the client.
+  if (revents & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+    handle_message_from_client((struct attached_client*)arg);
+  }
+}
+
 /* Discovers and fills in info about the client that can be obtained from the
  * socket. The pid of the attaching client identifies it in logs. */
 static void fill_client_info(struct attached_client* client) {
@@ -190,7 +245,7 @@ static void send_client_list_to_clients(struct server_data* serv) {
   struct cras_server_state* state;
   unsigned i;
 
-  state = cras_system_state_update_begin();
+  state = cras_system_state_update_section_begin(CRAS_SERVER_STATE_CLIENT_LIST);
   if (!state) {
     return;
   }
@@ -211,7 +266,7 @@ static void send_client_list_to_clients(struct server_data* serv) {
     }
   }
 
-  cras_system_state_update_complete();
+  cras_system_state_update_section_complete(CRAS_SERVER_STATE_CLIENT_LIST);
 }
 
 /* Handles requests from a client to attach to the server.  Create a local
@@ -254,7 +309,8 @@ static void handle_new_connection(struct server_socket* server_socket) {
 
   poll_client->fd = connection_fd;
   poll_client->next = NULL;
-  poll_client->pollfd = NULL;
+  poll_client->watch.handler = handle_client_ready;
+  poll_client->watch.arg = poll_client;
   fill_client_info(poll_client);
 
   poll_client->client =
@@ -264,6 +320,12 @@ static void handle_new_connection(struct server_socket* server_socket) {
     goto error;
   }
 
+  if (server_watch_fd(connection_fd, EPOLLIN, &poll_client->watch) < 0) {
+    syslog(LOG_WARNING, "failed to watch client");
+    cras_rclient_destroy(poll_client->client);
+    goto error;
+  }
+
   DL_APPEND(server_instance.clients_head, poll_client);
   server_instance.num_clients++;
   // Send a current list of available inputs and outputs.
@@ -276,6 +338,21 @@ error:
   return;
 }
 
+static void handle_server_socket_ready(void* arg, uint32_t revents) {
+  if (revents & EPOLLIN) {
+    handle_new_connection((struct server_socket*)arg);
+  }
+}
+
+static void handle_client_callback_ready(void* arg, uint32_t revents) {
+  struct client_callback* client_cb = (struct client_callback*)arg;
+
+  // The poll and epoll event bits have the same values.
+  if (!client_cb->deleted && (revents & client_cb->events)) {
+    client_cb->callback(client_cb->callback_data, revents);
+  }
+}
+
 /* Add a file descriptor to be passed to select in the main loop. This is
  * registered with system state so that it is called when any client asks to
  * have a callback triggered based on an fd being readable. */
@@ -287,6 +364,7 @@ static int add_select_fd(int fd,
   struct client_callback* new_cb;
   struct client_callback* client_cb;
   struct server_data* serv;
+  int rc;
 
   serv = (struct server_data*)server_data;
   if (serv == NULL) {
@@ -310,7 +388,14 @@ static int add_select_fd(int fd,
   new_cb->callback_data = callback_data;
   new_cb->deleted = 0;
   new_cb->events = events;
-  new_cb->pollfd = NULL;
+  new_cb->watch.handler = handle_client_callback_ready;
+  new_cb->watch.arg = new_cb;
+
+  rc = server_watch_fd(fd, events, &new_cb->watch);
+  if (rc < 0) {
+    free(new_cb);
+    return rc;
+  }
 
   DL_APPEND(serv->client_callbacks, new_cb);
   server_instance.num_client_callbacks++;
@@ -330,7 +415,8 @@ static void rm_select_fd(int fd, void* server_data) {
   }
 
   DL_FOREACH (serv->client_callbacks, client_cb) {
-    if (client_cb->select_fd == fd) {
+    if (client_cb->select_fd == fd && !client_cb->deleted) {
+      server_unwatch_fd(fd);
       client_cb->deleted = 1;
     }
   }
@@ -363,7 +449,8 @@ static int add_task(void (*cb)(void* data),
 }
 
 /* Cleans up the file descriptor list removing items deleted during the main
- * loop iteration. */
+ * loop iteration. They are kept until then as events already returned by
+ * epoll may still point to them. */
 static void cleanup_select_fds(void* server_data) {
   struct server_data* serv;
   struct client_callback* client_cb;
@@ -382,6 +469,36 @@ static void cleanup_select_fds(void* server_data) {
   }
 }
 
+static void handle_timer_fd_ready(void* arg, uint32_t revents) {
+  uint64_t expirations;
+
+  // Only clears the timer, expired timers are run every iteration.
+  if (read(server_instance.timer_fd, &expirations, sizeof(expirations)) < 0) {
+    syslog(LOG_DEBUG, "Failed to read timer fd: %d", errno);
+  }
+}
+
+/* Arms the timer fd to fire after |ts|, or disarms it if |ts| is NULL.
+ * Returns the timeout to pass to epoll_wait.
+ */
+static int arm_timer_fd(const struct timespec* ts) {
+  struct itimerspec spec = {};
+
+  if (ts) {
+    // A zero it_value would disarm the timer, don't block instead.
+    if (ts->tv_sec == 0 && ts->tv_nsec == 0) {
+      return 0;
+    }
+    spec.it_value = *ts;
+  }
+  if (timerfd_settime(server_instance.timer_fd, 0, &spec, NULL) < 0) {
+    syslog(LOG_WARNING, "Failed to arm timer fd: %d", errno);
+    // Fall back to the coarser epoll timeout.
+    return ts ? timespec_to_ms(ts) + 1 : -1;
+  }
+  return -1;
+}
+
 /* Checks whether the internal card is present. */
 void check_internal_card(struct cras_timer* t, void* second) {
   cras_server_metrics_internal_soundcard_status(
@@ -403,6 +520,25 @@ int cras_server_init() {
 
   server_instance.next_client_id = RESERVED_CLIENT_IDS;
 
+  server_instance.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (server_instance.epoll_fd < 0) {
+    syslog(LOG_ERR, "Failed to create epoll fd: %d", errno);
+    return -errno;
+  }
+  server_instance.timer_fd =
+      timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (server_instance.timer_fd < 0) {
+    syslog(LOG_ERR, "Failed to create timer fd: %d", errno);
+    return -errno;
+  }
+  server_instance.timer_watch.handler = handle_timer_fd_ready;
+  server_instance.timer_watch.arg = NULL;
+  if (server_watch_fd(server_instance.timer_fd, EPOLLIN,
+                      &server_instance.timer_watch) < 0) {
+    syslog(LOG_ERR, "Failed to watch timer fd");
+    return -EINVAL;
+  }
+
   // Initialize global observer.
   cras_observer_server_init();
 
@@ -418,6 +554,11 @@ int cras_server_init() {
   int main_message_fd = cras_main_message_init();
   cras_system_add_select_fd(main_message_fd, handle_main_messages, NULL,
                             POLLIN);
+  int audio_message_fd = cras_main_message_audio_fd();
+  if (audio_message_fd >= 0) {
+    cras_system_add_select_fd(audio_message_fd, handle_audio_main_messages,
+                              NULL, POLLIN);
+  }
 
   // Initializes all server_sockets
   for (int conn_type = 0; conn_type < CRAS_NUM_CONN_TYPE; conn_type++) {
@@ -492,6 +633,14 @@ static int create_and_listen_server_socket(
     goto error;
   }
 
+  server_socket->watch.handler = handle_server_socket_ready;
+  server_socket->watch.arg = server_socket;
+  rc = server_watch_fd(socket_fd, EPOLLIN, &server_socket->watch);
+  if (rc < 0) {
+    syslog(LOG_ERR, "Watch server socket failed.");
+    goto error;
+  }
+
   server_socket->fd = socket_fd;
   server_socket->type = conn_type;
   return 0;
@@ -513,23 +662,14 @@ static void cleanup_server_sockets() {
 int cras_server_run(unsigned int profile_disable_mask) {
   DBusConnection* dbus_conn;
   int rc = 0;
-  struct attached_client* elm;
-  struct client_callback* client_cb;
   struct system_task* tasks;
   struct system_task* system_task;
   struct cras_tm* tm;
-  struct timespec ts, *poll_timeout;
+  struct timespec ts;
   int timers_active;
-  struct pollfd* pollfds;
-  struct pollfd* pollfds_tmp;
-  unsigned int pollfds_size = 32;
-  unsigned int num_pollfds, poll_size_needed;
-
-  pollfds = malloc(sizeof(*pollfds) * pollfds_size);
-
-  if (!pollfds) {
-    return -ENOMEM;
-  }
+  struct epoll_event events[MAX_EPOLL_EVENTS];
+  struct server_watch* watch;
+  int num_events, timeout_ms, i;
 
   cras_udev_start_sound_subsystem_monitor();
 
@@ -614,40 +754,6 @@ int cras_server_run(unsigned int profile_disable_mask) {
 
   // Main server loop - client callbacks are run from this context.
   while (1) {
-    poll_size_needed = CRAS_NUM_CONN_TYPE + server_instance.num_clients +
-                       server_instance.num_client_callbacks;
-    if (poll_size_needed > pollfds_size) {
-      pollfds_size = 2 * poll_size_needed;
-      pollfds_tmp = realloc(pollfds, sizeof(*pollfds) * pollfds_size);
-      if (!pollfds_tmp) {
-        rc = -ENOMEM;
-        goto bail;
-      }
-      pollfds = pollfds_tmp;
-    }
-
-    for (int conn_type = 0; conn_type < CRAS_NUM_CONN_TYPE; conn_type++) {
-      pollfds[conn_type].fd = server_instance.server_sockets[conn_type].fd;
-      pollfds[conn_type].events = POLLIN;
-    }
-    num_pollfds = CRAS_NUM_CONN_TYPE;
-
-    DL_FOREACH (server_instance.clients_head, elm) {
-      pollfds[num_pollfds].fd = elm->fd;
-      pollfds[num_pollfds].events = POLLIN;
-      elm->pollfd = &pollfds[num_pollfds];
-      num_pollfds++;
-    }
-    DL_FOREACH (server_instance.client_callbacks, client_cb) {
-      if (client_cb->deleted) {
-        continue;
-      }
-      pollfds[num_pollfds].fd = client_cb->select_fd;
-      pollfds[num_pollfds].events = client_cb->events;
-      client_cb->pollfd = &pollfds[num_pollfds];
-      num_pollfds++;
-    }
-
     tasks = server_instance.system_tasks;
     server_instance.system_tasks = NULL;
     DL_FOREACH (tasks, system_task) {
@@ -663,38 +769,23 @@ int cras_server_run(unsigned int profile_disable_mask) {
      * for timeout, just do another loop to execute them.
      */
     if (server_instance.system_tasks) {
-      poll_timeout = NULL;
+      timeout_ms = 0;
     } else {
-      poll_timeout = timers_active ? &ts : NULL;
+      timeout_ms = arm_timer_fd(timers_active ? &ts : NULL);
     }
 
-    rc = ppoll(pollfds, num_pollfds, poll_timeout, NULL);
-    if (rc < 0) {
+    num_events = epoll_wait(server_instance.epoll_fd, events, MAX_EPOLL_EVENTS,
+                            timeout_ms);
+    if (num_events < 0) {
       continue;
     }
 
     cras_tm_call_callbacks(tm);
 
-    // Check for new connections.
-    for (int conn_type = 0; conn_type < CRAS_NUM_CONN_TYPE; conn_type++) {
-      if (pollfds[conn_type].revents & POLLIN) {
-        handle_new_connection(&server_instance.server_sockets[conn_type]);
-      }
-    }
-
-    // Check if there are messages pending for any clients.
-    DL_FOREACH (server_instance.clients_head, elm) {
-      if (elm->pollfd && elm->pollfd->revents & POLLIN) {
-        handle_message_from_client(elm);
-      }
-    }
-    // Check any client-registered fd/callback pairs.
-    DL_FOREACH (server_instance.client_callbacks, client_cb) {
-      if (!client_cb->deleted && client_cb->pollfd &&
-          (client_cb->pollfd->revents & client_cb->events)) {
-        client_cb->callback(client_cb->callback_data,
-                            client_cb->pollfd->revents);
-      }
+    // Only the fds which are ready are visited.
+    for (i = 0; i < num_events; i++) {
+      watch = (struct server_watch*)events[i].data.ptr;
+      watch->handler(watch->arg, events[i].events);
     }
 
     cleanup_select_fds(&server_instance);
@@ -708,7 +799,6 @@ int cras_server_run(unsigned int profile_disable_mask) {
 
 bail:
   cleanup_server_sockets();
-  free(pollfds);
   cras_observer_server_free();
   cras_features_deinit();
   return rc;
@@ -299,5 +299,5 @@ int cras_speak_on_mute_detector_add_voice_activity(bool detected) {
       .detected = detected,
       .when = now,
   };
-  return cras_main_message_send(&msg.base);
+  return cras_main_message_send_from_audio(&msg.base);
 }
@@ -5,14 +5,19 @@
 
 #include "cras/src/server/cras_sr.h"
 
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
 #include <speex/speex_resampler.h>
 #include <stdlib.h>
+#include <string.h>
 #include <syslog.h>
 
 #include "cras/common/check.h"
 #include "cras/src/common/sample_buffer.h"
 #include "cras/src/dsp/am.h"
 #include "cras/src/server/cras_fmt_conv_ops.h"
+#include "cras_config.h"
 #include "cras_util.h"
 
 /* The context for running the SR.
@@ -46,7 +51,41 @@
  *   (cras_sr_unprocessed_to_processed)
  *   |rw|       unprocessed         |
  *   |rw|        processed          |
+ *
+ *   With a worker thread, the full `internal` is instead moved to `lookahead`
+ *   and given to the worker, and the previous `lookahead` is replaced by its
+ *   output from the worker. If the worker is not done yet, the samples of
+ *   `lookahead` are used unprocessed.
+ *   (cras_sr_unprocessed_to_processed_async)
+ *   |rw|       unprocessed         | -> | lookahead | -> worker
+ *   |rw|   processed lookahead     | <- worker
  */
+
+enum SR_WORKER_STATE {
+  // Waiting for a run.
+  SR_WORKER_IDLE,
+  // Running the model on `input`.
+  SR_WORKER_BUSY,
+  // The result of the last run is in `output`.
+  SR_WORKER_DONE,
+};
+
+// A thread running the model one run at a time.
+struct cras_sr_worker {
+  pthread_t thread;
+  // Posted to start a run or to stop.
+  sem_t wake;
+  // enum SR_WORKER_STATE, written by both threads.
+  int state;
+  // Set to make the thread exit.
+  int stop;
+  // the return value of the last am_process.
+  int rc;
+  // the buffers of the run, owned by the worker while it is busy.
+  float* input;
+  float* output;
+};
+
 struct cras_sr {
   // the state of the speex resampler.
   SpeexResamplerState* speex_state;
@@ -60,8 +99,95 @@ struct cras_sr {
   double frames_ratio;
   // The number of frames needed to invoke the tflite model.
   size_t num_frames_per_run;
+  // The worker thread. NULL if the model runs in cras_sr_process.
+  struct cras_sr_worker* worker;
+  // The last full `internal`, whose output is due on the next run.
+  float* lookahead;
+  // A run sized buffer swapped with `lookahead`.
+  float* scratch;
+  // Whether `lookahead` was given to the worker.
+  bool lookahead_submitted;
+  // Statistics, accessed atomically.
+  struct cras_sr_stats stats;
 };
 
+static void* cras_sr_worker_thread(void* arg) {
+  struct cras_sr* sr = (struct cras_sr*)arg;
+  struct cras_sr_worker* worker = sr->worker;
+
+  /* The audio thread takes the output one run later, so the worker must
+   * not be starved by normal threads. Stay below the audio thread so it
+   * can always preempt the inference. */
+  if (cras_set_rt_scheduling(CRAS_SERVER_RT_THREAD_PRIORITY) == 0) {
+    cras_set_thread_priority(CRAS_SERVER_RT_THREAD_PRIORITY - 1);
+  }
+
+  while (true) {
+    if (sem_wait(&worker->wake)) {
+      continue;  // EINTR
+    }
+    if (__atomic_load_n(&worker->stop, __ATOMIC_ACQUIRE)) {
+      break;
+    }
+    worker->rc = am_process(sr->am, worker->input, sr->num_frames_per_run,
+                            worker->output, sr->num_frames_per_run);
+    __atomic_store_n(&worker->state, SR_WORKER_DONE, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&sr->stats.num_runs, 1, __ATOMIC_RELEASE);
+  }
+  return NULL;
+}
+
+static int cras_sr_worker_start(struct cras_sr* sr) {
+  struct cras_sr_worker* worker;
+  int rc;
+
+  sr->lookahead = calloc(sr->num_frames_per_run, sizeof(float));
+  sr->scratch = calloc(sr->num_frames_per_run, sizeof(float));
+  worker = calloc(1, sizeof(*worker));
+  if (!sr->lookahead || !sr->scratch || !worker) {
+    free(worker);
+    return -ENOMEM;
+  }
+  worker->input = calloc(sr->num_frames_per_run, sizeof(float));
+  worker->output = calloc(sr->num_frames_per_run, sizeof(float));
+  if (!worker->input || !worker->output) {
+    rc = -ENOMEM;
+    goto worker_start_fail;
+  }
+  if (sem_init(&worker->wake, 0, 0)) {
+    rc = -errno;
+    goto worker_start_fail;
+  }
+  sr->worker = worker;
+  rc = pthread_create(&worker->thread, NULL, cras_sr_worker_thread, sr);
+  if (rc) {
+    sr->worker = NULL;
+    sem_destroy(&worker->wake);
+    rc = -rc;
+    goto worker_start_fail;
+  }
+  return 0;
+
+worker_start_fail:
+  free(worker->input);
+  free(worker->output);
+  free(worker);
+  return rc;
+}
+
+static void cras_sr_worker_stop(struct cras_sr* sr) {
+  struct cras_sr_worker* worker = sr->worker;
+
+  __atomic_store_n(&worker->stop, 1, __ATOMIC_RELEASE);
+  sem_post(&worker->wake);
+  pthread_join(worker->thread, NULL);
+  sem_destroy(&worker->wake);
+  free(worker->input);
+  free(worker->output);
+  free(worker);
+  sr->worker = NULL;
+}
+
 struct cras_sr* cras_sr_create(const struct cras_sr_model_spec spec,
                                const size_t input_nbytes) {
   CRAS_CHECK(input_nbytes % sizeof(int16_t) == 0 &&
@@ -82,7 +208,8 @@ struct cras_sr* cras_sr_create(const struct cras_sr_model_spec spec,
     goto sr_create_fail;
   }
 
-  sr->am = am_new(spec.model_path);
+  sr->am = am_new_with_options(spec.model_path, spec.num_threads,
+                               spec.use_xnnpack);
   if (!sr->am) {
     syslog(LOG_ERR, "am_new failed.");
     goto sr_create_fail;
@@ -107,6 +234,14 @@ struct cras_sr* cras_sr_create(const struct cras_sr_model_spec spec,
   sr->frames_ratio = (double)spec.output_sample_rate / spec.input_sample_rate;
   sr->num_frames_per_run = spec.num_frames_per_run;
 
+  if (spec.use_worker_thread) {
+    rc = cras_sr_worker_start(sr);
+    if (rc) {
+      syslog(LOG_ERR, "cras_sr_worker_start failed: %d.", rc);
+      goto sr_create_fail;
+    }
+  }
+
   return sr;
 
 sr_create_fail:
@@ -119,6 +254,12 @@ void cras_sr_destroy(struct cras_sr* sr) {
     return;
   }
 
+  if (sr->worker) {
+    cras_sr_worker_stop(sr);
+  }
+  free(sr->lookahead);
+  free(sr->scratch);
+
   if (sr->speex_state) {
     speex_resampler_destroy(sr->speex_state);
   }
@@ -220,6 +361,48 @@ static void cras_sr_unprocessed_to_processed(struct cras_sr* sr) {
   if (am_process(sr->am, (const float*)buf, num_readable, buf, num_readable)) {
     syslog(LOG_WARNING, "am_process failed.");
   }
+  __atomic_fetch_add(&sr->stats.num_runs, 1, __ATOMIC_RELAXED);
+
+  sample_buf_increment_read(&sr->internal, num_readable);
+  sample_buf_increment_write(&sr->internal, num_readable);
+}
+
+static void cras_sr_unprocessed_to_processed_async(struct cras_sr* sr) {
+  struct cras_sr_worker* worker = sr->worker;
+  unsigned int num_readable = 0;
+  float* buf =
+      (float*)sample_buf_read_pointer_size(&sr->internal, &num_readable);
+  const size_t nbytes = num_readable * sizeof(float);
+  const float* processed = sr->lookahead;
+  float* tmp;
+
+  // Collects the output of the previous run, if it is done in time.
+  if (sr->lookahead_submitted) {
+    if (__atomic_load_n(&worker->state, __ATOMIC_ACQUIRE) == SR_WORKER_DONE &&
+        worker->rc == 0) {
+      processed = worker->output;
+    } else {
+      __atomic_fetch_add(&sr->stats.num_skipped_runs, 1, __ATOMIC_RELAXED);
+    }
+  }
+
+  // Moves this run to `lookahead` and outputs the previous one.
+  memcpy(sr->scratch, buf, nbytes);
+  memcpy(buf, processed, nbytes);
+  tmp = sr->lookahead;
+  sr->lookahead = sr->scratch;
+  sr->scratch = tmp;
+
+  // Gives this run to the worker, unless it is still busy with a late run.
+  sr->lookahead_submitted =
+      __atomic_load_n(&worker->state, __ATOMIC_ACQUIRE) != SR_WORKER_BUSY;
+  if (sr->lookahead_submitted) {
+    memcpy(worker->input, sr->lookahead, nbytes);
+    __atomic_store_n(&worker->state, SR_WORKER_BUSY, __ATOMIC_RELAXED);
+    sem_post(&worker->wake);
+  } else {
+    __atomic_fetch_add(&sr->stats.num_skipped_runs, 1, __ATOMIC_RELAXED);
+  }
 
   sample_buf_increment_read(&sr->internal, num_readable);
   sample_buf_increment_write(&sr->internal, num_readable);
@@ -241,7 +424,11 @@ static void cras_sr_propagate(struct cras_sr* sr,
     cras_sr_resampled_to_unprocessed(sr, num_propagated);
 
     if (sample_buf_full_with_zero_read_index(&sr->internal)) {
-      cras_sr_unprocessed_to_processed(sr);
+      if (sr->worker) {
+        cras_sr_unprocessed_to_processed_async(sr);
+      } else {
+        cras_sr_unprocessed_to_processed(sr);
+      }
     }
 
     num_need_propagated -= num_propagated;
@@ -275,3 +462,13 @@ double cras_sr_get_frames_ratio(struct cras_sr* sr) {
 size_t cras_sr_get_num_frames_per_run(struct cras_sr* sr) {
   return sr->num_frames_per_run;
 }
+
+size_t cras_sr_get_latency_frames(struct cras_sr* sr) {
+  return sr->worker ? sr->num_frames_per_run : 0;
+}
+
+void cras_sr_get_stats(struct cras_sr* sr, struct cras_sr_stats* stats) {
+  stats->num_runs = __atomic_load_n(&sr->stats.num_runs, __ATOMIC_ACQUIRE);
+  stats->num_skipped_runs =
+      __atomic_load_n(&sr->stats.num_skipped_runs, __ATOMIC_RELAXED);
+}
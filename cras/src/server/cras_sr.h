@@ -13,6 +13,7 @@
 #define CRAS_SRC_SERVER_CRAS_SR_H_
 #define CRAS_SR_MODEL_PATH_CAPACITY (256)
 
+#include <stdbool.h>
 #include <stddef.h>
 
 #include "cras/src/common/byte_buffer.h"
@@ -35,6 +36,22 @@ struct cras_sr_model_spec {
   size_t input_sample_rate;
   // the output sample rate of the audio data.
   size_t output_sample_rate;
+  /* Runs the model on a dedicated thread, one run ahead of the output. Runs
+   * not done in time are replaced by the resampled samples, adding
+   * num_frames_per_run of latency but never blocking the caller. */
+  bool use_worker_thread;
+  // number of threads used by the tflite interpreter, 0 for 1.
+  size_t num_threads;
+  // whether to run the model with the XNNPACK delegate.
+  bool use_xnnpack;
+};
+
+// Statistics of a sr component.
+struct cras_sr_stats {
+  // number of completed model runs.
+  unsigned int num_runs;
+  // number of runs replaced by the resampled samples.
+  unsigned int num_skipped_runs;
 };
 
 /* Creates a sr component.
@@ -80,6 +97,22 @@ double cras_sr_get_frames_ratio(struct cras_sr* sr);
  */
 size_t cras_sr_get_num_frames_per_run(struct cras_sr* sr);
 
+/* Gets the latency the model adds on top of the resampling.
+ * Args:
+ *    sr - The sr object.
+ * Returns:
+ *    num_frames_per_run output frames when the model runs on a worker thread,
+ *    0 otherwise.
+ */
+size_t cras_sr_get_latency_frames(struct cras_sr* sr);
+
+/* Gets the statistics of the model runs.
+ * Args:
+ *    sr - The sr object.
+ *    stats - Filled with the statistics.
+ */
+void cras_sr_get_stats(struct cras_sr* sr, struct cras_sr_stats* stats);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
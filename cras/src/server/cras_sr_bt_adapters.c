@@ -185,7 +185,8 @@ int cras_iodev_sr_bt_adapter_frames_queued(
 int cras_iodev_sr_bt_adapter_delay_frames(
     struct cras_iodev_sr_bt_adapter* adapter) {
   return adapter->iodev->delay_frames(adapter->iodev) *
-         cras_sr_get_frames_ratio(adapter->sr);
+             cras_sr_get_frames_ratio(adapter->sr) +
+         cras_sr_get_latency_frames(adapter->sr);
 }
 
 int cras_iodev_sr_bt_adapter_get_buffer(
@@ -7,10 +7,12 @@
 
 #include <stdbool.h>
 #include <stdio.h>
+#include <syslog.h>
 
 #include "cras/common/check.h"
 #include "cras/common/rust_common.h"
 #include "cras/server/platform/dlc/dlc.h"
+#include "cras/server/platform/features/features.h"
 #include "cras/src/server/cras_iodev.h"
 #include "cras/src/server/cras_server_metrics.h"
 #include "cras/src/server/cras_system_state.h"
@@ -36,6 +38,10 @@ struct cras_sr_model_spec cras_sr_bt_get_model_spec(
     enum cras_sr_bt_model model) {
   char* dlc_root = cras_dlc_get_sr_bt_root_path();
   struct cras_sr_model_spec spec = {};
+  // The worker thread adds num_frames_per_run of latency, see
+  // cras_sr_get_latency_frames.
+  bool use_worker_thread =
+      cras_feature_enabled(CrOSLateBootCrasSrBtWorkerThread);
   switch (model) {
     case SR_BT_NBS: {
       snprintf(spec.model_path, CRAS_SR_MODEL_PATH_CAPACITY, "%s/%s", dlc_root,
@@ -44,6 +50,8 @@ struct cras_sr_model_spec cras_sr_bt_get_model_spec(
       spec.num_channels = 1;
       spec.input_sample_rate = 8000;
       spec.output_sample_rate = 24000;
+      spec.use_worker_thread = use_worker_thread;
+      spec.num_threads = 1;
       break;
     };
     case SR_BT_WBS: {
@@ -53,6 +61,8 @@ struct cras_sr_model_spec cras_sr_bt_get_model_spec(
       spec.num_channels = 1;
       spec.input_sample_rate = 16000;
       spec.output_sample_rate = 24000;
+      spec.use_worker_thread = use_worker_thread;
+      spec.num_threads = 1;
       break;
     }
     default:
@@ -62,6 +72,17 @@ struct cras_sr_model_spec cras_sr_bt_get_model_spec(
   return spec;
 }
 
+void cras_sr_bt_log_stats(struct cras_sr* sr) {
+  struct cras_sr_stats stats;
+
+  if (!sr) {
+    return;
+  }
+  cras_sr_get_stats(sr, &stats);
+  syslog(LOG_INFO, "SR BT completed %u runs, skipped %u runs.", stats.num_runs,
+         stats.num_skipped_runs);
+}
+
 void cras_sr_bt_send_uma_log(struct cras_iodev* iodev,
                              const enum CRAS_SR_BT_CAN_BE_ENABLED_STATUS status,
                              bool is_enabled) {
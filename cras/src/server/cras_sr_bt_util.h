@@ -42,6 +42,13 @@ enum cras_sr_bt_model { SR_BT_NBS, SR_BT_WBS };
  */
 struct cras_sr_model_spec cras_sr_bt_get_model_spec(enum cras_sr_bt_model);
 
+/* Logs the statistics of the model runs of |sr|. Call before destroying it.
+ *
+ * Args:
+ *    sr - The sr instance, may be NULL.
+ */
+void cras_sr_bt_log_stats(struct cras_sr* sr);
+
 /* Sends UMA logs.
  *
  * Args:
@@ -28,3 +28,11 @@ double cras_sr_get_frames_ratio(struct cras_sr* sr) {
 size_t cras_sr_get_num_frames_per_run(struct cras_sr* sr) {
   return 0;
 }
+
+size_t cras_sr_get_latency_frames(struct cras_sr* sr) {
+  return 0;
+}
+
+void cras_sr_get_stats(struct cras_sr* sr, struct cras_sr_stats* stats) {
+  *stats = (struct cras_sr_stats){};
+}
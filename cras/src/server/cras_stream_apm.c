@@ -50,7 +50,9 @@ struct cras_apm_state {
 
 /*
  * Structure holding a WebRTC audio processing module and necessary
- * info to process and transfer input buffer from device to stream.
+ * info to process input buffer from device. Streams on the same input
+ * device asking for the same effects and format share one instance, each
+ * through its own cras_apm.
  *
  * Below chart describes the buffer structure inside APM and how an input buffer
  * flows from a device through the APM to stream. APM processes audio buffers in
@@ -58,27 +60,28 @@ struct cras_apm_state {
  * buffer:
  * (1) to cache input buffer from device until 10ms size is filled.
  * (2) to store the interleaved buffer, of 10ms size also, after APM processing.
+ *     Each stream sharing the APM has its own copy.
  *
  *  ________   _______     _______________________________
  *  |      |   |     |     |_____________APM ____________|
  *  |input |-> | DSP |---> ||           |    |          || -> stream 1
  *  |device|   |     | |   || float buf | -> | byte buf ||
  *  |______|   |_____| |   ||___________|    |__________||
+ *                     |   |                 | byte buf || -> stream 2
+ *                     |   |                 |__________||
  *                     |   |_____________________________|
  *                     |   _______________________________
- *                     |-> |             APM 2           | -> stream 2
+ *                     |-> |             APM 2           | -> stream 3
  *                     |   |_____________________________|
  *                     |                                       ...
  *                     |
  *                     |------------------------------------> stream N
  */
-struct cras_apm {
+struct apm_instance {
   // An APM instance from libwebrtc_audio_processing.
   webrtc_apm apm_ptr;
   // Pointer to the input device this APM is associated with.
   struct cras_iodev* idev;
-  // Stores the processed/interleaved data ready for stream to read.
-  struct byte_buffer* buffer;
   // Stores the floating pointer buffer from input device waiting
   // for APM to process.
   struct float_buffer* fbuffer;
@@ -86,9 +89,17 @@ struct cras_apm {
   struct cras_audio_format dev_fmt;
   // The audio data format configured for this APM.
   struct cras_audio_format fmt;
-  // The cras_audio_area used for copying processed data to client
-  // stream.
-  struct cras_audio_area* area;
+  // The device channel copied to each APM channel, or -1 if the APM channel
+  // is not filled. Resolved from |fmt| and |dev_fmt| when created.
+  int8_t dev_channels[CRAS_CH_MAX];
+  // The effects bit map of the streams sharing this APM.
+  uint64_t effects;
+  // The echo ref of the streams sharing this APM when it was created.
+  struct cras_iodev* echo_ref;
+  // Whether the APM was created with the tuned AEC settings.
+  bool is_aec_use_case;
+  // The enforced effects the APM was created with.
+  struct WebRtcApmConfig webrtc_apm_config;
   // Flag to indicate whether content has
   // beenobserved in the left or right channel which is not identical.
   bool only_symmetric_content_in_render;
@@ -105,14 +116,41 @@ struct cras_apm {
   struct plugin_processor* cras_processor;
   // The active effect of plugin_processor cras_processor.
   enum CrasProcessorEffect cras_processor_effect;
+  // Whether cras_processor runs on its own thread, so its run only hands
+  // the block over.
+  bool cras_processor_threaded;
   // Processor that wraps webrtc_apm.
   struct plugin_processor webrtc_apm_wrapper_processor;
-  // The time when the apm started.
-  struct timespec start_ts;
-  struct cras_apm *prev, *next;
   // Indicate if AEC dump is active on this APM. If this APM is
   // stopped while AEC dump is active, the dump will be stopped.
   bool aec_dump_active;
+  // Capture position of the input device, in frames, up to which this APM
+  // has been fed. Accessed in audio thread.
+  uint64_t input_frames;
+  // The last process_reverse pass which fed this APM.
+  unsigned int reverse_pass;
+  // Number of cras_apm sharing this instance, accessed in main thread.
+  unsigned int refcount;
+  struct apm_instance *prev, *next;
+};
+
+/*
+ * A stream's handle to an apm_instance on an input device.
+ */
+struct cras_apm {
+  // The shared APM.
+  struct apm_instance* inst;
+  // Pointer to the input device, same as inst->idev.
+  struct cras_iodev* idev;
+  // Queue of processed/interleaved data ready for stream to read. Holds
+  // whole blocks, enough to cover the input device buffer.
+  struct byte_buffer* buffer;
+  // The cras_audio_area used for copying processed data to client
+  // stream.
+  struct cras_audio_area* area;
+  // The time when the apm started.
+  struct timespec start_ts;
+  struct cras_apm *prev, *next;
 };
 
 /*
@@ -203,9 +241,15 @@ static dictionary* apm_ini = NULL;
  */
 static struct cras_stream_apm* cached_vad_target = NULL;
 
-static struct cras_apm* get_apm_wrapper_processor(struct plugin_processor* p) {
-  return (struct cras_apm*)((char*)p - offsetof(struct cras_apm,
-                                                webrtc_apm_wrapper_processor));
+/* APM instances shared by streams, owned by main thread. The instances are
+ * only freed after all the streams using them have been stopped. */
+static struct apm_instance* apm_instances = NULL;
+
+static struct apm_instance* get_apm_wrapper_processor(
+    struct plugin_processor* p) {
+  return (struct apm_instance*)((char*)p -
+                                offsetof(struct apm_instance,
+                                         webrtc_apm_wrapper_processor));
 }
 
 static enum status apm_wrapper_processor_run(struct plugin_processor* p,
@@ -213,24 +257,24 @@ static enum status apm_wrapper_processor_run(struct plugin_processor* p,
                                              struct multi_slice* output) {
   TRACE_EVENT(audio, __func__);
 
-  struct cras_apm* apm = get_apm_wrapper_processor(p);
-  webrtc_apm_process_stream_f(apm->apm_ptr, input->channels,
-                              apm->fmt.frame_rate, input->data);
+  struct apm_instance* inst = get_apm_wrapper_processor(p);
+  webrtc_apm_process_stream_f(inst->apm_ptr, input->channels,
+                              inst->fmt.frame_rate, input->data);
   *output = *input;
   return StatusOk;
 }
 
 static enum status apm_wrapper_processor_destroy(struct plugin_processor* p) {
   // Do nothing.
-  // Destruction handled by cras_apm, not plugin_processor.
+  // Destruction handled by apm_instance, not plugin_processor.
   return StatusOk;
 }
 
 static enum status apm_wrapper_processor_get_output_frame_rate(
     struct plugin_processor* p,
     size_t* output_frame_rate) {
-  struct cras_apm* apm = get_apm_wrapper_processor(p);
-  *output_frame_rate = apm->fmt.frame_rate;
+  struct apm_instance* inst = get_apm_wrapper_processor(p);
+  *output_frame_rate = inst->fmt.frame_rate;
   return StatusOk;
 }
 
@@ -280,10 +324,9 @@ static bool effect_needed_for_dev(struct cras_audio_ctx* actx,
                                   const struct cras_iodev* const idev,
                                   uint64_t effect) {
   struct active_apm* active;
-  struct cras_apm* apm;
   DL_FOREACH (actx->apm->active_apms, active) {
-    apm = active->apm;
-    if (apm->idev == idev && ((bool)(active->stream->effects & effect))) {
+    if (active->apm->idev == idev &&
+        ((bool)(active->stream->effects & effect))) {
       return true;
     }
   }
@@ -342,10 +385,8 @@ static void update_supported_dsp_effects_activation(
 
   // Toggle between having effects applied on DSP and in CRAS for each APM
   struct active_apm* active;
-  struct cras_apm* apm;
   LL_FOREACH (actx->apm->active_apms, active) {
-    apm = active->apm;
-    struct cras_iodev* const idev = apm->idev;
+    struct cras_iodev* const idev = active->apm->idev;
 
     // Try to activate effects on DSP.
     bool aec_on_dsp = false;
@@ -380,7 +421,7 @@ static void update_supported_dsp_effects_activation(
      * effect activation is on DSP.
      */
     webrtc_apm_enable_effects(
-        active->apm->apm_ptr,
+        active->apm->inst->apm_ptr,
         (active->stream->effects & APM_ECHO_CANCELLATION) && !aec_on_dsp,
         (active->stream->effects & APM_NOISE_SUPRESSION) && !ns_on_dsp,
         (active->stream->effects & APM_GAIN_CONTROL) && !agc_on_dsp);
@@ -393,10 +434,16 @@ static void update_supported_dsp_effects_activation(
 
 // Reconfigure APMs to update their VAD enabled status.
 static void reconfigure_apm_vad(struct cras_audio_ctx* actx) {
-  struct active_apm* active;
+  struct active_apm *active, *other;
   LL_FOREACH (actx->apm->active_apms, active) {
-    webrtc_apm_enable_vad(active->apm->apm_ptr,
-                          stream_apm_should_enable_vad(active->stream));
+    // A shared APM detects voice activity for any of its streams.
+    bool enable = false;
+    LL_FOREACH (actx->apm->active_apms, other) {
+      if (other->apm->inst == active->apm->inst) {
+        enable = enable || stream_apm_should_enable_vad(other->stream);
+      }
+    }
+    webrtc_apm_enable_vad(active->apm->inst->apm_ptr, enable);
   }
 }
 
@@ -407,21 +454,39 @@ static void update_vad_target(struct cras_audio_ctx* actx,
   reconfigure_apm_vad(actx);
 }
 
-static void apm_destroy(struct cras_apm** apm) {
-  if (*apm == NULL) {
+static void apm_instance_destroy(struct apm_instance** inst) {
+  if (*inst == NULL) {
     return;
   }
 
-  if ((*apm)->cras_processor) {
-    (*apm)->cras_processor->ops->destroy((*apm)->cras_processor);
+  if ((*inst)->cras_processor) {
+    (*inst)->cras_processor->ops->destroy((*inst)->cras_processor);
   }
 
-  byte_buffer_destroy(&(*apm)->buffer);
-  float_buffer_destroy(&(*apm)->fbuffer);
-  cras_audio_area_destroy((*apm)->area);
+  float_buffer_destroy(&(*inst)->fbuffer);
 
   // Any unfinished AEC dump handle will be closed.
-  webrtc_apm_destroy((*apm)->apm_ptr);
+  webrtc_apm_destroy((*inst)->apm_ptr);
+  free(*inst);
+  *inst = NULL;
+}
+
+static void apm_instance_unref(struct apm_instance* inst) {
+  if (--inst->refcount) {
+    return;
+  }
+  DL_DELETE(apm_instances, inst);
+  apm_instance_destroy(&inst);
+}
+
+static void apm_destroy(struct cras_apm** apm) {
+  if (*apm == NULL) {
+    return;
+  }
+
+  byte_buffer_destroy(&(*apm)->buffer);
+  cras_audio_area_destroy((*apm)->area);
+  apm_instance_unref((*apm)->inst);
   free(*apm);
   *apm = NULL;
 }
@@ -452,6 +517,10 @@ void possibly_start_apm_aec_dump(struct cras_stream_apm* stream,
   if (stream->aec_dump_active_apm) {
     return;
   }
+  // Another stream sharing the APM is dumping it.
+  if (apm->inst->aec_dump_active) {
+    return;
+  }
 
   // Create or append to the dump file fd.
   //
@@ -474,12 +543,12 @@ void possibly_start_apm_aec_dump(struct cras_stream_apm* stream,
   }
 
   // webrtc apm will own the FILE handle and close it.
-  int rc = webrtc_apm_aec_dump(apm->apm_ptr, 1, handle);
+  int rc = webrtc_apm_aec_dump(apm->inst->apm_ptr, 1, handle);
   if (rc) {
     syslog(LOG_WARNING, "Start apm aec dump failed, rc %d", rc);
   }
 
-  apm->aec_dump_active = true;
+  apm->inst->aec_dump_active = true;
   stream->aec_dump_active_apm = apm;
 }
 
@@ -487,16 +556,16 @@ void possibly_start_apm_aec_dump(struct cras_stream_apm* stream,
 // APM.
 void possibly_stop_apm_aec_dump(struct cras_stream_apm* stream,
                                 struct cras_apm* apm) {
-  if (!apm->aec_dump_active) {
+  if (stream->aec_dump_active_apm != apm || !apm->inst->aec_dump_active) {
     return;
   }
 
-  int rc = webrtc_apm_aec_dump(apm->apm_ptr, 0, NULL);
+  int rc = webrtc_apm_aec_dump(apm->inst->apm_ptr, 0, NULL);
   if (rc) {
     syslog(LOG_WARNING, "Stop apm aec dump failed, rc %d", rc);
   }
 
-  apm->aec_dump_active = false;
+  apm->inst->aec_dump_active = false;
   stream->aec_dump_active_apm = NULL;
 }
 
@@ -576,12 +645,12 @@ uint64_t cras_stream_apm_get_effects(struct cras_stream_apm* stream) {
 }
 
 static CRAS_STREAM_ACTIVE_AP_EFFECT get_active_ap_effects(
-    struct cras_apm* apm) {
+    struct apm_instance* inst) {
   CRAS_STREAM_ACTIVE_AP_EFFECT effects = 0;
 
-  if (apm->apm_ptr) {
+  if (inst->apm_ptr) {
     struct WebRtcApmActiveEffects webrtc_effects =
-        webrtc_apm_get_active_effects(apm->apm_ptr);
+        webrtc_apm_get_active_effects(inst->apm_ptr);
     if (webrtc_effects.echo_cancellation) {
       effects |= CRAS_STREAM_ACTIVE_AP_EFFECT_ECHO_CANCELLATION;
     }
@@ -594,7 +663,7 @@ static CRAS_STREAM_ACTIVE_AP_EFFECT get_active_ap_effects(
   }
 
   effects |=
-      cras_processor_effect_to_active_ap_effects(apm->cras_processor_effect);
+      cras_processor_effect_to_active_ap_effects(inst->cras_processor_effect);
 
   return effects;
 }
@@ -669,12 +738,143 @@ static size_t get_aec3_fixed_capture_delay_samples() {
   return 0;
 }
 
+static bool audio_formats_equal(const struct cras_audio_format* a,
+                                const struct cras_audio_format* b) {
+  return a->format == b->format && a->frame_rate == b->frame_rate &&
+         a->num_channels == b->num_channels &&
+         !memcmp(a->channel_layout, b->channel_layout,
+                 sizeof(a->channel_layout));
+}
+
+/*
+ * Returns true if the APM should run on its own thread instead of the audio
+ * thread. The thread adds one block of latency and passes the input through
+ * whenever it misses a deadline.
+ */
+static bool apm_dedicated_thread_enabled(enum CrasProcessorEffect cp_effect) {
+  if (cras_feature_enabled(CrOSLateBootCrasApmDedicatedThread)) {
+    return true;
+  }
+  return cp_effect != NoEffects &&
+         cras_feature_enabled(CrOSLateBootCrasProcessorDedicatedThread);
+}
+
+/*
+ * Looks up the device channel feeding each APM channel, so it isn't done for
+ * every block.
+ */
+static void resolve_dev_channels(struct apm_instance* inst) {
+  int ch, i;
+
+  for (i = 0; i < CRAS_CH_MAX; i++) {
+    inst->dev_channels[i] = -1;
+  }
+  for (ch = 0; ch < CRAS_CH_MAX; ch++) {
+    i = inst->fmt.channel_layout[ch];
+    if (i < 0 || i >= inst->fmt.num_channels) {
+      continue;
+    }
+    // Keep the first channel position mapped to |i|.
+    if (inst->dev_channels[i] == -1) {
+      inst->dev_channels[i] = inst->dev_fmt.channel_layout[ch];
+    }
+  }
+}
+
+static struct apm_instance* apm_instance_create(
+    struct cras_iodev* idev,
+    const struct cras_stream_apm* stream,
+    const struct cras_audio_format* dev_fmt,
+    const struct cras_audio_format* apm_fmt,
+    enum CrasProcessorEffect cp_effect,
+    bool is_aec_use_case,
+    const struct WebRtcApmConfig* webrtc_apm_config) {
+  struct apm_instance* inst = (struct apm_instance*)calloc(1, sizeof(*inst));
+  if (inst == NULL) {
+    syslog(LOG_ERR, "No memory in creating apm instance");
+    return NULL;
+  }
+
+  // Reset detection of proper stereo
+  inst->only_symmetric_content_in_render = true;
+  inst->blocks_with_nonsymmetric_content_in_render = 0;
+  inst->blocks_with_symmetric_content_in_render = 0;
+
+  inst->dev_fmt = *dev_fmt;
+  inst->fmt = *apm_fmt;
+  resolve_dev_channels(inst);
+  inst->effects = stream->effects;
+  inst->echo_ref = stream->echo_ref;
+  inst->is_aec_use_case = is_aec_use_case;
+  inst->webrtc_apm_config = *webrtc_apm_config;
+
+  dictionary* aec_ini_use = is_aec_use_case ? aec_ini : NULL;
+  dictionary* apm_ini_use = is_aec_use_case ? apm_ini : NULL;
+
+  inst->apm_ptr = webrtc_apm_create_with_enforced_effects(
+      inst->fmt.num_channels, inst->fmt.frame_rate, aec_ini_use, apm_ini_use,
+      webrtc_apm_config);
+  if (inst->apm_ptr == NULL) {
+    syslog(LOG_ERR,
+           "Fail to create webrtc apm for ch %zu"
+           " rate %zu effect %" PRIu64,
+           dev_fmt->num_channels, dev_fmt->frame_rate, stream->effects);
+    free(inst);
+    return NULL;
+  }
+
+  inst->idev = idev;
+
+  const int frame_length = inst->fmt.frame_rate / APM_NUM_BLOCKS_PER_SECOND;
+  inst->fbuffer = float_buffer_create(frame_length, inst->fmt.num_channels);
+
+  inst->webrtc_apm_wrapper_processor.ops = &apm_wrapper_processor_ops;
+  inst->cras_processor_threaded = apm_dedicated_thread_enabled(cp_effect);
+  struct CrasProcessorConfig cfg = {
+      .channels = inst->fmt.num_channels,
+      .block_size = frame_length,
+      .frame_rate = inst->fmt.frame_rate,
+      .effect = cp_effect,
+      .wrap_mode = inst->cras_processor_threaded ? WrapModeDedicatedThread
+                                                 : WrapModeNone,
+      .wav_dump = cras_feature_enabled(CrOSLateBootCrasProcessorWavDump),
+  };
+  struct CrasProcessorCreateResult cras_processor_create_result =
+      cras_processor_create(&cfg, &inst->webrtc_apm_wrapper_processor);
+  if (cras_processor_create_result.plugin_processor == NULL) {
+    // cras_processor_create should never fail.
+    // If it ever fails, give up using the APM.
+    // TODO: Add UMA about this failure.
+    syslog(LOG_ERR, "cras_processor_create returned NULL");
+    apm_instance_destroy(&inst);
+    return NULL;
+  }
+  if (cp_effect != NoEffects) {
+    const bool success = cras_processor_create_result.effect == cp_effect;
+    switch (cp_effect) {
+      case NoiseCancellation:
+        cras_server_metrics_ap_nc_start_status(success);
+        break;
+      case StyleTransfer:
+        cras_server_metrics_ast_start_status(success);
+        break;
+      default:
+        break;
+    }
+  }
+  inst->cras_processor = cras_processor_create_result.plugin_processor;
+  inst->cras_processor_effect = cras_processor_create_result.effect;
+
+  return inst;
+}
+
 struct cras_apm* cras_stream_apm_add(
     struct cras_stream_apm* stream,
     struct cras_iodev* idev,
     const struct cras_audio_format* dev_fmt,
     const struct cras_audio_format* stream_fmt) {
   struct cras_apm* apm;
+  struct apm_instance* inst;
   bool aec_applied_on_dsp = false;
   bool ns_applied_on_dsp = false;
   bool agc_applied_on_dsp = false;
@@ -707,13 +907,6 @@ struct cras_apm* cras_stream_apm_add(
     return NULL;
   }
 
-  apm = (struct cras_apm*)calloc(1, sizeof(*apm));
-
-  // Reset detection of proper stereo
-  apm->only_symmetric_content_in_render = true;
-  apm->blocks_with_nonsymmetric_content_in_render = 0;
-  apm->blocks_with_symmetric_content_in_render = 0;
-
   aec_applied_on_dsp = cras_iodev_get_rtc_proc_enabled(idev, RTC_PROC_AEC);
   ns_applied_on_dsp = cras_iodev_get_rtc_proc_enabled(idev, RTC_PROC_NS);
   agc_applied_on_dsp = cras_iodev_get_rtc_proc_enabled(idev, RTC_PROC_AGC);
@@ -736,12 +929,12 @@ struct cras_apm* cras_stream_apm_add(
   // Configure APM to the format used by input device.
   // If beamforming is not in use, limit the channel count to the stream
   // channel count to reduce AEC complexity.
-  apm->dev_fmt = *dev_fmt;
   int channel_limit = INT_MAX;
   if (enforce_aec_on && cp_effect != Beamforming) {
     channel_limit = stream_fmt->num_channels;
   }
-  apm->fmt = get_best_channels(dev_fmt, channel_limit);
+  const struct cras_audio_format apm_fmt =
+      get_best_channels(dev_fmt, channel_limit);
 
   /*
    * |aec_ini| and |apm_ini| are tuned specifically for the typical aec
@@ -753,9 +946,6 @@ struct cras_apm* cras_stream_apm_add(
       cras_iodev_is_tuned_aec_use_case(idev->active_node) &&
       cras_apm_reverse_is_aec_use_case(stream->echo_ref);
 
-  dictionary* aec_ini_use = is_aec_use_case ? aec_ini : NULL;
-  dictionary* apm_ini_use = is_aec_use_case ? apm_ini : NULL;
-
   const struct WebRtcApmConfig webrtc_apm_config = {
       .enforce_aec_on = enforce_aec_on,
       .enforce_ns_on = enforce_ns_on,
@@ -763,69 +953,58 @@ struct cras_apm* cras_stream_apm_add(
       .aec3_fixed_capture_delay_samples =
           get_aec3_fixed_capture_delay_samples(),
   };
-  apm->apm_ptr = webrtc_apm_create_with_enforced_effects(
-      apm->fmt.num_channels, apm->fmt.frame_rate, aec_ini_use, apm_ini_use,
-      &webrtc_apm_config);
-  if (apm->apm_ptr == NULL) {
-    syslog(LOG_ERR,
-           "Fail to create webrtc apm for ch %zu"
-           " rate %zu effect %" PRIu64,
-           dev_fmt->num_channels, dev_fmt->frame_rate, stream->effects);
-    free(apm);
-    return NULL;
+
+  // Share the APM of another stream processing the same input the same way.
+  DL_FOREACH (apm_instances, inst) {
+    if (inst->idev == idev && inst->effects == stream->effects &&
+        inst->echo_ref == stream->echo_ref &&
+        inst->is_aec_use_case == is_aec_use_case &&
+        inst->cras_processor_effect == cp_effect &&
+        audio_formats_equal(&inst->dev_fmt, dev_fmt) &&
+        audio_formats_equal(&inst->fmt, &apm_fmt) &&
+        !memcmp(&inst->webrtc_apm_config, &webrtc_apm_config,
+                sizeof(webrtc_apm_config))) {
+      break;
+    }
+  }
+  if (inst == NULL) {
+    inst = apm_instance_create(idev, stream, dev_fmt, &apm_fmt, cp_effect,
+                               is_aec_use_case, &webrtc_apm_config);
+    if (inst == NULL) {
+      return NULL;
+    }
+    DL_APPEND(apm_instances, inst);
   }
 
+  apm = (struct cras_apm*)calloc(1, sizeof(*apm));
+  if (apm == NULL) {
+    syslog(LOG_ERR, "No memory in creating apm");
+    if (!inst->refcount) {
+      DL_DELETE(apm_instances, inst);
+      apm_instance_destroy(&inst);
+    }
+    return NULL;
+  }
+  apm->inst = inst;
+  inst->refcount++;
   apm->idev = idev;
 
   /* WebRTC APM wants 1/100 second equivalence of data(a block) to
-   * process. Allocate buffer based on how many frames are in this block.
+   * process. Another stream sharing the APM may process up to the whole
+   * input device buffer before this one reads, so queue that many blocks.
    */
-  const int frame_length = apm->fmt.frame_rate / APM_NUM_BLOCKS_PER_SECOND;
-  apm->buffer =
-      byte_buffer_create(frame_length * cras_get_format_bytes(&apm->fmt));
-  apm->fbuffer = float_buffer_create(frame_length, apm->fmt.num_channels);
-  apm->area = cras_audio_area_create(apm->fmt.num_channels);
-  cras_audio_area_config_channels(apm->area, &apm->fmt);
-
-  apm->webrtc_apm_wrapper_processor.ops = &apm_wrapper_processor_ops;
-  struct CrasProcessorConfig cfg = {
-      .channels = apm->fmt.num_channels,
-      .block_size = frame_length,
-      .frame_rate = apm->fmt.frame_rate,
-      .effect = cp_effect,
-      .wrap_mode =
-          cp_effect != NoEffects &&
-                  cras_feature_enabled(CrOSLateBootCrasProcessorDedicatedThread)
-              ? WrapModeDedicatedThread
-              : WrapModeNone,
-      .wav_dump = cras_feature_enabled(CrOSLateBootCrasProcessorWavDump),
-  };
-  struct CrasProcessorCreateResult cras_processor_create_result =
-      cras_processor_create(&cfg, &apm->webrtc_apm_wrapper_processor);
-  if (cras_processor_create_result.plugin_processor == NULL) {
-    // cras_processor_create should never fail.
-    // If it ever fails, give up using the APM.
-    // TODO: Add UMA about this failure.
-    syslog(LOG_ERR, "cras_processor_create returned NULL");
-    apm_destroy(&apm);
-    return NULL;
-  }
+  const unsigned int frame_length =
+      inst->fmt.frame_rate / APM_NUM_BLOCKS_PER_SECOND;
+  const unsigned int num_blocks =
+      MAX(1, (idev->buffer_size + frame_length - 1) / frame_length);
+  apm->buffer = byte_buffer_create(num_blocks * frame_length *
+                                   cras_get_format_bytes(&inst->fmt));
+  apm->area = cras_audio_area_create(inst->fmt.num_channels);
+  cras_audio_area_config_channels(apm->area, &inst->fmt);
+
   if (cp_effect != NoEffects) {
-    const bool success = cras_processor_create_result.effect == cp_effect;
-    switch (cp_effect) {
-      case NoiseCancellation:
-        cras_server_metrics_ap_nc_start_status(success);
-        break;
-      case StyleTransfer:
-        cras_server_metrics_ast_start_status(success);
-        break;
-      default:
-        break;
-    }
     apm_state.num_nc++;
   }
-  apm->cras_processor = cras_processor_create_result.plugin_processor;
-  apm->cras_processor_effect = cras_processor_create_result.effect;
 
   DL_APPEND(stream->apms, apm);
 
@@ -863,6 +1042,9 @@ void cras_stream_apm_start(struct cras_stream_apm* stream,
   active->stream = stream;
   DL_APPEND(actx->apm->active_apms, active);
 
+  // Any block left from before the stream stopped is stale.
+  buf_reset(apm->buffer);
+
   clock_gettime(CLOCK_MONOTONIC_RAW, &apm->start_ts);
 
   cras_apm_reverse_state_update();
@@ -887,11 +1069,11 @@ void cras_stream_apm_stop(struct cras_stream_apm* stream,
 
   active = get_active_apm(actx, stream, idev);
   if (active) {
-    if (active->apm && active->apm->cras_processor_effect != NoEffects) {
+    if (active->apm && active->apm->inst->cras_processor_effect != NoEffects) {
       struct timespec now, runtime;
       clock_gettime(CLOCK_MONOTONIC_RAW, &now);
       subtract_timespecs(&now, &active->apm->start_ts, &runtime);
-      switch (active->apm->cras_processor_effect) {
+      switch (active->apm->inst->cras_processor_effect) {
         case NoiseCancellation:
           cras_server_metrics_ap_nc_runtime(runtime.tv_sec);
           break;
@@ -906,7 +1088,7 @@ void cras_stream_apm_stop(struct cras_stream_apm* stream,
     }
 
     // If AEC dump is active on this APM, stop it.
-    if (active->apm->aec_dump_active) {
+    if (stream->aec_dump_active_apm == active->apm) {
       possibly_stop_apm_aec_dump(stream, active->apm);
     }
 
@@ -959,7 +1141,9 @@ static int process_reverse(struct float_buffer* fbuf,
                            const struct cras_iodev* echo_ref) {
   struct cras_audio_ctx* actx = checked_audio_ctx();
 
+  static unsigned int pass;
   struct active_apm* active;
+  struct apm_instance* inst;
   int ret;
   float* const* rp;
   unsigned int unused;
@@ -967,6 +1151,9 @@ static int process_reverse(struct float_buffer* fbuf,
   // Caller side ensures fbuf is full and hasn't been read at all.
   rp = float_buffer_read_pointer(fbuf, 0, &unused);
 
+  // Feed each shared APM once, however many streams use it.
+  pass++;
+
   DL_FOREACH (actx->apm->active_apms, active) {
     if (!(active->stream->effects & APM_ECHO_CANCELLATION)) {
       continue;
@@ -978,13 +1165,18 @@ static int process_reverse(struct float_buffer* fbuf,
       continue;
     }
 
-    if (active->apm->only_symmetric_content_in_render) {
+    inst = active->apm->inst;
+    if (inst->reverse_pass == pass) {
+      continue;
+    }
+    inst->reverse_pass = pass;
+
+    if (inst->only_symmetric_content_in_render) {
       bool symmetric_content = left_and_right_channels_are_symmetric(
           fbuf->num_channels, frame_rate, rp);
 
-      int non_sym_frames =
-          active->apm->blocks_with_nonsymmetric_content_in_render;
-      int sym_frames = active->apm->blocks_with_symmetric_content_in_render;
+      int non_sym_frames = inst->blocks_with_nonsymmetric_content_in_render;
+      int sym_frames = inst->blocks_with_symmetric_content_in_render;
 
       /* Count number of consecutive frames with symmetric
          and non-symmetric content. */
@@ -995,21 +1187,21 @@ static int process_reverse(struct float_buffer* fbuf,
         /* Only flag render content to be non-symmetric if it has
    been non-symmetric for at least 2 seconds. */
 
-        active->apm->only_symmetric_content_in_render = false;
+        inst->only_symmetric_content_in_render = false;
       } else if (sym_frames > 5 * 60 * APM_NUM_BLOCKS_PER_SECOND) {
         /* Fall-back to consider render content as symmetric if it has
      been symmetric for 5 minutes. */
-        active->apm->only_symmetric_content_in_render = false;
+        inst->only_symmetric_content_in_render = false;
       }
 
-      active->apm->blocks_with_nonsymmetric_content_in_render = non_sym_frames;
-      active->apm->blocks_with_symmetric_content_in_render = sym_frames;
+      inst->blocks_with_nonsymmetric_content_in_render = non_sym_frames;
+      inst->blocks_with_symmetric_content_in_render = sym_frames;
     }
     int num_unique_channels =
-        active->apm->only_symmetric_content_in_render ? 1 : fbuf->num_channels;
+        inst->only_symmetric_content_in_render ? 1 : fbuf->num_channels;
 
     ret = webrtc_apm_process_reverse_stream_f(
-        active->apm->apm_ptr, num_unique_channels, frame_rate, rp);
+        inst->apm_ptr, num_unique_channels, frame_rate, rp);
     if (ret) {
       syslog(LOG_ERR, "APM process reverse err");
       return ret;
@@ -1166,7 +1358,7 @@ read_write_err:
 }
 
 static void possibly_track_voice_activity(struct cras_audio_ctx* actx,
-                                          struct cras_apm* apm) {
+                                          struct apm_instance* inst) {
   if (!cached_vad_target) {
     return;
   }
@@ -1174,7 +1366,7 @@ static void possibly_track_voice_activity(struct cras_audio_ctx* actx,
   struct active_apm* active;
   DL_FOREACH (actx->apm->active_apms, active) {
     // Match only the first apm. We don't care multiple inputs.
-    if (active->stream->apms != apm) {
+    if (!active->stream->apms || active->stream->apms->inst != inst) {
       continue;
     }
 
@@ -1183,7 +1375,7 @@ static void possibly_track_voice_activity(struct cras_audio_ctx* actx,
     }
 
     int rc = cras_speak_on_mute_detector_add_voice_activity(
-        webrtc_apm_get_voice_detected(apm->apm_ptr));
+        webrtc_apm_get_voice_detected(inst->apm_ptr));
     if (rc < 0) {
       syslog(LOG_ERR, "failed to send speak on mute message: %s",
              cras_strerror(-rc));
@@ -1239,19 +1431,32 @@ int cras_stream_apm_deinit() {
   return 0;
 }
 
-// Clamp the value between -1 and +1.
-static inline float clamp1(float value) {
-  return value < -1 ? -1 : (value > 1 ? 1 : value);
+/*
+ * Makes room for a processed block of |bytes| in the output queue of |apm|
+ * and returns where to write it. A stream sharing the APM that has not read
+ * its queue loses its oldest frames, so it cannot hold back the others.
+ */
+static uint8_t* apm_queue_block(struct cras_apm* apm, unsigned int bytes) {
+  unsigned int avail = buf_available(apm->buffer);
+
+  if (avail < bytes) {
+    buf_increment_read(apm->buffer, bytes - avail);
+  }
+  return buf_write_pointer(apm->buffer);
 }
 
 int cras_stream_apm_process(struct cras_apm* apm,
                             struct float_buffer* input,
                             unsigned int offset,
+                            uint64_t read_frames,
                             float preprocessing_gain_scalar) {
   struct cras_audio_ctx* actx = checked_audio_ctx();
 
-  unsigned int writable, nframes, nread;
-  int ch, i, j;
+  struct apm_instance* inst = apm->inst;
+  struct active_apm* active;
+  unsigned int skipped, writable, nframes, nread, bytes;
+  uint64_t pos;
+  int i, j;
   float* const* wp;
   float* const* rp;
 
@@ -1261,96 +1466,118 @@ int cras_stream_apm_process(struct cras_apm* apm,
     return -EINVAL;
   }
 
-  writable = float_buffer_writable(apm->fbuffer);
+  /* Frames another stream sharing this APM has already fed are consumed
+   * without being copied again. The APM cannot have been fed past the end
+   * of |input| unless the device restarted, and frames before |pos| that
+   * nobody fed were dropped from the device, so resync in both cases. */
+  pos = read_frames + offset;
+  if (inst->input_frames < pos || inst->input_frames > read_frames + nread) {
+    inst->input_frames = pos;
+  }
+  skipped = MIN(nread - offset, inst->input_frames - pos);
+  offset += skipped;
+
+  writable = float_buffer_writable(inst->fbuffer);
   writable = MIN(nread - offset, writable);
 
   // Read from shared fbuffer and apply gain
   nframes = writable;
   while (nframes) {
     nread = nframes;
-    wp = float_buffer_write_pointer(apm->fbuffer);
+    wp = float_buffer_write_pointer(inst->fbuffer);
     rp = float_buffer_read_pointer(input, offset, &nread);
 
-    for (i = 0; i < apm->fbuffer->num_channels; i++) {
-      /* Look up the channel position and copy from
-       * the correct index of |input| buffer.
-       */
-      for (ch = 0; ch < CRAS_CH_MAX; ch++) {
-        if (apm->fmt.channel_layout[ch] == i) {
-          break;
-        }
-      }
-      if (ch == CRAS_CH_MAX) {
-        continue;
-      }
-
-      j = apm->dev_fmt.channel_layout[ch];
+    for (i = 0; i < inst->fbuffer->num_channels; i++) {
+      j = inst->dev_channels[i];
       if (j == -1) {
         continue;
       }
-
-      for (int f = 0; f < nread; f++) {
-        wp[i][f] = clamp1(rp[j][f] * preprocessing_gain_scalar);
-      }
+      dsp_util_scale_clamp(rp[j], wp[i], preprocessing_gain_scalar, nread);
     }
 
     nframes -= nread;
     offset += nread;
 
-    float_buffer_written(apm->fbuffer, nread);
+    float_buffer_written(inst->fbuffer, nread);
   }
+  inst->input_frames += writable;
 
-  // process and move to int buffer
-  if ((float_buffer_writable(apm->fbuffer) == 0) &&
-      (buf_queued(apm->buffer) == 0)) {
-    nread = float_buffer_level(apm->fbuffer);
-    rp = float_buffer_read_pointer(apm->fbuffer, 0, &nread);
+  /* Process and move to int buffer. Only the queue of the stream calling
+   * in holds the APM back; the other sharers drop old data if full. */
+  bytes = float_buffer_level(inst->fbuffer) * cras_get_format_bytes(&inst->fmt);
+  if ((float_buffer_writable(inst->fbuffer) == 0) &&
+      buf_available(apm->buffer) >= bytes) {
+    nread = float_buffer_level(inst->fbuffer);
+    rp = float_buffer_read_pointer(inst->fbuffer, 0, &nread);
 
     // Process audio with cras_processor.
     struct multi_slice input = {
-        .channels = apm->fmt.num_channels,
+        .channels = inst->fmt.num_channels,
         .num_frames = nread,
     };
     struct multi_slice output = {};
     for (int ch = 0; ch < input.channels; ch++) {
       input.data[ch] = rp[ch];
     }
+    /* On its own thread the processor's work isn't on this thread's
+     * clock. Its stages are still timed in cras_processor_dump_stats. */
+    struct timespec cpu_start, cpu_end, cpu_used;
+    if (!inst->cras_processor_threaded) {
+      clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+    }
     enum status st =
-        apm->cras_processor->ops->run(apm->cras_processor, &input, &output);
+        inst->cras_processor->ops->run(inst->cras_processor, &input, &output);
     if (st != StatusOk) {
       syslog(LOG_ERR, "cras_processor run failed");
       return -ENOTRECOVERABLE;
     }
+    if (!inst->cras_processor_threaded) {
+      clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+      subtract_timespecs(&cpu_end, &cpu_start, &cpu_used);
+      cras_trace_processor_cpu(cpu_used.tv_sec * 1000000 +
+                               cpu_used.tv_nsec / 1000);
+    }
 
-    CRAS_CHECK(output.channels == apm->fmt.num_channels);
+    CRAS_CHECK(output.channels == inst->fmt.num_channels);
     CRAS_CHECK(output.num_frames == nread);
 
+    const uint8_t* processed = buf_write_pointer(apm->buffer);
     dsp_util_interleave(output.data, buf_write_pointer(apm->buffer),
-                        output.channels, apm->fmt.format, nread);
-    buf_increment_write(apm->buffer, nread * cras_get_format_bytes(&apm->fmt));
-    float_buffer_reset(apm->fbuffer);
+                        output.channels, inst->fmt.format, nread);
+    buf_increment_write(apm->buffer, bytes);
+
+    // Hand the same block to the other streams sharing this APM.
+    DL_FOREACH (actx->apm->active_apms, active) {
+      if (active->apm->inst != inst || active->apm == apm) {
+        continue;
+      }
+      memcpy(apm_queue_block(active->apm, bytes), processed, bytes);
+      buf_increment_write(active->apm->buffer, bytes);
+    }
+    float_buffer_reset(inst->fbuffer);
 
-    possibly_track_voice_activity(actx, apm);
+    possibly_track_voice_activity(actx, inst);
   }
 
-  return writable;
+  return skipped + writable;
 }
 
 struct cras_audio_area* cras_stream_apm_get_processed(struct cras_apm* apm) {
   uint8_t* buf_ptr;
 
   buf_ptr = buf_read_pointer_size(apm->buffer, &apm->area->frames);
-  apm->area->frames /= cras_get_format_bytes(&apm->fmt);
-  cras_audio_area_config_buf_pointers(apm->area, &apm->fmt, buf_ptr);
+  apm->area->frames /= cras_get_format_bytes(&apm->inst->fmt);
+  cras_audio_area_config_buf_pointers(apm->area, &apm->inst->fmt, buf_ptr);
   return apm->area;
 }
 
 void cras_stream_apm_put_processed(struct cras_apm* apm, unsigned int frames) {
-  buf_increment_read(apm->buffer, frames * cras_get_format_bytes(&apm->fmt));
+  buf_increment_read(apm->buffer,
+                     frames * cras_get_format_bytes(&apm->inst->fmt));
 }
 
 struct cras_audio_format* cras_stream_apm_get_format(struct cras_apm* apm) {
-  return &apm->fmt;
+  return &apm->inst->fmt;
 }
 
 bool cras_stream_apm_get_use_tuned_settings(struct cras_stream_apm* stream,
@@ -1509,9 +1736,9 @@ struct cras_stream_apm_state cras_stream_apm_get_state(
     return (struct cras_stream_apm_state){};
   }
 
-  struct WebRtcApmStats stats = webrtc_apm_get_stats(apm->apm_ptr);
+  struct WebRtcApmStats stats = webrtc_apm_get_stats(apm->inst->apm_ptr);
   return (struct cras_stream_apm_state){
-      .active_ap_effects = get_active_ap_effects(apm),
+      .active_ap_effects = get_active_ap_effects(apm->inst),
       .webrtc_apm_forward_blocks_processed = stats.forward_blocks_processed,
       .webrtc_apm_reverse_blocks_processed = stats.reverse_blocks_processed,
   };
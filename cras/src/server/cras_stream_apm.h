@@ -138,11 +138,20 @@ void cras_stream_apm_remove(struct cras_stream_apm* stream,
  *    input - Float buffer from device for apm to process.
  *    offset - Offset in |input| to note the data position to start
  *        reading.
+ *    read_frames - Frames read out of |input| before its read pointer, so
+ *        that |read_frames| + |offset| is the capture position of the data
+ *        at |offset|. Streams sharing an APM use it to skip frames another
+ *        stream already fed.
  *    preprocessing_gain_scalar - Gain to apply before processing.
+ * Returns:
+ *    The number of frames consumed from |input|, including the frames
+ *    another stream sharing the same APM already fed to it, or negative
+ *    error code.
  */
 int cras_stream_apm_process(struct cras_apm* apm,
                             struct float_buffer* input,
                             unsigned int offset,
+                            uint64_t read_frames,
                             float preprocessing_gain_scalar);
 
 /* Gets the APM processed data in the form of audio area.
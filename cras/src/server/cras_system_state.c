@@ -22,6 +22,7 @@
 #include "cras/common/check.h"
 #include "cras/server/s2/s2.h"
 #include "cras/src/common/cras_alsa_card_info.h"
+#include "cras/src/server/audio_thread_health.h"
 #include "cras/src/server/config/cras_board_config.h"
 #include "cras/src/server/cras_alert.h"
 #include "cras/src/server/cras_alsa_card.h"
@@ -47,6 +48,25 @@ struct card_list {
   struct card_list *prev, *next;
 };
 
+/* Main thread timers may be called this much later than requested when
+ * another timer expires within that time, so that they share a wake up.
+ */
+#define MAIN_TIMER_SLACK_MS 10
+
+// Maximum number of threads used to probe cards in parallel.
+#define MAX_CARD_PROBE_THREADS 4
+
+// Shared by the card probe workers of one cras_system_add_alsa_cards call.
+struct card_probe_job {
+  struct cras_alsa_card_info** infos;
+  struct cras_alsa_card** cards;
+  // Probe result of each card. A failed card is destroyed by the caller.
+  int* rcs;
+  size_t num_cards;
+  // Index of the next card to probe, claimed atomically by the workers.
+  size_t next;
+};
+
 struct name_list {
   char name[NAME_MAX];
   struct name_list *prev, *next;
@@ -130,6 +150,10 @@ struct private_state {
   // Incorrect values will cause issues such as A/V sync. Only update the values
   // based on actual measured latency data.
   int32_t speaker_output_latency_offset_ms;
+  // Frames worth of time, in microseconds, that ALSA playback devices keep
+  // in the buffer when scheduling wake ups from hardware timestamps. 0
+  // disables the timestamp based scheduling. Read from board.ini.
+  int32_t tstamp_wake_margin_us;
   // The raw string content obtained from board config for DSP offload. The
   // content should have at least one map entries. Each entry should be stated
   // in specific format: <NAME>:(<PPL_ID>,<PATTERN?>)
@@ -153,6 +177,11 @@ struct private_state {
   char* board_name;
   // Whether or not sidetone is enabled.
   int32_t sidetone_enabled;
+  // Copies of the device and node tables of exp_state, each followed by its
+  // extension table, returned by cras_system_state_get_*_devs and
+  // cras_system_state_get_*_nodes.
+  struct cras_iodev_info devs[CRAS_NUM_DIRECTIONS][CRAS_MAX_IODEVS_TOTAL];
+  struct cras_ionode_info nodes[CRAS_NUM_DIRECTIONS][CRAS_MAX_IONODES_TOTAL];
 };
 
 static struct private_state state;
@@ -226,6 +255,7 @@ void cras_system_state_init(const char* device_config_dir,
 
   // Initial system state.
   exp_state->state_version = CRAS_SERVER_STATE_VERSION;
+  exp_state->sections_magic = CRAS_SERVER_STATE_SECTIONS_MAGIC;
   exp_state->volume = CRAS_MAX_SYSTEM_VOLUME;
   exp_state->mute = 0;
   exp_state->mute_locked = 0;
@@ -274,6 +304,7 @@ void cras_system_state_init(const char* device_config_dir,
   }
 
   state.exp_state = exp_state;
+  audio_thread_health_init(&exp_state->audio_thread_health);
 
   // Directory for volume curve configs.
   state.device_config_dir = device_config_dir;
@@ -287,6 +318,7 @@ void cras_system_state_init(const char* device_config_dir,
     cras_board_config_destroy(board_config);
     exit(-ENOMEM);
   }
+  cras_tm_set_slack(state.tm, MAIN_TIMER_SLACK_MS);
 
   // Initialize snapshot buffer memory
   memset(&state.snapshot_buffer, 0, sizeof(state.snapshot_buffer));
@@ -302,6 +334,7 @@ void cras_system_state_init(const char* device_config_dir,
   state.speaker_output_latency_offset_ms =
       board_config->speaker_output_latency_offset_ms;
   state.output_proc_hats = board_config->output_proc_hats;
+  state.tstamp_wake_margin_us = MAX(board_config->tstamp_wake_margin_us, 0);
 
   state.dsp_offload_map_str = NULL;
   if (board_config->dsp_offload_map) {
@@ -320,6 +353,7 @@ void cras_system_state_deinit() {
 
   cras_tm_deinit(state.tm);
 
+  audio_thread_health_init(NULL);
   if (state.exp_state) {
     munmap(state.exp_state, state.shm_size);
     cras_shm_close_unlink(state.shm_name, state.shm_fd);
@@ -694,21 +728,54 @@ enum CRAS_SCREEN_ROTATION cras_system_get_display_rotation() {
   return state.display_rotation;
 }
 
-int cras_system_add_alsa_card(struct cras_alsa_card_info* alsa_card_info) {
+static bool card_index_exists(unsigned card_index) {
   struct card_list* card;
+
+  DL_FOREACH (state.cards, card) {
+    if (card_index == cras_alsa_card_get_index(card->card)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static int probe_alsa_card(struct cras_alsa_card_info* alsa_card_info,
+                           struct cras_alsa_card** alsa_card) {
+  if (alsa_card_info->card_type == ALSA_CARD_TYPE_USB) {
+    return cras_alsa_card_probe(alsa_card_info, CRAS_CONFIG_FILE_DIR, NULL,
+                                alsa_card);
+  }
+  return cras_alsa_card_probe(alsa_card_info, state.device_config_dir,
+                              state.internal_ucm_suffix, alsa_card);
+}
+
+// Adds an already created card to the list of cards in the system.
+static int append_alsa_card(struct cras_alsa_card_info* alsa_card_info,
+                            struct cras_alsa_card* alsa_card) {
+  struct card_list* card;
+
+  if (alsa_card_info->card_type != ALSA_CARD_TYPE_USB) {
+    cras_server_metrics_ucm_create_status(alsa_card_info->card_type,
+                                          cras_alsa_card_has_ucm(alsa_card));
+  }
+  card = calloc(1, sizeof(*card));
+  if (card == NULL) {
+    return -ENOMEM;
+  }
+  card->card = alsa_card;
+  DL_APPEND(state.cards, card);
+  return 0;
+}
+
+int cras_system_add_alsa_card(struct cras_alsa_card_info* alsa_card_info) {
   struct cras_alsa_card* alsa_card;
-  unsigned card_index;
 
   if (alsa_card_info == NULL) {
     return -EINVAL;
   }
 
-  card_index = alsa_card_info->card_index;
-
-  DL_FOREACH (state.cards, card) {
-    if (card_index == cras_alsa_card_get_index(card->card)) {
-      return -EEXIST;
-    }
+  if (card_index_exists(alsa_card_info->card_index)) {
+    return -EEXIST;
   }
 
   if (alsa_card_info->card_type == ALSA_CARD_TYPE_USB) {
@@ -722,17 +789,105 @@ int cras_system_add_alsa_card(struct cras_alsa_card_info* alsa_card_info) {
   if (alsa_card == NULL) {
     return -ENOMEM;
   }
-  if (alsa_card_info->card_type != ALSA_CARD_TYPE_USB) {
-    cras_server_metrics_ucm_create_status(alsa_card_info->card_type,
-                                          cras_alsa_card_has_ucm(alsa_card));
+  return append_alsa_card(alsa_card_info, alsa_card);
+}
+
+static void* card_probe_worker(void* arg) {
+  struct card_probe_job* job = (struct card_probe_job*)arg;
+  size_t i;
+
+  while ((i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) <
+         job->num_cards) {
+    if (job->infos[i]) {
+      job->rcs[i] = probe_alsa_card(job->infos[i], &job->cards[i]);
+    }
   }
-  card = calloc(1, sizeof(*card));
-  if (card == NULL) {
-    return -ENOMEM;
+  return NULL;
+}
+
+int cras_system_add_alsa_cards(struct cras_alsa_card_info** alsa_card_infos,
+                               size_t num_cards) {
+  struct card_probe_job job;
+  pthread_t threads[MAX_CARD_PROBE_THREADS];
+  size_t num_threads, started = 0;
+  size_t i;
+  int added = 0;
+
+  if (alsa_card_infos == NULL || num_cards == 0) {
+    return 0;
   }
-  card->card = alsa_card;
-  DL_APPEND(state.cards, card);
-  return 0;
+
+  job.infos = calloc(num_cards, sizeof(*job.infos));
+  job.cards = calloc(num_cards, sizeof(*job.cards));
+  job.rcs = calloc(num_cards, sizeof(*job.rcs));
+  if (job.infos == NULL || job.cards == NULL || job.rcs == NULL) {
+    free(job.infos);
+    free(job.cards);
+    free(job.rcs);
+    return 0;
+  }
+  job.num_cards = num_cards;
+  job.next = 0;
+
+  // Skip cards already in the system and duplicates within the batch.
+  for (i = 0; i < num_cards; i++) {
+    struct cras_alsa_card_info* info = alsa_card_infos[i];
+    size_t j;
+
+    if (info == NULL || card_index_exists(info->card_index)) {
+      continue;
+    }
+    for (j = 0; j < i; j++) {
+      if (job.infos[j] && job.infos[j]->card_index == info->card_index) {
+        break;
+      }
+    }
+    if (j == i) {
+      job.infos[i] = info;
+    }
+  }
+
+  /* The probe step only opens ALSA handles and parses configs, so it can run
+   * off the main thread. The calling thread always takes part in the work, and
+   * also does all of it if no worker can be started. */
+  num_threads = MIN(num_cards, MAX_CARD_PROBE_THREADS) - 1;
+  for (i = 0; i < num_threads; i++) {
+    if (pthread_create(&threads[started], NULL, card_probe_worker, &job)) {
+      syslog(LOG_WARNING, "Failed to start card probe thread");
+      break;
+    }
+    started++;
+  }
+  card_probe_worker(&job);
+  for (i = 0; i < started; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  /* Attach in the given order so iodev indexes stay deterministic. Cards
+   * that failed to probe are destroyed here rather than on the workers,
+   * because that releases their controls from the global control list. */
+  for (i = 0; i < num_cards; i++) {
+    if (job.infos[i] == NULL) {
+      continue;
+    }
+    if (job.rcs[i]) {
+      syslog(LOG_WARNING, "Failed to probe card %u: %d",
+             job.infos[i]->card_index, job.rcs[i]);
+      cras_alsa_card_destroy(job.cards[i]);
+      continue;
+    }
+    if (cras_alsa_card_attach(job.cards[i], job.infos[i]) ||
+        append_alsa_card(job.infos[i], job.cards[i])) {
+      cras_alsa_card_destroy(job.cards[i]);
+      continue;
+    }
+    added++;
+  }
+
+  free(job.infos);
+  free(job.cards);
+  free(job.rcs);
+  return added;
 }
 
 int cras_system_remove_alsa_card(size_t alsa_card_index) {
@@ -914,6 +1069,46 @@ void cras_system_state_stream_removed(enum CRAS_STREAM_DIRECTION direction,
                                           s->num_active_streams[direction]);
 }
 
+struct cras_power_meter* cras_system_state_add_power_meter(
+    enum CRAS_POWER_METER_SOURCE source,
+    uint32_t id,
+    enum CRAS_STREAM_DIRECTION direction) {
+  struct cras_server_state* s;
+  struct cras_power_meter* meter = NULL;
+  unsigned i;
+
+  s = cras_system_state_update_begin();
+  if (!s) {
+    return NULL;
+  }
+
+  for (i = 0; i < CRAS_MAX_POWER_METERS; i++) {
+    if (s->power_meters[i].source == CRAS_POWER_METER_NONE) {
+      meter = &s->power_meters[i];
+      meter->id = id;
+      meter->direction = direction;
+      meter->power = 0.0f;
+      meter->source = source;
+      break;
+    }
+  }
+
+  cras_system_state_update_complete();
+  if (!meter) {
+    syslog(LOG_DEBUG, "No free power meter for %s %x",
+           source == CRAS_POWER_METER_STREAM ? "stream" : "device", id);
+  }
+  return meter;
+}
+
+void cras_system_state_remove_power_meter(struct cras_power_meter* meter) {
+  if (!meter || !cras_system_state_update_begin()) {
+    return;
+  }
+  meter->source = CRAS_POWER_METER_NONE;
+  cras_system_state_update_complete();
+}
+
 unsigned cras_system_state_get_active_streams() {
   unsigned i, sum;
   sum = 0;
@@ -941,40 +1136,93 @@ void cras_system_state_get_last_stream_active_time(struct cras_timespec* ts) {
   *ts = state.exp_state->last_active_stream_time;
 }
 
+/* Copies the |num| first devices of a table of the shared state and its
+ * extension table to |out|. Returns the number of devices copied. */
+static int copy_devs(const struct cras_iodev_info* table,
+                     const struct cras_iodev_info* ext,
+                     uint32_t num,
+                     struct cras_iodev_info* out) {
+  uint32_t n = MIN(num, CRAS_MAX_IODEVS_TOTAL);
+  uint32_t n_table = MIN(n, CRAS_MAX_IODEVS);
+
+  memcpy(out, table, n_table * sizeof(*out));
+  memcpy(out + n_table, ext, (n - n_table) * sizeof(*out));
+  return n;
+}
+
+// Same as copy_devs, for nodes.
+static int copy_nodes(const struct cras_ionode_info* table,
+                      const struct cras_ionode_info* ext,
+                      uint32_t num,
+                      struct cras_ionode_info* out) {
+  uint32_t n = MIN(num, CRAS_MAX_IONODES_TOTAL);
+  uint32_t n_table = MIN(n, CRAS_MAX_IONODES);
+
+  memcpy(out, table, n_table * sizeof(*out));
+  memcpy(out + n_table, ext, (n - n_table) * sizeof(*out));
+  return n;
+}
+
 int cras_system_state_get_output_devs(const struct cras_iodev_info** devs) {
-  *devs = state.exp_state->output_devs;
-  return state.exp_state->num_output_devs;
+  struct cras_iodev_info* out = state.devs[CRAS_STREAM_OUTPUT];
+
+  *devs = out;
+  return copy_devs(state.exp_state->output_devs,
+                   state.exp_state->output_devs_ext,
+                   state.exp_state->num_output_devs_total, out);
 }
 
 int cras_system_state_get_input_devs(const struct cras_iodev_info** devs) {
-  *devs = state.exp_state->input_devs;
-  return state.exp_state->num_input_devs;
+  struct cras_iodev_info* out = state.devs[CRAS_STREAM_INPUT];
+
+  *devs = out;
+  return copy_devs(state.exp_state->input_devs, state.exp_state->input_devs_ext,
+                   state.exp_state->num_input_devs_total, out);
 }
 
 int cras_system_state_get_output_nodes(const struct cras_ionode_info** nodes) {
-  *nodes = state.exp_state->output_nodes;
-  return state.exp_state->num_output_nodes;
+  struct cras_ionode_info* out = state.nodes[CRAS_STREAM_OUTPUT];
+
+  *nodes = out;
+  return copy_nodes(state.exp_state->output_nodes,
+                    state.exp_state->output_nodes_ext,
+                    state.exp_state->num_output_nodes_total, out);
 }
 
 int cras_system_state_get_input_nodes(const struct cras_ionode_info** nodes) {
-  *nodes = state.exp_state->input_nodes;
-  return state.exp_state->num_input_nodes;
+  struct cras_ionode_info* out = state.nodes[CRAS_STREAM_INPUT];
+
+  *nodes = out;
+  return copy_nodes(state.exp_state->input_nodes,
+                    state.exp_state->input_nodes_ext,
+                    state.exp_state->num_input_nodes_total, out);
+}
+
+/* Copies the last active node of a node table of the shared state and its
+ * extension table to |node|. Leaves |node| unchanged if none is active. */
+static void get_active_node(const struct cras_ionode_info* table,
+                            const struct cras_ionode_info* ext,
+                            uint32_t num,
+                            struct cras_ionode_info* node) {
+  for (uint32_t i = 0; i < MIN(num, CRAS_MAX_IONODES_TOTAL); i++) {
+    const struct cras_ionode_info* n =
+        i < CRAS_MAX_IONODES ? &table[i] : &ext[i - CRAS_MAX_IONODES];
+    if (n->active) {
+      *node = *n;
+    }
+  }
 }
 
 void get_active_input_node(struct cras_ionode_info* node) {
-  for (int i = 0; i < state.exp_state->num_input_nodes; i++) {
-    if (state.exp_state->input_nodes[i].active) {
-      *node = state.exp_state->input_nodes[i];
-    }
-  }
+  get_active_node(state.exp_state->input_nodes,
+                  state.exp_state->input_nodes_ext,
+                  state.exp_state->num_input_nodes_total, node);
 }
 
 void get_active_output_node(struct cras_ionode_info* node) {
-  for (int i = 0; i < state.exp_state->num_output_nodes; i++) {
-    if (state.exp_state->output_nodes[i].active) {
-      *node = state.exp_state->output_nodes[i];
-    }
-  }
+  get_active_node(state.exp_state->output_nodes,
+                  state.exp_state->output_nodes_ext,
+                  state.exp_state->num_output_nodes_total, node);
 }
 
 const char* cras_system_state_get_active_node_types() {
@@ -1015,6 +1263,32 @@ void cras_system_state_update_complete() {
   pthread_mutex_unlock(&state.update_lock);
 }
 
+static uint32_t* section_update_count(enum CRAS_SERVER_STATE_SECTION section) {
+  switch (section) {
+    case CRAS_SERVER_STATE_DEV_LIST:
+      return &state.exp_state->dev_list_update_count;
+    case CRAS_SERVER_STATE_CLIENT_LIST:
+      return &state.exp_state->client_list_update_count;
+  }
+  return NULL;
+}
+
+struct cras_server_state* cras_system_state_update_section_begin(
+    enum CRAS_SERVER_STATE_SECTION section) {
+  struct cras_server_state* s = cras_system_state_update_begin();
+
+  if (s) {
+    __sync_fetch_and_add(section_update_count(section), 1);
+  }
+  return s;
+}
+
+void cras_system_state_update_section_complete(
+    enum CRAS_SERVER_STATE_SECTION section) {
+  __sync_fetch_and_add(section_update_count(section), 1);
+  cras_system_state_update_complete();
+}
+
 struct cras_server_state* cras_system_state_get_no_lock() {
   return state.exp_state;
 }
@@ -1085,6 +1359,10 @@ int cras_system_get_speaker_output_latency_offset_ms() {
   return state.speaker_output_latency_offset_ms;
 }
 
+int cras_system_get_tstamp_wake_margin_us() {
+  return state.tstamp_wake_margin_us;
+}
+
 bool cras_system_get_ap_nc_supported_on_bluetooth() {
   return !cras_s2_get_sr_bt_supported();
 }
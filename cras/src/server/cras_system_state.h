@@ -263,6 +263,19 @@ enum CRAS_SCREEN_ROTATION cras_system_get_display_rotation();
  */
 int cras_system_add_alsa_card(struct cras_alsa_card_info* alsa_card_info);
 
+/* Adds several cards at once.  Used when enumerating the cards present at
+ * startup: the cards are probed concurrently on a small pool of worker
+ * threads and then attached to the system one by one, in the given order, on
+ * the calling (main) thread.
+ * Args:
+ *    alsa_card_infos - Array of pointers to info about each card.
+ *    num_cards - Number of entries in alsa_card_infos.
+ * Returns:
+ *    The number of cards added.
+ */
+int cras_system_add_alsa_cards(struct cras_alsa_card_info** alsa_card_infos,
+                               size_t num_cards);
+
 /* Removes a card.  When a device is removed this will do the cleanup.  Device
  * at index must have been added using cras_system_add_alsa_card().
  * Args:
@@ -372,6 +385,25 @@ void cras_system_state_stream_removed(enum CRAS_STREAM_DIRECTION direction,
                                       enum CRAS_CLIENT_TYPE client_type,
                                       uint64_t effects);
 
+/* Claims a free power meter in the server state so clients can read the
+ * level of a stream or device from shared memory.
+ * Args:
+ *   source - What the meter measures, stream or device.
+ *   id - Stream id or device index.
+ *   direction - Direction of the stream or device.
+ * Returns:
+ *   The claimed meter, or NULL if all meters are in use.
+ */
+struct cras_power_meter* cras_system_state_add_power_meter(
+    enum CRAS_POWER_METER_SOURCE source,
+    uint32_t id,
+    enum CRAS_STREAM_DIRECTION direction);
+
+/* Releases a meter claimed by cras_system_state_add_power_meter. Does
+ * nothing if |meter| is NULL.
+ */
+void cras_system_state_remove_power_meter(struct cras_power_meter* meter);
+
 // Returns the number of active playback and capture streams.
 unsigned cras_system_state_get_active_streams();
 
@@ -397,33 +429,41 @@ void cras_system_state_get_input_streams_with_permission(
  */
 void cras_system_state_get_last_stream_active_time(struct cras_timespec* ts);
 
-/* Returns output devices information.
+/* Returns output devices information, including those in the extension
+ * table of the shared state. Must be called from the main thread.
  * Args:
- *    devs - returns the array of output devices information.
+ *    devs - returns the array of output devices information, valid until
+ *        the next call.
  * Returns:
  *    number of output devices.
  */
 int cras_system_state_get_output_devs(const struct cras_iodev_info** devs);
 
-/* Returns input devices information.
+/* Returns input devices information, including those in the extension
+ * table of the shared state. Must be called from the main thread.
  * Args:
- *    devs - returns the array of input devices information.
+ *    devs - returns the array of input devices information, valid until
+ *        the next call.
  * Returns:
  *    number of input devices.
  */
 int cras_system_state_get_input_devs(const struct cras_iodev_info** devs);
 
-/* Returns output nodes information.
+/* Returns output nodes information, including those in the extension
+ * table of the shared state. Must be called from the main thread.
  * Args:
- *    nodes - returns the array of output nodes information.
+ *    nodes - returns the array of output nodes information, valid until
+ *        the next call.
  * Returns:
  *    number of output nodes.
  */
 int cras_system_state_get_output_nodes(const struct cras_ionode_info** nodes);
 
-/* Returns input nodes information.
+/* Returns input nodes information, including those in the extension
+ * table of the shared state. Must be called from the main thread.
  * Args:
- *    nodes - returns the array of input nodes information.
+ *    nodes - returns the array of input nodes information, valid until
+ *        the next call.
  * Returns:
  *    number of input nodes.
  */
@@ -465,6 +505,24 @@ struct cras_server_state* cras_system_state_update_begin();
  */
 void cras_system_state_update_complete();
 
+// Sections of the shared system state with their own update count.
+enum CRAS_SERVER_STATE_SECTION {
+  // The device and node lists.
+  CRAS_SERVER_STATE_DEV_LIST,
+  // The attached client list.
+  CRAS_SERVER_STATE_CLIENT_LIST,
+};
+
+/* Like cras_system_state_update_begin, and also makes the update count of
+ * |section| odd, so that clients only reading |section| notice the update.
+ */
+struct cras_server_state* cras_system_state_update_section_begin(
+    enum CRAS_SERVER_STATE_SECTION section);
+
+// Completes an update started with cras_system_state_update_section_begin.
+void cras_system_state_update_section_complete(
+    enum CRAS_SERVER_STATE_SECTION section);
+
 /* Gets a pointer to the system state without locking it.  Only used for debug
  * log.  Don't add calls to this function. */
 struct cras_server_state* cras_system_state_get_no_lock();
@@ -517,6 +575,10 @@ int cras_system_get_num_stream_ignore_ui_gains();
 // Returns the latency offset that should be added for speaker output.
 int cras_system_get_speaker_output_latency_offset_ms();
 
+// Returns the margin in microseconds ALSA playback devices keep in the buffer
+// when waking up by hardware timestamps. 0 means the mode is disabled.
+int cras_system_get_tstamp_wake_margin_us();
+
 // Returns true AP NC is supported on bluetooth devices.
 // This does not consider feature flags.
 bool cras_system_get_ap_nc_supported_on_bluetooth();
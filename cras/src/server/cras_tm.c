@@ -5,12 +5,17 @@
 
 #include "cras/src/server/cras_tm.h"
 
+#include <errno.h>
 #include <stdlib.h>
+#include <syslog.h>
 #include <time.h>
 
 #include "cras_util.h"
 #include "third_party/utlist/utlist.h"
 
+// Initial number of timers the heap has room for.
+#define INITIAL_HEAP_SIZE 16
+
 // Represents an armed timer.
 struct cras_timer {
   // timespec at which the timer should fire.
@@ -19,12 +24,26 @@ struct cras_timer {
   void (*cb)(struct cras_timer* t, void* data);
   // Data passed to the callback.
   void* cb_data;
+  // Index in the heap, or -1 if the timer is queued to be called.
+  int heap_index;
+  // Links in the list of expired timers.
   struct cras_timer *next, *prev;
 };
 
-// Timer Manager, keeps a list of active timers.
+/* Timer Manager, keeps the active timers in a binary min-heap ordered by
+ * expiry time.
+ */
 struct cras_tm {
-  struct cras_timer* timers;
+  struct cras_timer** heap;
+  // Number of timers in the heap.
+  unsigned int num_timers;
+  // Number of timers the heap has room for.
+  unsigned int heap_size;
+  // Timers which expired and are waiting for their callbacks to be called.
+  struct cras_timer* expired;
+  // How long the next timeout may be delayed to fire more timers at once.
+  // Only used when another timer expires within that time.
+  unsigned int slack_ms;
 };
 
 // Local Functions.
@@ -49,6 +68,109 @@ static inline int timespec_sooner(const struct timespec* a,
           (a->tv_sec == b->tv_sec && a->tv_nsec <= b->tv_nsec));
 }
 
+static inline void heap_set(struct cras_tm* tm,
+                            unsigned int i,
+                            struct cras_timer* t) {
+  tm->heap[i] = t;
+  t->heap_index = i;
+}
+
+// Moves the timer at |i| towards the root until its parent is sooner.
+static void heap_sift_up(struct cras_tm* tm, unsigned int i) {
+  struct cras_timer* t = tm->heap[i];
+  unsigned int parent;
+
+  while (i > 0) {
+    parent = (i - 1) / 2;
+    if (timespec_sooner(&tm->heap[parent]->ts, &t->ts)) {
+      break;
+    }
+    heap_set(tm, i, tm->heap[parent]);
+    i = parent;
+  }
+  heap_set(tm, i, t);
+}
+
+// Moves the timer at |i| towards the leaves until its children are later.
+static void heap_sift_down(struct cras_tm* tm, unsigned int i) {
+  struct cras_timer* t = tm->heap[i];
+  unsigned int child;
+
+  while ((child = 2 * i + 1) < tm->num_timers) {
+    if (child + 1 < tm->num_timers &&
+        !timespec_sooner(&tm->heap[child]->ts, &tm->heap[child + 1]->ts)) {
+      child++;
+    }
+    if (timespec_sooner(&t->ts, &tm->heap[child]->ts)) {
+      break;
+    }
+    heap_set(tm, i, tm->heap[child]);
+    i = child;
+  }
+  heap_set(tm, i, t);
+}
+
+static int heap_insert(struct cras_tm* tm, struct cras_timer* t) {
+  struct cras_timer** heap;
+  unsigned int size;
+
+  if (tm->num_timers == tm->heap_size) {
+    size = tm->heap_size ? tm->heap_size * 2 : INITIAL_HEAP_SIZE;
+    heap = realloc(tm->heap, size * sizeof(*heap));
+    if (!heap) {
+      return -ENOMEM;
+    }
+    tm->heap = heap;
+    tm->heap_size = size;
+  }
+
+  heap_set(tm, tm->num_timers++, t);
+  heap_sift_up(tm, t->heap_index);
+  return 0;
+}
+
+static void heap_remove(struct cras_tm* tm, struct cras_timer* t) {
+  unsigned int i = t->heap_index;
+  struct cras_timer* last = tm->heap[--tm->num_timers];
+
+  t->heap_index = -1;
+  if (last == t) {
+    return;
+  }
+
+  // Fill the hole with the last timer and restore the heap order.
+  heap_set(tm, i, last);
+  if (i > 0 && timespec_sooner(&last->ts, &tm->heap[(i - 1) / 2]->ts)) {
+    heap_sift_up(tm, i);
+  } else {
+    heap_sift_down(tm, i);
+  }
+}
+
+/* Moves |latest| to the expiry time of the latest timer in the subtree at
+ * |i| that expires no later than |limit|.
+ */
+static void heap_latest_before(const struct cras_tm* tm,
+                               unsigned int i,
+                               const struct timespec* limit,
+                               struct timespec* latest) {
+  const struct cras_timer* t;
+
+  if (i >= tm->num_timers) {
+    return;
+  }
+  t = tm->heap[i];
+  // Children expire no sooner than their parent.
+  if (!timespec_sooner(&t->ts, limit)) {
+    return;
+  }
+  if (timespec_sooner(latest, &t->ts)) {
+    *latest = t->ts;
+  }
+  heap_latest_before(tm, 2 * i + 1, limit, latest);
+  heap_latest_before(tm, 2 * i + 2, limit, latest);
+}
+
 // Exported Interface.
 
 struct cras_timer* cras_tm_create_timer(struct cras_tm* tm,
@@ -69,13 +191,20 @@ struct cras_timer* cras_tm_create_timer(struct cras_tm* tm,
   clock_gettime(CLOCK_MONOTONIC_RAW, &t->ts);
   add_ms_ts(&t->ts, ms);
 
-  DL_APPEND(tm->timers, t);
+  if (heap_insert(tm, t)) {
+    free(t);
+    return NULL;
+  }
 
   return t;
 }
 
 void cras_tm_cancel_timer(struct cras_tm* tm, struct cras_timer* t) {
-  DL_DELETE(tm->timers, t);
+  if (t->heap_index < 0) {
+    DL_DELETE(tm->expired, t);
+  } else {
+    heap_remove(tm, t);
+  }
   free(t);
 }
 
@@ -85,62 +214,94 @@ struct cras_tm* cras_tm_init() {
 
 void cras_tm_deinit(struct cras_tm* tm) {
   struct cras_timer* t;
+  unsigned int i;
 
-  DL_FOREACH (tm->timers, t) {
-    DL_DELETE(tm->timers, t);
+  for (i = 0; i < tm->num_timers; i++) {
+    free(tm->heap[i]);
+  }
+  DL_FOREACH (tm->expired, t) {
+    DL_DELETE(tm->expired, t);
     free(t);
   }
+  free(tm->heap);
   free(tm);
 }
 
+void cras_tm_set_slack(struct cras_tm* tm, unsigned int ms) {
+  tm->slack_ms = ms;
+}
+
 int cras_tm_get_next_timeout(const struct cras_tm* tm, struct timespec* ts) {
-  struct cras_timer* t;
   struct timespec now;
-  struct timespec* min;
+  struct timespec next;
+  struct timespec limit;
 
-  if (!tm->timers) {
+  if (!tm->num_timers) {
     return 0;
   }
 
-  min = &tm->timers->ts;
-  DL_FOREACH (tm->timers, t) {
-    if (timespec_sooner(&t->ts, min)) {
-      min = &t->ts;
-    }
+  /* Waiting for the last timer due within the slack of the soonest one
+   * lets them all fire on the same wake up. A timer alone in the slack
+   * window isn't delayed. */
+  next = tm->heap[0]->ts;
+  if (tm->slack_ms) {
+    limit = next;
+    add_ms_ts(&limit, tm->slack_ms);
+    heap_latest_before(tm, 0, &limit, &next);
   }
 
   clock_gettime(CLOCK_MONOTONIC_RAW, &now);
 
-  if (timespec_sooner(min, &now)) {
+  if (timespec_sooner(&next, &now)) {
     // Timer already expired.
     ts->tv_sec = ts->tv_nsec = 0;
     return 1;
   }
 
-  subtract_timespecs(min, &now, ts);
+  subtract_timespecs(&next, &now, ts);
   return 1;
 }
 
 void cras_tm_call_callbacks(struct cras_tm* tm) {
   struct timespec now;
-  struct cras_timer *t, *next;
+  struct cras_timer* t;
+
+  clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+
+  /* Move the expired timers out of the heap first, so that timers created
+   * by the callbacks are left for the next call. */
+  while (tm->num_timers && timespec_sooner(&tm->heap[0]->ts, &now)) {
+    t = tm->heap[0];
+    heap_remove(tm, t);
+    DL_APPEND(tm->expired, t);
+  }
+
+  /* Callbacks may cancel other expired timers, so always take the head of
+   * the list rather than holding on to the next timer. */
+  while ((t = tm->expired)) {
+    DL_DELETE(tm->expired, t);
+    t->cb(t, t->cb_data);
+    free(t);
+  }
+}
+
+void cras_tm_dump_timers(const struct cras_tm* tm) {
+  struct timespec now, remaining;
+  const struct cras_timer* t;
+  unsigned int i;
 
   clock_gettime(CLOCK_MONOTONIC_RAW, &now);
 
-  /* Don't use DL_FOREACH to iterate timers because in each loop the
-   * next timer pointer is stored for later access but it could be
-   * cancelled and freed in current timer's callback causing invalid
-   * memory access. */
-  t = tm->timers;
-  while (t) {
-    next = t->next;
+  syslog(LOG_INFO, "%u pending timers, slack %u ms", tm->num_timers,
+         tm->slack_ms);
+  for (i = 0; i < tm->num_timers; i++) {
+    t = tm->heap[i];
     if (timespec_sooner(&t->ts, &now)) {
-      t->cb(t, t->cb_data);
-      /* Update next timer because it could have been modified
-       * in t->cb(). */
-      next = t->next;
-      cras_tm_cancel_timer(tm, t);
+      remaining.tv_sec = remaining.tv_nsec = 0;
+    } else {
+      subtract_timespecs(&t->ts, &now, &remaining);
     }
-    t = next;
+    syslog(LOG_INFO, "timer cb %p data %p in %u ms", (void*)t->cb,
+           t->cb_data, timespec_to_ms(&remaining));
   }
 }
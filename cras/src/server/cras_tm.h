@@ -45,8 +45,17 @@ struct cras_tm* cras_tm_init();
 // Interface for system to destroy the timer manager.
 void cras_tm_deinit(struct cras_tm* tm);
 
+/* Allows the timeout returned by cras_tm_get_next_timeout to be up to |ms|
+ * later than the soonest timer when other timers expire within that time, so
+ * that they are called on a single wake up. A timer with no other timer
+ * within |ms| isn't delayed, and timers are never called early. Defaults to 0.
+ */
+void cras_tm_set_slack(struct cras_tm* tm, unsigned int ms);
+
 /* Get the amount of time before the next timer expires. ts is set to an
- * the amount of time before the next timer expires (0 if already past due).
+ * the amount of time before the next timer expires (0 if already past due),
+ * or before the last timer expiring within the slack set with
+ * cras_tm_set_slack after it.
  * Args:
  *    tm - Timer manager.
  *    ts - Filled with time before next event.
@@ -55,9 +64,14 @@ void cras_tm_deinit(struct cras_tm* tm);
  */
 int cras_tm_get_next_timeout(const struct cras_tm* tm, struct timespec* ts);
 
-// Calls any expired timers.
+/* Calls any expired timers. Timers created by the callbacks are not called
+ * before the next call, even if they already expired.
+ */
 void cras_tm_call_callbacks(struct cras_tm* tm);
 
+// Logs the pending timers and when they expire to syslog.
+void cras_tm_dump_timers(const struct cras_tm* tm);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
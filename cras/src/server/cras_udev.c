@@ -27,6 +27,8 @@
 #include "cras/src/server/cras_system_state.h"
 #include "cras_util.h"
 
+#define MAX_ALSA_CARDS 32  // Alsa limit on number of cards.
+
 struct udev_callback_data {
   struct udev_monitor* mon;
   struct udev* udev;
@@ -349,25 +351,38 @@ static struct cras_alsa_usb_card_info usb_card_info_create(
   return usb_card_info;
 }
 
-static void device_add_alsa(struct udev_device* dev,
-                            const char* sysname,
-                            unsigned card,
-                            enum CRAS_ALSA_CARD_TYPE card_type) {
-  udev_delay_for_alsa();
+/* Fills the info of an ALSA card. The info of a USB card is a
+ * cras_alsa_usb_card_info, so *info must be large enough to hold one.
+ * Returns false if the card should not be added. */
+static bool fill_alsa_card_info(struct udev_device* dev,
+                                unsigned card,
+                                enum CRAS_ALSA_CARD_TYPE card_type,
+                                struct cras_alsa_usb_card_info* info) {
   if (card_type == ALSA_CARD_TYPE_USB) {
     struct udev_device* parent_dev =
         udev_device_get_parent_with_subsystem_devtype(dev, "usb", "usb_device");
     // snd-dummy devices don't have a parent_dev
     if (!parent_dev && !is_dummy_device(dev)) {
-      return;
+      return false;
     }
-    struct cras_alsa_usb_card_info usb_card_info =
-        usb_card_info_create(card, dev, parent_dev);
-    cras_system_add_alsa_card(&usb_card_info.base);
+    *info = usb_card_info_create(card, dev, parent_dev);
   } else {
-    struct cras_alsa_card_info card_info = {.card_type = card_type,
-                                            .card_index = card};
-    cras_system_add_alsa_card(&card_info);
+    memset(info, 0, sizeof(*info));
+    info->base.card_type = card_type;
+    info->base.card_index = card;
+  }
+  return true;
+}
+
+static void device_add_alsa(struct udev_device* dev,
+                            const char* sysname,
+                            unsigned card,
+                            enum CRAS_ALSA_CARD_TYPE card_type) {
+  struct cras_alsa_usb_card_info info;
+
+  udev_delay_for_alsa();
+  if (fill_alsa_card_info(dev, card, card_type, &info)) {
+    cras_system_add_alsa_card(&info.base);
   }
 }
 
@@ -419,10 +434,47 @@ static void remove_device_if_card(struct udev_device* dev) {
   }
 }
 
+/* Cards found while enumerating at startup.  They are added together so
+ * that they can be probed in parallel. */
+struct enumerated_cards {
+  struct cras_alsa_usb_card_info infos[MAX_ALSA_CARDS];
+  struct cras_alsa_card_info* info_ptrs[MAX_ALSA_CARDS];
+  size_t num;
+};
+
+static void enumerate_alsa_card(struct udev_device* dev,
+                                struct enumerated_cards* cards) {
+  enum CRAS_ALSA_CARD_TYPE card_type;
+  unsigned card_number;
+  const char* sysname;
+  struct cras_alsa_usb_card_info* info;
+
+  if (cards->num >= MAX_ALSA_CARDS ||
+      !is_card_device(dev, &card_type, &card_number, &sysname) ||
+      !udev_sound_initialized(dev) ||
+      cras_system_alsa_card_exists(card_number)) {
+    return;
+  }
+  if (card_type == ALSA_CARD_TYPE_USB) {
+    set_factory_default(card_number);
+  }
+  info = &cards->infos[cards->num];
+  if (fill_alsa_card_info(dev, card_number, card_type, info)) {
+    cards->info_ptrs[cards->num++] = &info->base;
+  }
+}
+
 static void enumerate_devices(struct udev_callback_data* data) {
   struct udev_enumerate* enumerate = udev_enumerate_new(data->udev);
   struct udev_list_entry* dl;
   struct udev_list_entry* dev_list_entry;
+  struct enumerated_cards* cards;
+
+  cards = calloc(1, sizeof(*cards));
+  if (cards == NULL) {
+    udev_enumerate_unref(enumerate);
+    return;
+  }
 
   udev_enumerate_add_match_subsystem(enumerate, subsystem);
   udev_enumerate_scan_devices(enumerate);
@@ -432,10 +484,17 @@ static void enumerate_devices(struct udev_callback_data* data) {
     const char* path = udev_list_entry_get_name(dev_list_entry);
     struct udev_device* dev = udev_device_new_from_syspath(data->udev, path);
 
-    change_udev_device_if_alsa_device(dev);
+    enumerate_alsa_card(dev, cards);
     udev_device_unref(dev);
   }
   udev_enumerate_unref(enumerate);
+
+  if (cards->num) {
+    // One delay covers every card found, see udev_delay_for_alsa().
+    udev_delay_for_alsa();
+    cras_system_add_alsa_cards(cards->info_ptrs, cards->num);
+  }
+  free(cards);
 }
 
 static void udev_sound_subsystem_callback(void* arg, int revents) {
@@ -18,10 +18,13 @@
 #include <time.h>
 
 #include "cras/server/cras_trace.h"
+#include "cras/src/common/byte_buffer.h"
+#include "cras/src/server/audio_thread_health.h"
 #include "cras/src/server/audio_thread_log.h"
 #include "cras/src/server/cras_audio_area.h"
 #include "cras/src/server/cras_audio_thread_monitor.h"
 #include "cras/src/server/cras_device_monitor.h"
+#include "cras/src/server/cras_fmt_conv.h"
 #include "cras/src/server/cras_iodev.h"
 #include "cras/src/server/cras_non_empty_audio_handler.h"
 #include "cras/src/server/cras_rstream.h"
@@ -69,6 +72,34 @@ static struct timespec last_io_err_time = {0, 0};
 // The gap time to avoid repeated error close request to main thread.
 static const int ERROR_CLOSE_GAP_TIME_SECS = 10;
 
+/*
+ * Rate offset applied while the hw_level of a device sharing the mix of
+ * another one is out of range. Same as for streams in dev_stream.c.
+ */
+static const int MIX_FOLLOWER_COARSE_RATE_STEP = 3;
+
+/*
+ * An output device playing the mix of another open device, its leader. The
+ * leader copies the frames it commits to |buf|, and the follower converts
+ * them to its own format and rate.
+ */
+struct mix_follower {
+  // The device whose mix can be played, found when streams or devices were
+  // last added or removed. NULL if there is none.
+  struct open_dev* group_leader;
+  // The device whose mix is played, NULL while mixing the streams alone.
+  struct open_dev* leader;
+  // Mixed frames of |leader| not played yet, in the format of |leader|.
+  struct byte_buffer* buf;
+  // Frame size in |buf|.
+  unsigned int frame_bytes;
+  // Frame rate of the frames in |buf|.
+  unsigned int frame_rate;
+  // Converts from the format of |leader|. Its linear resampler tracks the
+  // drift between the two devices.
+  struct cras_fmt_conv* conv;
+};
+
 // Gets the main device which the stream is attached to.
 static inline struct cras_iodev* get_main_dev(const struct dev_stream* stream) {
   return (struct cras_iodev*)stream->stream->main_dev.dev_ptr;
@@ -134,6 +165,313 @@ static void update_estimated_rate(struct open_dev* adev,
   }
 }
 
+static void mix_follower_free_buffers(struct mix_follower* mf) {
+  if (mf->conv) {
+    cras_fmt_conv_destroy(&mf->conv);
+  }
+  if (mf->buf) {
+    byte_buffer_destroy(&mf->buf);
+  }
+}
+
+// Mixes of different formats or channel layouts are not shared.
+static bool can_share_mix_format(const struct cras_audio_format* a,
+                                 const struct cras_audio_format* b) {
+  return a->format == b->format && a->num_channels == b->num_channels &&
+         !memcmp(a->channel_layout, b->channel_layout,
+                 sizeof(a->channel_layout));
+}
+
+/*
+ * Returns the device |adev| can share the mix of, or NULL. That is the main
+ * device of all its streams, playing exactly the same streams and written
+ * before |adev| in |odev_list|. Whether both devices are running is checked
+ * in each playback pass.
+ */
+static struct open_dev* find_mix_leader(struct open_dev* odev_list,
+                                        struct open_dev* adev) {
+  struct cras_iodev* dev = adev->dev;
+  struct cras_iodev* main_dev;
+  struct open_dev* leader;
+  struct dev_stream *curr, *lcurr;
+  unsigned int num_streams = 0;
+
+  if (!dev->streams) {
+    return NULL;
+  }
+
+  main_dev = get_main_dev(dev->streams);
+  for (leader = odev_list; leader != adev; leader = leader->next) {
+    if (leader->dev == main_dev) {
+      break;
+    }
+  }
+  if (leader == adev ||
+      (leader->mix_follower && leader->mix_follower->group_leader) ||
+      !can_share_mix_format(main_dev->format, dev->format)) {
+    return NULL;
+  }
+
+  DL_FOREACH (dev->streams, curr) {
+    if (get_main_dev(curr) != main_dev) {
+      return NULL;
+    }
+    DL_SEARCH_SCALAR(main_dev->streams, lcurr, stream, curr->stream);
+    if (!lcurr) {
+      return NULL;
+    }
+    num_streams++;
+  }
+  DL_FOREACH (main_dev->streams, lcurr) {
+    if (num_streams == 0) {
+      return NULL;
+    }
+    num_streams--;
+  }
+  return num_streams == 0 ? leader : NULL;
+}
+
+/*
+ * Allocates the buffer and converter |adev| needs to play the mix of
+ * |leader|. Kept if they already fit, and never replaced while frames of the
+ * previous leader are left to play.
+ */
+static int mix_follower_configure(struct open_dev* adev,
+                                  struct open_dev* leader) {
+  struct mix_follower* mf = adev->mix_follower;
+  const struct cras_audio_format* from = leader->dev->format;
+  const struct cras_audio_format* to = adev->dev->format;
+  unsigned int buf_frames = leader->dev->buffer_size;
+  unsigned int frame_bytes = cras_get_format_bytes(from);
+  unsigned int max_frames;
+  int rc;
+
+  if (!mf) {
+    mf = (struct mix_follower*)calloc(1, sizeof(*mf));
+    if (!mf) {
+      return -ENOMEM;
+    }
+    adev->mix_follower = mf;
+  }
+  if (mf->conv && mf->buf && mf->frame_rate == from->frame_rate &&
+      mf->frame_bytes == frame_bytes &&
+      mf->buf->used_size == buf_frames * frame_bytes) {
+    return 0;
+  }
+  if (mf->buf && buf_queued(mf->buf)) {
+    return -EBUSY;
+  }
+  mix_follower_free_buffers(mf);
+
+  // Large enough for a full buffer at either rate, see dev_stream.c.
+  max_frames =
+      MAX(buf_frames,
+          cras_frames_at_rate(from->frame_rate, buf_frames, to->frame_rate)) +
+      1;
+  rc = config_format_converter(
+      &mf->conv, CRAS_STREAM_OUTPUT, from, to,
+      adev->dev->active_node ? adev->dev->active_node->type
+                             : CRAS_NODE_TYPE_UNKNOWN,
+      max_frames);
+  if (rc) {
+    return rc;
+  }
+  mf->frame_bytes = frame_bytes;
+  mf->frame_rate = from->frame_rate;
+  mf->buf = byte_buffer_create(buf_frames * frame_bytes);
+  if (!mf->buf) {
+    mix_follower_free_buffers(mf);
+    return -ENOMEM;
+  }
+  return 0;
+}
+
+void dev_io_update_mix_groups(struct open_dev* odev_list) {
+  struct open_dev* adev;
+  struct open_dev* leader;
+  int rc;
+
+  DL_FOREACH (odev_list, adev) {
+    if (!adev->share_mix) {
+      continue;
+    }
+    leader = find_mix_leader(odev_list, adev);
+    if (leader) {
+      rc = mix_follower_configure(adev, leader);
+      if (rc < 0) {
+        syslog(LOG_WARNING, "Failed to share mix of %s on %s: %d",
+               leader->dev->info.name, adev->dev->info.name, rc);
+        leader = NULL;
+      }
+    }
+    if (adev->mix_follower) {
+      adev->mix_follower->group_leader = leader;
+    }
+  }
+}
+
+/*
+ * Drops the leaders of devices whose streams no longer match them. Doesn't
+ * allocate, so it can run from the playback pass.
+ */
+static void check_mix_groups(struct open_dev* odev_list) {
+  struct open_dev* adev;
+  struct mix_follower* mf;
+
+  DL_FOREACH (odev_list, adev) {
+    mf = adev->mix_follower;
+    if (mf && mf->group_leader &&
+        find_mix_leader(odev_list, adev) != mf->group_leader) {
+      mf->group_leader = NULL;
+    }
+  }
+}
+
+// Whether |adev| plays the shared mix, or what is left of it, in this pass.
+static inline bool plays_shared_mix(const struct open_dev* adev) {
+  const struct mix_follower* mf = adev->mix_follower;
+
+  return mf && (mf->leader || (mf->buf && buf_queued(mf->buf)));
+}
+
+/*
+ * Decides for each device in a mix group whether it plays the mix of its
+ * leader in this pass. A device leaving the group keeps playing the frames
+ * left in its buffer and mixes its streams again once they are played.
+ */
+static void update_mix_followers(struct open_dev* odev_list) {
+  struct open_dev* adev;
+  struct open_dev* leader;
+  struct mix_follower* mf;
+
+  DL_FOREACH (odev_list, adev) {
+    mf = adev->mix_follower;
+    if (!mf) {
+      continue;
+    }
+    leader = mf->group_leader;
+    if (leader &&
+        (!cras_iodev_is_open(adev->dev) ||
+         cras_iodev_state(adev->dev) != CRAS_IODEV_STATE_NORMAL_RUN ||
+         cras_iodev_state(leader->dev) != CRAS_IODEV_STATE_NORMAL_RUN)) {
+      leader = NULL;
+    }
+    if (mf->leader == leader) {
+      continue;
+    }
+    // Frames mixed but not committed yet are replaced by the shared mix,
+    // unless the mix of the leader is still being played.
+    if (leader && !buf_queued(mf->buf)) {
+      cras_iodev_force_all_streams_read(
+          adev->dev, cras_iodev_max_stream_offset(adev->dev));
+    }
+    mf->leader = leader;
+  }
+}
+
+// Copies |frames| frames mixed by |adev| to the devices sharing its mix.
+static void feed_mix_followers(struct open_dev* odev_list,
+                               struct open_dev* adev,
+                               const uint8_t* src,
+                               unsigned int frames) {
+  struct open_dev* odev;
+  struct mix_follower* mf;
+  unsigned int bytes, writable, n;
+
+  DL_FOREACH (odev_list, odev) {
+    mf = odev->mix_follower;
+    if (!mf || mf->leader != adev) {
+      continue;
+    }
+    bytes = frames * mf->frame_bytes;
+    if (bytes > mf->buf->used_size) {
+      src += bytes - mf->buf->used_size;
+      bytes = mf->buf->used_size;
+    }
+    // Drop the oldest frames if the follower can't keep up.
+    if (bytes > buf_available(mf->buf)) {
+      buf_increment_read(mf->buf, bytes - buf_available(mf->buf));
+    }
+    while (bytes) {
+      uint8_t* dst = buf_write_pointer_size(mf->buf, &writable);
+      n = MIN(bytes, writable);
+      memcpy(dst, src, n);
+      buf_increment_write(mf->buf, n);
+      src += n;
+      bytes -= n;
+    }
+  }
+}
+
+/*
+ * Converts up to |frames| frames of the shared mix into |dst|. Returns the
+ * number of frames written.
+ */
+static unsigned int write_shared_mix(struct open_dev* adev,
+                                     uint8_t* dst,
+                                     unsigned int frames) {
+  struct mix_follower* mf = adev->mix_follower;
+  struct cras_iodev* odev = adev->dev;
+  unsigned int frame_bytes = cras_get_format_bytes(odev->format);
+  unsigned int dev_rate = odev->format->frame_rate;
+  unsigned int written = 0;
+  unsigned int readable, in_frames;
+  size_t out_frames;
+  uint8_t* src;
+  double new_rate;
+
+  // Without a leader the frames left are played at the last rates.
+  if (mf->leader) {
+    new_rate = dev_rate * cras_iodev_get_est_rate_ratio(odev) /
+                   cras_iodev_get_est_rate_ratio(mf->leader->dev) +
+               MIX_FOLLOWER_COARSE_RATE_STEP * adev->coarse_rate_adjust;
+    cras_fmt_conv_set_linear_resample_rates(mf->conv, dev_rate, new_rate);
+  }
+
+  while (written < frames) {
+    src = buf_read_pointer_size(mf->buf, &readable);
+    in_frames = MIN(readable / mf->frame_bytes,
+                    cras_fmt_conv_out_frames_to_in(mf->conv, frames - written));
+    if (in_frames == 0) {
+      break;
+    }
+    out_frames =
+        cras_fmt_conv_convert_frames(mf->conv, src, dst + written * frame_bytes,
+                                     &in_frames, frames - written);
+    buf_increment_read(mf->buf, in_frames * mf->frame_bytes);
+    written += out_frames;
+    if (out_frames == 0) {
+      break;
+    }
+  }
+  return written;
+}
+
+/*
+ * Moves the stream offsets of the devices sharing a mix to those of their
+ * leaders, so the frames they played are released from the streams.
+ */
+static void sync_mix_followers(struct open_dev* odev_list) {
+  struct open_dev* adev;
+  struct dev_stream* curr;
+  unsigned int leader_idx, leader_offset, offset;
+
+  DL_FOREACH (odev_list, adev) {
+    if (!adev->mix_follower || !adev->mix_follower->leader) {
+      continue;
+    }
+    leader_idx = adev->mix_follower->leader->dev->info.idx;
+    DL_FOREACH (adev->dev->streams, curr) {
+      leader_offset = cras_rstream_dev_offset(curr->stream, leader_idx);
+      offset = cras_rstream_dev_offset(curr->stream, curr->dev_id);
+      if (leader_offset > offset) {
+        cras_rstream_dev_offset_update(curr->stream, leader_offset - offset,
+                                       curr->dev_id);
+      }
+    }
+  }
+}
+
 /*
  * Counts the number of devices which are currently playing/capturing non-empty
  * audio.
@@ -571,6 +909,7 @@ static int capture_to_streams(struct open_dev* adev,
   hw_level = rc;
 
   cras_iodev_update_highest_hw_level(idev, hw_level);
+  audio_thread_health_hw_level(adev->health, hw_level);
 
   if (idev->active_node) {
     cras_trace_hw_level(idev->active_node->type, hw_level);
@@ -928,6 +1267,8 @@ int write_output_samples(struct open_dev** odevs,
   }
   ATLOG(atlog, AUDIO_THREAD_FILL_AUDIO, adev->dev->info.idx, hw_level,
         odev->min_cb_level);
+  odev->lowest_wake_hw_level = MIN(odev->lowest_wake_hw_level, hw_level);
+  audio_thread_health_hw_level(adev->health, hw_level);
 
   /* Don't request more than hardware can hold. Note that min_buffer_level
    * has been subtracted from the actual hw_level so we need to take it
@@ -959,8 +1300,15 @@ int write_output_samples(struct open_dev** odevs,
 
     // TODO(dgreid) - This assumes interleaved audio.
     dst = area->channels[0].buf;
-    unsigned int write_limit = get_write_limit(odevs, adev, frames_writeable);
-    written = write_streams(odevs, adev, dst, write_limit, frames_writeable);
+    if (plays_shared_mix(adev)) {
+      written = write_shared_mix(adev, dst, frames_writeable);
+    } else {
+      unsigned int write_limit =
+          get_write_limit(odevs, adev, frames_writeable);
+      written = write_streams(odevs, adev, dst, write_limit, frames_writeable);
+      // Followers take the mix before DSP and volume are applied in place.
+      feed_mix_followers(*odevs, adev, dst, written);
+    }
     if (written < (snd_pcm_sframes_t)frames_writeable) {
       /* Got all the samples from client that we can, but it
        * won't fill the request. */
@@ -1252,6 +1600,8 @@ int dev_io_playback_write(struct open_dev** odevs,
     }
   }
 
+  update_mix_followers(*odevs);
+
   DL_FOREACH (*odevs, adev) {
     if (!cras_iodev_is_open(adev->dev)) {
       continue;
@@ -1303,6 +1653,8 @@ int dev_io_playback_write(struct open_dev** odevs,
     }
   }
 
+  sync_mix_followers(*odevs);
+
   // TODO(dgreid) - once per rstream, not once per dev_stream.
   DL_FOREACH (*odevs, adev) {
     struct dev_stream* stream;
@@ -1513,6 +1865,18 @@ void dev_io_rm_open_dev(struct open_dev** odev_list,
 
   DL_DELETE(*odev_list, dev_to_rm);
 
+  DL_FOREACH (*odev_list, odev) {
+    if (!odev->mix_follower) {
+      continue;
+    }
+    if (odev->mix_follower->group_leader == dev_to_rm) {
+      odev->mix_follower->group_leader = NULL;
+    }
+    if (odev->mix_follower->leader == dev_to_rm) {
+      odev->mix_follower->leader = NULL;
+    }
+  }
+
   // Metrics logs the number of underruns of this device.
   cras_server_metrics_num_underruns(dev_to_rm->dev);
 
@@ -1550,6 +1914,11 @@ void dev_io_rm_open_dev(struct open_dev** odev_list,
   if (dev_to_rm->non_empty_check_pi) {
     pic_polled_interval_destroy(&dev_to_rm->non_empty_check_pi);
   }
+  if (dev_to_rm->mix_follower) {
+    mix_follower_free_buffers(dev_to_rm->mix_follower);
+    free(dev_to_rm->mix_follower);
+  }
+  audio_thread_health_rm_dev(dev_to_rm->health);
   free(dev_to_rm);
 }
 
@@ -1800,6 +2169,7 @@ int dev_io_remove_stream(struct open_dev** dev_list,
   } else {
     delete_stream_from_dev(dev, stream);
   }
+  check_mix_groups(*dev_list);
 
   return 0;
 }
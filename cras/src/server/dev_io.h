@@ -9,6 +9,8 @@
 #ifndef CRAS_SRC_SERVER_DEV_IO_H_
 #define CRAS_SRC_SERVER_DEV_IO_H_
 
+#include <stdbool.h>
+
 #include "cras/src/server/cras_iodev.h"
 #include "cras/src/server/polled_interval_checker.h"
 #include "cras_types.h"
@@ -17,6 +19,8 @@
 extern "C" {
 #endif
 
+struct mix_follower;
+
 /*
  * Open input/output devices.
  */
@@ -38,6 +42,13 @@ struct open_dev {
   // For debug purpose
   unsigned int last_get_frames;
   unsigned int last_put_frames;
+  // Where hw_level samples of the device are recorded, may be NULL.
+  struct cras_health_dev* health;
+  // Whether this output device may play the mix of another open device
+  // instead of mixing the same set of streams again.
+  bool share_mix;
+  // State kept while sharing the mix of another device, may be NULL.
+  struct mix_follower* mix_follower;
   struct open_dev *prev, *next;
 };
 
@@ -47,8 +58,20 @@ struct open_dev {
  */
 void dev_io_playback_fetch(struct open_dev* odev_list);
 
+/*
+ * Finds for each device with |share_mix| set the device whose mix it can
+ * play, and allocates what it needs to do so. Call after streams are added to
+ * or removed from the devices, so playback doesn't allocate.
+ *    odev_list - The list of open output devices.
+ */
+void dev_io_update_mix_groups(struct open_dev* odev_list);
+
 /*
  * Writes the samples fetched from the streams to the playback devices.
+ * A device with |share_mix| set whose streams are exactly those of an earlier
+ * device in the list, their main device, plays the mix of that device instead
+ * of mixing the streams itself, see dev_io_update_mix_groups(). It resamples
+ * the mix by the ratio of the two devices' estimated rates.
  *    odev_list - The list of open devices.  Devices will be removed when
  *                writing returns an error.
  */
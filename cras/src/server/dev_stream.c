@@ -33,6 +33,12 @@
  */
 static const int coarse_rate_adjust_step = 3;
 
+/*
+ * Changes of the stream volume are ramped over this duration to avoid
+ * zipper noise from stepping the gain between two buffers.
+ */
+static const unsigned int stream_volume_ramp_ms = 10;
+
 /*
  * Allow capture callback to fire this much earlier than the scheduled
  * next_cb_ts to avoid an extra wake of audio thread.
@@ -95,6 +101,8 @@ struct dev_stream* dev_stream_create(struct cras_rstream* stream,
       stream->buffer_frames, stream_fmt->frame_rate, dev_fmt->frame_rate);
 
   if (stream->direction == CRAS_STREAM_OUTPUT) {
+    out->mix_vol = cras_rstream_get_volume_scaler(stream);
+    out->mix_vol_target = out->mix_vol;
     rc = config_format_converter(&out->conv, stream->direction, stream_fmt,
                                  dev_fmt, iodev->active_node->type, max_frames);
   } else {
@@ -182,6 +190,28 @@ void dev_stream_set_dev_rate(struct dev_stream* dev_stream,
   }
 }
 
+/*
+ * Mixes |frames| frames of |src| into |dst| while the stream volume ramps
+ * from |mix_vol| to |mix_vol_target|, then advances the ramp.
+ */
+static void mix_add_ramp(struct dev_stream* dev_stream,
+                         const struct cras_audio_format* fmt,
+                         uint8_t* dst,
+                         uint8_t* src,
+                         unsigned int frames,
+                         int mute) {
+  cras_mix_add_ramp(fmt->format, dst, src, frames, mute, dev_stream->mix_vol,
+                    dev_stream->mix_vol_increment, dev_stream->mix_vol_target,
+                    fmt->num_channels);
+  if (frames >= dev_stream->mix_vol_ramp_frames) {
+    dev_stream->mix_vol = dev_stream->mix_vol_target;
+    dev_stream->mix_vol_ramp_frames = 0;
+  } else {
+    dev_stream->mix_vol += dev_stream->mix_vol_increment * frames;
+    dev_stream->mix_vol_ramp_frames -= frames;
+  }
+}
+
 int dev_stream_mix(struct dev_stream* dev_stream,
                    const struct cras_audio_format* fmt,
                    uint8_t* dst,
@@ -208,8 +238,15 @@ int dev_stream_mix(struct dev_stream* dev_stream,
 
   buffer_offset = cras_rstream_dev_offset(rstream, dev_stream->dev_id);
 
-  // Stream volume scaler.
+  // Stream volume scaler. Start a ramp to it if it changed.
   mix_vol = cras_rstream_get_volume_scaler(dev_stream->stream);
+  if (mix_vol != dev_stream->mix_vol_target) {
+    dev_stream->mix_vol_ramp_frames =
+        MAX(dev_stream->dev_rate * stream_volume_ramp_ms / 1000, 1);
+    dev_stream->mix_vol_target = mix_vol;
+    dev_stream->mix_vol_increment =
+        (mix_vol - dev_stream->mix_vol) / dev_stream->mix_vol_ramp_frames;
+  }
 
   playable_frames = cras_rstream_playable_frames(rstream, dev_stream->dev_id);
 
@@ -237,9 +274,14 @@ int dev_stream_mix(struct dev_stream* dev_stream,
       dev_frames = MIN(frames, num_to_write - fr_written);
       read_frames = dev_frames;
     }
-    num_samples = dev_frames * fmt->num_channels;
-    cras_mix_add(fmt->format, target, src, num_samples, 1,
-                 cras_rstream_get_mute(rstream), mix_vol);
+    if (dev_stream->mix_vol_ramp_frames) {
+      mix_add_ramp(dev_stream, fmt, target, src, dev_frames,
+                   cras_rstream_get_mute(rstream));
+    } else {
+      num_samples = dev_frames * fmt->num_channels;
+      cras_mix_add(fmt->format, target, src, num_samples, 1,
+                   cras_rstream_get_mute(rstream), mix_vol);
+    }
     target += dev_frames * cras_get_format_bytes(fmt);
     fr_written += dev_frames;
     fr_read += read_frames;
@@ -44,6 +44,14 @@ struct dev_stream {
   // created.
   size_t dev_rate;
   struct dev_stream *prev, *next;
+  // Stream volume scaler applied to the next frame mixed. Output only.
+  float mix_vol;
+  // Stream volume scaler |mix_vol| is ramping to.
+  float mix_vol_target;
+  // Change of |mix_vol| per frame while ramping.
+  float mix_vol_increment;
+  // Number of frames left in the ramp to |mix_vol_target|.
+  unsigned int mix_vol_ramp_frames;
   // For input stream, it should be set to true after it is added
   // into device. For output stream, it should be set to true
   // just before its first fetch to avoid affecting other existing
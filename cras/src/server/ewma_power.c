@@ -8,10 +8,17 @@
 #include <stdint.h>
 
 #include "cras/src/server/cras_audio_area.h"
+#include "cras_types.h"
 
-// One sample per 1ms.
+// One block per 1ms.
 #define EWMA_SAMPLE_RATE 1000
 
+/* Number of partial sums kept while summing squares. Independent partial
+ * sums let the compiler vectorize the loops without reassociating float
+ * additions.
+ */
+#define SUM_LANES 8
+
 /* Smooth factor for EWMA, 1 - expf(-1.0/(rate * 0.01))
  * where the 0.01 corresponds to 10ms interval that is chosen and
  * being used in Chrome for a long time.
@@ -21,6 +28,203 @@
  */
 const static float smooth_factor = 0.095;
 
+/* Sums the squares of |count| samples. The samples are not normalized, see
+ * |full_scale_squared|.
+ */
+static float sum_squares_s16_le(const int16_t* buf, unsigned int count) {
+  float sum[SUM_LANES] = {};
+  unsigned int i, j;
+
+  for (i = 0; i + SUM_LANES <= count; i += SUM_LANES) {
+    for (j = 0; j < SUM_LANES; j++) {
+      float f = (int32_t)buf[i + j];
+      sum[j] += f * f;
+    }
+  }
+  for (; i < count; i++) {
+    float f = buf[i];
+    sum[0] += f * f;
+  }
+  for (j = 1; j < SUM_LANES; j++) {
+    sum[0] += sum[j];
+  }
+  return sum[0];
+}
+
+// S24_LE samples sit in the low 24 bits, shift them up to sign extend.
+static float sum_squares_s24_le(const int32_t* buf, unsigned int count) {
+  float sum[SUM_LANES] = {};
+  unsigned int i, j;
+
+  for (i = 0; i + SUM_LANES <= count; i += SUM_LANES) {
+    for (j = 0; j < SUM_LANES; j++) {
+      float f = (int32_t)((uint32_t)buf[i + j] << 8);
+      sum[j] += f * f;
+    }
+  }
+  for (; i < count; i++) {
+    float f = (int32_t)((uint32_t)buf[i] << 8);
+    sum[0] += f * f;
+  }
+  for (j = 1; j < SUM_LANES; j++) {
+    sum[0] += sum[j];
+  }
+  return sum[0];
+}
+
+static float sum_squares_s32_le(const int32_t* buf, unsigned int count) {
+  float sum[SUM_LANES] = {};
+  unsigned int i, j;
+
+  for (i = 0; i + SUM_LANES <= count; i += SUM_LANES) {
+    for (j = 0; j < SUM_LANES; j++) {
+      float f = buf[i + j];
+      sum[j] += f * f;
+    }
+  }
+  for (; i < count; i++) {
+    float f = buf[i];
+    sum[0] += f * f;
+  }
+  for (j = 1; j < SUM_LANES; j++) {
+    sum[0] += sum[j];
+  }
+  return sum[0];
+}
+
+static float sum_squares_float_le(const float* buf, unsigned int count) {
+  float sum[SUM_LANES] = {};
+  unsigned int i, j;
+
+  for (i = 0; i + SUM_LANES <= count; i += SUM_LANES) {
+    for (j = 0; j < SUM_LANES; j++) {
+      float f = buf[i + j];
+      sum[j] += f * f;
+    }
+  }
+  for (; i < count; i++) {
+    float f = buf[i];
+    sum[0] += f * f;
+  }
+  for (j = 1; j < SUM_LANES; j++) {
+    sum[0] += sum[j];
+  }
+  return sum[0];
+}
+
+/* Returns the square of the full scale value of samples of |fmt| as seen by
+ * the sum_squares functions, or 0 if |fmt| is not supported.
+ */
+static float full_scale_squared(snd_pcm_format_t fmt) {
+  switch (fmt) {
+    case SND_PCM_FORMAT_S16_LE:
+      return 32768.0f * 32768.0f;
+    case SND_PCM_FORMAT_S24_LE:
+    case SND_PCM_FORMAT_S32_LE:
+      return 2147483648.0f * 2147483648.0f;
+    case SND_PCM_FORMAT_FLOAT_LE:
+      return 1.0f;
+    default:
+      return 0.0f;
+  }
+}
+
+// Sums the squares of |count| contiguous samples of |fmt| in |buf|.
+static float sum_squares(snd_pcm_format_t fmt,
+                         const uint8_t* buf,
+                         unsigned int count) {
+  switch (fmt) {
+    case SND_PCM_FORMAT_S16_LE:
+      return sum_squares_s16_le((const int16_t*)buf, count);
+    case SND_PCM_FORMAT_S24_LE:
+      return sum_squares_s24_le((const int32_t*)buf, count);
+    case SND_PCM_FORMAT_S32_LE:
+      return sum_squares_s32_le((const int32_t*)buf, count);
+    case SND_PCM_FORMAT_FLOAT_LE:
+      return sum_squares_float_le((const float*)buf, count);
+    default:
+      return 0.0f;
+  }
+}
+
+/* Sums the squares of the samples in |frames| interleaved frames of
+ * |num_channels| channels, skipping channels not mapped to a position in
+ * |area|.
+ */
+static float sum_squares_area(snd_pcm_format_t fmt,
+                              const uint8_t* buf,
+                              const struct cras_audio_area* area,
+                              unsigned int num_channels,
+                              unsigned int frames) {
+  unsigned int sample_bytes = snd_pcm_format_physical_width(fmt) / 8;
+  unsigned int fr, ch;
+  float sum = 0.0f;
+
+  for (fr = 0; fr < frames; fr++) {
+    for (ch = 0; ch < num_channels; ch++) {
+      if (area->channels[ch].ch_set) {
+        sum += sum_squares(fmt, buf + ch * sample_bytes, 1);
+      }
+    }
+    buf += num_channels * sample_bytes;
+  }
+  return sum;
+}
+
+static void update_power(struct ewma_power* ewma, float power) {
+  if (!ewma->power_set) {
+    ewma->power = power;
+    ewma->power_set = 1;
+  } else {
+    ewma->power = smooth_factor * power + (1 - smooth_factor) * ewma->power;
+  }
+}
+
+/* Feeds |size| interleaved frames of |num_channels| channels to |ewma|.
+ * If |area| is not NULL, only the channels mapped to a position in it are
+ * included. The power of a block is averaged over all |num_channels|
+ * channels either way.
+ */
+static void calculate(struct ewma_power* ewma,
+                      const uint8_t* buf,
+                      unsigned int num_channels,
+                      const struct cras_audio_area* area,
+                      unsigned int size) {
+  unsigned int frame_bytes, fr;
+  float inv_channels;
+
+  if (!ewma->enabled || num_channels == 0) {
+    return;
+  }
+
+  frame_bytes = snd_pcm_format_physical_width(ewma->fmt) / 8 * num_channels;
+  inv_channels = 1.0f / num_channels;
+  while (size) {
+    fr = ewma->step_fr - ewma->block_fr;
+    if (fr > size) {
+      fr = size;
+    }
+    if (area == NULL) {
+      ewma->block_sum += sum_squares(ewma->fmt, buf, fr * num_channels);
+    } else {
+      ewma->block_sum +=
+          sum_squares_area(ewma->fmt, buf, area, num_channels, fr);
+    }
+    ewma->block_fr += fr;
+    if (ewma->block_fr == ewma->step_fr) {
+      update_power(ewma, ewma->block_sum * ewma->scale * inv_channels);
+      ewma->block_sum = 0.0f;
+      ewma->block_fr = 0;
+    }
+    buf += fr * frame_bytes;
+    size -= fr;
+  }
+
+  if (ewma->meter && ewma->power_set) {
+    ewma->meter->power = ewma->power;
+  }
+}
+
 void ewma_power_disable(struct ewma_power* ewma) {
   ewma->enabled = 0;
 }
@@ -28,61 +232,43 @@ void ewma_power_disable(struct ewma_power* ewma) {
 void ewma_power_init(struct ewma_power* ewma,
                      snd_pcm_format_t fmt,
                      unsigned int rate) {
-  ewma->enabled = 1;
+  float full_scale = full_scale_squared(fmt);
+
   ewma->fmt = fmt;
   ewma->power_set = 0;
-  ewma->step_fr = rate / EWMA_SAMPLE_RATE;
+  ewma->power = 0.0f;
+  ewma->step_fr = rate >= EWMA_SAMPLE_RATE ? rate / EWMA_SAMPLE_RATE : 1;
+  ewma->block_sum = 0.0f;
+  ewma->block_fr = 0;
+  ewma->meter = NULL;
+  ewma->enabled = full_scale != 0.0f;
+  ewma->scale = ewma->enabled ? 1.0f / (full_scale * ewma->step_fr) : 0.0f;
+}
+
+void ewma_power_set_meter(struct ewma_power* ewma,
+                          struct cras_power_meter* meter) {
+  ewma->meter = meter;
 }
 
 void ewma_power_calculate(struct ewma_power* ewma,
-                          const int16_t* buf,
+                          const uint8_t* buf,
                           unsigned int channels,
                           unsigned int size) {
-  int i, ch;
-  float power, f;
-
-  if (!ewma->enabled || (ewma->fmt != SND_PCM_FORMAT_S16_LE)) {
-    return;
-  }
-  for (i = 0; i < size; i += ewma->step_fr * channels) {
-    power = 0.0f;
-    for (ch = 0; ch < channels; ch++) {
-      f = buf[i + ch] / 32768.0f;
-      power += f * f / channels;
-    }
-    if (!ewma->power_set) {
-      ewma->power = power;
-      ewma->power_set = 1;
-    } else {
-      ewma->power = smooth_factor * power + (1 - smooth_factor) * ewma->power;
-    }
-  }
+  calculate(ewma, buf, channels, NULL, size);
 }
 
 void ewma_power_calculate_area(struct ewma_power* ewma,
-                               const int16_t* buf,
+                               const uint8_t* buf,
                                struct cras_audio_area* area,
                                unsigned int size) {
-  int i, ch;
-  float power, f;
+  unsigned int ch;
 
-  if (!ewma->enabled) {
-    return;
-  }
-  for (i = 0; i < size; i += ewma->step_fr * area->num_channels) {
-    power = 0.0f;
-    for (ch = 0; ch < area->num_channels; ch++) {
-      if (area->channels[ch].ch_set == 0) {
-        continue;
-      }
-      f = buf[i + ch] / 32768.0f;
-      power += f * f / area->num_channels;
-    }
-    if (!ewma->power_set) {
-      ewma->power = power;
-      ewma->power_set = 1;
-    } else {
-      ewma->power = smooth_factor * power + (1 - smooth_factor) * ewma->power;
+  // Take the contiguous path when no channel needs to be skipped.
+  for (ch = 0; ch < area->num_channels; ch++) {
+    if (area->channels[ch].ch_set == 0) {
+      calculate(ewma, buf, area->num_channels, area, size);
+      return;
     }
   }
+  calculate(ewma, buf, area->num_channels, NULL, size);
 }
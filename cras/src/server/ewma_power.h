@@ -10,6 +10,7 @@
 #include <stdint.h>
 
 #include "cras/src/server/cras_audio_area.h"
+#include "cras_types.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -18,6 +19,10 @@ extern "C" {
 /*
  * The exponentially weighted moving average power module used to
  * calculate the energe level in audio stream.
+ *
+ * Samples are accumulated into blocks of 1ms and the mean square of each
+ * block updates the moving average, so partial blocks carry over between
+ * calls.
  */
 struct ewma_power {
   // Flag to note if the first power value has set.
@@ -27,10 +32,19 @@ struct ewma_power {
   bool enabled;
   // The power value.
   float power;
-  // How many frames to sample one for EWMA calculation.
+  // Number of frames in one block of EWMA calculation.
   unsigned int step_fr;
   // The sample format of audio data.
   snd_pcm_format_t fmt;
+  // 1 / (full scale ^ 2 * step_fr) of |fmt|, normalizing the sum of
+  // squares of a block.
+  float scale;
+  // Sum of squares of the samples in the current block.
+  float block_sum;
+  // Number of frames in the current block.
+  unsigned int block_fr;
+  // Meter in the server state to publish |power| to, or NULL.
+  struct cras_power_meter* meter;
 };
 
 /*
@@ -39,10 +53,12 @@ struct ewma_power {
 void ewma_power_disable(struct ewma_power* ewma);
 
 /*
- * Initializes the ewma_power object.
+ * Initializes the ewma_power object. The object stops publishing to any
+ * meter until ewma_power_set_meter is called again.
  * Args:
  *    ewma - The ewma_power object to initialize.
- *    fmt - The sample format of the audio data.
+ *    fmt - The sample format of the audio data. S16_LE, S24_LE, S32_LE and
+ *        FLOAT_LE are supported, other formats disable the instance.
  *    rate - The sample rate of the audio data that the ewma object
  *        will calculate power from.
  */
@@ -50,27 +66,35 @@ void ewma_power_init(struct ewma_power* ewma,
                      snd_pcm_format_t fmt,
                      unsigned int rate);
 
+/*
+ * Sets the meter in the server state that the power value is published to
+ * after each calculation. Pass NULL to stop publishing.
+ */
+void ewma_power_set_meter(struct ewma_power* ewma,
+                          struct cras_power_meter* meter);
+
 /*
  * Feeds an audio buffer to ewma_power object to calculate the
  * latest power value.
  * Args:
  *    ewma - The ewma_power object to calculate power.
- *    buf - Pointer to the audio data.
+ *    buf - Pointer to the interleaved audio data.
  *    channels - Number of channels of the audio data.
  *    size - Length in frames of the audio data.
  */
 void ewma_power_calculate(struct ewma_power* ewma,
-                          const int16_t* buf,
+                          const uint8_t* buf,
                           unsigned int channels,
                           unsigned int size);
 
 /*
- * Feeds non-interleaved audio data to ewma_power to calculate the
- * latest power value. This is similar to ewma_power_calculate but
- * accepts cras_audio_area.
+ * Feeds interleaved audio data described by a cras_audio_area to
+ * ewma_power to calculate the latest power value. This is similar to
+ * ewma_power_calculate but skips the channels that are not mapped to any
+ * position in |area|.
  */
 void ewma_power_calculate_area(struct ewma_power* ewma,
-                               const int16_t* buf,
+                               const uint8_t* buf,
                                struct cras_audio_area* area,
                                unsigned int size);
 
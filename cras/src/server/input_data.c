@@ -87,10 +87,12 @@ void input_data_set_all_streams_read(struct input_data* data,
            "All streams read %u frames exceeds %u"
            " in input_data's buffer",
            nframes, float_buffer_level(data->fbuffer));
+    data->read_frames += float_buffer_level(data->fbuffer);
     float_buffer_reset(data->fbuffer);
     return;
   }
   float_buffer_read(data->fbuffer, nframes);
+  data->read_frames += nframes;
 }
 
 /*
@@ -166,8 +168,9 @@ int input_data_get_for_stream(struct input_data* data,
     /*
      * Case 3 from above example.
      */
-    apm_processed = cras_stream_apm_process(apm, data->fbuffer, stream_offset,
-                                            preprocessing_gain_scalar);
+    apm_processed =
+        cras_stream_apm_process(apm, data->fbuffer, stream_offset,
+                                data->read_frames, preprocessing_gain_scalar);
     if (apm_processed < 0) {
       cras_stream_apm_stop(stream->stream_apm, data->idev);
       return 0;
@@ -31,6 +31,9 @@ struct input_data {
   struct cras_audio_area* area;
   // Floating point buffer from input device.
   struct float_buffer* fbuffer;
+  // Frames all streams have read out of |fbuffer|, which is the capture
+  // position of its read pointer.
+  uint64_t read_frames;
 };
 
 /*
@@ -933,6 +933,7 @@ void ewma_power_disable(struct ewma_power* ewma) {}
 
 // From audio_thread
 struct audio_thread_event_log* atlog;
+struct audio_thread_trace* atlog_trace;
 
 void audio_thread_add_events_callback(int fd,
                                       thread_callback cb,
@@ -2,18 +2,28 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <errno.h>
 #include <gtest/gtest.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "cras/src/server/cras_alert.h"
 
+static int cras_tm_create_timer_called;
+static unsigned int cras_tm_create_timer_ms;
+static void (*cras_tm_create_timer_cb)(struct cras_timer* t, void* data);
+static void* cras_tm_create_timer_cb_data;
+static int cras_tm_cancel_timer_called;
+static struct timespec clock_gettime_retspec;
+
 namespace {
 
 void callback1(void* arg, void* data);
 void callback2(void* arg, void* data);
 void prepare(struct cras_alert* alert);
+void flush(void* arg);
 
 struct cb_data_struct {
   int data;
@@ -24,8 +34,17 @@ static cb_data_struct cb1_data;
 static int cb2_called = 0;
 static int cb2_set_pending = 0;
 static int prepare_called = 0;
+static int flush_called = 0;
 
 void ResetStub() {
+  cras_tm_create_timer_called = 0;
+  cras_tm_create_timer_ms = 0;
+  cras_tm_create_timer_cb = NULL;
+  cras_tm_create_timer_cb_data = NULL;
+  cras_tm_cancel_timer_called = 0;
+  clock_gettime_retspec.tv_sec = 1;
+  clock_gettime_retspec.tv_nsec = 0;
+  flush_called = 0;
   cb1_called = 0;
   cb2_called = 0;
   cb2_set_pending = 0;
@@ -200,6 +219,98 @@ TEST_F(Alert, TwoAlerts) {
   cras_alert_destroy_all();
 }
 
+TEST_F(Alert, KeyedDataCoalescedPerKey) {
+  struct cras_alert* alert = cras_alert_create(NULL, 0);
+  struct cb_data_struct data = {1};
+  struct cb_data_struct data2 = {2};
+  struct cb_data_struct data3 = {3};
+  cras_alert_add_callback(alert, &callback1, NULL);
+  ResetStub();
+  // The second update of key 5 replaces the first, key 6 is kept.
+  cras_alert_pending_keyed_data(alert, 5, &data, sizeof(data));
+  cras_alert_pending_keyed_data(alert, 6, &data2, sizeof(data2));
+  cras_alert_pending_keyed_data(alert, 5, &data3, sizeof(data3));
+  cras_alert_process_all_pending_alerts();
+  EXPECT_EQ(2, cb1_called);
+  EXPECT_EQ(3, cb1_data.data);
+  cras_alert_destroy(alert);
+}
+
+TEST_F(Alert, MinInterval) {
+  struct cras_alert* alert = cras_alert_create(NULL, 0);
+  struct cras_tm* tm = reinterpret_cast<struct cras_tm*>(0x123);
+  struct cb_data_struct data = {1};
+  struct cb_data_struct data2 = {2};
+  cras_alert_add_callback(alert, &callback1, NULL);
+  cras_alert_set_min_interval(alert, tm, 20);
+  ResetStub();
+
+  // The first change goes out immediately.
+  cras_alert_pending_data(alert, &data, sizeof(data));
+  cras_alert_process_all_pending_alerts();
+  EXPECT_EQ(1, cb1_called);
+  EXPECT_EQ(0, cras_tm_create_timer_called);
+
+  // Changes within the interval are held back until the timer fires.
+  clock_gettime_retspec.tv_nsec = 5000000;
+  cras_alert_pending_data(alert, &data, sizeof(data));
+  cras_alert_process_all_pending_alerts();
+  cras_alert_pending_data(alert, &data2, sizeof(data2));
+  cras_alert_process_all_pending_alerts();
+  EXPECT_EQ(1, cb1_called);
+  EXPECT_EQ(1, cras_tm_create_timer_called);
+  EXPECT_EQ(15, cras_tm_create_timer_ms);
+  ASSERT_NE(nullptr, cras_tm_create_timer_cb);
+
+  clock_gettime_retspec.tv_nsec = 20000000;
+  cras_tm_create_timer_cb(NULL, cras_tm_create_timer_cb_data);
+  cras_alert_process_all_pending_alerts();
+  EXPECT_EQ(2, cb1_called);
+  EXPECT_EQ(2, cb1_data.data);
+  cras_alert_destroy(alert);
+  EXPECT_EQ(0, cras_tm_cancel_timer_called);
+}
+
+TEST_F(Alert, MinIntervalCancelOnDestroy) {
+  struct cras_alert* alert = cras_alert_create(NULL, 0);
+  struct cras_tm* tm = reinterpret_cast<struct cras_tm*>(0x123);
+  cras_alert_add_callback(alert, &callback1, NULL);
+  cras_alert_set_min_interval(alert, tm, 20);
+  ResetStub();
+
+  cras_alert_pending(alert);
+  cras_alert_process_all_pending_alerts();
+  cras_alert_pending(alert);
+  cras_alert_process_all_pending_alerts();
+  EXPECT_EQ(1, cb1_called);
+  EXPECT_EQ(1, cras_tm_create_timer_called);
+  cras_alert_destroy(alert);
+  EXPECT_EQ(1, cras_tm_cancel_timer_called);
+}
+
+TEST_F(Alert, FlushCallback) {
+  struct cras_alert* alert = cras_alert_create(NULL, 0);
+  cras_alert_add_callback(alert, &callback1, NULL);
+  ResetStub();
+  EXPECT_EQ(0, cras_alert_add_flush_callback(flush, NULL));
+  EXPECT_EQ(-EEXIST, cras_alert_add_flush_callback(flush, NULL));
+
+  // Only called after a round that processed alerts.
+  cras_alert_process_all_pending_alerts();
+  EXPECT_EQ(0, flush_called);
+  cras_alert_pending(alert);
+  cras_alert_process_all_pending_alerts();
+  EXPECT_EQ(1, cb1_called);
+  EXPECT_EQ(1, flush_called);
+
+  EXPECT_EQ(0, cras_alert_rm_flush_callback(flush, NULL));
+  EXPECT_EQ(-ENOENT, cras_alert_rm_flush_callback(flush, NULL));
+  cras_alert_pending(alert);
+  cras_alert_process_all_pending_alerts();
+  EXPECT_EQ(1, flush_called);
+  cras_alert_destroy(alert);
+}
+
 void callback1(void* arg, void* data) {
   cb1_called++;
   if (data) {
@@ -220,4 +331,33 @@ void prepare(struct cras_alert* alert) {
   return;
 }
 
+void flush(void* arg) {
+  flush_called++;
+}
+
 }  // namespace
+
+extern "C" {
+
+struct cras_timer* cras_tm_create_timer(struct cras_tm* tm,
+                                        unsigned int ms,
+                                        void (*cb)(struct cras_timer* t,
+                                                   void* data),
+                                        void* cb_data) {
+  cras_tm_create_timer_called++;
+  cras_tm_create_timer_ms = ms;
+  cras_tm_create_timer_cb = cb;
+  cras_tm_create_timer_cb_data = cb_data;
+  return reinterpret_cast<struct cras_timer*>(0x456);
+}
+
+void cras_tm_cancel_timer(struct cras_tm* tm, struct cras_timer* t) {
+  cras_tm_cancel_timer_called++;
+}
+
+int clock_gettime(clockid_t clk_id, struct timespec* tp) {
+  *tp = clock_gettime_retspec;
+  return 0;
+}
+
+}  // extern "C"
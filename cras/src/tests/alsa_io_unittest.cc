@@ -157,6 +157,8 @@ static int sys_get_max_headphone_channels_called = 0;
 static int sys_get_max_headphone_channels_return_value = 2;
 static int sys_using_default_volume_curve_for_usb_audio_device_value;
 static int cras_iodev_update_underrun_duration_called = 0;
+static unsigned int cras_iodev_frames_to_play_in_sleep_until_ret;
+static unsigned int cras_iodev_frames_to_play_in_sleep_until_wakeup_frames;
 static bool testing_channel_retry = false;
 static struct cras_board_config fake_board_config;
 
@@ -166,6 +168,8 @@ void cras_dsp_set_variable_integer(struct cras_dsp_context* ctx,
 
 void ResetStubData() {
   cras_alsa_open_called = 0;
+  cras_iodev_frames_to_play_in_sleep_until_ret = 0;
+  cras_iodev_frames_to_play_in_sleep_until_wakeup_frames = 0;
   cras_iodev_append_stream_ret = 0;
   cras_alsa_get_avail_frames_ret = 0;
   cras_alsa_get_avail_frames_avail = 0;
@@ -333,8 +337,10 @@ TEST(AlsaIoInit, DefaultNodeInternalCard) {
   EXPECT_EQ(2, cras_card_config_get_volume_curve_for_control_called);
   ASSERT_STREQ(DEFAULT, aio->common.base.active_node->name);
   ASSERT_EQ(1, aio->common.base.active_node->plugged);
-  ASSERT_EQ((void*)no_stream, (void*)aio->common.base.no_stream);
-  ASSERT_EQ((void*)is_free_running, (void*)aio->common.base.is_free_running);
+  ASSERT_EQ((void*)cras_alsa_common_no_stream,
+            (void*)aio->common.base.no_stream);
+  ASSERT_EQ((void*)cras_alsa_common_is_free_running,
+            (void*)aio->common.base.is_free_running);
   alsa_iodev_destroy((struct cras_iodev*)aio);
 
   aio = (struct alsa_io*)alsa_iodev_create_with_default_parameters(
@@ -344,8 +350,10 @@ TEST(AlsaIoInit, DefaultNodeInternalCard) {
   EXPECT_EQ(4, cras_card_config_get_volume_curve_for_control_called);
   ASSERT_STREQ(INTERNAL_SPEAKER, aio->common.base.active_node->name);
   ASSERT_EQ(1, aio->common.base.active_node->plugged);
-  ASSERT_EQ((void*)no_stream, (void*)aio->common.base.no_stream);
-  ASSERT_EQ((void*)is_free_running, (void*)aio->common.base.is_free_running);
+  ASSERT_EQ((void*)cras_alsa_common_no_stream,
+            (void*)aio->common.base.no_stream);
+  ASSERT_EQ((void*)cras_alsa_common_is_free_running,
+            (void*)aio->common.base.is_free_running);
   alsa_iodev_destroy((struct cras_iodev*)aio);
 
   aio = (struct alsa_io*)alsa_iodev_create_with_default_parameters(
@@ -356,8 +364,10 @@ TEST(AlsaIoInit, DefaultNodeInternalCard) {
   EXPECT_EQ(4, cras_card_config_get_volume_curve_for_control_called);
   ASSERT_STREQ(DEFAULT, aio->common.base.active_node->name);
   ASSERT_EQ(1, aio->common.base.active_node->plugged);
-  ASSERT_EQ((void*)no_stream, (void*)aio->common.base.no_stream);
-  ASSERT_EQ((void*)is_free_running, (void*)aio->common.base.is_free_running);
+  ASSERT_EQ((void*)cras_alsa_common_no_stream,
+            (void*)aio->common.base.no_stream);
+  ASSERT_EQ((void*)cras_alsa_common_is_free_running,
+            (void*)aio->common.base.is_free_running);
   alsa_iodev_destroy((struct cras_iodev*)aio);
 
   aio = (struct alsa_io*)alsa_iodev_create_with_default_parameters(
@@ -367,8 +377,10 @@ TEST(AlsaIoInit, DefaultNodeInternalCard) {
   EXPECT_EQ(4, cras_card_config_get_volume_curve_for_control_called);
   ASSERT_STREQ(INTERNAL_MICROPHONE, aio->common.base.active_node->name);
   ASSERT_EQ(1, aio->common.base.active_node->plugged);
-  ASSERT_EQ((void*)no_stream, (void*)aio->common.base.no_stream);
-  ASSERT_EQ((void*)is_free_running, (void*)aio->common.base.is_free_running);
+  ASSERT_EQ((void*)cras_alsa_common_no_stream,
+            (void*)aio->common.base.no_stream);
+  ASSERT_EQ((void*)cras_alsa_common_is_free_running,
+            (void*)aio->common.base.is_free_running);
   alsa_iodev_destroy((struct cras_iodev*)aio);
 }
 
@@ -384,8 +396,10 @@ TEST(AlsaIoInit, DefaultNodeHDMICard) {
   EXPECT_EQ(2, cras_card_config_get_volume_curve_for_control_called);
   ASSERT_STREQ(DEFAULT, aio->common.base.active_node->name);
   ASSERT_EQ(1, aio->common.base.active_node->plugged);
-  ASSERT_EQ((void*)no_stream, (void*)aio->common.base.no_stream);
-  ASSERT_EQ((void*)is_free_running, (void*)aio->common.base.is_free_running);
+  ASSERT_EQ((void*)cras_alsa_common_no_stream,
+            (void*)aio->common.base.no_stream);
+  ASSERT_EQ((void*)cras_alsa_common_is_free_running,
+            (void*)aio->common.base.is_free_running);
   alsa_iodev_destroy((struct cras_iodev*)aio);
 
   aio = (struct alsa_io*)alsa_iodev_create_with_default_parameters(
@@ -395,8 +409,10 @@ TEST(AlsaIoInit, DefaultNodeHDMICard) {
   EXPECT_EQ(4, cras_card_config_get_volume_curve_for_control_called);
   ASSERT_STREQ(INTERNAL_SPEAKER, aio->common.base.active_node->name);
   ASSERT_EQ(1, aio->common.base.active_node->plugged);
-  ASSERT_EQ((void*)no_stream, (void*)aio->common.base.no_stream);
-  ASSERT_EQ((void*)is_free_running, (void*)aio->common.base.is_free_running);
+  ASSERT_EQ((void*)cras_alsa_common_no_stream,
+            (void*)aio->common.base.no_stream);
+  ASSERT_EQ((void*)cras_alsa_common_is_free_running,
+            (void*)aio->common.base.is_free_running);
   alsa_iodev_destroy((struct cras_iodev*)aio);
 
   aio = (struct alsa_io*)alsa_iodev_create_with_default_parameters(
@@ -407,8 +423,10 @@ TEST(AlsaIoInit, DefaultNodeHDMICard) {
   EXPECT_EQ(4, cras_card_config_get_volume_curve_for_control_called);
   ASSERT_STREQ(DEFAULT, aio->common.base.active_node->name);
   ASSERT_EQ(1, aio->common.base.active_node->plugged);
-  ASSERT_EQ((void*)no_stream, (void*)aio->common.base.no_stream);
-  ASSERT_EQ((void*)is_free_running, (void*)aio->common.base.is_free_running);
+  ASSERT_EQ((void*)cras_alsa_common_no_stream,
+            (void*)aio->common.base.no_stream);
+  ASSERT_EQ((void*)cras_alsa_common_is_free_running,
+            (void*)aio->common.base.is_free_running);
   alsa_iodev_destroy((struct cras_iodev*)aio);
 
   aio = (struct alsa_io*)alsa_iodev_create_with_default_parameters(
@@ -418,8 +436,10 @@ TEST(AlsaIoInit, DefaultNodeHDMICard) {
   EXPECT_EQ(4, cras_card_config_get_volume_curve_for_control_called);
   ASSERT_STREQ(INTERNAL_MICROPHONE, aio->common.base.active_node->name);
   ASSERT_EQ(1, aio->common.base.active_node->plugged);
-  ASSERT_EQ((void*)no_stream, (void*)aio->common.base.no_stream);
-  ASSERT_EQ((void*)is_free_running, (void*)aio->common.base.is_free_running);
+  ASSERT_EQ((void*)cras_alsa_common_no_stream,
+            (void*)aio->common.base.no_stream);
+  ASSERT_EQ((void*)cras_alsa_common_is_free_running,
+            (void*)aio->common.base.is_free_running);
   alsa_iodev_destroy((struct cras_iodev*)aio);
 }
 
@@ -2223,7 +2243,7 @@ class AlsaFreeRunTestSuite : public testing::Test {
     fmt_.frame_rate = 48000;
     fmt_.num_channels = 2;
     aio.common.base.frames_queued = frames_queued;
-    aio.common.base.output_underrun = alsa_output_underrun;
+    aio.common.base.output_underrun = cras_alsa_common_output_underrun;
     aio.common.base.direction = CRAS_STREAM_OUTPUT;
     aio.common.base.format = &fmt_;
     aio.common.base.buffer_size = BUFFER_SIZE;
@@ -2242,11 +2262,86 @@ class AlsaFreeRunTestSuite : public testing::Test {
   struct cras_audio_format fmt_;
 };
 
+//  Test playback wake up scheduling from hardware timestamps.
+class AlsaTstampWakeTestSuite : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    ResetStubData();
+    memset(&aio, 0, sizeof(aio));
+    fmt_.format = SND_PCM_FORMAT_S16_LE;
+    fmt_.frame_rate = 48000;
+    fmt_.num_channels = 2;
+    aio.common.base.frames_queued = frames_queued;
+    aio.common.base.direction = CRAS_STREAM_OUTPUT;
+    aio.common.base.format = &fmt_;
+    aio.common.base.buffer_size = BUFFER_SIZE;
+    aio.common.base.streams = reinterpret_cast<struct dev_stream*>(0x1);
+    aio.common.policy.tstamp_wake_margin_us = 500;
+    aio.common.base.tstamp_wake_margin_frames = 24;
+  }
+
+  virtual void TearDown() {
+    clock_gettime_retspec.tv_sec = 0;
+    clock_gettime_retspec.tv_nsec = 0;
+  }
+
+  struct alsa_io aio;
+  struct cras_audio_format fmt_;
+};
+
+TEST_F(AlsaTstampWakeTestSuite, SleepCountedFromHardwareTimestamp) {
+  unsigned int hw_level;
+  struct timespec hw_tstamp;
+
+  clock_gettime_retspec.tv_sec = 10;
+  clock_gettime_retspec.tv_nsec = 5000000;
+  aio.common.hardware_timestamp.tv_sec = 10;
+  aio.common.hardware_timestamp.tv_nsec = 1000000;
+  cras_iodev_frames_to_play_in_sleep_until_ret = 1000;
+
+  EXPECT_EQ(1000, cras_alsa_common_frames_to_play_in_sleep(
+                      &aio.common.base, &hw_level, &hw_tstamp));
+  EXPECT_EQ(24, cras_iodev_frames_to_play_in_sleep_until_wakeup_frames);
+  EXPECT_EQ(10, hw_tstamp.tv_sec);
+  EXPECT_EQ(1000000, hw_tstamp.tv_nsec);
+}
+
+TEST_F(AlsaTstampWakeTestSuite, StaleHardwareTimestampIgnored) {
+  unsigned int hw_level;
+  struct timespec hw_tstamp;
+
+  clock_gettime_retspec.tv_sec = 10;
+  clock_gettime_retspec.tv_nsec = 500000000;
+  aio.common.hardware_timestamp.tv_sec = 10;
+  aio.common.hardware_timestamp.tv_nsec = 1000000;
+
+  cras_alsa_common_frames_to_play_in_sleep(&aio.common.base, &hw_level,
+                                           &hw_tstamp);
+  EXPECT_EQ(10, hw_tstamp.tv_sec);
+  EXPECT_EQ(500000000, hw_tstamp.tv_nsec);
+}
+
+TEST_F(AlsaTstampWakeTestSuite, PredictionError) {
+  struct timespec tstamp;
+
+  clock_gettime_retspec.tv_sec = 10;
+  clock_gettime_retspec.tv_nsec = 0;
+  cras_alsa_get_avail_frames_avail = BUFFER_SIZE - 4000;
+  EXPECT_EQ(4000, frames_queued(&aio.common.base, &tstamp));
+  EXPECT_EQ(0, aio.common.base.max_wake_prediction_error);
+
+  // 10ms at 48kHz consumes 480 frames, predicting hw_level 3520.
+  clock_gettime_retspec.tv_nsec = 10000000;
+  cras_alsa_get_avail_frames_avail = BUFFER_SIZE - 3500;
+  EXPECT_EQ(3500, frames_queued(&aio.common.base, &tstamp));
+  EXPECT_EQ(20, aio.common.base.max_wake_prediction_error);
+}
+
 TEST_F(AlsaFreeRunTestSuite, FillWholeBufferWithZeros) {
   int rc;
   int16_t* zeros;
 
-  rc = fill_whole_buffer_with_zeros(&aio.common.base);
+  rc = cras_alsa_common_fill_whole_buffer_with_zeros(&aio.common.base);
 
   EXPECT_EQ(aio.common.base.buffer_size, rc);
   zeros = (int16_t*)calloc(BUFFER_SIZE * 2, sizeof(*zeros));
@@ -2261,7 +2356,7 @@ TEST_F(AlsaFreeRunTestSuite, EnterFreeRunAlreadyFreeRunning) {
   // Device is in free run state, no need to fill zeros or fill whole buffer.
   aio.common.free_running = 1;
 
-  rc = no_stream(&aio.common.base, 1);
+  rc = cras_alsa_common_no_stream(&aio.common.base, 1);
 
   EXPECT_EQ(0, rc);
   EXPECT_EQ(0, cras_alsa_mmap_get_whole_buffer_called);
@@ -2281,7 +2376,7 @@ TEST_F(AlsaFreeRunTestSuite, EnterFreeRunNotDrainedYetNeedToFillZeros) {
   rc = aio.common.base.frames_queued(&aio.common.base, &hw_tstamp);
   EXPECT_EQ(200, rc);
 
-  rc = no_stream(&aio.common.base, 1);
+  rc = cras_alsa_common_no_stream(&aio.common.base, 1);
 
   EXPECT_EQ(0, rc);
   EXPECT_EQ(0, cras_alsa_mmap_get_whole_buffer_called);
@@ -2302,7 +2397,7 @@ TEST_F(AlsaFreeRunTestSuite, EnterFreeRunNotDrainedYetFillZerosExceedBuffer) {
   real_hw_level = 7000;
   cras_alsa_get_avail_frames_avail = BUFFER_SIZE - real_hw_level;
 
-  rc = no_stream(&aio.common.base, 1);
+  rc = cras_alsa_common_no_stream(&aio.common.base, 1);
 
   EXPECT_EQ(0, rc);
   EXPECT_EQ(0, cras_alsa_mmap_get_whole_buffer_called);
@@ -2324,7 +2419,7 @@ TEST_F(AlsaFreeRunTestSuite, EnterFreeRunDrained) {
   cras_alsa_get_avail_frames_avail = BUFFER_SIZE - real_hw_level;
   aio.common.filled_zeros_for_draining = 100;
 
-  rc = no_stream(&aio.common.base, 1);
+  rc = cras_alsa_common_no_stream(&aio.common.base, 1);
 
   EXPECT_EQ(0, rc);
   EXPECT_EQ(1, cras_alsa_mmap_get_whole_buffer_called);
@@ -2340,7 +2435,7 @@ TEST_F(AlsaFreeRunTestSuite, EnterFreeRunNoSamples) {
   real_hw_level = 0;
   cras_alsa_get_avail_frames_avail = BUFFER_SIZE - real_hw_level;
 
-  rc = no_stream(&aio.common.base, 1);
+  rc = cras_alsa_common_no_stream(&aio.common.base, 1);
 
   EXPECT_EQ(0, rc);
   EXPECT_EQ(1, cras_alsa_mmap_get_whole_buffer_called);
@@ -2350,10 +2445,10 @@ TEST_F(AlsaFreeRunTestSuite, EnterFreeRunNoSamples) {
 
 TEST_F(AlsaFreeRunTestSuite, IsFreeRunning) {
   aio.common.free_running = 1;
-  EXPECT_EQ(1, is_free_running(&aio.common.base));
+  EXPECT_EQ(1, cras_alsa_common_is_free_running(&aio.common.base));
 
   aio.common.free_running = 0;
-  EXPECT_EQ(0, is_free_running(&aio.common.base));
+  EXPECT_EQ(0, cras_alsa_common_is_free_running(&aio.common.base));
 }
 
 TEST_F(AlsaFreeRunTestSuite, LeaveFreeRunNotInFreeRunMoreRemain) {
@@ -2368,7 +2463,7 @@ TEST_F(AlsaFreeRunTestSuite, LeaveFreeRunNotInFreeRunMoreRemain) {
   real_hw_level = 900;
   cras_alsa_get_avail_frames_avail = BUFFER_SIZE - real_hw_level;
 
-  rc = no_stream(&aio.common.base, 0);
+  rc = cras_alsa_common_no_stream(&aio.common.base, 0);
 
   EXPECT_EQ(0, rc);
   EXPECT_EQ(1, cras_alsa_resume_appl_ptr_called);
@@ -2392,7 +2487,7 @@ TEST_F(AlsaFreeRunTestSuite, LeaveFreeRunNotInFreeRunLessRemain) {
   real_hw_level = 400;
   cras_alsa_get_avail_frames_avail = BUFFER_SIZE - real_hw_level;
 
-  rc = no_stream(&aio.common.base, 0);
+  rc = cras_alsa_common_no_stream(&aio.common.base, 0);
 
   EXPECT_EQ(0, rc);
   EXPECT_EQ(1, cras_alsa_resume_appl_ptr_called);
@@ -2411,7 +2506,7 @@ TEST_F(AlsaFreeRunTestSuite, LeaveFreeRunInFreeRun) {
   aio.common.filled_zeros_for_draining = 100;
   aio.common.base.min_buffer_level = 512;
 
-  rc = no_stream(&aio.common.base, 0);
+  rc = cras_alsa_common_no_stream(&aio.common.base, 0);
 
   EXPECT_EQ(0, rc);
   EXPECT_EQ(1, cras_alsa_resume_appl_ptr_called);
@@ -2430,7 +2525,7 @@ TEST_F(AlsaFreeRunTestSuite, OutputUnderrun) {
   snd_pcm_uframes_t offset;
 
   // Ask alsa_io to handle output underrun.
-  rc = alsa_output_underrun(&aio.common.base);
+  rc = cras_alsa_common_output_underrun(&aio.common.base);
   EXPECT_EQ(aio.common.base.buffer_size, rc);
   EXPECT_EQ(1, cras_iodev_update_underrun_duration_called);
 
@@ -3220,6 +3315,23 @@ int cras_iodev_frames_queued(struct cras_iodev* iodev,
   return cras_iodev_frames_queued_ret;
 }
 
+unsigned int cras_iodev_default_frames_to_play_in_sleep(
+    struct cras_iodev* odev,
+    unsigned int* hw_level,
+    struct timespec* hw_tstamp) {
+  return 0;
+}
+
+unsigned int cras_iodev_frames_to_play_in_sleep_until(
+    struct cras_iodev* odev,
+    unsigned int* hw_level,
+    struct timespec* hw_tstamp,
+    unsigned int wakeup_frames) {
+  cras_iodev_frames_to_play_in_sleep_until_wakeup_frames = wakeup_frames;
+  clock_gettime(CLOCK_MONOTONIC_RAW, hw_tstamp);
+  return cras_iodev_frames_to_play_in_sleep_until_ret;
+}
+
 int cras_iodev_buffer_avail(struct cras_iodev* iodev, unsigned hw_level) {
   return cras_iodev_buffer_avail_ret;
 }
@@ -3347,6 +3459,10 @@ int cras_system_get_speaker_output_latency_offset_ms() {
   return 0;
 }
 
+int cras_system_get_tstamp_wake_margin_us() {
+  return 0;
+}
+
 bool cras_iodev_list_get_dsp_nc_allowed() {
   return false;
 }
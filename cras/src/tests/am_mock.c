@@ -3,6 +3,7 @@
  * found in the LICENSE file.
  */
 
+#include <pthread.h>
 #include <stddef.h>
 #include <stdlib.h>
 
@@ -12,6 +13,17 @@ struct am_context {
   int16_t fake_output_value;
 };
 
+// Held by am_mock_block to make am_process wait until am_mock_unblock.
+static pthread_mutex_t am_mock_gate = PTHREAD_MUTEX_INITIALIZER;
+
+void am_mock_block() {
+  pthread_mutex_lock(&am_mock_gate);
+}
+
+void am_mock_unblock() {
+  pthread_mutex_unlock(&am_mock_gate);
+}
+
 struct am_context* am_new(const char* model_path) {
   struct am_context* am =
       (struct am_context*)calloc(1, sizeof(struct am_context));
@@ -19,6 +31,12 @@ struct am_context* am_new(const char* model_path) {
   return am;
 }
 
+struct am_context* am_new_with_options(const char* model_path,
+                                       size_t num_threads,
+                                       bool use_xnnpack) {
+  return am_new(model_path);
+}
+
 void am_free(struct am_context* am) {
   free(am);
 }
@@ -47,6 +65,9 @@ int am_process(struct am_context* am,
                size_t num_inputs,
                float* outputs,
                size_t num_outputs) {
+  pthread_mutex_lock(&am_mock_gate);
+  pthread_mutex_unlock(&am_mock_gate);
+
   for (int i = 0; i < num_outputs; ++i) {
     outputs[i] = am->fake_output_value / 32768.f;
   }
@@ -0,0 +1,174 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "cras/src/server/audio_thread_health.h"
+#include "cras_types.h"
+
+namespace {
+
+static struct timespec time_now;
+
+static void set_time_us(uint64_t us) {
+  time_now.tv_sec = us / 1000000;
+  time_now.tv_nsec = (us % 1000000) * 1000;
+}
+
+class AudioThreadHealthTestSuite : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    set_time_us(1000000);
+    audio_thread_health_init(&health_);
+  }
+
+  virtual void TearDown() { audio_thread_health_init(NULL); }
+
+  struct cras_audio_thread_health health_;
+};
+
+TEST(AudioThreadHealthHistogram, Buckets) {
+  struct cras_health_histogram hist;
+
+  memset(&hist, 0, sizeof(hist));
+  cras_health_histogram_add(&hist, 0);
+  cras_health_histogram_add(&hist, 1);
+  cras_health_histogram_add(&hist, 2);
+  cras_health_histogram_add(&hist, 3);
+  cras_health_histogram_add(&hist, 1024);
+  cras_health_histogram_add(&hist, UINT32_MAX);
+
+  EXPECT_EQ(1, hist.buckets[0]);
+  EXPECT_EQ(1, hist.buckets[1]);
+  // [2, 4)
+  EXPECT_EQ(2, hist.buckets[2]);
+  // [1024, 2048)
+  EXPECT_EQ(1, hist.buckets[11]);
+  // Values past the last bucket are clamped into it.
+  EXPECT_EQ(1, hist.buckets[CRAS_HEALTH_HISTOGRAM_BUCKETS - 1]);
+  EXPECT_EQ(6, hist.count);
+  EXPECT_EQ(UINT32_MAX, hist.max);
+  EXPECT_EQ(1030ULL + UINT32_MAX, hist.sum);
+}
+
+TEST_F(AudioThreadHealthTestSuite, RecordsWakeUps) {
+  struct timespec dsp_start;
+  struct cras_health_dev* dev;
+
+  dev = audio_thread_health_add_dev(5, CRAS_STREAM_OUTPUT);
+  ASSERT_TRUE(dev);
+
+  audio_thread_health_wake();
+  set_time_us(1000100);
+  audio_thread_health_dsp_start(&dsp_start);
+  set_time_us(1000130);
+  audio_thread_health_dsp_done(&dsp_start);
+  audio_thread_health_hw_level(dev, 480);
+  audio_thread_health_hw_level(dev, 240);
+  set_time_us(1000200);
+  audio_thread_health_sleep();
+
+  ASSERT_EQ(1, health_.num_wakes);
+  EXPECT_EQ(1, health_.wakes[0].wake_ts.tv_sec);
+  EXPECT_EQ(0, health_.wakes[0].wake_ts.tv_nsec);
+  EXPECT_EQ(200, health_.wakes[0].run_us);
+  EXPECT_EQ(30, health_.wakes[0].dsp_us);
+  EXPECT_EQ(240, health_.wakes[0].min_hw_level);
+  EXPECT_EQ(5, health_.wakes[0].min_hw_level_dev_idx);
+  EXPECT_EQ(1, health_.run_us.count);
+  EXPECT_EQ(200, health_.run_us.max);
+  EXPECT_EQ(1, health_.dsp_us.count);
+  EXPECT_EQ(2, health_.devs[0].hw_level.count);
+  EXPECT_EQ(480, health_.devs[0].hw_level.max);
+
+  // A wake up without samples records no hw_level.
+  audio_thread_health_wake();
+  audio_thread_health_sleep();
+  ASSERT_EQ(2, health_.num_wakes);
+  EXPECT_EQ(0, health_.wakes[1].dsp_us);
+  EXPECT_EQ(UINT32_MAX, health_.wakes[1].min_hw_level);
+}
+
+TEST_F(AudioThreadHealthTestSuite, WakeRecordsWrap) {
+  unsigned int i;
+
+  for (i = 0; i < CRAS_HEALTH_WAKE_RECORDS + 3; i++) {
+    set_time_us(2000000 + i * 10);
+    audio_thread_health_wake();
+    set_time_us(2000000 + i * 10 + i);
+    audio_thread_health_sleep();
+  }
+  EXPECT_EQ(CRAS_HEALTH_WAKE_RECORDS + 3, health_.num_wakes);
+  // The oldest records are overwritten.
+  EXPECT_EQ(CRAS_HEALTH_WAKE_RECORDS + 2, health_.wakes[2].run_us);
+  EXPECT_EQ(3, health_.wakes[3].run_us);
+}
+
+TEST_F(AudioThreadHealthTestSuite, DevSlots) {
+  struct cras_health_dev* devs[CRAS_HEALTH_MAX_DEVS];
+  struct cras_health_dev* dev;
+  unsigned int i;
+
+  for (i = 0; i < CRAS_HEALTH_MAX_DEVS; i++) {
+    devs[i] = audio_thread_health_add_dev(10 + i, CRAS_STREAM_INPUT);
+    ASSERT_TRUE(devs[i]);
+  }
+  // All slots are in use, sampling the device is a no-op.
+  dev = audio_thread_health_add_dev(100, CRAS_STREAM_INPUT);
+  EXPECT_EQ(NULL, dev);
+  audio_thread_health_hw_level(dev, 10);
+  audio_thread_health_rm_dev(dev);
+
+  audio_thread_health_hw_level(devs[1], 10);
+  audio_thread_health_rm_dev(devs[1]);
+  // The samples of the closed device stay until the slot is reused.
+  EXPECT_EQ(0, health_.devs[1].open);
+  EXPECT_EQ(11, health_.devs[1].dev_idx);
+  EXPECT_EQ(1, health_.devs[1].hw_level.count);
+
+  dev = audio_thread_health_add_dev(100, CRAS_STREAM_OUTPUT);
+  EXPECT_EQ(&health_.devs[1], dev);
+  EXPECT_EQ(1, dev->open);
+  EXPECT_EQ(100, dev->dev_idx);
+  EXPECT_EQ(CRAS_STREAM_OUTPUT, dev->direction);
+  EXPECT_EQ(0, dev->hw_level.count);
+}
+
+TEST_F(AudioThreadHealthTestSuite, StreamReplied) {
+  struct timespec requested = {.tv_sec = 0, .tv_nsec = 500000};
+  struct timespec never = {};
+
+  audio_thread_health_stream_replied(&requested);
+  audio_thread_health_stream_replied(&never);
+  EXPECT_EQ(1, health_.stream_cb_us.count);
+  EXPECT_EQ(999500, health_.stream_cb_us.max);
+}
+
+TEST(AudioThreadHealthDisabled, NoOps) {
+  struct timespec start;
+
+  audio_thread_health_init(NULL);
+  EXPECT_EQ(NULL, audio_thread_health_add_dev(1, CRAS_STREAM_OUTPUT));
+  audio_thread_health_wake();
+  audio_thread_health_dsp_start(&start);
+  EXPECT_EQ(0, start.tv_sec);
+  EXPECT_EQ(0, start.tv_nsec);
+  audio_thread_health_dsp_done(&start);
+  audio_thread_health_sleep();
+}
+
+}  // namespace
+
+// Stubs
+extern "C" {
+
+int clock_gettime(clockid_t clk_id, struct timespec* tp) {
+  *tp = time_now;
+  return 0;
+}
+
+}  // extern "C"
@@ -147,7 +147,7 @@ int cras_main_message_add_handler(enum CRAS_MAIN_MESSAGE_TYPE type,
   return 0;
 }
 
-int cras_main_message_send(struct cras_main_message* msg) {
+int cras_main_message_send_from_audio(struct cras_main_message* msg) {
   message = *(struct cras_audio_thread_event_message*)msg;
   return 0;
 }
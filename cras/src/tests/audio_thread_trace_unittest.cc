@@ -0,0 +1,185 @@
+// Copyright 2024 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <map>
+#include <thread>
+#include <vector>
+
+#include "cras/src/server/audio_thread_log.h"
+
+extern "C" {
+#include "cras/src/server/audio_thread_trace.c"
+
+struct audio_thread_event_log* atlog;
+int atlog_rw_shm_fd;
+int atlog_ro_shm_fd;
+}
+
+namespace {
+
+struct ParsedTrace {
+  struct audio_thread_trace_header header;
+  // Events and dropped event counts per thread id.
+  std::map<uint32_t, std::vector<struct audio_thread_event>> events;
+  std::map<uint32_t, uint64_t> dropped;
+};
+
+class AudioThreadTraceTestSuite : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    log_ = (struct audio_thread_event_log*)calloc(1, sizeof(*log_));
+    file_ = tmpfile();
+    ASSERT_NE(file_, nullptr);
+  }
+
+  virtual void TearDown() {
+    audio_thread_trace_stop();
+    fclose(file_);
+    free(log_);
+  }
+
+  int StartTrace() { return audio_thread_trace_start(dup(fileno(file_))); }
+
+  void ReadTrace(struct ParsedTrace* trace) {
+    struct audio_thread_trace_record rec;
+
+    rewind(file_);
+    ASSERT_EQ(fread(&trace->header, sizeof(trace->header), 1, file_), 1u);
+    while (fread(&rec, sizeof(rec), 1, file_) == 1) {
+      if (rec.type == AUDIO_THREAD_TRACE_OVERFLOW) {
+        trace->dropped[rec.tid] += rec.count;
+        continue;
+      }
+      ASSERT_EQ(rec.type, AUDIO_THREAD_TRACE_EVENTS);
+      std::vector<struct audio_thread_event>& events = trace->events[rec.tid];
+      size_t offset = events.size();
+      events.resize(offset + rec.count);
+      ASSERT_EQ(fread(&events[offset], sizeof(events[0]), rec.count, file_),
+                rec.count);
+    }
+  }
+
+  struct audio_thread_event_log* log_;
+  FILE* file_;
+};
+
+TEST_F(AudioThreadTraceTestSuite, NotTracing) {
+  audio_thread_event_log_data(log_, AUDIO_THREAD_WAKE, 1, 2, 3);
+  EXPECT_EQ(log_->write_pos, 1u);
+  EXPECT_EQ(atlog_trace, nullptr);
+  audio_thread_trace_stop();
+}
+
+TEST_F(AudioThreadTraceTestSuite, TraceEvents) {
+  struct ParsedTrace trace;
+  uint32_t tid = syscall(SYS_gettid);
+
+  ASSERT_EQ(StartTrace(), 0);
+  EXPECT_NE(atlog_trace, nullptr);
+  for (uint32_t i = 0; i < 100; i++) {
+    audio_thread_event_log_data(log_, AUDIO_THREAD_WAKE, i, 2, 3);
+  }
+  audio_thread_trace_stop();
+  EXPECT_EQ(atlog_trace, nullptr);
+  // Not traced after stop.
+  audio_thread_event_log_data(log_, AUDIO_THREAD_SLEEP, 0, 0, 0);
+
+  ReadTrace(&trace);
+  EXPECT_EQ(trace.header.magic, AUDIO_THREAD_TRACE_MAGIC);
+  EXPECT_EQ(trace.header.version, AUDIO_THREAD_TRACE_VERSION);
+  ASSERT_EQ(trace.events.size(), 1u);
+  ASSERT_EQ(trace.events[tid].size(), 100u);
+  for (uint32_t i = 0; i < 100; i++) {
+    EXPECT_EQ(trace.events[tid][i].tag_sec >> 24, AUDIO_THREAD_WAKE);
+    EXPECT_EQ(trace.events[tid][i].data1, i);
+    EXPECT_EQ(trace.events[tid][i].data3, 3u);
+  }
+  EXPECT_EQ(trace.dropped.size(), 0u);
+}
+
+TEST_F(AudioThreadTraceTestSuite, AlreadyTracing) {
+  ASSERT_EQ(StartTrace(), 0);
+  EXPECT_EQ(StartTrace(), -EBUSY);
+  audio_thread_trace_stop();
+  // Can be restarted after stop.
+  EXPECT_EQ(StartTrace(), 0);
+}
+
+TEST_F(AudioThreadTraceTestSuite, OverflowIsCounted) {
+  struct ParsedTrace trace;
+  uint32_t tid = syscall(SYS_gettid);
+  const uint64_t num_events = 4 * TRACE_RING_SIZE;
+
+  ASSERT_EQ(StartTrace(), 0);
+  for (uint64_t i = 0; i < num_events; i++) {
+    audio_thread_event_log_data(log_, AUDIO_THREAD_WAKE, i, 0, 0);
+  }
+  audio_thread_trace_stop();
+
+  // Depending on how fast the writer drains, events may be dropped but all
+  // of them are accounted for, in order.
+  ReadTrace(&trace);
+  EXPECT_EQ(trace.events[tid].size() + trace.dropped[tid], num_events);
+  for (size_t i = 1; i < trace.events[tid].size(); i++) {
+    EXPECT_LT(trace.events[tid][i - 1].data1, trace.events[tid][i].data1);
+  }
+}
+
+TEST_F(AudioThreadTraceTestSuite, RingPerThread) {
+  struct ParsedTrace trace;
+  uint32_t other_tid = 0;
+
+  ASSERT_EQ(StartTrace(), 0);
+  audio_thread_event_log_data(log_, AUDIO_THREAD_WAKE, 1, 0, 0);
+  std::thread other([&] {
+    struct audio_thread_event_log* log =
+        (struct audio_thread_event_log*)calloc(1, sizeof(*log));
+    other_tid = syscall(SYS_gettid);
+    audio_thread_event_log_data(log, AUDIO_THREAD_SLEEP, 2, 0, 0);
+    audio_thread_event_log_data(log, AUDIO_THREAD_SLEEP, 3, 0, 0);
+    free(log);
+  });
+  other.join();
+  audio_thread_trace_stop();
+
+  ReadTrace(&trace);
+  ASSERT_EQ(trace.events.size(), 2u);
+  ASSERT_EQ(trace.events[other_tid].size(), 2u);
+  EXPECT_EQ(trace.events[other_tid][1].data1, 3u);
+  EXPECT_EQ(trace.events[syscall(SYS_gettid)].size(), 1u);
+}
+
+TEST_F(AudioThreadTraceTestSuite, StaleLoggerAfterRestart) {
+  struct ParsedTrace parsed;
+  struct audio_thread_trace* stale;
+  uint32_t tid = syscall(SYS_gettid);
+
+  ASSERT_EQ(StartTrace(), 0);
+  audio_thread_event_log_data(log_, AUDIO_THREAD_WAKE, 0, 0, 0);
+  stale = atlog_trace;
+  audio_thread_trace_stop();
+  fclose(file_);
+  file_ = tmpfile();
+  ASSERT_NE(file_, nullptr);
+
+  // A logger which loaded the trace before it was stopped drops its event
+  // instead of writing to the rings reset by the next start.
+  stale->log(stale, AUDIO_THREAD_SLEEP << 24, 0, 1, 0, 0);
+  EXPECT_EQ(trace->rings[0].write_pos, 1u);
+  ASSERT_EQ(StartTrace(), 0);
+  audio_thread_event_log_data(log_, AUDIO_THREAD_WAKE, 2, 0, 0);
+  audio_thread_trace_stop();
+
+  ReadTrace(&parsed);
+  ASSERT_EQ(parsed.events[tid].size(), 1u);
+  EXPECT_EQ(parsed.events[tid][0].data1, 2u);
+  EXPECT_EQ(parsed.dropped.size(), 0u);
+}
+
+}  // namespace
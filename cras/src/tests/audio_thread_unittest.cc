@@ -61,6 +61,10 @@ static std::map<const struct dev_stream*, struct timespec>
     dev_stream_wake_time_val;
 static int cras_device_monitor_set_device_mute_state_called;
 static int cras_iodev_is_zero_volume_ret;
+static int config_format_converter_called;
+static int cras_fmt_conv_convert_frames_called;
+static unsigned int cras_fmt_conv_convert_frames_in_left;
+static int cras_iodev_force_all_streams_read_called;
 
 void ResetGlobalStubData() {
   cras_rstream_dev_offset_called = 0;
@@ -103,6 +107,10 @@ void ResetGlobalStubData() {
   cras_iodev_start_ramp_request = CRAS_IODEV_RAMP_REQUEST_UP_START_PLAYBACK;
   cras_device_monitor_set_device_mute_state_called = 0;
   cras_iodev_is_zero_volume_ret = 0;
+  config_format_converter_called = 0;
+  cras_fmt_conv_convert_frames_called = 0;
+  cras_fmt_conv_convert_frames_in_left = UINT_MAX;
+  cras_iodev_force_all_streams_read_called = 0;
   clock_gettime_retspec.tv_sec = 0;
   clock_gettime_retspec.tv_nsec = 0;
   dev_stream_wake_time_val.clear();
@@ -996,6 +1004,92 @@ TEST_F(StreamDeviceSuite, DoPlaybackSevereUnderrun) {
   TearDownRstream(&rstream);
 }
 
+TEST_F(StreamDeviceSuite, DoPlaybackSharesMixOfMainDevice) {
+  struct cras_iodev iodev, iodev2;
+  struct cras_iodev* iodevs[] = {&iodev, &iodev2};
+  struct cras_rstream rstream;
+  struct cras_rstream* streams[] = {&rstream};
+  struct cras_audio_format fmt = {
+      .format = SND_PCM_FORMAT_S16_LE,
+      .frame_rate = 48000,
+      .num_channels = 2,
+  };
+  struct open_dev* adev;
+
+  ResetGlobalStubData();
+
+  SetupDevice(&iodev, CRAS_STREAM_OUTPUT);
+  SetupDevice(&iodev2, CRAS_STREAM_OUTPUT);
+  iodev.format = &fmt;
+  iodev2.format = &fmt;
+  SetupRstream(&rstream, CRAS_STREAM_OUTPUT);
+  rstream.main_dev.dev_id = iodev.info.idx;
+  rstream.main_dev.dev_ptr = &iodev;
+
+  cras_iodev_get_output_buffer_area = cras_audio_area_create(2);
+
+  thread_add_open_dev(thread_, &iodev);
+  thread_add_open_dev(thread_, &iodev2);
+  thread_add_streams(thread_, streams, 1, iodevs, 2);
+  dev_stream_set_running(iodev.streams);
+  dev_stream_set_running(iodev2.streams);
+
+  cras_iodev_prepare_output_before_write_samples_state =
+      CRAS_IODEV_STATE_NORMAL_RUN;
+  dev_stream_playback_frames_ret = 100;
+  cras_iodev_all_streams_written_ret = 100;
+  frames_queued_ = 480;
+
+  // Without sharing, each device mixes the stream.
+  dev_io_playback_write(&thread_->open_devs[CRAS_STREAM_OUTPUT], nullptr);
+  EXPECT_EQ(2, dev_stream_mix_called);
+  EXPECT_EQ(0, config_format_converter_called);
+
+  // The second device plays the mix of the main device of the stream. What
+  // it needs is allocated when the group is set up, not while playing.
+  adev = thread_->open_devs[CRAS_STREAM_OUTPUT]->next;
+  adev->share_mix = true;
+  dev_io_update_mix_groups(thread_->open_devs[CRAS_STREAM_OUTPUT]);
+  EXPECT_EQ(1, config_format_converter_called);
+  cras_rstream_dev_offset_ret[0] = 100;
+  dev_io_playback_write(&thread_->open_devs[CRAS_STREAM_OUTPUT], nullptr);
+  EXPECT_EQ(3, dev_stream_mix_called);
+  EXPECT_EQ(1, config_format_converter_called);
+  EXPECT_EQ(1, cras_iodev_force_all_streams_read_called);
+  EXPECT_EQ(1, cras_fmt_conv_convert_frames_called);
+  EXPECT_EQ(4, cras_iodev_put_output_buffer_called);
+  EXPECT_EQ(100, cras_iodev_put_output_buffer_nframes);
+
+  // Its stream offset follows the main device.
+  ASSERT_EQ(1, cras_rstream_dev_offset_update_called);
+  EXPECT_EQ(&rstream, cras_rstream_dev_offset_update_rstream_val[0]);
+  EXPECT_EQ(100, cras_rstream_dev_offset_update_frames_val[0]);
+
+  // Leave part of the next shared mix unplayed.
+  cras_fmt_conv_convert_frames_in_left = 60;
+  dev_io_playback_write(&thread_->open_devs[CRAS_STREAM_OUTPUT], nullptr);
+  EXPECT_EQ(4, dev_stream_mix_called);
+  EXPECT_EQ(1, config_format_converter_called);
+  cras_fmt_conv_convert_frames_in_left = UINT_MAX;
+
+  // Once the main device is gone, it plays the rest of the shared mix.
+  thread_rm_open_dev(thread_, CRAS_STREAM_OUTPUT, iodev.info.idx);
+  cras_fmt_conv_convert_frames_called = 0;
+  cras_iodev_put_output_buffer_nframes = 0;
+  dev_io_playback_write(&thread_->open_devs[CRAS_STREAM_OUTPUT], nullptr);
+  EXPECT_EQ(4, dev_stream_mix_called);
+  EXPECT_EQ(1, cras_fmt_conv_convert_frames_called);
+  EXPECT_EQ(40, cras_iodev_put_output_buffer_nframes);
+
+  // Then it mixes the stream again.
+  dev_io_playback_write(&thread_->open_devs[CRAS_STREAM_OUTPUT], nullptr);
+  EXPECT_EQ(5, dev_stream_mix_called);
+  EXPECT_EQ(1, cras_fmt_conv_convert_frames_called);
+
+  thread_rm_open_dev(thread_, CRAS_STREAM_OUTPUT, iodev2.info.idx);
+  TearDownRstream(&rstream);
+}
+
 TEST(AudioThreadStreams, DrainStream) {
   struct cras_rstream rstream;
   struct cras_audio_shm_header* shm_header;
@@ -1044,6 +1138,8 @@ TEST(BusyloopDetectSuite, CheckerTest) {
 
 extern "C" {
 
+struct audio_thread_trace* atlog_trace;
+
 int cras_iodev_add_stream(struct cras_iodev* iodev, struct dev_stream* stream) {
   DL_APPEND(iodev->streams, stream);
   return 0;
@@ -1163,6 +1259,43 @@ int cras_iodev_get_dsp_delay(const struct cras_iodev* iodev) {
 
 void cras_fmt_conv_destroy(struct cras_fmt_conv** conv) {}
 
+int config_format_converter(struct cras_fmt_conv** conv,
+                            enum CRAS_STREAM_DIRECTION dir,
+                            const struct cras_audio_format* from,
+                            const struct cras_audio_format* to,
+                            enum CRAS_NODE_TYPE node_type,
+                            unsigned int frames) {
+  config_format_converter_called++;
+  *conv = reinterpret_cast<struct cras_fmt_conv*>(0x123);
+  return 0;
+}
+
+size_t cras_fmt_conv_convert_frames(struct cras_fmt_conv* conv,
+                                    const uint8_t* in_buf,
+                                    uint8_t* out_buf,
+                                    unsigned int* in_frames,
+                                    size_t out_frames) {
+  cras_fmt_conv_convert_frames_called++;
+  *in_frames = MIN(MIN(*in_frames, out_frames),
+                   cras_fmt_conv_convert_frames_in_left);
+  cras_fmt_conv_convert_frames_in_left -= *in_frames;
+  return *in_frames;
+}
+
+size_t cras_fmt_conv_out_frames_to_in(struct cras_fmt_conv* conv,
+                                      size_t out_frames) {
+  return out_frames;
+}
+
+void cras_fmt_conv_set_linear_resample_rates(struct cras_fmt_conv* conv,
+                                             float from,
+                                             float to) {}
+
+void cras_iodev_force_all_streams_read(struct cras_iodev* iodev,
+                                       unsigned int read_limit) {
+  cras_iodev_force_all_streams_read_called++;
+}
+
 struct cras_fmt_conv* cras_channel_remix_conv_create(unsigned int num_channels,
                                                      const float* coefficient) {
   return NULL;
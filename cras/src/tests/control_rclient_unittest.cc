@@ -38,6 +38,9 @@ static int cras_system_set_capture_mute_called;
 static size_t cras_system_set_capture_mute_locked_value;
 static int cras_system_set_capture_mute_locked_called;
 static int cras_system_state_dump_snapshots_called;
+static int audio_thread_trace_start_called;
+static int audio_thread_trace_start_fd;
+static int audio_thread_trace_stop_called;
 static size_t cras_make_fd_nonblocking_called;
 static audio_thread* iodev_get_thread_return;
 static int stream_list_add_stream_return;
@@ -58,8 +61,18 @@ static struct cras_observer_ops cras_observer_ops_are_empty_empty_ops;
 static size_t cras_observer_remove_called;
 static struct packet_status_logger wbs_logger;
 
+static size_t cras_alert_add_flush_callback_called;
+static cras_alert_flush_cb cras_alert_add_flush_callback_cb;
+static size_t cras_alert_rm_flush_callback_called;
+
 void ResetStubData() {
+  cras_alert_add_flush_callback_called = 0;
+  cras_alert_add_flush_callback_cb = NULL;
+  cras_alert_rm_flush_callback_called = 0;
   cras_rstream_create_return = 0;
+  audio_thread_trace_start_called = 0;
+  audio_thread_trace_start_fd = -1;
+  audio_thread_trace_stop_called = 0;
   cras_rstream_create_stream_out = (struct cras_rstream*)NULL;
   cras_iodev_attach_stream_retval = 0;
   cras_system_set_volume_value = 0;
@@ -412,6 +425,30 @@ TEST_F(RClientMessagesSuite, DumpSnapshots) {
   EXPECT_EQ(1, cras_system_state_dump_snapshots_called);
 }
 
+TEST_F(RClientMessagesSuite, SetAtlogTrace) {
+  struct cras_set_atlog_trace msg;
+  int trace_fds[2];
+  int rc;
+
+  ASSERT_EQ(0, pipe(trace_fds));
+  cras_fill_set_atlog_trace_message(&msg, 1);
+  rc = rclient_->ops->handle_message_from_client(rclient_, &msg.header,
+                                                 &trace_fds[1], 1);
+  EXPECT_EQ(0, rc);
+  EXPECT_EQ(1, audio_thread_trace_start_called);
+  EXPECT_EQ(trace_fds[1], audio_thread_trace_start_fd);
+
+  cras_fill_set_atlog_trace_message(&msg, 0);
+  rc =
+      rclient_->ops->handle_message_from_client(rclient_, &msg.header, NULL, 0);
+  EXPECT_EQ(0, rc);
+  EXPECT_EQ(1, audio_thread_trace_start_called);
+  EXPECT_EQ(1, audio_thread_trace_stop_called);
+
+  close(trace_fds[0]);
+  close(trace_fds[1]);
+}
+
 void RClientMessagesSuite::RegisterNotification(
     enum CRAS_CLIENT_MESSAGE_ID msg_id,
     void* callback,
@@ -681,6 +718,92 @@ TEST_F(RClientMessagesSuite, SendNumActiveStreamsChanged) {
   EXPECT_EQ(msg->num_active_streams, num_active_streams);
 }
 
+TEST_F(RClientMessagesSuite, NotificationBatch) {
+  void* void_client = reinterpret_cast<void*>(rclient_);
+  struct cras_register_notification reg;
+  struct cras_client_notification_batch batch;
+  struct cras_client_volume_changed* volume;
+  struct cras_client_node_value_changed* gain;
+  ssize_t rc;
+  int i;
+
+  cras_fill_register_notification_message(&reg, CRAS_CLIENT_NOTIFICATION_BATCH,
+                                          1);
+  rc =
+      rclient_->ops->handle_message_from_client(rclient_, &reg.header, NULL, 0);
+  EXPECT_EQ(0, rc);
+  EXPECT_EQ(1, cras_alert_add_flush_callback_called);
+  ASSERT_NE(nullptr, cras_alert_add_flush_callback_cb);
+  EXPECT_EQ(0, cras_observer_get_ops_called);
+
+  // Nothing is sent until the alerts are flushed.
+  send_output_volume_changed(void_client, 90);
+  send_input_node_gain_changed(void_client, 0x10002, -20);
+  cras_alert_add_flush_callback_cb(NULL);
+  rc = read(pipe_fds_[0], &batch, sizeof(batch));
+  ASSERT_EQ((ssize_t)(sizeof(batch.header) + sizeof(*volume) + sizeof(*gain)),
+            rc);
+  EXPECT_EQ(CRAS_CLIENT_NOTIFICATION_BATCH, batch.header.id);
+  EXPECT_EQ(rc, batch.header.length);
+  volume = reinterpret_cast<struct cras_client_volume_changed*>(batch.msgs);
+  EXPECT_EQ(CRAS_CLIENT_OUTPUT_VOLUME_CHANGED, volume->header.id);
+  EXPECT_EQ(90, volume->volume);
+  gain = reinterpret_cast<struct cras_client_node_value_changed*>(
+      batch.msgs + sizeof(*volume));
+  EXPECT_EQ(CRAS_CLIENT_INPUT_NODE_GAIN_CHANGED, gain->header.id);
+  EXPECT_EQ(0x10002, gain->node_id);
+  EXPECT_EQ(-20, gain->value);
+
+  // A full batch is sent before adding more.
+  for (i = 0; sizeof(batch.header) + (i + 1) * sizeof(*volume) <= sizeof(batch);
+       i++) {
+    send_output_volume_changed(void_client, i);
+  }
+  send_output_volume_changed(void_client, i);
+  rc = read(pipe_fds_[0], &batch, sizeof(batch));
+  EXPECT_EQ((ssize_t)(sizeof(batch.header) + i * sizeof(*volume)), rc);
+  cras_alert_add_flush_callback_cb(NULL);
+  rc = read(pipe_fds_[0], &batch, sizeof(batch));
+  EXPECT_EQ((ssize_t)(sizeof(batch.header) + sizeof(*volume)), rc);
+
+  // Back to one message per notification once unregistered.
+  cras_fill_register_notification_message(&reg, CRAS_CLIENT_NOTIFICATION_BATCH,
+                                          0);
+  rc =
+      rclient_->ops->handle_message_from_client(rclient_, &reg.header, NULL, 0);
+  EXPECT_EQ(0, rc);
+  EXPECT_EQ(1, cras_alert_rm_flush_callback_called);
+  send_output_volume_changed(void_client, 90);
+  rc = read(pipe_fds_[0], &batch, sizeof(batch));
+  EXPECT_EQ((ssize_t)sizeof(*volume), rc);
+  EXPECT_EQ(CRAS_CLIENT_OUTPUT_VOLUME_CHANGED, batch.header.id);
+}
+
+TEST_F(RClientMessagesSuite, NotificationBatchDroppedOnDestroy) {
+  void* void_client = reinterpret_cast<void*>(rclient_);
+  struct cras_register_notification reg;
+  struct cras_client_connected msg;
+  ssize_t rc;
+
+  cras_fill_register_notification_message(&reg, CRAS_CLIENT_NOTIFICATION_BATCH,
+                                          1);
+  rc =
+      rclient_->ops->handle_message_from_client(rclient_, &reg.header, NULL, 0);
+  EXPECT_EQ(0, rc);
+  send_output_volume_changed(void_client, 90);
+
+  // The server closes the client fd before destroying the client, so the
+  // pending batch must not be sent.
+  rclient_->ops->destroy(rclient_);
+  EXPECT_EQ(1, cras_alert_rm_flush_callback_called);
+
+  // The next message in the pipe is from the client created for TearDown.
+  rclient_ = cras_control_rclient_create(pipe_fds_[1], 2);
+  rc = read(pipe_fds_[0], &msg, sizeof(msg));
+  EXPECT_EQ((ssize_t)sizeof(msg), rc);
+  EXPECT_EQ(CRAS_CLIENT_CONNECTED, msg.header.id);
+}
+
 }  //  namespace
 
 // stubs
@@ -730,6 +853,16 @@ int audio_thread_event_log_shm_fd() {
   return -1;
 }
 
+int audio_thread_trace_start(int fd) {
+  audio_thread_trace_start_called++;
+  audio_thread_trace_start_fd = fd;
+  return 0;
+}
+
+void audio_thread_trace_stop() {
+  audio_thread_trace_stop_called++;
+}
+
 void cras_stream_apm_reload_aec_config() {}
 
 void cras_system_set_bt_wbs_enabled(bool enabled) {}
@@ -802,6 +935,12 @@ struct cras_server_state* cras_system_state_get_no_lock() {
   return NULL;
 }
 
+struct cras_tm* cras_system_state_get_tm() {
+  return NULL;
+}
+
+void cras_tm_dump_timers(const struct cras_tm* tm) {}
+
 key_t cras_sys_state_shm_fd() {
   return 1;
 }
@@ -882,6 +1021,17 @@ int cras_iodev_list_set_hotword_model(cras_node_id_t id,
   return 0;
 }
 
+int cras_alert_add_flush_callback(cras_alert_flush_cb cb, void* arg) {
+  cras_alert_add_flush_callback_called++;
+  cras_alert_add_flush_callback_cb = cb;
+  return 0;
+}
+
+int cras_alert_rm_flush_callback(cras_alert_flush_cb cb, void* arg) {
+  cras_alert_rm_flush_callback_called++;
+  return 0;
+}
+
 struct cras_observer_client* cras_observer_add(
     const struct cras_observer_ops* ops,
     void* context) {
@@ -159,6 +159,7 @@ static int sys_get_max_internal_speaker_channels_return_value;
 static int sys_get_max_headphone_channels_called = 0;
 static int sys_get_max_headphone_channels_return_value = 2;
 static int cras_iodev_update_underrun_duration_called = 0;
+static unsigned int cras_iodev_default_frames_to_play_in_sleep_ret;
 static std::map<std::string, int32_t>
     ucm_get_playback_number_of_volume_steps_values;
 
@@ -262,6 +263,7 @@ void ResetStubData() {
   sys_get_max_headphone_channels_called = 0;
   sys_get_max_headphone_channels_return_value = 2;
   cras_iodev_update_underrun_duration_called = 0;
+  cras_iodev_default_frames_to_play_in_sleep_ret = 0;
   ucm_node_use_software_volume_ret_value = 0;
 }
 
@@ -945,7 +947,7 @@ class USBFreeRunTestSuite : public testing::Test {
     fmt_.frame_rate = 48000;
     fmt_.num_channels = 2;
     aio.common.base.frames_queued = usb_frames_queued;
-    aio.common.base.output_underrun = usb_alsa_output_underrun;
+    aio.common.base.output_underrun = cras_alsa_common_output_underrun;
     aio.common.base.direction = CRAS_STREAM_OUTPUT;
     aio.common.base.format = &fmt_;
     aio.common.base.buffer_size = BUFFER_SIZE;
@@ -970,8 +972,8 @@ TEST_F(USBFreeRunTestSuite, OutputUnderrun) {
   snd_pcm_uframes_t offset;
 
   // Ask alsa_io to handle output underrun.
-  rc = usb_alsa_output_underrun(&aio.common.base);
-  EXPECT_EQ(0, rc);
+  rc = cras_alsa_common_output_underrun(&aio.common.base);
+  EXPECT_EQ(aio.common.base.buffer_size, rc);
   EXPECT_EQ(1, cras_iodev_update_underrun_duration_called);
 
   // mmap buffer should be filled with zeros.
@@ -988,6 +990,82 @@ TEST_F(USBFreeRunTestSuite, OutputUnderrun) {
   free(zeros);
 }
 
+// Test playback wake up padding from the measured hw_ptr cadence.
+class USBWakeCadenceTestSuite : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    ResetStubData();
+    memset(&aio, 0, sizeof(aio));
+    aio.common.base.direction = CRAS_STREAM_OUTPUT;
+    aio.common.base.buffer_size = BUFFER_SIZE;
+    aio.common.base.min_cb_level = 480;
+    aio.common.base.streams = reinterpret_cast<struct dev_stream*>(0x1);
+    aio.common.policy.adaptive_wake = true;
+  }
+
+  // Observes hw_level dropping by `step` frames for a whole window.
+  void ConsumeWindow(unsigned int level, unsigned int step) {
+    struct timespec tstamp;
+    for (int i = 0; i <= ALSA_WAKE_CADENCE_WINDOW; i++) {
+      cras_alsa_get_avail_frames_avail = BUFFER_SIZE - level + i * step;
+      EXPECT_EQ(level - i * step,
+                usb_frames_queued(&aio.common.base, &tstamp));
+    }
+  }
+
+  struct alsa_usb_io aio;
+};
+
+TEST_F(USBWakeCadenceTestSuite, NoPaddingBeforeMeasured) {
+  unsigned int hw_level;
+  struct timespec tstamp;
+
+  cras_iodev_default_frames_to_play_in_sleep_ret = 1000;
+  EXPECT_EQ(1000, cras_alsa_common_frames_to_play_in_sleep(
+                      &aio.common.base, &hw_level, &tstamp));
+}
+
+TEST_F(USBWakeCadenceTestSuite, PadsMeasuredCadence) {
+  unsigned int hw_level;
+  struct timespec tstamp;
+
+  ConsumeWindow(4000, 48);
+  EXPECT_EQ(48, aio.common.wake_cadence.packet_frames);
+
+  cras_iodev_default_frames_to_play_in_sleep_ret = 1000;
+  EXPECT_EQ(952, cras_alsa_common_frames_to_play_in_sleep(
+                     &aio.common.base, &hw_level, &tstamp));
+
+  // No padding when there is no stream to serve.
+  aio.common.base.streams = NULL;
+  EXPECT_EQ(1000, cras_alsa_common_frames_to_play_in_sleep(
+                      &aio.common.base, &hw_level, &tstamp));
+}
+
+TEST_F(USBWakeCadenceTestSuite, WritesAreNotCountedAsConsumption) {
+  struct timespec tstamp;
+  unsigned int level = 4000;
+
+  for (int i = 0; i <= ALSA_WAKE_CADENCE_WINDOW; i++) {
+    cras_alsa_get_avail_frames_avail = BUFFER_SIZE - level;
+    usb_frames_queued(&aio.common.base, &tstamp);
+    // Simulate put_buffer committing 200 frames while 96 are consumed.
+    aio.common.wake_cadence.last_hw_level += 200;
+    level += 200 - 96;
+  }
+  EXPECT_EQ(96, aio.common.wake_cadence.packet_frames);
+}
+
+TEST_F(USBWakeCadenceTestSuite, PaddingBoundedByMinCbLevel) {
+  unsigned int hw_level;
+  struct timespec tstamp;
+
+  ConsumeWindow(8000, 250);
+  cras_iodev_default_frames_to_play_in_sleep_ret = 1000;
+  EXPECT_EQ(1000 - 480 / 2, cras_alsa_common_frames_to_play_in_sleep(
+                                &aio.common.base, &hw_level, &tstamp));
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   openlog(NULL, LOG_PERROR, LOG_USER);
@@ -1654,6 +1732,21 @@ int cras_iodev_frames_queued(struct cras_iodev* iodev,
   return cras_iodev_frames_queued_ret;
 }
 
+unsigned int cras_iodev_default_frames_to_play_in_sleep(
+    struct cras_iodev* odev,
+    unsigned int* hw_level,
+    struct timespec* hw_tstamp) {
+  return cras_iodev_default_frames_to_play_in_sleep_ret;
+}
+
+unsigned int cras_iodev_frames_to_play_in_sleep_until(
+    struct cras_iodev* odev,
+    unsigned int* hw_level,
+    struct timespec* hw_tstamp,
+    unsigned int wakeup_frames) {
+  return 0;
+}
+
 int cras_iodev_buffer_avail(struct cras_iodev* iodev, unsigned hw_level) {
   return cras_iodev_buffer_avail_ret;
 }
@@ -4,6 +4,7 @@
 
 #include <gtest/gtest.h>
 #include <stdio.h>
+#include <vector>
 
 #include "cras_messages.h"
 
@@ -335,6 +336,46 @@ TEST_F(CrasClientTestSuite, SetInputStreamVolume) {
   EXPECT_EQ(0.6f, cras_shm_get_volume_scaler(stream_.shm));
 }
 
+static std::vector<int32_t> output_volume_changed_values;
+static std::vector<int32_t> input_node_gain_changed_values;
+
+void output_volume_changed(void* context, int32_t volume) {
+  output_volume_changed_values.push_back(volume);
+}
+
+void input_node_gain_changed(void* context,
+                             cras_node_id_t node_id,
+                             int32_t gain) {
+  input_node_gain_changed_values.push_back(gain);
+}
+
+TEST_F(CrasClientTestSuite, HandleNotificationBatch) {
+  struct cras_client_notification_batch batch;
+  struct cras_client_volume_changed volume;
+  struct cras_client_node_value_changed gain;
+
+  output_volume_changed_values.clear();
+  input_node_gain_changed_values.clear();
+  client_.observer_ops.output_volume_changed = output_volume_changed;
+  client_.observer_ops.input_node_gain_changed = input_node_gain_changed;
+
+  cras_init_client_notification_batch(&batch);
+  cras_fill_client_output_volume_changed(&volume, 90);
+  cras_fill_client_input_node_gain_changed(&gain, 1, -20);
+  memcpy(batch.msgs, &volume, sizeof(volume));
+  memcpy(batch.msgs + sizeof(volume), &gain, sizeof(gain));
+  batch.header.length += sizeof(volume) + sizeof(gain);
+
+  EXPECT_EQ(0, handle_notification_batch(&client_, &batch.header));
+  EXPECT_EQ(std::vector<int32_t>{90}, output_volume_changed_values);
+  EXPECT_EQ(std::vector<int32_t>{-20}, input_node_gain_changed_values);
+
+  // A message running past the end of the batch is rejected.
+  batch.header.length -= 1;
+  EXPECT_EQ(-EIO, handle_notification_batch(&client_, &batch.header));
+  EXPECT_EQ(2, output_volume_changed_values.size());
+}
+
 TEST(CrasClientTest, InitStreamVolume) {
   cras_stream_id_t stream_id;
   struct cras_stream_params config;
@@ -408,6 +449,10 @@ TEST(CrasClientTest, HideInternalDevices) {
   shm.num_output_nodes = num_nodes;
   shm.num_input_devs = num_devs;
   shm.num_input_nodes = num_nodes;
+  shm.num_output_devs_total = num_devs;
+  shm.num_output_nodes_total = num_nodes;
+  shm.num_input_devs_total = num_devs;
+  shm.num_input_nodes_total = num_nodes;
 
   // In Chrome the hidden devices should not be reported.
   EXPECT_EQ(0, cras_client_set_client_type(client, CRAS_CLIENT_TYPE_CHROME));
@@ -458,6 +503,75 @@ TEST(CrasClientTest, HideInternalDevices) {
   pthread_rwlock_destroy(&client_int.server_state_rwlock);
 }
 
+TEST(CrasClientTest, GetDevicesFromExtTables) {
+  struct client_int client_int;
+  struct cras_client* client = &client_int.client;
+  struct cras_server_state shm;
+  struct cras_iodev_info devs[CRAS_MAX_IODEVS_TOTAL];
+  struct cras_ionode_info nodes[CRAS_MAX_IONODES_TOTAL];
+  size_t num_devs, num_nodes, i;
+
+  memset(&client_int, 0, sizeof(client_int));
+  memset(&shm, 0, sizeof(shm));
+  client->server_state = &shm;
+  pthread_rwlock_init(&client_int.server_state_rwlock, NULL);
+
+  for (i = 0; i < CRAS_MAX_IODEVS_TOTAL; i++) {
+    if (i < CRAS_MAX_IODEVS) {
+      shm.output_devs[i].idx = i;
+    } else {
+      shm.output_devs_ext[i - CRAS_MAX_IODEVS].idx = i;
+    }
+  }
+  for (i = 0; i < CRAS_MAX_IONODES_TOTAL; i++) {
+    if (i < CRAS_MAX_IONODES) {
+      shm.output_nodes[i].stable_id = i;
+    } else {
+      shm.output_nodes_ext[i - CRAS_MAX_IONODES].stable_id = i;
+    }
+  }
+  shm.num_output_devs = CRAS_MAX_IODEVS;
+  shm.num_output_nodes = CRAS_MAX_IONODES;
+  shm.sections_magic = CRAS_SERVER_STATE_SECTIONS_MAGIC;
+  shm.num_output_devs_total = CRAS_MAX_IODEVS + 2;
+  shm.num_output_nodes_total = CRAS_MAX_IONODES + 3;
+
+  num_devs = CRAS_MAX_IODEVS_TOTAL;
+  num_nodes = CRAS_MAX_IONODES_TOTAL;
+  EXPECT_EQ(0, cras_client_get_output_devices(client, devs, nodes, &num_devs,
+                                              &num_nodes));
+  ASSERT_EQ(CRAS_MAX_IODEVS + 2, num_devs);
+  for (i = 0; i < num_devs; i++) {
+    EXPECT_EQ(i, devs[i].idx);
+  }
+  ASSERT_EQ(CRAS_MAX_IONODES + 3, num_nodes);
+  for (i = 0; i < num_nodes; i++) {
+    EXPECT_EQ(i, nodes[i].stable_id);
+  }
+
+  // Callers with room for the first tables only get those.
+  num_devs = CRAS_MAX_IODEVS;
+  num_nodes = CRAS_MAX_IONODES;
+  EXPECT_EQ(0, cras_client_get_output_devices(client, devs, nodes, &num_devs,
+                                              &num_nodes));
+  EXPECT_EQ(CRAS_MAX_IODEVS, num_devs);
+  EXPECT_EQ(CRAS_MAX_IONODES, num_nodes);
+
+  /* An older server doesn't maintain the section counts or the extension
+   * tables. Only the fixed tables are read, guarded by update_count.
+   */
+  shm.sections_magic = 0;
+  shm.dev_list_update_count = 1;
+  num_devs = CRAS_MAX_IODEVS_TOTAL;
+  num_nodes = CRAS_MAX_IONODES_TOTAL;
+  EXPECT_EQ(0, cras_client_get_output_devices(client, devs, nodes, &num_devs,
+                                              &num_nodes));
+  EXPECT_EQ(CRAS_MAX_IODEVS, num_devs);
+  EXPECT_EQ(CRAS_MAX_IONODES, num_nodes);
+
+  pthread_rwlock_destroy(&client_int.server_state_rwlock);
+}
+
 }  // namespace
 
 // stubs
@@ -3,8 +3,10 @@
  * found in the LICENSE file.
  */
 
+#include <chrono>
 #include <cstdio>
 #include <gtest/gtest.h>
+#include <thread>
 #include <vector>
 
 #include "cras/common/check.h"
@@ -12,6 +14,12 @@
 #include "cras/src/dsp/am.h"
 #include "cras/src/server/cras_sr.h"
 
+extern "C" {
+// Defined in am_mock.c.
+void am_mock_block();
+void am_mock_unblock();
+}
+
 namespace {
 
 // Helper functions for testing.
@@ -237,4 +245,127 @@ TEST_F(BtSrTestSuite, NumFramesPerRun) {
   EXPECT_EQ(cras_sr_get_num_frames_per_run(sr), 480);
 }
 
+TEST_F(BtSrTestSuite, NoLatencyWithoutWorker) {
+  EXPECT_EQ(cras_sr_get_latency_frames(sr), 0);
+}
+
+class BtSrWorkerTestSuite : public testing::Test {
+ protected:
+  void SetUp() override {
+    input_buf = byte_buffer_create(sizeof(int16_t) * 160 * 2);
+    buf_reset(input_buf);
+    output_buf = byte_buffer_create(sizeof(int16_t) * 480 * 2);
+    buf_reset(output_buf);
+    sr = cras_sr_create({.num_frames_per_run = 480,
+                         .num_channels = 1,
+                         .input_sample_rate = 8000,
+                         .output_sample_rate = 24000,
+                         .use_worker_thread = true},
+                        buf_writable(input_buf));
+    ASSERT_NE(sr, nullptr);
+  }
+
+  void TearDown() override {
+    byte_buffer_destroy(&input_buf);
+    byte_buffer_destroy(&output_buf);
+    cras_sr_destroy(sr);
+  }
+
+  // Waits for the worker to complete `num_runs` runs in total.
+  void WaitForRuns(unsigned int num_runs) {
+    struct cras_sr_stats stats;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    do {
+      cras_sr_get_stats(sr, &stats);
+      if (stats.num_runs >= num_runs) {
+        ASSERT_EQ(stats.num_runs, num_runs);
+        return;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    } while (std::chrono::steady_clock::now() < deadline);
+    FAIL() << "timed out waiting for " << num_runs << " runs, got "
+           << stats.num_runs;
+  }
+
+  // Processes 160 input samples of `value`, producing 480 samples.
+  void Process(int16_t value) {
+    Fill<int16_t>(input_buf, value, 160);
+    EXPECT_EQ(cras_sr_process(sr, input_buf, output_buf),
+              160 * sizeof(int16_t));
+  }
+
+  struct cras_sr* sr;
+  struct byte_buffer* input_buf;
+  struct byte_buffer* output_buf;
+};
+
+TEST_F(BtSrWorkerTestSuite, LatencyIsOneRun) {
+  EXPECT_EQ(cras_sr_get_latency_frames(sr), 480);
+}
+
+TEST_F(BtSrWorkerTestSuite, OneRunOfLookahead) {
+  struct cras_sr_stats stats;
+
+  {
+    SCOPED_TRACE("Expects the padded zeros of internal.");
+    Process(1);
+    BufValEQ<int16_t>(output_buf, 480, 0);
+    WaitForRuns(1);
+  }
+
+  {
+    SCOPED_TRACE("Expects the padded zeros of lookahead.");
+    Process(1);
+    BufValEQ<int16_t>(output_buf, 480, 0);
+    WaitForRuns(2);
+  }
+
+  {
+    SCOPED_TRACE("Expects processed values(1) and (2).");
+    Process(1);
+    BufValEQ<int16_t>(output_buf, 480, 1);
+    WaitForRuns(3);
+    Process(1);
+    BufValEQ<int16_t>(output_buf, 480, 2);
+  }
+
+  cras_sr_get_stats(sr, &stats);
+  EXPECT_EQ(stats.num_skipped_runs, 0);
+}
+
+TEST_F(BtSrWorkerTestSuite, SlowRunsAreSkipped) {
+  struct cras_sr_stats stats;
+
+  // Zeros are resampled to zeros, unlike the processed values.
+  am_mock_block();
+  for (int i = 0; i < 3; i++) {
+    SCOPED_TRACE(testing::Message() << "Blocked run " << i);
+    Process(0);
+    BufValEQ<int16_t>(output_buf, 480, 0);
+  }
+  cras_sr_get_stats(sr, &stats);
+  // The first run is late, the next two could not be started.
+  EXPECT_EQ(stats.num_skipped_runs, 3);
+
+  am_mock_unblock();
+  WaitForRuns(1);
+  {
+    SCOPED_TRACE("Expects the resampled values of the last skipped run.");
+    Process(0);
+    BufValEQ<int16_t>(output_buf, 480, 0);
+    WaitForRuns(2);
+    Process(0);
+    BufValEQ<int16_t>(output_buf, 480, 0);
+  }
+
+  {
+    SCOPED_TRACE("Expects processed values(2) from the second invocation.");
+    Process(0);
+    BufValEQ<int16_t>(output_buf, 480, 2);
+  }
+
+  cras_sr_get_stats(sr, &stats);
+  EXPECT_EQ(stats.num_skipped_runs, 3);
+}
+
 }  // namespace
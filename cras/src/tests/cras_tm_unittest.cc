@@ -3,8 +3,11 @@
 // found in the LICENSE file.
 
 #include <gtest/gtest.h>
+#include <stdint.h>
 #include <stdio.h>
 
+#include <vector>
+
 #include "cras/src/server/cras_tm.h"
 #include "cras_types.h"
 
@@ -34,6 +37,25 @@ void test_cb2(struct cras_timer* t, void* data) {
   test_cb2_called++;
 }
 
+static std::vector<uintptr_t> order_called;
+
+void order_cb(struct cras_timer* t, void* data) {
+  order_called.push_back((uintptr_t)data);
+}
+
+static struct cras_tm* cb_tm;
+static struct cras_timer* cb_cancel_timer;
+
+// Cancels |cb_cancel_timer| and creates an already expired timer.
+void cancel_and_create_cb(struct cras_timer* t, void* data) {
+  test_cb_called++;
+  if (cb_cancel_timer) {
+    cras_tm_cancel_timer(cb_tm, cb_cancel_timer);
+    cb_cancel_timer = NULL;
+  }
+  cras_tm_create_timer(cb_tm, 0, test_cb2, NULL);
+}
+
 TEST_F(TimerTestSuite, InitNoTimers) {
   struct timespec ts;
   int timers_active;
@@ -178,6 +200,113 @@ TEST_F(TimerTestSuite, AddTwoTimers) {
   cras_tm_cancel_timer(tm_, t1);
 }
 
+TEST_F(TimerTestSuite, ManyTimersCalledInOrder) {
+  static const unsigned int delays[] = {50, 10, 40, 30, 20, 70, 60, 5,
+                                        45, 15, 35, 25, 65, 55, 1,  80,
+                                        75, 3,  33, 22};
+  static const unsigned int num_delays = sizeof(delays) / sizeof(delays[0]);
+  struct cras_timer* cancelled = NULL;
+  struct timespec ts;
+  unsigned int i;
+
+  time_now.tv_sec = 0;
+  time_now.tv_nsec = 0;
+  for (i = 0; i < num_delays; i++) {
+    struct cras_timer* t =
+        cras_tm_create_timer(tm_, delays[i], order_cb, (void*)(uintptr_t)i);
+    ASSERT_TRUE(t);
+    if (delays[i] == 40) {
+      cancelled = t;
+    }
+  }
+  cras_tm_cancel_timer(tm_, cancelled);
+
+  // The soonest timer decides the timeout.
+  ASSERT_TRUE(cras_tm_get_next_timeout(tm_, &ts));
+  EXPECT_EQ(0, ts.tv_sec);
+  EXPECT_EQ(1000000, ts.tv_nsec);
+
+  order_called.clear();
+  for (i = 1; i <= 80; i++) {
+    time_now.tv_nsec = i * 1000000;
+    cras_tm_call_callbacks(tm_);
+  }
+  ASSERT_EQ(num_delays - 1, order_called.size());
+  for (i = 0; i < order_called.size(); i++) {
+    EXPECT_NE(40, delays[order_called[i]]);
+    if (i > 0) {
+      EXPECT_LT(delays[order_called[i - 1]], delays[order_called[i]]);
+    }
+  }
+  EXPECT_FALSE(cras_tm_get_next_timeout(tm_, &ts));
+}
+
+TEST_F(TimerTestSuite, SlackDelaysTimeout) {
+  struct timespec ts;
+
+  cras_tm_set_slack(tm_, 10);
+  time_now.tv_sec = 0;
+  time_now.tv_nsec = 0;
+  ASSERT_TRUE(cras_tm_create_timer(tm_, 20, test_cb, NULL));
+  ASSERT_TRUE(cras_tm_create_timer(tm_, 25, test_cb2, NULL));
+
+  ASSERT_TRUE(cras_tm_get_next_timeout(tm_, &ts));
+  EXPECT_EQ(0, ts.tv_sec);
+  EXPECT_EQ(25 * 1000000, ts.tv_nsec);
+
+  // Both timers are called on the delayed wake up.
+  test_cb_called = 0;
+  test_cb2_called = 0;
+  time_now.tv_nsec = 25 * 1000000;
+  cras_tm_call_callbacks(tm_);
+  EXPECT_EQ(1, test_cb_called);
+  EXPECT_EQ(1, test_cb2_called);
+
+  // A timer alone in the slack window isn't delayed.
+  ASSERT_TRUE(cras_tm_create_timer(tm_, 5, test_cb, NULL));
+  ASSERT_TRUE(cras_tm_create_timer(tm_, 20, test_cb2, NULL));
+  ASSERT_TRUE(cras_tm_get_next_timeout(tm_, &ts));
+  EXPECT_EQ(0, ts.tv_sec);
+  EXPECT_EQ(5 * 1000000, ts.tv_nsec);
+
+  // The slack never makes a timer fire early.
+  time_now.tv_nsec = 29 * 1000000;
+  cras_tm_call_callbacks(tm_);
+  EXPECT_EQ(1, test_cb_called);
+  time_now.tv_nsec = 30 * 1000000;
+  cras_tm_call_callbacks(tm_);
+  EXPECT_EQ(2, test_cb_called);
+  EXPECT_EQ(1, test_cb2_called);
+}
+
+TEST_F(TimerTestSuite, CallbackCancelsAndCreatesTimers) {
+  struct timespec ts;
+
+  cb_tm = tm_;
+  time_now.tv_sec = 0;
+  time_now.tv_nsec = 0;
+  ASSERT_TRUE(cras_tm_create_timer(tm_, 10, cancel_and_create_cb, NULL));
+  cb_cancel_timer = cras_tm_create_timer(tm_, 10, test_cb, NULL);
+  ASSERT_TRUE(cb_cancel_timer);
+
+  test_cb_called = 0;
+  test_cb2_called = 0;
+  time_now.tv_nsec = 10 * 1000000;
+  cras_tm_call_callbacks(tm_);
+  // The expired timer cancelled by the callback is not called, and the
+  // timer created by it waits for the next call.
+  EXPECT_EQ(1, test_cb_called);
+  EXPECT_EQ(0, test_cb2_called);
+  EXPECT_EQ(NULL, cb_cancel_timer);
+
+  ASSERT_TRUE(cras_tm_get_next_timeout(tm_, &ts));
+  EXPECT_EQ(0, ts.tv_sec);
+  EXPECT_EQ(0, ts.tv_nsec);
+  cras_tm_call_callbacks(tm_);
+  EXPECT_EQ(1, test_cb2_called);
+  EXPECT_FALSE(cras_tm_get_next_timeout(tm_, &ts));
+}
+
 // Stubs
 extern "C" {
 
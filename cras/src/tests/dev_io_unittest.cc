@@ -23,6 +23,7 @@
 #include "third_party/utlist/utlist.h"
 
 struct audio_thread_event_log* atlog;
+struct audio_thread_trace* atlog_trace;
 
 static float dev_stream_capture_software_gain_scaler_val;
 static float dev_stream_capture_ui_gain_scaler_val;
@@ -648,6 +649,29 @@ struct dev_stream* dev_stream_create(struct cras_rstream* stream,
                                      const struct timespec* sleep_interval_ts) {
   return 0;
 }
+int config_format_converter(struct cras_fmt_conv** conv,
+                            enum CRAS_STREAM_DIRECTION dir,
+                            const struct cras_audio_format* from,
+                            const struct cras_audio_format* to,
+                            enum CRAS_NODE_TYPE node_type,
+                            unsigned int frames) {
+  return 0;
+}
+void cras_fmt_conv_destroy(struct cras_fmt_conv** conv) {}
+size_t cras_fmt_conv_convert_frames(struct cras_fmt_conv* conv,
+                                    const uint8_t* in_buf,
+                                    uint8_t* out_buf,
+                                    unsigned int* in_frames,
+                                    size_t out_frames) {
+  return 0;
+}
+size_t cras_fmt_conv_out_frames_to_in(struct cras_fmt_conv* conv,
+                                      size_t out_frames) {
+  return out_frames;
+}
+void cras_fmt_conv_set_linear_resample_rates(struct cras_fmt_conv* conv,
+                                             float from,
+                                             float to) {}
 int cras_device_monitor_error_close(unsigned int dev_idx) {
   return 0;
 }
@@ -16,6 +16,7 @@
 
 extern "C" {
 struct audio_thread_event_log* atlog;
+struct audio_thread_trace* atlog_trace;
 // For audio_thread_log.h use.
 int atlog_rw_shm_fd;
 int atlog_ro_shm_fd;
@@ -98,7 +99,15 @@ static float cras_fmt_conv_set_linear_resample_rates_from;
 static float cras_fmt_conv_set_linear_resample_rates_to;
 
 static unsigned int rstream_playable_frames_ret;
+static float rstream_volume_scaler_ret;
 static struct mix_add_call mix_add_call;
+static struct mix_add_ramp_call {
+  unsigned int num_called;
+  unsigned int frames;
+  float scaler;
+  float increment;
+  float target;
+} mix_add_ramp_call;
 static struct rstream_get_readable_call rstream_get_readable_call;
 static unsigned int rstream_get_readable_num;
 static uint8_t* rstream_get_readable_ptr;
@@ -149,6 +158,8 @@ class CreateSuite : public testing::Test {
     cras_rstream_flush_old_audio_messages_called = 0;
     cras_server_metrics_missed_cb_event_called = 0;
 
+    rstream_volume_scaler_ret = 1.0;
+    memset(&mix_add_ramp_call, 0, sizeof(mix_add_ramp_call));
     memset(&copy_area_call, 0xff, sizeof(copy_area_call));
     memset(&conv_frames_call, 0xff, sizeof(conv_frames_call));
 
@@ -638,6 +649,8 @@ TEST_F(CreateSuite, StreamMixNoConv) {
 
   dev_stream.conv = NULL;
   dev_stream.stream = reinterpret_cast<cras_rstream*>(0x5446);
+  dev_stream.mix_vol = dev_stream.mix_vol_target = 1.0;
+  dev_stream.mix_vol_ramp_frames = 0;
   rstream_playable_frames_ret = nfr;
   rstream_get_readable_num = nfr;
   rstream_get_readable_ptr = reinterpret_cast<uint8_t*>(0x4000);
@@ -664,6 +677,8 @@ TEST_F(CreateSuite, StreamMixNoConvTwoPass) {
 
   dev_stream.conv = NULL;
   dev_stream.stream = reinterpret_cast<cras_rstream*>(0x5446);
+  dev_stream.mix_vol = dev_stream.mix_vol_target = 1.0;
+  dev_stream.mix_vol_ramp_frames = 0;
   rstream_playable_frames_ret = nfr;
   rstream_get_readable_num = nfr / 2;
   rstream_get_readable_ptr = reinterpret_cast<uint8_t*>(0x4000);
@@ -681,6 +696,47 @@ TEST_F(CreateSuite, StreamMixNoConvTwoPass) {
   EXPECT_EQ(2, rstream_get_readable_call.num_called);
 }
 
+TEST_F(CreateSuite, StreamMixRampsVolumeChange) {
+  struct dev_stream dev_stream;
+  const unsigned int nfr = 240;
+  struct cras_audio_format fmt;
+
+  dev_stream.conv = NULL;
+  dev_stream.stream = reinterpret_cast<cras_rstream*>(0x5446);
+  dev_stream.dev_rate = 48000;
+  dev_stream.mix_vol = dev_stream.mix_vol_target = 1.0;
+  dev_stream.mix_vol_ramp_frames = 0;
+  rstream_playable_frames_ret = nfr;
+  rstream_get_readable_num = nfr;
+  rstream_get_readable_ptr = reinterpret_cast<uint8_t*>(0x4000);
+  fmt.num_channels = 2;
+  fmt.format = SND_PCM_FORMAT_S16_LE;
+  mix_add_call.count = 0;
+
+  // Ramps over 10ms, 480 frames, so the first mix gets half way.
+  rstream_volume_scaler_ret = 0.5;
+  EXPECT_EQ(nfr, dev_stream_mix(&dev_stream, &fmt, (uint8_t*)0x5000, nfr));
+  EXPECT_EQ(1, mix_add_ramp_call.num_called);
+  EXPECT_EQ(nfr, mix_add_ramp_call.frames);
+  EXPECT_FLOAT_EQ(1.0, mix_add_ramp_call.scaler);
+  EXPECT_FLOAT_EQ(-0.5 / 480, mix_add_ramp_call.increment);
+  EXPECT_FLOAT_EQ(0.5, mix_add_ramp_call.target);
+  EXPECT_FLOAT_EQ(0.75, dev_stream.mix_vol);
+  EXPECT_EQ(0, mix_add_call.count);
+
+  // The second mix continues from where the first stopped.
+  EXPECT_EQ(nfr, dev_stream_mix(&dev_stream, &fmt, (uint8_t*)0x5000, nfr));
+  EXPECT_EQ(2, mix_add_ramp_call.num_called);
+  EXPECT_FLOAT_EQ(0.75, mix_add_ramp_call.scaler);
+  EXPECT_FLOAT_EQ(0.5, dev_stream.mix_vol);
+
+  // Ramp done, back to a plain mix at the new volume.
+  EXPECT_EQ(nfr, dev_stream_mix(&dev_stream, &fmt, (uint8_t*)0x5000, nfr));
+  EXPECT_EQ(2, mix_add_ramp_call.num_called);
+  EXPECT_EQ(nfr * 2, mix_add_call.count);
+  EXPECT_FLOAT_EQ(0.5, mix_add_call.mix_vol);
+}
+
 TEST_F(CreateSuite, DevStreamFlushAudioMessages) {
   struct dev_stream* dev_stream;
   unsigned int dev_id = 9;
@@ -1227,7 +1283,7 @@ unsigned int cras_rstream_playable_frames(struct cras_rstream* rstream,
 }
 
 float cras_rstream_get_volume_scaler(struct cras_rstream* rstream) {
-  return 1.0;
+  return rstream_volume_scaler_ret;
 }
 
 uint8_t* cras_rstream_get_readable_frames(struct cras_rstream* rstream,
@@ -1309,6 +1365,22 @@ void cras_mix_add(snd_pcm_format_t fmt,
   mix_add_call.mix_vol = mix_vol;
 }
 
+void cras_mix_add_ramp(snd_pcm_format_t fmt,
+                       uint8_t* dst,
+                       uint8_t* src,
+                       unsigned int frame,
+                       int mute,
+                       float scaler,
+                       float increment,
+                       float target,
+                       int channel) {
+  mix_add_ramp_call.num_called++;
+  mix_add_ramp_call.frames = frame;
+  mix_add_ramp_call.scaler = scaler;
+  mix_add_ramp_call.increment = increment;
+  mix_add_ramp_call.target = target;
+}
+
 struct cras_audio_area* cras_audio_area_create(size_t num_channels) {
   cras_audio_area_create_num_channels_val = num_channels;
   return NULL;
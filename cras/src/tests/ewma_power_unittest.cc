@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include <gtest/gtest.h>
+#include <stdint.h>
 
 #include "cras/src/server/ewma_power.h"
 
@@ -21,7 +22,7 @@ TEST(EWMAPower, RelativePowerValue) {
   ewma_power_init(&ewma, SND_PCM_FORMAT_S16_LE, 48000);
   EXPECT_EQ(48, ewma.step_fr);
 
-  ewma_power_calculate(&ewma, buf, 1, 480);
+  ewma_power_calculate(&ewma, (uint8_t*)buf, 1, 480);
   EXPECT_LT(0.0f, ewma.power);
 
   // After 10ms of silence the power value decreases.
@@ -29,12 +30,12 @@ TEST(EWMAPower, RelativePowerValue) {
   for (i = 0; i < 480; i++) {
     buf[i] = 0x00;
   }
-  ewma_power_calculate(&ewma, buf, 1, 480);
+  ewma_power_calculate(&ewma, (uint8_t*)buf, 1, 480);
   EXPECT_LT(ewma.power, f);
 
   // After 300ms of silence the power value decreases to insignificant low.
   for (i = 0; i < 30; i++) {
-    ewma_power_calculate(&ewma, buf, 1, 480);
+    ewma_power_calculate(&ewma, (uint8_t*)buf, 1, 480);
   }
   EXPECT_LT(ewma.power, 1.0e-10);
 }
@@ -51,7 +52,7 @@ TEST(EWMAPower, PowerInStereoData) {
     buf[i] = 0x0;
     buf[i + 1] = 0x00fe;
   }
-  ewma_power_calculate(&ewma, buf, 2, 480);
+  ewma_power_calculate(&ewma, (uint8_t*)buf, 2, 480);
   EXPECT_LT(0.0f, ewma.power);
 
   // After 10ms of silence the power value decreases.
@@ -59,12 +60,12 @@ TEST(EWMAPower, PowerInStereoData) {
   for (i = 0; i < 960; i++) {
     buf[i] = 0x0;
   }
-  ewma_power_calculate(&ewma, buf, 2, 480);
+  ewma_power_calculate(&ewma, (uint8_t*)buf, 2, 480);
   EXPECT_LT(ewma.power, f);
 
   // After 300ms of silence the power value decreases to insignificant low.
   for (i = 0; i < 30; i++) {
-    ewma_power_calculate(&ewma, buf, 2, 480);
+    ewma_power_calculate(&ewma, (uint8_t*)buf, 2, 480);
   }
   EXPECT_LT(ewma.power, 1.0e-10);
 
@@ -75,7 +76,7 @@ TEST(EWMAPower, PowerInStereoData) {
     buf[i] = 0x0ffe;
     buf[i + 1] = 0x0;
   }
-  ewma_power_calculate(&ewma, buf, 2, 480);
+  ewma_power_calculate(&ewma, (uint8_t*)buf, 2, 480);
   EXPECT_LT(0.0f, ewma.power);
 }
 
@@ -99,7 +100,7 @@ TEST(EWMAPower, PowerInAudioArea) {
     buf[i + 3] = 0x0ffe;
   }
   ewma_power_init(&ewma, SND_PCM_FORMAT_S16_LE, 48000);
-  ewma_power_calculate_area(&ewma, buf, area, 480);
+  ewma_power_calculate_area(&ewma, (uint8_t*)buf, area, 480);
   f = ewma.power;
   EXPECT_LT(0.0f, f);
 
@@ -109,7 +110,7 @@ TEST(EWMAPower, PowerInAudioArea) {
   cras_audio_format_set_channel_layout(fmt, layout);
   cras_audio_area_config_channels(area, fmt);
   ewma_power_init(&ewma, SND_PCM_FORMAT_S16_LE, 48000);
-  ewma_power_calculate_area(&ewma, buf, area, 480);
+  ewma_power_calculate_area(&ewma, (uint8_t*)buf, area, 480);
   EXPECT_GT(f, ewma.power);
 
   // Change layout to the two silent channels. Expect power is 0.0f.
@@ -117,11 +118,105 @@ TEST(EWMAPower, PowerInAudioArea) {
   cras_audio_format_set_channel_layout(fmt, layout);
   cras_audio_area_config_channels(area, fmt);
   ewma_power_init(&ewma, SND_PCM_FORMAT_S16_LE, 48000);
-  ewma_power_calculate_area(&ewma, buf, area, 480);
+  ewma_power_calculate_area(&ewma, (uint8_t*)buf, area, 480);
   EXPECT_EQ(0.0f, ewma.power);
 
   cras_audio_format_destroy(fmt);
   cras_audio_area_destroy(area);
 }
 
+TEST(EWMAPower, SameLevelInAllFormats) {
+  struct ewma_power ewma;
+  int16_t s16[960];
+  int32_t s24[960];
+  int32_t s32[960];
+  float f32[960];
+  float power;
+  int i;
+
+  // Half of full scale in both channels.
+  for (i = 0; i < 960; i++) {
+    s16[i] = (i % 4 < 2) ? 0x4000 : -0x4000;
+    s24[i] = (int32_t)(((uint32_t)s16[i] << 8) & 0xffffff);
+    s32[i] = (int32_t)((uint32_t)s16[i] << 16);
+    f32[i] = s16[i] / 32768.0f;
+  }
+
+  ewma_power_init(&ewma, SND_PCM_FORMAT_S16_LE, 48000);
+  ewma_power_calculate(&ewma, (uint8_t*)s16, 2, 480);
+  power = ewma.power;
+  EXPECT_FLOAT_EQ(0.25f, power);
+
+  ewma_power_init(&ewma, SND_PCM_FORMAT_S24_LE, 48000);
+  ewma_power_calculate(&ewma, (uint8_t*)s24, 2, 480);
+  EXPECT_FLOAT_EQ(power, ewma.power);
+
+  ewma_power_init(&ewma, SND_PCM_FORMAT_S32_LE, 48000);
+  ewma_power_calculate(&ewma, (uint8_t*)s32, 2, 480);
+  EXPECT_FLOAT_EQ(power, ewma.power);
+
+  ewma_power_init(&ewma, SND_PCM_FORMAT_FLOAT_LE, 48000);
+  ewma_power_calculate(&ewma, (uint8_t*)f32, 2, 480);
+  EXPECT_FLOAT_EQ(power, ewma.power);
+
+  // Unsupported formats make the calculation a no-op.
+  ewma_power_init(&ewma, SND_PCM_FORMAT_S24_3LE, 48000);
+  EXPECT_FALSE(ewma.enabled);
+  ewma_power_calculate(&ewma, (uint8_t*)s16, 2, 480);
+  EXPECT_FALSE(ewma.power_set);
+}
+
+TEST(EWMAPower, PartialBlocksCarryOver) {
+  struct ewma_power whole, split;
+  int16_t buf[480];
+  int i;
+
+  for (i = 0; i < 480; i++) {
+    buf[i] = (i * 37) % 2000 - 1000;
+  }
+
+  ewma_power_init(&whole, SND_PCM_FORMAT_S16_LE, 48000);
+  ewma_power_calculate(&whole, (uint8_t*)buf, 1, 480);
+
+  // Feeding the same frames in chunks smaller than a 48 frame block gives
+  // the same result.
+  ewma_power_init(&split, SND_PCM_FORMAT_S16_LE, 48000);
+  for (i = 0; i < 480; i += 20) {
+    ewma_power_calculate(&split, (uint8_t*)(buf + i), 1, 20);
+  }
+  EXPECT_FLOAT_EQ(whole.power, split.power);
+
+  // Less than a block does not update the power.
+  ewma_power_init(&split, SND_PCM_FORMAT_S16_LE, 48000);
+  ewma_power_calculate(&split, (uint8_t*)buf, 1, 47);
+  EXPECT_FALSE(split.power_set);
+  ewma_power_calculate(&split, (uint8_t*)(buf + 47), 1, 1);
+  EXPECT_TRUE(split.power_set);
+}
+
+TEST(EWMAPower, PublishToMeter) {
+  struct ewma_power ewma;
+  struct cras_power_meter meter = {};
+  int16_t buf[480];
+  int i;
+
+  for (i = 0; i < 480; i++) {
+    buf[i] = 0x00fe;
+  }
+
+  ewma_power_init(&ewma, SND_PCM_FORMAT_S16_LE, 48000);
+  ewma_power_set_meter(&ewma, &meter);
+  ewma_power_calculate(&ewma, (uint8_t*)buf, 1, 480);
+  EXPECT_LT(0.0f, meter.power);
+  EXPECT_EQ(ewma.power, meter.power);
+
+  // Initializing again stops publishing.
+  ewma_power_init(&ewma, SND_PCM_FORMAT_S16_LE, 48000);
+  for (i = 0; i < 480; i++) {
+    buf[i] = 0x0ffe;
+  }
+  ewma_power_calculate(&ewma, (uint8_t*)buf, 1, 480);
+  EXPECT_LT(meter.power, ewma.power);
+}
+
 }  // namespace
@@ -40,6 +40,7 @@ static unsigned cras_sco_acquire_return_val;
 static int cras_sco_enable_cras_sr_bt_called;
 static int cras_sco_enable_cras_sr_bt_return_val;
 static int cras_sco_disable_cras_sr_bt_called;
+static unsigned cras_sco_sr_latency_frames_val;
 static size_t cras_sco_buf_release_called;
 static unsigned cras_sco_buf_release_nwritten_val;
 static size_t cras_sco_fill_output_with_zeros_called;
@@ -73,6 +74,7 @@ void ResetStubData() {
   cras_sco_enable_cras_sr_bt_called = 0;
   cras_sco_enable_cras_sr_bt_return_val = 0;
   cras_sco_disable_cras_sr_bt_called = 0;
+  cras_sco_sr_latency_frames_val = 0;
   cras_sco_buf_release_called = 0;
   cras_sco_buf_release_nwritten_val = 0;
   cras_sco_fill_output_with_zeros_called = 0;
@@ -348,6 +350,24 @@ TEST_F(HfpIodev, NoStreamState) {
   hfp_iodev_destroy(iodev);
 }
 
+TEST_F(HfpIodev, DelayFramesIncludesSrLatency) {
+  ResetStubData();
+  cras_sco_sr_latency_frames_val = 480;
+
+  iodev = hfp_iodev_create(CRAS_STREAM_INPUT, fake_device, fake_slc, fake_sco);
+  EXPECT_EQ(480, iodev->delay_frames(iodev));
+  hfp_iodev_destroy(iodev);
+
+  iodev = hfp_iodev_create(CRAS_STREAM_OUTPUT, fake_device, fake_slc, fake_sco);
+  EXPECT_EQ(0, iodev->delay_frames(iodev));
+  hfp_iodev_destroy(iodev);
+
+  cras_sco_running_return_val = 0;
+  iodev = hfp_iodev_create(CRAS_STREAM_INPUT, fake_device, fake_slc, fake_sco);
+  EXPECT_EQ(-EINVAL, iodev->delay_frames(iodev));
+  hfp_iodev_destroy(iodev);
+}
+
 }  // namespace
 
 extern "C" {
@@ -475,6 +495,10 @@ void cras_sco_disable_cras_sr_bt(struct cras_sco* sco) {
   cras_sco_disable_cras_sr_bt_called++;
 }
 
+unsigned cras_sco_sr_latency_frames(struct cras_sco* sco) {
+  return cras_sco_sr_latency_frames_val;
+}
+
 int cras_sco_set_fd(struct cras_sco* sco, int fd) {
   return 0;
 }
@@ -161,6 +161,7 @@ struct cras_apm* cras_stream_apm_get_active(struct cras_stream_apm* stream,
 int cras_stream_apm_process(struct cras_apm* apm,
                             struct float_buffer* input,
                             unsigned int offset,
+                            uint64_t read_frames,
                             float preprocessing_gain_scalar) {
   cras_stream_apm_process_called++;
   cras_stream_apm_process_offset_val = offset;
@@ -1591,6 +1591,39 @@ TEST_F(IoDevTestSuite, AddRemoveInput) {
   cras_iodev_list_deinit();
 }
 
+// Nodes past CRAS_MAX_IONODES go to the extension table.
+TEST_F(IoDevTestSuite, NodesOverflowToExtTable) {
+  static const unsigned int num_nodes = CRAS_MAX_IONODES + 5;
+  struct cras_ionode nodes[num_nodes];
+  unsigned int i;
+
+  memset(nodes, 0, sizeof(nodes));
+  for (i = 0; i < num_nodes; i++) {
+    nodes[i].idx = i;
+    nodes[i].next = i + 1 < num_nodes ? &nodes[i + 1] : NULL;
+  }
+  d1_.direction = CRAS_STREAM_INPUT;
+  d1_.nodes = &nodes[0];
+  d1_.active_node = &nodes[0];
+
+  cras_iodev_list_init();
+  ASSERT_EQ(cras_iodev_list_add(&d1_), 0);
+
+  EXPECT_EQ(server_state_stub.num_input_devs, 1);
+  EXPECT_EQ(server_state_stub.num_input_devs_total, 1);
+  EXPECT_EQ(server_state_stub.num_input_nodes, CRAS_MAX_IONODES);
+  EXPECT_EQ(server_state_stub.num_input_nodes_total, num_nodes);
+  EXPECT_EQ(server_state_stub.input_nodes[CRAS_MAX_IONODES - 1].ionode_idx,
+            CRAS_MAX_IONODES - 1);
+  for (i = CRAS_MAX_IONODES; i < num_nodes; i++) {
+    EXPECT_EQ(
+        server_state_stub.input_nodes_ext[i - CRAS_MAX_IONODES].ionode_idx, i);
+  }
+
+  cras_iodev_list_rm(&d1_);
+  cras_iodev_list_deinit();
+}
+
 // Test adding/removing an input dev to the list without updating the server
 // state.
 TEST_F(IoDevTestSuite, AddRemoveInputNoSem) {
@@ -3799,11 +3832,13 @@ extern "C" {
 
 // Stubs
 
-struct cras_server_state* cras_system_state_update_begin() {
+struct cras_server_state* cras_system_state_update_section_begin(
+    enum CRAS_SERVER_STATE_SECTION section) {
   return server_state_update_begin_return;
 }
 
-void cras_system_state_update_complete() {}
+void cras_system_state_update_section_complete(
+    enum CRAS_SERVER_STATE_SECTION section) {}
 
 int cras_system_get_mute() {
   return system_get_mute_return;
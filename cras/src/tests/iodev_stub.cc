@@ -177,6 +177,9 @@ unsigned int cras_iodev_max_stream_offset(const struct cras_iodev* iodev) {
   return 0;
 }
 
+void cras_iodev_force_all_streams_read(struct cras_iodev* iodev,
+                                       unsigned int read_limit) {}
+
 int cras_iodev_odev_should_wake(const struct cras_iodev* odev) {
   return 1;
 }
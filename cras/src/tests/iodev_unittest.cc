@@ -93,6 +93,7 @@ static bool can_start_ret;
 static int configure_dev_ret;
 // This will be used extensively in cras_iodev.
 struct audio_thread_event_log* atlog;
+struct audio_thread_trace* atlog_trace;
 static unsigned int simple_no_stream_called;
 static int simple_no_stream_enable;
 static int dev_stream_playback_frames_ret;
@@ -2925,6 +2926,15 @@ void cras_system_state_stream_added(enum CRAS_STREAM_DIRECTION direction,
 void cras_system_state_stream_removed(enum CRAS_STREAM_DIRECTION direction,
                                       enum CRAS_CLIENT_TYPE client_type) {}
 
+struct cras_power_meter* cras_system_state_add_power_meter(
+    enum CRAS_POWER_METER_SOURCE source,
+    uint32_t id,
+    enum CRAS_STREAM_DIRECTION direction) {
+  return NULL;
+}
+
+void cras_system_state_remove_power_meter(struct cras_power_meter* meter) {}
+
 // From cras_dsp
 struct cras_dsp_context* cras_dsp_context_new(int sample_rate,
                                               const char* purpose) {
@@ -3215,13 +3225,16 @@ void ewma_power_init(struct ewma_power* ewma,
                      snd_pcm_format_t fmt,
                      unsigned int rate){};
 
+void ewma_power_set_meter(struct ewma_power* ewma,
+                          struct cras_power_meter* meter) {}
+
 void ewma_power_calculate(struct ewma_power* ewma,
-                          const int16_t* buf,
+                          const uint8_t* buf,
                           unsigned int channels,
                           unsigned int size){};
 
 void ewma_power_calculate_area(struct ewma_power* ewma,
-                               const int16_t* buf,
+                               const uint8_t* buf,
                                struct cras_audio_area* area,
                                unsigned int size){};
 
@@ -549,6 +549,7 @@ void ewma_power_disable(struct ewma_power* ewma) {}
 
 // From audio_thread
 struct audio_thread_event_log* atlog;
+struct audio_thread_trace* atlog_trace;
 
 // From cras_bt_log
 struct cras_bt_event_log* btlog;
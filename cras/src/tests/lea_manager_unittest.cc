@@ -247,6 +247,7 @@ int connect(int sockfd, const struct sockaddr* addr, socklen_t addrlen) {
 
 // From audio_thread
 struct audio_thread_event_log* atlog;
+struct audio_thread_trace* atlog_trace;
 
 // From cras_bt_log
 struct cras_bt_event_log* btlog;
@@ -18,6 +18,7 @@
 
 // For audio_thread_log.h use.
 struct audio_thread_event_log* atlog;
+struct audio_thread_trace* atlog_trace;
 int atlog_rw_shm_fd;
 int atlog_ro_shm_fd;
 
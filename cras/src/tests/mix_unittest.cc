@@ -330,6 +330,38 @@ TEST_F(MixTestSuiteS16_LE, StrideCopy) {
   TestScaleStride(0.5);
 }
 
+TEST_F(MixTestSuiteS16_LE, MixRampCappedByTarget) {
+  float scaler = 0.2;
+  float increment = 0.001;
+  float target = 0.5;
+
+  _SetupBuffer();
+  for (size_t i = 0; i < kBufferFrames * 2; i += 2) {
+    float applied_scaler = scaler > target ? target : scaler;
+    for (size_t j = i; j < i + 2; j++) {
+      int32_t tmp = mix_buffer_[j] + (int16_t)(src_buffer_[j] * applied_scaler);
+      if (tmp > INT16_MAX) {
+        tmp = INT16_MAX;
+      } else if (tmp < INT16_MIN) {
+        tmp = INT16_MIN;
+      }
+      compare_buffer_[j] = tmp;
+    }
+    scaler += increment;
+  }
+
+  cras_mix_add_ramp(fmt_, (uint8_t*)mix_buffer_, (uint8_t*)src_buffer_,
+                    kBufferFrames, 0, 0.2, increment, target, 2);
+  EXPECT_EQ(0, memcmp(compare_buffer_, mix_buffer_, kBufferFrames * 4));
+}
+
+TEST_F(MixTestSuiteS16_LE, MixRampMuted) {
+  _SetupBuffer();
+  cras_mix_add_ramp(fmt_, (uint8_t*)mix_buffer_, (uint8_t*)src_buffer_,
+                    kBufferFrames, 1, 1.0, -0.001, 0.0, 2);
+  EXPECT_EQ(0, memcmp(compare_buffer_, mix_buffer_, kBufferFrames * 4));
+}
+
 class MixTestSuiteS24_LE : public testing::Test {
  protected:
   virtual void SetUp() {
@@ -960,6 +992,32 @@ TEST_F(MixTestSuiteS32_LE, StrideCopy) {
   TestScaleStride(0.1);
 }
 
+TEST_F(MixTestSuiteS32_LE, MixRampDown) {
+  float scaler = 0.9;
+  float increment = -0.0005;
+  float target = 0.1;
+
+  _SetupBuffer();
+  for (size_t i = 0; i < kBufferFrames * 2; i += 2) {
+    float applied_scaler = scaler < target ? target : scaler;
+    for (size_t j = i; j < i + 2; j++) {
+      int64_t tmp = (int64_t)mix_buffer_[j] +
+                    (int64_t)(src_buffer_[j] * applied_scaler);
+      if (tmp > INT32_MAX) {
+        tmp = INT32_MAX;
+      } else if (tmp < INT32_MIN) {
+        tmp = INT32_MIN;
+      }
+      compare_buffer_[j] = tmp;
+    }
+    scaler += increment;
+  }
+
+  cras_mix_add_ramp(fmt_, (uint8_t*)mix_buffer_, (uint8_t*)src_buffer_,
+                    kBufferFrames, 0, 0.9, increment, target, 2);
+  EXPECT_EQ(0, memcmp(compare_buffer_, mix_buffer_, kBufferFrames * 8));
+}
+
 class MixTestSuiteS24_3LE : public testing::Test {
  protected:
   virtual void SetUp() {
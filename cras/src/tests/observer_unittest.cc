@@ -31,6 +31,9 @@ static alert_flags_map cras_alert_create_flags_map;
 static struct cras_alert* cras_alert_pending_alert_value;
 static void* cras_alert_pending_data_value = NULL;
 static size_t cras_alert_pending_data_size_value;
+static uint64_t cras_alert_pending_keyed_data_key_value;
+typedef std::map<struct cras_alert*, unsigned int> alert_interval_map;
+static alert_interval_map cras_alert_set_min_interval_map;
 static size_t cras_iodev_list_update_device_list_called;
 static std::vector<void*> cb_context;
 static size_t cb_output_volume_changed_called;
@@ -89,6 +92,8 @@ static void ResetStubData() {
   cras_alert_add_callback_map.clear();
   cras_alert_pending_alert_value = NULL;
   cras_alert_pending_data_size_value = 0;
+  cras_alert_pending_keyed_data_key_value = 0;
+  cras_alert_set_min_interval_map.clear();
   if (cras_alert_pending_data_value) {
     free(cras_alert_pending_data_value);
     cras_alert_pending_data_value = NULL;
@@ -349,6 +354,13 @@ class ObserverTest : public testing::Test {
               cras_alert_add_callback_map[g_observer->alerts.severe_underrun]);
     EXPECT_EQ(reinterpret_cast<void*>(underrun_alert),
               cras_alert_add_callback_map[g_observer->alerts.underrun]);
+    EXPECT_EQ(
+        CRAS_OBSERVER_MIN_INTERVAL_MS,
+        cras_alert_set_min_interval_map[g_observer->alerts.output_volume]);
+    EXPECT_EQ(
+        CRAS_OBSERVER_MIN_INTERVAL_MS,
+        cras_alert_set_min_interval_map[g_observer->alerts.output_node_volume]);
+    EXPECT_EQ(0, cras_alert_set_min_interval_map[g_observer->alerts.nodes]);
 
     cras_observer_get_ops(NULL, &ops1_);
     EXPECT_NE(0, cras_observer_ops_are_empty(&ops1_));
@@ -358,6 +370,8 @@ class ObserverTest : public testing::Test {
 
     context1_ = reinterpret_cast<void*>(1);
     context2_ = reinterpret_cast<void*>(2);
+    client1_ = NULL;
+    client2_ = NULL;
   }
 
   virtual void TearDown() {
@@ -366,9 +380,16 @@ class ObserverTest : public testing::Test {
     ResetStubData();
   }
 
-  void DoObserverAlert(cras_alert_cb alert, void* data) {
+  // Adds the clients with the current |ops1_| and |ops2_|.
+  void AddClients() {
     client1_ = cras_observer_add(&ops1_, context1_);
     client2_ = cras_observer_add(&ops2_, context2_);
+  }
+
+  void DoObserverAlert(cras_alert_cb alert, void* data) {
+    if (!client1_) {
+      AddClients();
+    }
     ASSERT_NE(client1_, reinterpret_cast<struct cras_observer_client*>(NULL));
     ASSERT_NE(client2_, reinterpret_cast<struct cras_observer_client*>(NULL));
 
@@ -425,6 +446,10 @@ TEST_F(ObserverTest, NotifyOutputVolume) {
   struct cras_observer_alert_data_volume* data;
   const int32_t volume = 100;
 
+  ops1_.output_volume_changed = cb_output_volume_changed;
+  ops2_.output_volume_changed = cb_output_volume_changed;
+  AddClients();
+
   cras_observer_notify_output_volume(volume);
   EXPECT_EQ(cras_alert_pending_alert_value, g_observer->alerts.output_volume);
   ASSERT_EQ(cras_alert_pending_data_size_value, sizeof(*data));
@@ -433,8 +458,6 @@ TEST_F(ObserverTest, NotifyOutputVolume) {
       cras_alert_pending_data_value);
   EXPECT_EQ(data->volume, volume);
 
-  ops1_.output_volume_changed = cb_output_volume_changed;
-  ops2_.output_volume_changed = cb_output_volume_changed;
   DoObserverAlert(output_volume_alert, data);
   ASSERT_EQ(2, cb_output_volume_changed_called);
   EXPECT_EQ(cb_output_volume_changed_volume[0], volume);
@@ -477,6 +500,10 @@ TEST_F(ObserverTest, NotifyCaptureGain) {
   struct cras_observer_alert_data_volume* data;
   const int32_t gain = -20;
 
+  ops1_.capture_gain_changed = cb_capture_gain_changed;
+  ops2_.capture_gain_changed = cb_capture_gain_changed;
+  AddClients();
+
   cras_observer_notify_capture_gain(gain);
   EXPECT_EQ(cras_alert_pending_alert_value, g_observer->alerts.capture_gain);
   ASSERT_EQ(cras_alert_pending_data_size_value, sizeof(*data));
@@ -485,8 +512,6 @@ TEST_F(ObserverTest, NotifyCaptureGain) {
       cras_alert_pending_data_value);
   EXPECT_EQ(data->volume, gain);
 
-  ops1_.capture_gain_changed = cb_capture_gain_changed;
-  ops2_.capture_gain_changed = cb_capture_gain_changed;
   DoObserverAlert(capture_gain_alert, data);
   ASSERT_EQ(2, cb_capture_gain_changed_called);
   EXPECT_EQ(cb_capture_gain_changed_gain[0], gain);
@@ -564,9 +589,14 @@ TEST_F(ObserverTest, NotifyOutputNodeVolume) {
   const cras_node_id_t node_id = 0x0001000100020002;
   const int32_t volume = 100;
 
+  ops1_.output_node_volume_changed = cb_output_node_volume_changed;
+  ops2_.output_node_volume_changed = cb_output_node_volume_changed;
+  AddClients();
+
   cras_observer_notify_output_node_volume(node_id, volume);
   EXPECT_EQ(cras_alert_pending_alert_value,
             g_observer->alerts.output_node_volume);
+  EXPECT_EQ(node_id, cras_alert_pending_keyed_data_key_value);
   ASSERT_EQ(cras_alert_pending_data_size_value, sizeof(*data));
   ASSERT_NE(cras_alert_pending_data_value, reinterpret_cast<void*>(NULL));
   data = reinterpret_cast<struct cras_observer_alert_data_node_volume*>(
@@ -574,8 +604,6 @@ TEST_F(ObserverTest, NotifyOutputNodeVolume) {
   EXPECT_EQ(data->node_id, node_id);
   EXPECT_EQ(data->volume, volume);
 
-  ops1_.output_node_volume_changed = cb_output_node_volume_changed;
-  ops2_.output_node_volume_changed = cb_output_node_volume_changed;
   DoObserverAlert(output_node_volume_alert, data);
   ASSERT_EQ(2, cb_output_node_volume_changed_called);
   EXPECT_EQ(cb_output_node_volume_changed_volume[0], volume);
@@ -591,9 +619,14 @@ TEST_F(ObserverTest, NotifyNodeLeftRightSwapped) {
   const cras_node_id_t node_id = 0x0001000100020002;
   const int swapped = 1;
 
+  ops1_.node_left_right_swapped_changed = cb_node_left_right_swapped_changed;
+  ops2_.node_left_right_swapped_changed = cb_node_left_right_swapped_changed;
+  AddClients();
+
   cras_observer_notify_node_left_right_swapped(node_id, swapped);
   EXPECT_EQ(cras_alert_pending_alert_value,
             g_observer->alerts.node_left_right_swapped);
+  EXPECT_EQ(node_id, cras_alert_pending_keyed_data_key_value);
   ASSERT_EQ(cras_alert_pending_data_size_value, sizeof(*data));
   ASSERT_NE(cras_alert_pending_data_value, reinterpret_cast<void*>(NULL));
   data = reinterpret_cast<struct cras_observer_alert_data_node_lr_swapped*>(
@@ -601,8 +634,6 @@ TEST_F(ObserverTest, NotifyNodeLeftRightSwapped) {
   EXPECT_EQ(data->node_id, node_id);
   EXPECT_EQ(data->swapped, swapped);
 
-  ops1_.node_left_right_swapped_changed = cb_node_left_right_swapped_changed;
-  ops2_.node_left_right_swapped_changed = cb_node_left_right_swapped_changed;
   DoObserverAlert(node_left_right_swapped_alert, data);
   ASSERT_EQ(2, cb_node_left_right_swapped_changed_called);
   EXPECT_EQ(cb_node_left_right_swapped_changed_swapped[0], swapped);
@@ -618,8 +649,13 @@ TEST_F(ObserverTest, NotifyInputNodeGain) {
   const cras_node_id_t node_id = 0x0001000100020002;
   const int32_t gain = -20;
 
+  ops1_.input_node_gain_changed = cb_input_node_gain_changed;
+  ops2_.input_node_gain_changed = cb_input_node_gain_changed;
+  AddClients();
+
   cras_observer_notify_input_node_gain(node_id, gain);
   EXPECT_EQ(cras_alert_pending_alert_value, g_observer->alerts.input_node_gain);
+  EXPECT_EQ(node_id, cras_alert_pending_keyed_data_key_value);
   ASSERT_EQ(cras_alert_pending_data_size_value, sizeof(*data));
   ASSERT_NE(cras_alert_pending_data_value, reinterpret_cast<void*>(NULL));
   data = reinterpret_cast<struct cras_observer_alert_data_node_volume*>(
@@ -627,8 +663,6 @@ TEST_F(ObserverTest, NotifyInputNodeGain) {
   EXPECT_EQ(data->node_id, node_id);
   EXPECT_EQ(data->volume, gain);
 
-  ops1_.input_node_gain_changed = cb_input_node_gain_changed;
-  ops2_.input_node_gain_changed = cb_input_node_gain_changed;
   DoObserverAlert(input_node_gain_alert, data);
   ASSERT_EQ(2, cb_input_node_gain_changed_called);
   EXPECT_EQ(cb_input_node_gain_changed_gain[0], gain);
@@ -855,6 +889,10 @@ TEST_F(ObserverTest, NumArcStreamsChanged) {
 }
 
 TEST_F(ObserverTest, EwmaPowerReported) {
+  ops1_.ewma_power_reported = cb_ewma_power_reported;
+  ops2_.ewma_power_reported = cb_ewma_power_reported;
+  AddClients();
+
   cras_observer_notify_ewma_power_reported(1.0);
   EXPECT_EQ(cras_alert_pending_alert_value,
             g_observer->alerts.ewma_power_reported);
@@ -863,9 +901,6 @@ TEST_F(ObserverTest, EwmaPowerReported) {
           cras_alert_pending_data_value);
   EXPECT_EQ(data->power, 1.0);
 
-  ops1_.ewma_power_reported = cb_ewma_power_reported;
-  ops2_.ewma_power_reported = cb_ewma_power_reported;
-
   DoObserverAlert(ewma_power_reported_alert, data);
   ASSERT_EQ(cb_ewma_power_reported_called, 2);
   EXPECT_EQ(cb_ewma_power_reported_values, (std::vector<double>{1.0, 1.0}));
@@ -873,6 +908,28 @@ TEST_F(ObserverTest, EwmaPowerReported) {
   DoObserverRemoveClear(ewma_power_reported_alert, data);
 }
 
+TEST_F(ObserverTest, NoSubscriberSkipsNotify) {
+  // Changes no client is subscribed to are not queued.
+  ops1_.output_mute_changed = cb_output_mute_changed;
+  AddClients();
+  cras_observer_notify_output_volume(100);
+  cras_observer_notify_ewma_power_reported(1.0);
+  EXPECT_EQ(NULL, cras_alert_pending_alert_value);
+
+  // Until a client subscribes.
+  ops2_.output_volume_changed = cb_output_volume_changed;
+  cras_observer_set_ops(client2_, &ops2_);
+  cras_observer_notify_output_volume(100);
+  EXPECT_EQ(cras_alert_pending_alert_value, g_observer->alerts.output_volume);
+
+  // And again once it is gone.
+  cras_alert_pending_alert_value = NULL;
+  cras_observer_remove(client2_);
+  cras_observer_notify_output_volume(100);
+  EXPECT_EQ(NULL, cras_alert_pending_alert_value);
+  cras_observer_remove(client1_);
+}
+
 TEST_F(ObserverTest, SidetoneSupportedChanged) {
   cras_observer_notify_sidetone_supported_changed(true);
   EXPECT_EQ(cras_alert_pending_alert_value,
@@ -983,6 +1040,24 @@ void cras_alert_pending_data(struct cras_alert* alert,
   }
 }
 
+void cras_alert_pending_keyed_data(struct cras_alert* alert,
+                                   uint64_t key,
+                                   void* data,
+                                   size_t data_size) {
+  cras_alert_pending_keyed_data_key_value = key;
+  cras_alert_pending_data(alert, data, data_size);
+}
+
+void cras_alert_set_min_interval(struct cras_alert* alert,
+                                 struct cras_tm* tm,
+                                 unsigned int ms) {
+  cras_alert_set_min_interval_map[alert] = ms;
+}
+
+struct cras_tm* cras_system_state_get_tm() {
+  return NULL;
+}
+
 void cras_iodev_list_update_device_list() {
   cras_iodev_list_update_device_list_called++;
 }
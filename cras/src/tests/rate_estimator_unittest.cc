@@ -173,3 +173,35 @@ TEST(RateEstimatorTest, EstimateInputLinear2) {
 
   rate_estimator_destroy(re);
 }
+
+TEST(RateEstimatorTest, RobustEstimateOutputWithOutliers) {
+  struct rate_estimator* re;
+  struct timespec t = {.tv_sec = 1, .tv_nsec = 0};
+  static struct timespec robust_window = {.tv_sec = 1, .tv_nsec = 0};
+  int i, rc, level, written = 480;
+  int updates = 0;
+
+  re = rate_estimator_create_robust(48000, &robust_window, 0.0f);
+  ASSERT_NE(nullptr, re);
+  for (i = 0; i < 300; i++) {
+    // Device consumes 48010 frames per second, woken up every 10ms. Every
+    // 20th wake up reads the level 5ms late.
+    int consumed = 48010 * i / 100 + (i % 20 == 10 ? 240 : 0);
+    level = written - consumed;
+    rc = rate_estimator_check(re, level, &t);
+    updates += rc;
+
+    rate_estimator_add_frames(re, 960 - level);
+    written += 960 - level;
+    t.tv_nsec += 10000000;
+    if (t.tv_nsec >= 1000000000) {
+      t.tv_sec++;
+      t.tv_nsec -= 1000000000;
+    }
+  }
+  EXPECT_LE(2, updates);
+  EXPECT_LT(48009, rate_estimator_get_rate(re));
+  EXPECT_GT(48011, rate_estimator_get_rate(re));
+
+  rate_estimator_destroy(re);
+}
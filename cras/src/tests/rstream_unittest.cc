@@ -513,22 +513,35 @@ void ewma_power_init(struct ewma_power* ewma,
                      unsigned int rate) {}
 
 void ewma_power_calculate(struct ewma_power* ewma,
-                          const int16_t* buf,
+                          const uint8_t* buf,
                           unsigned int channels,
                           unsigned int size) {
+  const int16_t* samples = reinterpret_cast<const int16_t*>(buf);
   unsigned val = 0;
   for (unsigned int i = 0; i < size * channels; i += channels) {
-    val += buf[i];
+    val += samples[i];
   }
   (void)val;
 }
 
+void ewma_power_set_meter(struct ewma_power* ewma,
+                          struct cras_power_meter* meter) {}
+
 void cras_system_state_stream_added(enum CRAS_STREAM_DIRECTION direction,
                                     enum CRAS_CLIENT_TYPE client_type) {}
 
 void cras_system_state_stream_removed(enum CRAS_STREAM_DIRECTION direction,
                                       enum CRAS_CLIENT_TYPE client_type) {}
 
+struct cras_power_meter* cras_system_state_add_power_meter(
+    enum CRAS_POWER_METER_SOURCE source,
+    uint32_t id,
+    enum CRAS_STREAM_DIRECTION direction) {
+  return NULL;
+}
+
+void cras_system_state_remove_power_meter(struct cras_power_meter* meter) {}
+
 int cras_system_aec_on_dsp_supported() {
   return 0;
 }
@@ -133,11 +133,12 @@ TEST_F(SrBtAdaptersTest, FramesQueued) {
 
 TEST_F(SrBtAdaptersTest, DelayFrames) {
   cras_sr_set_frames_ratio(sr_, 3);
+  cras_sr_set_latency_frames(sr_, 480);
   fake_delay_frames_return_val = 3;
 
   const int delay_frames = cras_iodev_sr_bt_adapter_delay_frames(adapter_);
 
-  EXPECT_EQ(9, delay_frames);
+  EXPECT_EQ(489, delay_frames);
   EXPECT_EQ(1, fake_delay_frames_called);
 }
 
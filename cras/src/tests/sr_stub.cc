@@ -17,6 +17,7 @@ struct cras_sr {
   int16_t fake_output_value;
   float sample_rate_scale;
   size_t num_frames_per_run;
+  size_t latency_frames;
 };
 
 struct cras_sr* cras_sr_create(const struct cras_sr_model_spec spec,
@@ -78,4 +79,16 @@ void cras_sr_set_num_frames_per_run(struct cras_sr* sr,
                                     size_t num_frames_per_run) {
   sr->num_frames_per_run = num_frames_per_run;
 }
+
+size_t cras_sr_get_latency_frames(struct cras_sr* sr) {
+  return sr->latency_frames;
+}
+
+void cras_sr_set_latency_frames(struct cras_sr* sr, size_t latency_frames) {
+  sr->latency_frames = latency_frames;
+}
+
+void cras_sr_get_stats(struct cras_sr* sr, struct cras_sr_stats* stats) {
+  *stats = (struct cras_sr_stats){};
+}
 }
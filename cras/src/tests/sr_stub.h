@@ -22,6 +22,9 @@ void cras_sr_set_frames_ratio(struct cras_sr* sr, double frames_ratio);
 void cras_sr_set_num_frames_per_run(struct cras_sr* sr,
                                     size_t num_frames_per_run);
 
+// Sets the value returned by cras_sr_get_latency_frames.
+void cras_sr_set_latency_frames(struct cras_sr* sr, size_t latency_frames);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
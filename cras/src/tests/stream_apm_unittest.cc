@@ -30,8 +30,11 @@ static struct cras_stream_apm* stream;
 static struct cras_audio_area fake_audio_area;
 static unsigned int dsp_util_interleave_frames;
 static unsigned int webrtc_apm_process_stream_f_called;
+static float webrtc_apm_process_stream_f_first_sample;
+static float webrtc_apm_process_stream_f_last_sample;
 static unsigned int webrtc_apm_process_reverse_stream_f_called;
 static int webrtc_apm_create_called;
+static int webrtc_apm_destroy_called;
 static dictionary* webrtc_apm_create_aec_ini_val = NULL;
 static dictionary* webrtc_apm_create_apm_ini_val = NULL;
 static bool cras_apm_reverse_is_aec_use_case_ret;
@@ -48,6 +51,22 @@ static int cras_iodev_set_rtc_proc_enabled_called;
 static std::unordered_map<cras_iodev*, bool> iodev_rtc_proc_enabled_maps[3];
 static int cras_system_aec_on_dsp_supported_ret = 0;
 
+// Scale of the frame index held in the buffers from below.
+static const float kFrameIndexScale = 1.0f / 1024;
+
+/* Creates a stereo buffer of |frames| frames, at most 1024, holding the
+ * frame index scaled by |kFrameIndexScale|. */
+static struct float_buffer* create_frame_index_buffer(unsigned int frames) {
+  struct float_buffer* buf = float_buffer_create(frames, 2);
+  float* const* wp = float_buffer_write_pointer(buf);
+
+  for (unsigned int i = 0; i < frames; i++) {
+    wp[0][i] = wp[1][i] = i * kFrameIndexScale;
+  }
+  float_buffer_written(buf, frames);
+  return buf;
+}
+
 class StreamApm : public ::testing::Test {
   void SetUp() override {
     cras_thread_disarm_checks();
@@ -367,7 +386,7 @@ TEST_F(StreamApm, ApmProcessForwardBuffer) {
   buf = float_buffer_create(500, 2);
   float_buffer_written(buf, 300);
   webrtc_apm_process_stream_f_called = 0;
-  cras_stream_apm_process(apm, buf, 0, 1);
+  EXPECT_EQ(300, cras_stream_apm_process(apm, buf, 0, 0, 1));
   EXPECT_EQ(0, webrtc_apm_process_stream_f_called);
 
   area = cras_stream_apm_get_processed(apm);
@@ -375,7 +394,7 @@ TEST_F(StreamApm, ApmProcessForwardBuffer) {
 
   float_buffer_reset(buf);
   float_buffer_written(buf, 200);
-  cras_stream_apm_process(apm, buf, 0, 1);
+  EXPECT_EQ(180, cras_stream_apm_process(apm, buf, 0, 300, 1));
   area = cras_stream_apm_get_processed(apm);
   EXPECT_EQ(1, webrtc_apm_process_stream_f_called);
   EXPECT_EQ(480, dsp_util_interleave_frames);
@@ -387,14 +406,14 @@ TEST_F(StreamApm, ApmProcessForwardBuffer) {
   cras_stream_apm_put_processed(apm, 200);
   float_buffer_reset(buf);
   float_buffer_written(buf, 500);
-  cras_stream_apm_process(apm, buf, 0, 1);
+  EXPECT_EQ(480, cras_stream_apm_process(apm, buf, 0, 480, 1));
   EXPECT_EQ(1, webrtc_apm_process_stream_f_called);
 
   /* Put another 280 processed frames, so it's now ready for webrtc_apm
    * to process another chunk of 480 frames (10ms) data.
    */
   cras_stream_apm_put_processed(apm, 280);
-  cras_stream_apm_process(apm, buf, 0, 1);
+  EXPECT_EQ(0, cras_stream_apm_process(apm, buf, 480, 480, 1));
   EXPECT_EQ(2, webrtc_apm_process_stream_f_called);
 
   float_buffer_destroy(&buf);
@@ -429,6 +448,138 @@ TEST_F(StreamApm, StreamAddToAlreadyOpenedDev) {
   cras_stream_apm_deinit();
 }
 
+TEST_F(StreamApm, StreamJoinsSharedApmAtDeviceOffset) {
+  struct cras_audio_format fmt;
+  struct cras_stream_apm *stream1, *stream2;
+  struct cras_apm *apm1, *apm2;
+  struct float_buffer* buf;
+
+  fmt.num_channels = 2;
+  fmt.frame_rate = 48000;
+  fmt.format = SND_PCM_FORMAT_S16_LE;
+  init_channel_layout(&fmt);
+  fmt.channel_layout[CRAS_CH_FL] = 0;
+  fmt.channel_layout[CRAS_CH_FR] = 1;
+  cras_iodev_is_tuned_aec_use_case_value = 1;
+  cras_iodev_is_dsp_aec_use_case_value = 1;
+  cras_stream_apm_init("");
+
+  // Queue two blocks per stream.
+  idev->buffer_size = 960;
+  stream1 = cras_stream_apm_create(APM_ECHO_CANCELLATION);
+  stream2 = cras_stream_apm_create(APM_ECHO_CANCELLATION);
+  apm1 = cras_stream_apm_add(stream1, idev, &fmt, &fmt);
+  apm2 = cras_stream_apm_add(stream2, idev, &fmt, &fmt);
+  ASSERT_NE((void*)NULL, apm1);
+  ASSERT_NE((void*)NULL, apm2);
+
+  cras_stream_apm_start(stream1, idev);
+  buf = create_frame_index_buffer(960);
+  webrtc_apm_process_stream_f_called = 0;
+  EXPECT_EQ(480, cras_stream_apm_process(apm1, buf, 0, 0, 1));
+  EXPECT_EQ(1, webrtc_apm_process_stream_f_called);
+  EXPECT_EQ(0.0f, webrtc_apm_process_stream_f_first_sample);
+
+  /* The second stream joins at offset 0 while the first stream is 480 frames
+   * into the device buffer. It skips the frames the first stream fed and
+   * feeds the next block, rather than feeding the first block again. The
+   * gain pushes the end of the block past full scale, where it is clamped.
+   */
+  cras_stream_apm_start(stream2, idev);
+  EXPECT_EQ(960, cras_stream_apm_process(apm2, buf, 0, 0, 2));
+  EXPECT_EQ(2, webrtc_apm_process_stream_f_called);
+  EXPECT_EQ(2 * 480 * kFrameIndexScale,
+            webrtc_apm_process_stream_f_first_sample);
+  EXPECT_EQ(1.0f, webrtc_apm_process_stream_f_last_sample);
+  EXPECT_EQ(480, cras_stream_apm_get_processed(apm2)->frames);
+
+  // The first stream finds the next block already processed for it.
+  cras_stream_apm_put_processed(apm1, 480);
+  EXPECT_EQ(480, cras_stream_apm_process(apm1, buf, 480, 0, 1));
+  EXPECT_EQ(2, webrtc_apm_process_stream_f_called);
+  EXPECT_EQ(480, cras_stream_apm_get_processed(apm1)->frames);
+
+  cras_stream_apm_stop(stream1, idev);
+  cras_stream_apm_stop(stream2, idev);
+  cras_stream_apm_destroy(stream1);
+  cras_stream_apm_destroy(stream2);
+  idev->buffer_size = 0;
+
+  float_buffer_destroy(&buf);
+  cras_stream_apm_deinit();
+}
+
+TEST_F(StreamApm, StreamsShareApmOnSameDev) {
+  struct cras_audio_format fmt;
+  struct cras_stream_apm *stream1, *stream2, *stream3;
+  struct cras_apm *apm1, *apm2, *apm3;
+  struct float_buffer* buf;
+
+  fmt.num_channels = 2;
+  fmt.frame_rate = 48000;
+  fmt.format = SND_PCM_FORMAT_S16_LE;
+  init_channel_layout(&fmt);
+  fmt.channel_layout[CRAS_CH_FL] = 0;
+  fmt.channel_layout[CRAS_CH_FR] = 1;
+  cras_iodev_is_tuned_aec_use_case_value = 1;
+  cras_iodev_is_dsp_aec_use_case_value = 1;
+  cras_stream_apm_init("");
+
+  webrtc_apm_create_called = 0;
+  webrtc_apm_destroy_called = 0;
+  stream1 = cras_stream_apm_create(APM_ECHO_CANCELLATION);
+  stream2 = cras_stream_apm_create(APM_ECHO_CANCELLATION);
+  stream3 = cras_stream_apm_create(APM_NOISE_SUPRESSION);
+
+  apm1 = cras_stream_apm_add(stream1, idev, &fmt, &fmt);
+  apm2 = cras_stream_apm_add(stream2, idev, &fmt, &fmt);
+  ASSERT_NE((void*)NULL, apm1);
+  ASSERT_NE((void*)NULL, apm2);
+  EXPECT_NE(apm1, apm2);
+  EXPECT_EQ(1, webrtc_apm_create_called);
+
+  // Different effects get their own APM.
+  apm3 = cras_stream_apm_add(stream3, idev, &fmt, &fmt);
+  ASSERT_NE((void*)NULL, apm3);
+  EXPECT_EQ(2, webrtc_apm_create_called);
+
+  cras_stream_apm_start(stream1, idev);
+  cras_stream_apm_start(stream2, idev);
+
+  buf = create_frame_index_buffer(960);
+  webrtc_apm_process_stream_f_called = 0;
+  EXPECT_EQ(480, cras_stream_apm_process(apm1, buf, 0, 0, 1));
+  EXPECT_EQ(1, webrtc_apm_process_stream_f_called);
+  EXPECT_EQ(480, cras_stream_apm_get_processed(apm1)->frames);
+  EXPECT_EQ(480, cras_stream_apm_get_processed(apm2)->frames);
+
+  /* The second stream consumes the frames already processed for it and
+   * feeds the next block, but has not read its queue to process it. */
+  EXPECT_EQ(960, cras_stream_apm_process(apm2, buf, 0, 0, 1));
+  EXPECT_EQ(1, webrtc_apm_process_stream_f_called);
+
+  /* That does not hold back the first stream. The second stream's queue
+   * holds one block, so it loses its unread block for the new one. */
+  cras_stream_apm_put_processed(apm1, 480);
+  EXPECT_EQ(480, cras_stream_apm_process(apm1, buf, 480, 0, 1));
+  EXPECT_EQ(2, webrtc_apm_process_stream_f_called);
+  EXPECT_EQ(480 * kFrameIndexScale, webrtc_apm_process_stream_f_first_sample);
+  EXPECT_EQ(480, cras_stream_apm_get_processed(apm1)->frames);
+  EXPECT_EQ(480, cras_stream_apm_get_processed(apm2)->frames);
+
+  cras_stream_apm_stop(stream1, idev);
+  cras_stream_apm_destroy(stream1);
+  EXPECT_EQ(0, webrtc_apm_destroy_called);
+  cras_stream_apm_stop(stream2, idev);
+  cras_stream_apm_destroy(stream2);
+  EXPECT_EQ(1, webrtc_apm_destroy_called);
+  cras_stream_apm_destroy(stream3);
+  EXPECT_EQ(2, webrtc_apm_destroy_called);
+
+  float_buffer_destroy(&buf);
+  cras_stream_apm_deinit();
+}
+
 TEST_F(StreamApm, ReverseDevChanged) {
   cras_stream_apm_init("");
   EXPECT_NE((void*)NULL, output_devices_changed_callback);
@@ -832,6 +983,15 @@ void dsp_util_interleave(float* const* input,
                          int frames) {
   dsp_util_interleave_frames = frames;
 }
+void dsp_util_scale_clamp(const float* input,
+                          float* output,
+                          float gain,
+                          int frames) {
+  for (int i = 0; i < frames; i++) {
+    float f = input[i] * gain;
+    output[i] = f < -1 ? -1 : (f > 1 ? 1 : f);
+  }
+}
 struct aec_config* aec_config_get(const char* device_config_dir) {
   return NULL;
 }
@@ -854,13 +1014,16 @@ webrtc_apm webrtc_apm_create_with_enforced_effects(
 }
 void webrtc_apm_dump_configs(dictionary* aec_ini, dictionary* apm_ini) {}
 void webrtc_apm_destroy(webrtc_apm apm) {
-  return;
+  webrtc_apm_destroy_called++;
 }
 int webrtc_apm_process_stream_f(webrtc_apm ptr,
                                 int num_channels,
                                 int rate,
                                 float* const* data) {
   webrtc_apm_process_stream_f_called++;
+  webrtc_apm_process_stream_f_first_sample = data[0][0];
+  webrtc_apm_process_stream_f_last_sample =
+      data[0][rate / APM_NUM_BLOCKS_PER_SECOND - 1];
   return 0;
 }
 
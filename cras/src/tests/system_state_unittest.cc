@@ -3,9 +3,11 @@
 // found in the LICENSE file.
 
 #include <gtest/gtest.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
 #include <unordered_map>
+#include <vector>
 
 #include "cras/common/rust_common.h"
 #include "cras/server/s2/s2.h"
@@ -24,6 +26,12 @@ namespace {
 static struct cras_alsa_card* kFakeAlsaCards[SND_MAX_CARDS];
 size_t cras_alsa_card_create_called;
 size_t cras_alsa_card_destroy_called;
+static pthread_t cras_alsa_card_destroy_thread;
+static struct cras_alsa_card* const kFakePartialCard =
+    reinterpret_cast<struct cras_alsa_card*>(0x99);
+static size_t cras_alsa_card_probe_called;
+static size_t cras_alsa_card_attach_called;
+static std::vector<size_t> cras_alsa_card_attach_order;
 static size_t add_stub_called;
 static size_t rm_stub_called;
 static size_t add_task_stub_called;
@@ -58,6 +66,9 @@ std::unordered_map<const cras_alsa_card*, int> card_index_map;
 static void ResetStubData() {
   cras_alsa_card_create_called = 0;
   cras_alsa_card_destroy_called = 0;
+  cras_alsa_card_probe_called = 0;
+  cras_alsa_card_attach_called = 0;
+  cras_alsa_card_attach_order.clear();
   for (int i = 0; i < SND_MAX_CARDS; i++) {
     kFakeAlsaCards[i] = reinterpret_cast<struct cras_alsa_card*>(0x33 + i);
   }
@@ -344,6 +355,46 @@ TEST(SystemStateSuite, AddCard) {
   cras_system_state_deinit();
 }
 
+TEST(SystemStateSuite, AddCards) {
+  ResetStubData();
+  cras_alsa_card_info infos[6];
+  cras_alsa_card_info* info_ptrs[7];
+
+  for (int i = 0; i < 6; i++) {
+    infos[i].card_type = ALSA_CARD_TYPE_INTERNAL;
+    infos[i].card_index = i;
+    info_ptrs[i] = &infos[i];
+  }
+  // Duplicated card in the same batch is only added once.
+  info_ptrs[6] = &infos[2];
+  // Card 4 fails to probe.
+  kFakeAlsaCards[4] = NULL;
+
+  do_sys_init();
+  EXPECT_EQ(5, cras_system_add_alsa_cards(info_ptrs, 7));
+  EXPECT_EQ(6, cras_alsa_card_probe_called);
+  EXPECT_EQ(5, cras_alsa_card_attach_called);
+  // The partially probed card is destroyed on the calling thread.
+  EXPECT_EQ(1, cras_alsa_card_destroy_called);
+  EXPECT_TRUE(pthread_equal(pthread_self(), cras_alsa_card_destroy_thread));
+  // Cards are attached in the given order regardless of probe order.
+  ASSERT_EQ(5, cras_alsa_card_attach_order.size());
+  EXPECT_EQ(0, cras_alsa_card_attach_order[0]);
+  EXPECT_EQ(1, cras_alsa_card_attach_order[1]);
+  EXPECT_EQ(2, cras_alsa_card_attach_order[2]);
+  EXPECT_EQ(3, cras_alsa_card_attach_order[3]);
+  EXPECT_EQ(5, cras_alsa_card_attach_order[4]);
+  for (int i = 0; i < 6; i++) {
+    EXPECT_EQ(i != 4 ? 1 : 0, cras_system_alsa_card_exists(i));
+  }
+
+  // Cards already in the system are not probed again.
+  cras_alsa_card_probe_called = 0;
+  EXPECT_EQ(0, cras_system_add_alsa_cards(info_ptrs, 4));
+  EXPECT_EQ(0, cras_alsa_card_probe_called);
+  cras_system_state_deinit();
+}
+
 TEST(SystemSettingsRegisterSelectDescriptor, AddSelectFd) {
   void* stub_data = reinterpret_cast<void*>(44);
   void* select_data = reinterpret_cast<void*>(33);
@@ -445,6 +496,102 @@ TEST(SystemSettingsStreamCount, StreamCount) {
   cras_system_state_deinit();
 }
 
+TEST(SystemStateSuite, PowerMeters) {
+  struct cras_power_meter* meters[CRAS_MAX_POWER_METERS];
+  struct cras_server_state* s;
+  unsigned int i;
+
+  ResetStubData();
+  do_sys_init();
+  s = cras_system_state_get_no_lock();
+
+  meters[0] = cras_system_state_add_power_meter(CRAS_POWER_METER_STREAM,
+                                                0x10001, CRAS_STREAM_INPUT);
+  ASSERT_NE(nullptr, meters[0]);
+  EXPECT_EQ(CRAS_POWER_METER_STREAM, meters[0]->source);
+  EXPECT_EQ(0x10001, meters[0]->id);
+  EXPECT_EQ(CRAS_STREAM_INPUT, meters[0]->direction);
+  EXPECT_EQ(&s->power_meters[0], meters[0]);
+
+  for (i = 1; i < CRAS_MAX_POWER_METERS; i++) {
+    meters[i] = cras_system_state_add_power_meter(CRAS_POWER_METER_DEVICE, i,
+                                                  CRAS_STREAM_OUTPUT);
+    ASSERT_NE(nullptr, meters[i]);
+  }
+  // All meters are in use.
+  EXPECT_EQ(nullptr, cras_system_state_add_power_meter(
+                         CRAS_POWER_METER_DEVICE, 100, CRAS_STREAM_OUTPUT));
+
+  // A released meter is reused.
+  meters[3]->power = 0.5f;
+  cras_system_state_remove_power_meter(meters[3]);
+  EXPECT_EQ(CRAS_POWER_METER_NONE, s->power_meters[3].source);
+  EXPECT_EQ(meters[3], cras_system_state_add_power_meter(
+                           CRAS_POWER_METER_DEVICE, 100, CRAS_STREAM_OUTPUT));
+  EXPECT_EQ(0.0f, meters[3]->power);
+  EXPECT_EQ(100, meters[3]->id);
+
+  for (i = 0; i < CRAS_MAX_POWER_METERS; i++) {
+    cras_system_state_remove_power_meter(meters[i]);
+  }
+  cras_system_state_remove_power_meter(NULL);
+  cras_system_state_deinit();
+}
+
+TEST(SystemStateSuite, SectionUpdateCounts) {
+  struct cras_server_state* s;
+  uint32_t update_count, dev_list_update_count, client_list_update_count;
+
+  ResetStubData();
+  do_sys_init();
+  s = cras_system_state_get_no_lock();
+  update_count = s->update_count;
+  dev_list_update_count = s->dev_list_update_count;
+  client_list_update_count = s->client_list_update_count;
+
+  EXPECT_EQ(s, cras_system_state_update_section_begin(
+                   CRAS_SERVER_STATE_DEV_LIST));
+  // Both the whole state and the section are being updated.
+  EXPECT_EQ(1, s->update_count % 2);
+  EXPECT_EQ(1, s->dev_list_update_count % 2);
+  cras_system_state_update_section_complete(CRAS_SERVER_STATE_DEV_LIST);
+
+  EXPECT_EQ(update_count + 2, s->update_count);
+  EXPECT_EQ(dev_list_update_count + 2, s->dev_list_update_count);
+  // Other sections are untouched.
+  EXPECT_EQ(client_list_update_count, s->client_list_update_count);
+
+  cras_system_state_deinit();
+}
+
+TEST(SystemStateSuite, GetNodesIncludesExtensionTables) {
+  struct cras_server_state* s;
+  const struct cras_iodev_info* devs;
+  const struct cras_ionode_info* nodes;
+  struct cras_ionode_info active = {};
+
+  ResetStubData();
+  do_sys_init();
+  s = cras_system_state_get_no_lock();
+  s->num_input_devs = CRAS_MAX_IODEVS;
+  s->num_input_devs_total = CRAS_MAX_IODEVS + 1;
+  s->input_devs_ext[0].idx = 77;
+  s->num_input_nodes = CRAS_MAX_IONODES;
+  s->num_input_nodes_total = CRAS_MAX_IONODES + 2;
+  s->input_nodes_ext[1].iodev_idx = 77;
+  s->input_nodes_ext[1].active = 1;
+
+  EXPECT_EQ(CRAS_MAX_IODEVS + 1, cras_system_state_get_input_devs(&devs));
+  EXPECT_EQ(77, devs[CRAS_MAX_IODEVS].idx);
+  EXPECT_EQ(CRAS_MAX_IONODES + 2, cras_system_state_get_input_nodes(&nodes));
+  EXPECT_EQ(77, nodes[CRAS_MAX_IONODES + 1].iodev_idx);
+
+  get_active_input_node(&active);
+  EXPECT_EQ(77, active.iodev_idx);
+
+  cras_system_state_deinit();
+}
+
 TEST(SystemSettingsStreamCount, StreamCountByDirection) {
   ResetStubData();
   do_sys_init();
@@ -709,8 +856,32 @@ struct cras_alsa_card* cras_alsa_card_create(struct cras_alsa_card_info* info,
   return kFakeAlsaCards[cras_alsa_card_create_called++];
 }
 
+int cras_alsa_card_probe(struct cras_alsa_card_info* info,
+                         const char* device_config_dir,
+                         const char* ucm_suffix,
+                         struct cras_alsa_card** card) {
+  // Called from the probe workers, kFakeAlsaCards is indexed by card index.
+  __atomic_fetch_add(&cras_alsa_card_probe_called, 1, __ATOMIC_RELAXED);
+  if (kFakeAlsaCards[info->card_index] == NULL) {
+    *card = kFakePartialCard;
+    return -EIO;
+  }
+  *card = kFakeAlsaCards[info->card_index];
+  return 0;
+}
+
+int cras_alsa_card_attach(struct cras_alsa_card* alsa_card,
+                          struct cras_alsa_card_info* info) {
+  cras_alsa_card_attach_called++;
+  cras_alsa_card_attach_order.push_back(info->card_index);
+  card_type_map[alsa_card] = info->card_type;
+  card_index_map[alsa_card] = info->card_index;
+  return 0;
+}
+
 void cras_alsa_card_destroy(struct cras_alsa_card* alsa_card) {
   cras_alsa_card_destroy_called++;
+  cras_alsa_card_destroy_thread = pthread_self();
 }
 
 size_t cras_alsa_card_get_index(const struct cras_alsa_card* alsa_card) {
@@ -758,6 +929,8 @@ void cras_tm_deinit(cras_tm* tm) {
   free(tm);
 }
 
+void cras_tm_set_slack(cras_tm* tm, unsigned int ms) {}
+
 void cras_observer_notify_output_volume(int32_t volume) {
   cras_observer_notify_output_volume_called++;
 }
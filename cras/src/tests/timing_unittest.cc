@@ -22,6 +22,7 @@
 #include "third_party/utlist/utlist.h"
 
 struct audio_thread_event_log* atlog;
+struct audio_thread_trace* atlog_trace;
 
 #define FAKE_POLL_FD 33
 
@@ -65,16 +65,16 @@ size_t node_array_index_of_node_id(struct cras_ionode_info* nodes,
       return i;
     }
   }
-  return CRAS_MAX_IONODES;
+  return CRAS_MAX_IONODES_TOTAL;
 }
 
 const char* node_name_for_node_id(struct cras_client* client,
                                   enum CRAS_STREAM_DIRECTION dir,
                                   cras_node_id_t node_id) {
-  struct cras_ionode_info nodes[CRAS_MAX_IONODES];
-  struct cras_iodev_info devs[CRAS_MAX_IODEVS];
-  size_t num_devs = CRAS_MAX_IODEVS;
-  size_t num_nodes = CRAS_MAX_IONODES;
+  struct cras_ionode_info nodes[CRAS_MAX_IONODES_TOTAL];
+  struct cras_iodev_info devs[CRAS_MAX_IODEVS_TOTAL];
+  size_t num_devs = CRAS_MAX_IODEVS_TOTAL;
+  size_t num_nodes = CRAS_MAX_IONODES_TOTAL;
   uint32_t iodev_idx = dev_index_of(node_id);
   size_t node_index;
   char buf[1024];